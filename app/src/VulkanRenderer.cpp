@@ -12,6 +12,7 @@
 #include <QtGui/QWindow>
 
 #include <celengine/skygrid.h>
+#include <celengine/starcull.h>
 
 #include <vks/pipelines.hpp>
 #include "CloseEventFilter.h"
@@ -217,7 +218,7 @@ void VulkanRenderer::shutdown() {
 static const uint32_t LOOP_INTERVAL_MS = 10000;
 
 template <class OBJ, class PREC>
-class ObjectRenderer : public OctreeProcessor<OBJ, PREC> {
+class ObjectRenderer {
 public:
     ObjectRenderer(const Observer& observer, const PREC distanceLimit)
         : observer(observer)
@@ -265,14 +266,18 @@ class PointStarRenderer : public ObjectRenderer<Star, float> {
 public:
     PointStarRenderer(const Observer& observer, const StarDatabase& starDB)
         : ObjectRenderer<Star, float>(observer, STAR_DISTANCE_LIMIT)
-        , starDB(starDB) {}
+        , starDB(starDB)
+        , stars(starDB.getStarStore()) {}
 
-    void process(const StarPtr& star, float distance, float appMag) override;
+    void process(uint32_t starIndex, float distance, float appMag);
 
 public:
     Vector3d obsPos;
+    Vector3f obsPosf;
     //std::vector<RenderListEntry> renderList;
     const StarDatabase& starDB;
+    const StarStore& stars;
+    std::vector<VisibleStar> visibleStars;
     bool useScaledDiscs{ false };
     float maxDiscSize{ 1 };
     std::vector<size_t> indices;
@@ -310,15 +315,14 @@ static const float MaxScaledDiscStarSize = 8.0f;
 static const float GlareOpacity = 0.65f;
 static const float BaseStarDiscSize = 5.0f;
 
-void PointStarRenderer::process(const StarPtr& starPtr, float distance, float appMag) {
+void PointStarRenderer::process(uint32_t starIndex, float distance, float appMag) {
     nProcessed++;
-    const auto& star = *starPtr;
-    auto starPos = star.getPosition();
+    auto starPos = stars.getPosition(starIndex);
 
     // Calculate the difference at double precision *before* converting to float.
     // This is very important for stars that are far from the origin.
     Vector3f relPos = (starPos.cast<double>() - obsPos).cast<float>();
-    float orbitalRadius = star.getOrbitalRadius();
+    float orbitalRadius = stars.getOrbitalRadius(starIndex);
     bool hasOrbit = orbitalRadius > 0.0f;
 
     if (distance > distanceLimit)
@@ -331,7 +335,7 @@ void PointStarRenderer::process(const StarPtr& starPtr, float distance, float ap
     // cosFOV--this will cull many more stars than relPos*viewNormal, at the
     // cost of a normalize per star.
     if (relPos.dot(viewNormal) > 0.0f || relPos.x() * relPos.x() < 0.1f || hasOrbit) {
-        Color starColor = colorTemp->lookupColor(star.getTemperature());
+        Color starColor = colorTemp->lookupColor(stars.getTemperature(starIndex));
         float discSizeInPixels = 0.0f;
         float orbitSizeInPixels = 0.0f;
 
@@ -353,6 +357,7 @@ void PointStarRenderer::process(const StarPtr& starPtr, float distance, float ap
             // This is a much more accurate (and expensive) distance
             // calculation than the previous one which used the observer's
             // position rounded off to floats.
+            const auto& star = *starDB.getStar(starIndex);
             Vector3d hPos = astrocentricPosition(observer.getPosition(), star, observer.getTime());
             relPos = hPos.cast<float>() * -astro::kilometersToLightYears(1.0f), distance = relPos.norm();
 
@@ -404,7 +409,7 @@ void PointStarRenderer::process(const StarPtr& starPtr, float distance, float ap
 
             RenderListEntry rle;
             rle.renderableType = RenderListEntry::RenderableStar;
-            rle.star = starPtr;
+            rle.star = starDB.getStar(starIndex);
 
             // Objects in the render list are always rendered relative to
             // a viewer at the origin--this is different than for distant
@@ -734,31 +739,13 @@ void VulkanRenderer::renderSkyGrids(const Observer& observer) {
 void VulkanRenderer::renderDeepSkyObjects(const Universe& universe, const Observer& observer, const float faintestMagNight) {
 }
 
-StarOctree::Frustum computeFrustum(const Eigen::Vector3f& position, const Eigen::Quaternionf& orientation, float fovY, float aspectRatio) {
-    // Compute the bounding planes of an infinite view frustum
-    StarOctree::Frustum frustumPlanes;
-    Vector3f planeNormals[5];
-    Eigen::Matrix3f rot = orientation.toRotationMatrix();
-    float h = (float)tan(fovY / 2);
-    float w = h * aspectRatio;
-    planeNormals[0] = Vector3f(0.0f, 1.0f, -h);
-    planeNormals[1] = Vector3f(0.0f, -1.0f, -h);
-    planeNormals[2] = Vector3f(1.0f, 0.0f, -w);
-    planeNormals[3] = Vector3f(-1.0f, 0.0f, -w);
-    planeNormals[4] = Vector3f(0.0f, 0.0f, -1.0f);
-    for (int i = 0; i < 5; i++) {
-        planeNormals[i] = rot.transpose() * planeNormals[i].normalized();
-        frustumPlanes[i] = Hyperplane<float, 3>(planeNormals[i], position);
-    }
-    return frustumPlanes;
-}
-
 void VulkanRenderer::renderStars(const Observer& observer, const StarDatabase& starDB, float faintestMagNight) {
     //_context.deviceFeatures.largePoints
     Vector3d obsPos = observer.getPosition().toLy();
 
     PointStarRenderer starRenderer(observer, starDB);
     starRenderer.obsPos = obsPos;
+    starRenderer.obsPosf = obsPos.cast<float>();
     starRenderer.viewNormal = observer.getOrientationf().conjugate() * -Vector3f::UnitZ();
     starRenderer.pixelSize = pixelSize;
     starRenderer.brightnessScale = brightnessScale * corrFac;
@@ -782,8 +769,12 @@ void VulkanRenderer::renderStars(const Observer& observer, const StarDatabase& s
     //    starRenderer.brightnessScale *= 1.0f;
     //}
     //starRenderer.colorTemp = colorTemp;
-    auto frustum = computeFrustum(obsPos.cast<float>(), observer.getOrientationf(), fov, aspectRatio);
-    starDB.findVisibleStars(starRenderer, obsPos.cast<float>(), observer.getOrientationf(), frustum, faintestMagNight);
+    auto frustum = ComputeStarOctreeFrustum(obsPos.cast<float>(), observer.getOrientationf(), fov, aspectRatio);
+    // Culling runs on the thread pool; vertices are then built in octree order
+    starDB.findVisibleStars(starRenderer.visibleStars, starRenderer.obsPosf, frustum, faintestMagNight);
+    for (const auto& visible : starRenderer.visibleStars) {
+        starRenderer.process(visible.index, visible.distance, visible.appMag);
+    }
 
     auto updateStarVertices = [&](const PointStarRenderer::StarVertices& data, uint32_t& vertexCount, vks::Buffer& vertexBuffer) {
         uint32_t newSize = (uint32_t)data.size();
@@ -25,6 +25,10 @@
 #include <cstring>
 #include <cassert>
 #include <ctime>
+#include <chrono>
+#include <functional>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #include <celutil/util.h>
 #include <celutil/filetype.h>
@@ -32,6 +36,7 @@
 #include <celutil/formatnum.h>
 #include <celutil/debug.h>
 #include <celutil/utf8.h>
+#include <celutil/threadpool.h>
 #include <celmath/geomutil.h>
 #include <celastro/astro.h>
 #include <celengine/asterism.h>
@@ -43,6 +48,10 @@
 #include <celengine/render.h>
 #include <celengine/axisarrow.h>
 #include <celengine/planetgrid.h>
+#include <celengine/dsodb.h>
+#include <celengine/galaxy.h>
+#include <celengine/globular.h>
+#include <celutil/profiler.h>
 
 #include "favorites.h"
 #include "url.h"
@@ -286,6 +295,7 @@ void CelestiaCore::setStartURL(string url) {
 }
 
 void CelestiaCore::tick() {
+    PROFILE_ZONE("CelestiaCore::tick");
     double lastTime = sysTime;
     sysTime = timer->getTime();
 
@@ -302,66 +312,126 @@ void CelestiaCore::tick() {
     sim->update(dt);
 }
 
-class SolarSystemLoader : public EnumFilesHandler {
-public:
-    const UniversePtr& universe;
-    const ProgressNotifierPtr& notifier;
-    SolarSystemLoader(const UniversePtr& u, const ProgressNotifierPtr& pn) : universe(u), notifier(pn){};
-
-    bool process(const string& filename) {
-        if (DetermineFileType(filename) == Content_CelestiaCatalog) {
-            string fullname = getPath() + '/' + filename;
-            clog << _("Loading solar system catalog: ") << fullname << '\n';
-            if (notifier)
-                notifier->update(filename);
-
-            ifstream solarSysFile(fullname.c_str(), ios::in);
-            if (solarSysFile.good()) {
-                LoadSolarSystemObjects(solarSysFile, *universe, getPath());
+// Whether there's a binary catalog compiled from source that is at least as
+// recent as the source.
+static bool HaveCurrentBinaryCatalog(const string& source, const string& binary) {
+    struct stat binaryStat, sourceStat;
+    if (stat(binary.c_str(), &binaryStat) != 0)
+        return false;
+    return stat(source.c_str(), &sourceStat) != 0 || sourceStat.st_mtime <= binaryStat.st_mtime;
+}
+
+// A text catalog (.stc, .dsc or .ssc) staged for loading. Catalogs are read
+// and parsed concurrently, then applied to their databases one at a time in
+// the order they were listed, so that later catalogs override earlier ones
+// exactly as if they had been loaded sequentially. A deep sky catalog that
+// has a current binary version is mapped instead of parsed.
+struct StagedCatalog {
+    string filename;
+    string resourcePath;
+    // Listed explicitly in the config file, as opposed to found in an extras
+    // directory; these report errors more loudly.
+    bool listed;
+    bool opened{ false };
+    bool parsed{ false };
+    CatalogRecordList records;
+    storage::StoragePointer binary;
+
+    StagedCatalog(const string& filename, const string& resourcePath, bool listed) :
+        filename(filename), resourcePath(resourcePath), listed(listed) {}
+
+    void parse() {
+        if (DetermineFileType(filename) == Content_CelestiaDeepSkyCatalog) {
+            string binaryFilename = BinaryDSOCatalogFilename(filename);
+            if (HaveCurrentBinaryCatalog(filename, binaryFilename)) {
+                try {
+                    binary = storage::Storage::readFile(binaryFilename);
+                    opened = parsed = true;
+                    return;
+                } catch (const std::runtime_error&) {
+                }
             }
         }
 
-        return true;
-    };
+        storage::StoragePointer file;
+        try {
+            file = storage::Storage::readFile(filename);
+        } catch (const std::runtime_error&) {
+            return;
+        }
+        opened = true;
+        parsed = ReadCatalogRecords(file, records);
+    }
 };
 
-template <class OBJDB>
-class CatalogLoader : public EnumFilesHandler {
+using StagedCatalogList = vector<StagedCatalog>;
+
+class CatalogCollector : public EnumFilesHandler {
 public:
-    const std::shared_ptr<OBJDB>& objDB;
-    string typeDesc;
+    CatalogCollector(ContentType contentType, StagedCatalogList& catalogs) :
+        contentType(contentType), catalogs(catalogs) {}
+
+    bool process(const string& filename) {
+        if (DetermineFileType(filename) == contentType)
+            catalogs.emplace_back(getPath() + '/' + filename, getPath(), false);
+        return true;
+    }
+
+private:
     ContentType contentType;
-    const ProgressNotifierPtr& notifier;
+    StagedCatalogList& catalogs;
+};
 
-    CatalogLoader(const std::shared_ptr<OBJDB>& db,
-                  const std::string& typeDesc,
-                  const ContentType& contentType,
-                  const ProgressNotifierPtr& pn) :
-        objDB(db),
-        typeDesc(typeDesc), contentType(contentType), notifier(pn) {}
+static void collectCatalogs(const vector<string>& listedFiles,
+                            const vector<string>& dirs,
+                            ContentType contentType,
+                            StagedCatalogList& catalogs) {
+    for (const auto& file : listedFiles) {
+        if (!file.empty())
+            catalogs.emplace_back(file, "", true);
+    }
 
-    bool process(const string& filename) {
-        if (DetermineFileType(filename) == contentType) {
-            string fullname = getPath() + '/' + filename;
-            clog << _("Loading ") << typeDesc << " catalog: " << fullname << '\n';
-            if (notifier)
-                notifier->update(filename);
-
-            ifstream catalogFile(fullname.c_str(), ios::in);
-            if (catalogFile.good()) {
-                bool success = objDB->load(catalogFile, getPath());
-                if (!success) {
-                    //DPRINTF(0, _("Error reading star file: %s\n"), fullname.c_str());
-                    DPRINTF(0, "Error reading %s catalog file: %s\n", typeDesc.c_str(), fullname.c_str());
-                }
-            }
+    for (const auto& dirName : dirs) {
+        if (!dirName.empty()) {
+            auto dir = OpenDirectory(dirName);
+            CatalogCollector collector(contentType, catalogs);
+            collector.pushDir(dirName);
+            dir->enumFiles(collector, true);
         }
-        return true;
     }
+}
+
+// Logs the wall clock time of one stage of catalog loading and passes it on
+// to the progress notifier.
+class LoadStageTimer {
+public:
+    LoadStageTimer(const string& stage, const ProgressNotifierPtr& notifier) :
+        stage(stage), notifier(notifier), start(std::chrono::steady_clock::now()) {}
+
+    ~LoadStageTimer() {
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        clog << stage << ": " << ms << " ms\n";
+        if (notifier)
+            notifier->reportTiming(stage, ms);
+    }
+
+private:
+    string stage;
+    const ProgressNotifierPtr& notifier;
+    std::chrono::steady_clock::time_point start;
 };
 
-typedef CatalogLoader<StarDatabase> StarLoader;
-typedef CatalogLoader<DSODatabase> DeepSkyLoader;
+static void loadCrossIndex(const StarDatabasePtr& starDB, StarDatabase::Catalog catalog, const string& filename) {
+    if (!filename.empty()) {
+        ifstream xrefFile(filename.c_str(), ios::in | ios::binary);
+        if (xrefFile.good()) {
+            if (!starDB->loadCrossIndex(catalog, xrefFile))
+                cerr << _("Error reading cross index ") << filename << '\n';
+            else
+                clog << _("Loaded cross index ") << filename << '\n';
+        }
+    }
+}
 
 bool CelestiaCore::initSimulation(const string& configFileName,
                                   const vector<string>& extrasDirs,
@@ -413,79 +483,8 @@ bool CelestiaCore::initSimulation(const string& configFileName,
     // an empty list.
     universe = std::make_shared<Universe>();
 
-    /***** Load star catalogs *****/
-
-    if (!readStars(*config, progressNotifier)) {
-        fatalError(_("Cannot read star database."));
+    if (!loadCatalogs(extrasDirs, progressNotifier))
         return false;
-    }
-
-    /***** Load the deep sky catalogs *****/
-
-    auto dsoNameDB = std::make_shared<DSONameDatabase>();
-    auto dsoDB = std::make_shared<DSODatabase>();
-    dsoDB->setNameDatabase(dsoNameDB);
-
-    // Load first the vector of dsoCatalogFiles in the data directory (deepsky.dsc, globulars.dsc,...):
-
-    for (const auto& file : config->dsoCatalogFiles) {
-        if (progressNotifier)
-            progressNotifier->update(file);
-
-        ifstream dsoFile(file, ios::in);
-        if (!dsoFile.good()) {
-            cerr << _("Error opening deepsky catalog file.") << '\n';
-            return false;
-        } else if (!dsoDB->load(dsoFile, "")) {
-            cerr << "Cannot read Deep Sky Objects database." << '\n';
-            return false;
-        }
-    }
-
-    // Next, read all the deep sky files in the extras directories
-    {
-        for (const auto& dirName : extrasDirs) {
-            if (!dirName.empty()) {
-                auto dir = OpenDirectory(dirName);
-                DeepSkyLoader loader(dsoDB, "deep sky object", Content_CelestiaDeepSkyCatalog, progressNotifier);
-                loader.pushDir(dirName);
-                dir->enumFiles(loader, true);
-            }
-        }
-    }
-    dsoDB->finish();
-    universe->setDSOCatalog(dsoDB);
-
-    /***** Load the solar system catalogs *****/
-    // First read the solar system files listed individually in the
-    // config file.
-    {
-        auto solarSystemCatalog = std::make_shared<SolarSystemCatalog>();
-        universe->setSolarSystemCatalog(solarSystemCatalog);
-        for (const auto& file : config->solarSystemFiles) {
-            if (progressNotifier)
-                progressNotifier->update(file);
-
-            ifstream solarSysFile(file, ios::in);
-            if (!solarSysFile.good()) {
-                warning(_("Error opening solar system catalog.\n"));
-            } else {
-                LoadSolarSystemObjects(solarSysFile, *universe, "");
-            }
-        }
-    }
-
-    // Next, read all the solar system files in the extras directories
-    {
-        for (const auto& dirName : config->extrasDirs) {
-            if (!dirName.empty()) {
-                auto dir = OpenDirectory(dirName);
-                SolarSystemLoader loader(universe, progressNotifier);
-                loader.pushDir(dirName);
-                dir->enumFiles(loader, true);
-            }
-        }
-    }
 
     // Load asterisms:
     if (config->asterismsFile != "") {
@@ -525,91 +524,170 @@ bool CelestiaCore::initSimulation(const string& configFileName,
     return true;
 }
 
-static void loadCrossIndex(const StarDatabasePtr& starDB, StarDatabase::Catalog catalog, const string& filename) {
-    if (!filename.empty()) {
-        ifstream xrefFile(filename.c_str(), ios::in | ios::binary);
-        if (xrefFile.good()) {
-            if (!starDB->loadCrossIndex(catalog, xrefFile))
-                cerr << _("Error reading cross index ") << filename << '\n';
-            else
-                clog << _("Loaded cross index ") << filename << '\n';
+bool CelestiaCore::loadCatalogs(const vector<string>& extrasDirs, const ProgressNotifierPtr& progressNotifier) {
+    PROFILE_ZONE("CelestiaCore::loadCatalogs");
+    const CelestiaConfig& cfg = *config;
+    StarDetails::SetStarTextures(cfg.starTextures);
+
+    StagedCatalogList starCatalogs;
+    StagedCatalogList dsoCatalogs;
+    StagedCatalogList solarSystemCatalogs;
+    collectCatalogs(cfg.starCatalogFiles, cfg.extrasDirs, Content_CelestiaStarCatalog, starCatalogs);
+    collectCatalogs(cfg.dsoCatalogFiles, extrasDirs, Content_CelestiaDeepSkyCatalog, dsoCatalogs);
+    collectCatalogs(cfg.solarSystemFiles, cfg.extrasDirs, Content_CelestiaCatalog, solarSystemCatalogs);
+
+    auto starDB = std::make_shared<StarDatabase>();
+    StarNameDatabase::Pointer starNameDB;
+    bool starNamesOpened = false;
+    bool starsOpened = true;
+    bool starsLoaded = true;
+
+    // Stage 1: read every file. None of these depend on each other: the
+    // binary star database and the cross indexes fill separate members of
+    // the star database, and text catalogs are only parsed into records.
+    {
+        LoadStageTimer timer(_("Reading catalogs"), progressNotifier);
+        if (progressNotifier)
+            progressNotifier->update(_("Reading catalogs"));
+
+        vector<std::function<void()>> tasks;
+        tasks.push_back([&] {
+            ifstream starNamesFile(cfg.starNamesFile.c_str(), ios::in);
+            starNamesOpened = starNamesFile.good();
+            if (starNamesOpened)
+                starNameDB = StarNameDatabase::readNames(starNamesFile);
+        });
+        if (!cfg.starDatabaseFile.empty()) {
+            tasks.push_back([&] {
+                storage::StoragePointer starFile;
+                try {
+                    starFile = storage::Storage::readFile(cfg.starDatabaseFile);
+                } catch (const std::runtime_error&) {
+                    starsOpened = false;
+                    return;
+                }
+                starsLoaded = starDB->loadBinary(starFile);
+            });
+        }
+        tasks.push_back([&] { loadCrossIndex(starDB, StarDatabase::HenryDraper, cfg.HDCrossIndexFile); });
+        tasks.push_back([&] { loadCrossIndex(starDB, StarDatabase::SAO, cfg.SAOCrossIndexFile); });
+        tasks.push_back([&] { loadCrossIndex(starDB, StarDatabase::Gliese, cfg.GlieseCrossIndexFile); });
+        // Build the galaxy and globular forms now rather than when the first
+        // deep sky catalog needs them
+        tasks.push_back([&] { Galaxy::initializeForms(cfg.galaxyFormCacheFile); });
+        tasks.push_back([&] { Globular::initializeForms(cfg.globularFormCacheFile); });
+        for (auto catalogs : { &starCatalogs, &dsoCatalogs, &solarSystemCatalogs }) {
+            for (auto& catalog : *catalogs)
+                tasks.push_back([&catalog] { catalog.parse(); });
         }
-    }
-}
 
-bool CelestiaCore::readStars(const CelestiaConfig& cfg, const ProgressNotifierPtr& progressNotifier) {
-    StarDetails::SetStarTextures(cfg.starTextures);
+        ThreadPool::getDefault().parallelFor(tasks.size(), [&tasks](size_t i) { tasks[i](); });
+    }
 
-    ifstream starNamesFile(cfg.starNamesFile.c_str(), ios::in);
-    if (!starNamesFile.good()) {
+    if (!starNamesOpened) {
         cerr << _("Error opening ") << cfg.starNamesFile << '\n';
+        fatalError(_("Cannot read star database."));
         return false;
     }
-
-    auto starNameDB = StarNameDatabase::readNames(starNamesFile);
     if (starNameDB == NULL) {
         cerr << _("Error reading star names file\n");
+        fatalError(_("Cannot read star database."));
         return false;
     }
-
-    // First load the binary star database file.  The majority of stars
-    // will be defined here.
-    auto starDB = std::make_shared<StarDatabase>();
-    if (!cfg.starDatabaseFile.empty()) {
-        if (progressNotifier)
-            progressNotifier->update(cfg.starDatabaseFile);
-
-        ifstream starFile(cfg.starDatabaseFile.c_str(), ios::in | ios::binary);
-        if (!starFile.good()) {
-            cerr << _("Error opening ") << cfg.starDatabaseFile << '\n';
-            return false;
-        }
-
-        if (!starDB->loadBinary(starFile)) {
-            cerr << _("Error reading stars file\n");
-            return false;
-        }
+    if (!starsOpened) {
+        cerr << _("Error opening ") << cfg.starDatabaseFile << '\n';
+        fatalError(_("Cannot read star database."));
+        return false;
+    }
+    if (!starsLoaded) {
+        cerr << _("Error reading stars file\n");
+        fatalError(_("Cannot read star database."));
+        return false;
     }
 
+    // Stage 2: apply the text catalogs in their original order; Replace and
+    // Modify dispositions depend on everything loaded before them.
     starDB->setNameDatabase(starNameDB);
-
-    loadCrossIndex(starDB, StarDatabase::HenryDraper, cfg.HDCrossIndexFile);
-    loadCrossIndex(starDB, StarDatabase::SAO, cfg.SAOCrossIndexFile);
-    loadCrossIndex(starDB, StarDatabase::Gliese, cfg.GlieseCrossIndexFile);
-
-    // Next, read any ASCII star catalog files specified in the StarCatalogs
-    // list.
-    if (!cfg.starCatalogFiles.empty()) {
-        for (const auto& filename : config->starCatalogFiles) {
-            if (!filename.empty()) {
-                ifstream starFile(filename, ios::in);
-                if (starFile.good()) {
-                    starDB->load(starFile, "");
-                } else {
-                    cerr << _("Error opening star catalog ") << filename << '\n';
-                }
+    {
+        LoadStageTimer timer(_("Merging star catalogs"), progressNotifier);
+        for (const auto& catalog : starCatalogs) {
+            if (!catalog.opened) {
+                if (catalog.listed)
+                    cerr << _("Error opening star catalog ") << catalog.filename << '\n';
+                continue;
+            }
+            clog << _("Loading star catalog: ") << catalog.filename << '\n';
+            if (progressNotifier)
+                progressNotifier->update(catalog.filename);
+            if (!starDB->load(catalog.records, catalog.resourcePath) || !catalog.parsed) {
+                DPRINTF(0, "Error reading star catalog file: %s\n", catalog.filename.c_str());
             }
         }
     }
 
-    // Now, read supplemental star files from the extras directories
-    for (const auto& dirName : config->extrasDirs) {
-        if (!dirName.empty()) {
-            auto dir = OpenDirectory(dirName);
-            StarLoader loader(starDB, "star", Content_CelestiaStarCatalog, progressNotifier);
-            loader.pushDir(dirName);
-            dir->enumFiles(loader, true);
+    auto dsoDB = std::make_shared<DSODatabase>();
+    dsoDB->setNameDatabase(std::make_shared<DSONameDatabase>());
+    {
+        LoadStageTimer timer(_("Merging deep sky catalogs"), progressNotifier);
+        for (const auto& catalog : dsoCatalogs) {
+            if (catalog.listed && !catalog.opened) {
+                cerr << _("Error opening deepsky catalog file.") << '\n';
+                return false;
+            }
+            if (!catalog.opened)
+                continue;
+            clog << _("Loading deep sky object catalog: ") << catalog.filename << '\n';
+            if (progressNotifier)
+                progressNotifier->update(catalog.filename);
+            bool loaded = catalog.binary ? dsoDB->loadBinary(catalog.binary, catalog.resourcePath)
+                                         : dsoDB->load(catalog.records, catalog.resourcePath);
+            if (!loaded || !catalog.parsed) {
+                if (catalog.listed) {
+                    cerr << "Cannot read Deep Sky Objects database." << '\n';
+                    return false;
+                }
+                DPRINTF(0, "Error reading deep sky object catalog file: %s\n", catalog.filename.c_str());
+            }
         }
     }
 
-    starDB->finish();
-
+    // Stage 3: sorting the stars and deep sky objects into their octrees
+    // are independent of each other.
+    {
+        LoadStageTimer timer(_("Building octrees"), progressNotifier);
+        starDB->setOctreeCacheFile(cfg.starOctreeCacheFile);
+        ThreadPool::getDefault().parallelFor(2, [&](size_t i) {
+            if (i == 0)
+                starDB->finish();
+            else
+                dsoDB->finish();
+        });
+    }
     universe->setStarCatalog(starDB);
+    universe->setDSOCatalog(dsoDB);
+
+    // Stage 4: solar systems refer to their stars and to each other, so they
+    // are applied last and in order.
+    {
+        LoadStageTimer timer(_("Loading solar systems"), progressNotifier);
+        auto solarSystemCatalog = std::make_shared<SolarSystemCatalog>();
+        universe->setSolarSystemCatalog(solarSystemCatalog);
+        for (const auto& catalog : solarSystemCatalogs) {
+            if (!catalog.opened) {
+                if (catalog.listed)
+                    warning(_("Error opening solar system catalog.\n"));
+                continue;
+            }
+            clog << _("Loading solar system catalog: ") << catalog.filename << '\n';
+            if (progressNotifier)
+                progressNotifier->update(catalog.filename);
+            LoadSolarSystemObjects(catalog.records, *universe, catalog.resourcePath);
+        }
+    }
 
     return true;
 }
 
-
 /// Set faintest visible star magnitude and saturation magnitude
 /// for a given field of view;
 /// adjust the renderer's brightness parameters appropriately.
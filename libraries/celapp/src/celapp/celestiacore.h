@@ -94,6 +94,8 @@ public:
     virtual ~ProgressNotifier(){};
 
     virtual void update(const std::string&) = 0;
+    // Called once each stage of catalog loading completes
+    virtual void reportTiming(const std::string& /*stage*/, double /*milliseconds*/) {}
 };
 
 using ProgressNotifierPtr = std::shared_ptr<ProgressNotifier>;
@@ -330,7 +332,7 @@ public:
     bool referenceMarkEnabled(const std::string& refMark, Selection sel = {}) const;
 
 private:
-    bool readStars(const CelestiaConfig&, const ProgressNotifierPtr&);
+    bool loadCatalogs(const std::vector<std::string>& extrasDirs, const ProgressNotifierPtr&);
     void fatalError(const std::string&);
 
 private:
@@ -86,6 +86,12 @@ CelestiaConfig::Pointer ReadCelestiaConfig(const string& filename, CelestiaConfi
     config->boundariesFile = WordExp(config->boundariesFile);
     configParams->getString("StarDatabase", config->starDatabaseFile);
     config->starDatabaseFile = WordExp(config->starDatabaseFile);
+    configParams->getString("StarOctreeCache", config->starOctreeCacheFile);
+    config->starOctreeCacheFile = WordExp(config->starOctreeCacheFile);
+    configParams->getString("GalaxyFormCache", config->galaxyFormCacheFile);
+    config->galaxyFormCacheFile = WordExp(config->galaxyFormCacheFile);
+    configParams->getString("GlobularFormCache", config->globularFormCacheFile);
+    config->globularFormCacheFile = WordExp(config->globularFormCacheFile);
     configParams->getString("StarNameDatabase", config->starNamesFile);
     config->starNamesFile = WordExp(config->starNamesFile);
     configParams->getString("HDCrossIndex", config->HDCrossIndexFile);
@@ -20,6 +20,9 @@ class CelestiaConfig {
 public:
     using Pointer = std::shared_ptr<CelestiaConfig>;
     std::string starDatabaseFile;
+    std::string starOctreeCacheFile;
+    std::string galaxyFormCacheFile;
+    std::string globularFormCacheFile;
     std::string starNamesFile;
     std::vector<std::string> solarSystemFiles;
     std::vector<std::string> starCatalogFiles;
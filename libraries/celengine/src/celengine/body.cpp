@@ -299,6 +299,8 @@ Matrix4d Body::getLocalToAstrocentric(double tdb) const {
 Vector3d Body::getAstrocentricPosition(double tdb) const {
     // TODO: Switch the iterative method used in getPosition
     auto phase = timeline->findPhase(tdb);
+    if (phase->getFrameTree())
+        return phase->getFrameTree()->getAstrocentricPosition(*phase, tdb);
     return phase->orbitFrame()->convertToAstrocentric(phase->orbit()->positionAtTime(tdb), tdb);
 }
 
@@ -555,9 +557,10 @@ void Body::computeLocations() {
             v.normalize();
         v *= (float)boundingRadius;
 
-        Ray3d ray(v.cast<double>(), -v.cast<double>());
+        // Model::pick answers this from the mesh BVHs, so placing many
+        // locations on a detailed shape model stays cheap.
         double t = 0.0;
-        if (g->pick(ray, t)) {
+        if (g->pick(v.cast<double>(), -v.cast<double>(), t)) {
             v *= (float)((1.0 - t) * radius + alt);
             location->setPosition(v);
         }
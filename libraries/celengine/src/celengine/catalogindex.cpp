@@ -0,0 +1,50 @@
+// catalogindex.cpp
+//
+// Copyright (C) 2001-2009, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "catalogindex.h"
+
+#include <cassert>
+
+void CatalogIndex::reset(size_t count) {
+    // Keep the load factor at or below 3/4 so probe sequences stay short
+    uint32_t bits = 1;
+    while (((size_t)1 << bits) * 3 < count * 4)
+        ++bits;
+
+    slots.assign((size_t)1 << bits, Slot{ EmptyKey, InvalidValue });
+    mask = (uint32_t)(slots.size() - 1);
+    shift = 32 - bits;
+    entryCount = 0;
+}
+
+void CatalogIndex::insert(uint32_t key, uint32_t value) {
+    if (key == EmptyKey)
+        return;
+    assert(slots.size() * 3 >= (entryCount + 1) * 4);
+
+    for (uint32_t slot = hash(key);; slot = (slot + 1) & mask) {
+        Slot& s = slots[slot];
+        if (s.key == key)
+            return;
+        if (s.key == EmptyKey) {
+            s.key = key;
+            s.value = value;
+            ++entryCount;
+            return;
+        }
+    }
+}
+
+void CatalogIndex::clear() {
+    slots.clear();
+    slots.shrink_to_fit();
+    mask = 0;
+    shift = 32;
+    entryCount = 0;
+}
@@ -0,0 +1,70 @@
+// catalogindex.h
+//
+// Copyright (C) 2001-2009, the Celestia Development Team
+//
+// Read-mostly hash table keyed by catalog number.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef _CELENGINE_CATALOGINDEX_H_
+#define _CELENGINE_CATALOGINDEX_H_
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Maps a 32-bit catalog number to a 32-bit value (another catalog number or
+// an index into a star or DSO array). The table is built in one go and then
+// only read, so it uses open addressing with linear probing over a single
+// flat array: a lookup is a multiply, a shift and usually one cache line,
+// and never allocates.
+//
+// The catalog number ~0 is reserved to mark empty slots; it is also the
+// invalid catalog number of both stars and DSOs, so it is never a real key.
+class CatalogIndex {
+public:
+    static const uint32_t InvalidValue = ~(uint32_t)0;
+
+    // Prepare for up to count insertions; existing entries are discarded.
+    void reset(size_t count);
+    // Insert a mapping unless the key is already present; as with a search of
+    // the original list, the first entry for a key wins.
+    void insert(uint32_t key, uint32_t value);
+    void clear();
+
+    inline uint32_t find(uint32_t key) const {
+        if (entryCount == 0 || key == EmptyKey)
+            return InvalidValue;
+        for (uint32_t slot = hash(key);; slot = (slot + 1) & mask) {
+            const Slot& s = slots[slot];
+            if (s.key == key)
+                return s.value;
+            if (s.key == EmptyKey)
+                return InvalidValue;
+        }
+    }
+
+    inline size_t size() const { return entryCount; }
+
+private:
+    static const uint32_t EmptyKey = ~(uint32_t)0;
+
+    struct Slot {
+        uint32_t key;
+        uint32_t value;
+    };
+
+    // Fibonacci hashing: catalog numbers are often dense runs, which this
+    // spreads evenly over the table.
+    inline uint32_t hash(uint32_t key) const { return (uint32_t)((key * 2654435769u) >> shift); }
+
+    std::vector<Slot> slots;
+    uint32_t mask{ 0 };
+    uint32_t shift{ 32 };
+    size_t entryCount{ 0 };
+};
+
+#endif  // _CELENGINE_CATALOGINDEX_H_
@@ -0,0 +1,60 @@
+// catalogrecord.cpp
+//
+// Copyright (C) 2001-2009, the Celestia Development Team
+// Original version by Chris Laurel <claurel@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "catalogrecord.h"
+#include <celutil/debug.h>
+#include <celutil/profiler.h>
+
+using namespace std;
+
+static bool ReadCatalogRecords(Tokenizer& tokenizer, CatalogRecordList& records) {
+    PROFILE_ZONE("ReadCatalogRecords");
+    Parser parser(&tokenizer);
+
+    while (tokenizer.nextToken() != Tokenizer::TokenEnd) {
+        CatalogRecord record;
+        record.lineNumber = tokenizer.getLineNumber();
+
+        for (;;) {
+            auto tokenType = tokenizer.getTokenType();
+            if (tokenType == Tokenizer::TokenName) {
+                record.header.push_back({ tokenType, tokenizer.getNameValue(), 0.0 });
+            } else if (tokenType == Tokenizer::TokenString) {
+                record.header.push_back({ tokenType, tokenizer.getStringValue(), 0.0 });
+            } else if (tokenType == Tokenizer::TokenNumber) {
+                record.header.push_back({ tokenType, string(), tokenizer.getNumberValue() });
+            } else {
+                break;
+            }
+            tokenizer.nextToken();
+        }
+
+        tokenizer.pushBack();
+        record.value = parser.readValue();
+        if (record.value == NULL) {
+            cerr << "Error in catalog file (line " << tokenizer.getLineNumber() << "): bad object definition\n";
+            return false;
+        }
+
+        records.push_back(std::move(record));
+    }
+
+    return true;
+}
+
+bool ReadCatalogRecords(istream& in, CatalogRecordList& records) {
+    Tokenizer tokenizer(&in);
+    return ReadCatalogRecords(tokenizer, records);
+}
+
+bool ReadCatalogRecords(const storage::StoragePointer& file, CatalogRecordList& records) {
+    Tokenizer tokenizer(file);
+    return ReadCatalogRecords(tokenizer, records);
+}
@@ -0,0 +1,65 @@
+// catalogrecord.h
+//
+// Copyright (C) 2001-2009, the Celestia Development Team
+// Original version by Chris Laurel <claurel@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef _CELENGINE_CATALOGRECORD_H_
+#define _CELENGINE_CATALOGRECORD_H_
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include "parser.h"
+
+// The text catalogs (.stc, .dsc and .ssc files) are all a sequence of
+// definitions made of a few header tokens (disposition, object type, catalog
+// number, names) followed by a property hash. Reading a catalog into records
+// depends on nothing but the file itself, so catalogs can be parsed
+// concurrently and then applied to their databases in a fixed order.
+struct CatalogToken {
+    Tokenizer::TokenType type;
+    std::string text;
+    double number;
+};
+
+struct CatalogRecord {
+    std::vector<CatalogToken> header;
+    ValuePtr value;
+    int lineNumber;
+};
+
+using CatalogRecordList = std::vector<CatalogRecord>;
+
+// Walks the header tokens of a record; past the last token the type is
+// TokenEnd, which lets the catalog loaders mirror their old token stream
+// handling.
+class CatalogHeaderReader {
+public:
+    CatalogHeaderReader(const CatalogRecord& record) : header(record.header) {}
+
+    Tokenizer::TokenType getTokenType() const { return atEnd() ? Tokenizer::TokenEnd : header[position].type; }
+    const std::string& getNameValue() const { return header[position].text; }
+    const std::string& getStringValue() const { return header[position].text; }
+    double getNumberValue() const { return header[position].number; }
+    void next() { ++position; }
+    bool atEnd() const { return position >= header.size(); }
+
+private:
+    const std::vector<CatalogToken>& header;
+    size_t position{ 0 };
+};
+
+// Appends every definition in the stream to records. Returns false on a
+// syntax error; the definitions read before the error are kept so that
+// callers can apply them just as the old incremental loaders did.
+bool ReadCatalogRecords(std::istream& in, CatalogRecordList& records);
+// The same for a file read through Storage; tokenizing straight out of the
+// mapping avoids the per character stream overhead.
+bool ReadCatalogRecords(const storage::StoragePointer& file, CatalogRecordList& records);
+
+#endif  // _CELENGINE_CATALOGRECORD_H_
@@ -0,0 +1,75 @@
+// completionindex.cpp
+//
+// Copyright (C) 2001-2009, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "completionindex.h"
+
+#include <algorithm>
+#include <cstring>
+#include <celutil/utf8.h>
+
+using namespace std;
+
+static int compareBytes(const char* a, size_t aLength, const char* b, size_t bLength) {
+    int result = memcmp(a, b, std::min(aLength, bLength));
+    if (result != 0)
+        return result;
+    return aLength < bLength ? -1 : (aLength > bLength ? 1 : 0);
+}
+
+void CompletionIndex::clear() {
+    pool.clear();
+    entries.clear();
+}
+
+void CompletionIndex::add(const string& name) {
+    string key = UTF8NormalizeString(name);
+
+    Entry entry;
+    entry.key = (uint32_t)pool.size();
+    entry.keyLength = (uint32_t)key.length();
+    pool += key;
+    entry.name = (uint32_t)pool.size();
+    entry.nameLength = (uint32_t)name.length();
+    pool += name;
+    entries.push_back(entry);
+}
+
+void CompletionIndex::build() {
+    const char* data = pool.data();
+    auto compare = [data](const Entry& a, const Entry& b) {
+        int result = compareBytes(data + a.key, a.keyLength, data + b.key, b.keyLength);
+        if (result == 0)
+            result = compareBytes(data + a.name, a.nameLength, data + b.name, b.nameLength);
+        return result;
+    };
+
+    std::sort(entries.begin(), entries.end(), [&compare](const Entry& a, const Entry& b) { return compare(a, b) < 0; });
+    entries.erase(std::unique(entries.begin(), entries.end(),
+                              [&compare](const Entry& a, const Entry& b) { return compare(a, b) == 0; }),
+                  entries.end());
+    entries.shrink_to_fit();
+}
+
+int CompletionIndex::compareKey(const Entry& entry, const char* s, size_t length) const {
+    return compareBytes(pool.data() + entry.key, entry.keyLength, s, length);
+}
+
+void CompletionIndex::find(const string& prefix, size_t maxCount, vector<string>& completion) const {
+    string key = UTF8NormalizeString(prefix);
+
+    auto iter = std::lower_bound(entries.begin(), entries.end(), key, [this](const Entry& entry, const string& k) {
+        return compareKey(entry, k.data(), k.length()) < 0;
+    });
+
+    for (size_t count = 0; iter != entries.end() && count < maxCount; ++iter, ++count) {
+        if (iter->keyLength < key.length() || memcmp(pool.data() + iter->key, key.data(), key.length()) != 0)
+            break;
+        completion.emplace_back(pool, iter->name, iter->nameLength);
+    }
+}
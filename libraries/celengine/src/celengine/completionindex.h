@@ -0,0 +1,55 @@
+// completionindex.h
+//
+// Copyright (C) 2001-2009, the Celestia Development Team
+//
+// Sorted prefix index over object names, used for search completion.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef _CELENGINE_COMPLETIONINDEX_H_
+#define _CELENGINE_COMPLETIONINDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Names are stored with their normalized form (see UTF8NormalizeString) in a
+// single character pool and sorted by it, so all names starting with a given
+// prefix form one contiguous range. A lookup is a binary search followed by a
+// walk over the matches, and costs nothing for the names that don't match.
+//
+// Matches are returned in normalized order, ties broken by the names
+// themselves, so the result doesn't depend on the order the names were added.
+class CompletionIndex {
+public:
+    void clear();
+    void add(const std::string& name);
+    // Sort the names added so far and drop duplicates; must be called
+    // before find.
+    void build();
+
+    // Append up to maxCount names whose normalized form starts with the
+    // normalized prefix.
+    void find(const std::string& prefix, size_t maxCount, std::vector<std::string>& completion) const;
+
+    size_t size() const { return entries.size(); }
+
+private:
+    struct Entry {
+        uint32_t key;  // offsets into pool
+        uint32_t keyLength;
+        uint32_t name;
+        uint32_t nameLength;
+    };
+
+    int compareKey(const Entry& entry, const char* s, size_t length) const;
+
+    std::string pool;
+    std::vector<Entry> entries;
+};
+
+#endif  // _CELENGINE_COMPLETIONINDEX_H_
@@ -90,6 +90,23 @@ void DeepSkyObject::setInfoURL(const string& s) {
         *infoURL = s;
 }
 
+/*! Make an info URL given in a catalog relative to the directory of the
+ *  catalog, resPath, unless it's already absolute.
+ */
+string DeepSkyObject::resolveInfoURL(const string& infoURL, const string& resPath) {
+    if (infoURL.find(':') != string::npos)
+        return infoURL;
+
+    // Relative URL, the base directory is the current one,
+    // not the main installation directory
+    if (resPath.size() > 1 && resPath[1] == ':')
+        // Absolute Windows path, file:/// is required
+        return "file:///" + resPath + "/" + infoURL;
+    else if (!resPath.empty())
+        return resPath + "/" + infoURL;
+    return infoURL;
+}
+
 bool DeepSkyObject::pick(const Ray3d& ray, double& distanceToPicker, double& cosAngleToBoundCenter) const {
     if (isVisible())
         return testIntersection(ray, Sphered(position, (double)radius), distanceToPicker, cosAngleToBoundCenter);
@@ -191,18 +208,8 @@ bool DeepSkyObject::load(const HashPtr& params, const string& resPath) {
         setAbsoluteMagnitude((float)absMag);
 
     string infoURL;
-    if (params->getString("InfoURL", infoURL)) {
-        if (infoURL.find(':') == string::npos) {
-            // Relative URL, the base directory is the current one,
-            // not the main installation directory
-            if (resPath[1] == ':')
-                // Absolute Windows path, file:/// is required
-                infoURL = "file:///" + resPath + "/" + infoURL;
-            else if (!resPath.empty())
-                infoURL = resPath + "/" + infoURL;
-        }
-        setInfoURL(infoURL);
-    }
+    if (params->getString("InfoURL", infoURL))
+        setInfoURL(resolveInfoURL(infoURL, resPath));
 
     bool visible = true;
     if (params->getBoolean("Visible", visible)) {
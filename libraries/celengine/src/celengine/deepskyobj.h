@@ -66,6 +66,7 @@ public:
 
     std::string getInfoURL() const;
     void setInfoURL(const std::string&);
+    static std::string resolveInfoURL(const std::string& infoURL, const std::string& resPath);
 
     bool isVisible() const { return visible; }
     void setVisible(bool _visible) { visible = _visible; }
@@ -17,18 +17,22 @@
 #include <cmath>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <cassert>
+#include <iterator>
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
 #include <celutil/bytes.h>
 #include <celutil/debug.h>
+#include <celutil/threadpool.h>
 #include <celutil/utf8.h>
 #include <celutil/util.h>
 #include <celmath/mathlib.h>
 #include <celmath/plane.h>
 #include <celastro/astro.h>
+#include <celutil/profiler.h>
 
 #include "celestia.h"
 #include "parser.h"
@@ -89,12 +93,12 @@ DeepSkyObject::Pointer DSODatabase::find(const string& name) const {
     return NULL;
 }
 
-vector<string> DSODatabase::getCompletion(const string& name) const {
+vector<string> DSODatabase::getCompletion(const string& name, size_t maxCount) const {
     vector<string> completion;
 
     // only named DSOs are supported by completion.
     if (!name.empty() && namesDB != NULL)
-        return namesDB->getCompletion(name);
+        return namesDB->getCompletion(name, maxCount);
     else
         return completion;
 }
@@ -129,6 +133,7 @@ void DSODatabase::findVisibleDSOs(DSOHandler& dsoHandler,
                                   float fovY,
                                   float aspectRatio,
                                   float limitingMag) const {
+    PROFILE_ZONE("DSODatabase::findVisibleDSOs");
     
     // Compute the bounding planes of an infinite view frustum
     DSOOctree::Frustum frustumPlanes;
@@ -150,47 +155,55 @@ void DSODatabase::findVisibleDSOs(DSOHandler& dsoHandler,
         frustumPlanes[i] = Hyperplane<double, 3>(planeNormals[i], obsPos);
     }
 
-    octreeRoot->processVisibleObjects(dsoHandler, obsPos, frustumPlanes, limitingMag, DSO_OCTREE_ROOT_SIZE);
+    octreeRoot->processVisibleObjects(dsoHandler, obsPos, frustumPlanes, limitingMag, DSO_OCTREE_ROOT_SIZE, ThreadPool::getDefault());
 }
 
 void DSODatabase::findCloseDSOs(DSOHandler& dsoHandler, const Vector3d& obsPos, float radius) const {
-    octreeRoot->processCloseObjects(dsoHandler, obsPos, radius, DSO_OCTREE_ROOT_SIZE);
+    PROFILE_ZONE("DSODatabase::findCloseDSOs");
+    octreeRoot->processCloseObjects(dsoHandler, obsPos, radius, DSO_OCTREE_ROOT_SIZE, ThreadPool::getDefault());
 }
 
 bool DSODatabase::load(istream& in, const string& resourcePath) {
-    Tokenizer tokenizer(&in);
-    Parser parser(&tokenizer);
+    CatalogRecordList records;
+    bool parsed = ReadCatalogRecords(in, records);
+    return load(records, resourcePath) && parsed;
+}
 
-    while (tokenizer.nextToken() != Tokenizer::TokenEnd) {
+bool DSODatabase::load(const CatalogRecordList& records, const string& resourcePath) {
+    PROFILE_ZONE("DSODatabase::load");
+    for (const auto& record : records) {
+        CatalogHeaderReader header(record);
         string objType;
         string objName;
 
-        if (tokenizer.getTokenType() != Tokenizer::TokenName) {
+        if (header.getTokenType() != Tokenizer::TokenName) {
             DPRINTF(0, "Error parsing deep sky catalog file.\n");
             return false;
         }
-        objType = tokenizer.getNameValue();
+        objType = header.getNameValue();
 
         bool autoGenCatalogNumber = true;
         uint32_t objCatalogNumber = DeepSkyObject::InvalidCatalogNumber;
-        if (tokenizer.getTokenType() == Tokenizer::TokenNumber) {
+        if (header.getTokenType() == Tokenizer::TokenNumber) {
             autoGenCatalogNumber = false;
-            objCatalogNumber = (uint32_t)tokenizer.getNumberValue();
-            tokenizer.nextToken();
+            objCatalogNumber = (uint32_t)header.getNumberValue();
+            header.next();
         }
 
         if (autoGenCatalogNumber) {
             objCatalogNumber = nextAutoCatalogNumber--;
         }
 
-        if (tokenizer.nextToken() != Tokenizer::TokenString) {
+        header.next();
+        if (header.getTokenType() != Tokenizer::TokenString) {
             DPRINTF(0, "Error parsing deep sky catalog file: bad name.\n");
             return false;
         }
-        objName = tokenizer.getStringValue();
+        objName = header.getStringValue();
+        header.next();
 
-        auto objParamsValue = parser.readValue();
-        if (objParamsValue == NULL || objParamsValue->getType() != Value::HashType) {
+        const auto& objParamsValue = record.value;
+        if (!header.atEnd() || objParamsValue->getType() != Value::HashType) {
             DPRINTF(0, "Error parsing deep sky catalog entry %s\n", objName.c_str());
             return false;
         }
@@ -212,30 +225,7 @@ bool DSODatabase::load(istream& in, const string& resourcePath) {
             DSOs.push_back(obj);
 
             obj->setCatalogNumber(objCatalogNumber);
-
-            if (namesDB != NULL && !objName.empty()) {
-                // List of names will replace any that already exist for
-                // this DSO.
-                namesDB->erase(objCatalogNumber);
-
-                // Iterate through the string for names delimited
-                // by ':', and insert them into the DSO database.
-                // Note that db->add() will skip empty names.
-                string::size_type startPos = 0;
-                while (startPos != string::npos) {
-                    string::size_type next = objName.find(':', startPos);
-                    string::size_type length = string::npos;
-                    if (next != string::npos) {
-                        length = next - startPos;
-                        ++next;
-                    }
-                    string DSOName = objName.substr(startPos, length);
-                    namesDB->add(objCatalogNumber, DSOName);
-                    if (DSOName != _(DSOName.c_str()))
-                        namesDB->add(objCatalogNumber, _(DSOName.c_str()));
-                    startPos = next;
-                }
-            }
+            addNames(objCatalogNumber, objName);
         } else {
             DPRINTF(1, "Bad Deep Sky Object definition--will continue parsing file.\n");
             return false;
@@ -244,12 +234,325 @@ bool DSODatabase::load(istream& in, const string& resourcePath) {
     return true;
 }
 
-bool DSODatabase::loadBinary(istream&) {
-    // TODO: define a binary dso file format
+// Add the ':' delimited list of names of a DSO to the name database. The
+// list replaces any names that already exist for this DSO.
+void DSODatabase::addNames(uint32_t catalogNumber, const string& names) {
+    if (namesDB == NULL || names.empty())
+        return;
+
+    namesDB->erase(catalogNumber);
+
+    // Note that db->add() will skip empty names.
+    string::size_type startPos = 0;
+    while (startPos != string::npos) {
+        string::size_type next = names.find(':', startPos);
+        string::size_type length = string::npos;
+        if (next != string::npos) {
+            length = next - startPos;
+            ++next;
+        }
+        string DSOName = names.substr(startPos, length);
+        namesDB->add(catalogNumber, DSOName);
+        if (DSOName != _(DSOName.c_str()))
+            namesDB->add(catalogNumber, _(DSOName.c_str()));
+        startPos = next;
+    }
+}
+
+// Binary deep sky catalog layout (little endian):
+//
+//   char[8]    "CEL_DSOs"
+//   uint16_t   version
+//   uint32_t   object count
+//   uint32_t   string table size
+//   record     records[object count]
+//   char       strings[string table size]
+//
+// Strings are stored as offsets into the string table, which holds NUL
+// terminated strings and starts with the empty string. A record is:
+//
+//    0  uint8_t    object type (DSOBinaryType)
+//    1  uint8_t    flags (DSOBinaryFlags)
+//    2  uint16_t   unused
+//    4  uint32_t   catalog number
+//    8  double[3]  position
+//   32  float[4]   orientation w, x, y, z
+//   48  float      radius
+//   52  float      absolute magnitude
+//   56  float      detail                   galaxies and globulars
+//   60  float      core radius              globulars
+//   64  float      King concentration       globulars
+//   68  uint32_t   names, ':' delimited
+//   72  uint32_t   info URL
+//   76  uint32_t   Hubble type              galaxies
+//   80  uint32_t   custom template or mesh  galaxies, globulars, nebulae
+static const uint16_t DSO_BINARY_VERSION = 0x0100;
+static const size_t DSO_BINARY_PREAMBLE_SIZE = 8 + sizeof(uint16_t) + 2 * sizeof(uint32_t);
+static const size_t DSO_BINARY_RECORD_SIZE = 84;
+
+enum DSOBinaryType
+{
+    DSOBinaryGalaxy = 0,
+    DSOBinaryGlobular = 1,
+    DSOBinaryNebula = 2,
+    DSOBinaryOpenCluster = 3,
+};
+
+enum DSOBinaryFlags
+{
+    DSOBinaryVisible = 0x01,
+    DSOBinaryClickable = 0x02,
+    // The catalog number was generated rather than given in the catalog
+    DSOBinaryAutoCatalogNumber = 0x04,
+    // The globular's King concentration was given in the catalog
+    DSOBinaryConcentration = 0x08,
+};
+
+static uint32_t readUint32(const uint8_t* data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof value);
+    LE_TO_CPU_INT32(value, value);
+    return value;
+}
+
+static float readFloat(const uint8_t* data) {
+    float value;
+    memcpy(&value, data, sizeof value);
+    LE_TO_CPU_FLOAT(value, value);
+    return value;
+}
+
+static double readDouble(const uint8_t* data) {
+    double value;
+    memcpy(&value, data, sizeof value);
+    LE_TO_CPU_DOUBLE(value, value);
+    return value;
+}
+
+static void writeUint32(uint8_t* data, uint32_t value) {
+    LE_TO_CPU_INT32(value, value);
+    memcpy(data, &value, sizeof value);
+}
+
+static void writeFloat(uint8_t* data, float value) {
+    LE_TO_CPU_FLOAT(value, value);
+    memcpy(data, &value, sizeof value);
+}
+
+static void writeDouble(uint8_t* data, double value) {
+    LE_TO_CPU_DOUBLE(value, value);
+    memcpy(data, &value, sizeof value);
+}
+
+bool DSODatabase::loadBinary(istream& in, const string& resourcePath) {
+    vector<uint8_t> data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    return loadBinary(storage::Storage::create(data.size(), data.data()), resourcePath);
+}
+
+bool DSODatabase::loadBinary(const storage::StoragePointer& file, const string& resourcePath) {
+    PROFILE_ZONE("DSODatabase::loadBinary");
+    if (!file || file->size() < DSO_BINARY_PREAMBLE_SIZE)
+        return false;
+
+    const uint8_t* data = file->data();
+    if (strncmp((const char*)data, FILE_HEADER, 8))
+        return false;
+
+    uint16_t version;
+    memcpy(&version, data + 8, sizeof version);
+    LE_TO_CPU_INT16(version, version);
+    if (version != DSO_BINARY_VERSION)
+        return false;
+
+    uint32_t nDSOsInFile = readUint32(data + 10);
+    uint32_t stringTableSize = readUint32(data + 14);
+    if ((file->size() - DSO_BINARY_PREAMBLE_SIZE) / DSO_BINARY_RECORD_SIZE < nDSOsInFile ||
+        file->size() - DSO_BINARY_PREAMBLE_SIZE - nDSOsInFile * DSO_BINARY_RECORD_SIZE != stringTableSize)
+        return false;
+
+    // Every string must end inside the table
+    const char* strings = (const char*)data + DSO_BINARY_PREAMBLE_SIZE + nDSOsInFile * DSO_BINARY_RECORD_SIZE;
+    if (stringTableSize == 0 || strings[stringTableSize - 1] != '\0')
+        return false;
+    auto getString = [&](const uint8_t* field, string& s) {
+        uint32_t offset = readUint32(field);
+        if (offset >= stringTableSize)
+            return false;
+        s = strings + offset;
+        return true;
+    };
+
+    // Validate everything before adding objects, so that a damaged file
+    // leaves the database as it was.
+    const uint8_t* records = data + DSO_BINARY_PREAMBLE_SIZE;
+    for (uint32_t i = 0; i < nDSOsInFile; i++) {
+        const uint8_t* record = records + i * DSO_BINARY_RECORD_SIZE;
+        string s;
+        if (record[0] > DSOBinaryOpenCluster || !getString(record + 68, s) || !getString(record + 72, s) ||
+            !getString(record + 76, s) || !getString(record + 80, s))
+            return false;
+    }
+
+    DSOs.reserve(DSOs.size() + nDSOsInFile);
+    for (uint32_t i = 0; i < nDSOsInFile; i++) {
+        const uint8_t* record = records + i * DSO_BINARY_RECORD_SIZE;
+        uint8_t flags = record[1];
+        string names, infoURL, typeName, templateName;
+        getString(record + 68, names);
+        getString(record + 72, infoURL);
+        getString(record + 76, typeName);
+        getString(record + 80, templateName);
+
+        DeepSkyObject::Pointer obj;
+        switch (record[0]) {
+            case DSOBinaryGalaxy: {
+                auto galaxy = std::make_shared<Galaxy>();
+                galaxy->setDetail(readFloat(record + 56));
+                if (!templateName.empty())
+                    galaxy->setCustomTmpName(templateName);
+                galaxy->setType(typeName);
+                obj = galaxy;
+            } break;
+            case DSOBinaryGlobular:
+                obj = std::make_shared<Globular>();
+                break;
+            case DSOBinaryNebula: {
+                auto nebula = std::make_shared<Nebula>();
+                nebula->setGeometryFileName(templateName);
+                obj = nebula;
+            } break;
+            default:
+                obj = std::make_shared<OpenCluster>();
+                break;
+        }
+
+        obj->setPosition(Vector3d(readDouble(record + 8), readDouble(record + 16), readDouble(record + 24)));
+        obj->setOrientation(Quaternionf(readFloat(record + 32), readFloat(record + 36), readFloat(record + 40), readFloat(record + 44)));
+        obj->setRadius(readFloat(record + 48));
+        obj->setAbsoluteMagnitude(readFloat(record + 52));
+        if (!infoURL.empty())
+            obj->setInfoURL(DeepSkyObject::resolveInfoURL(infoURL, resourcePath));
+        obj->setVisible((flags & DSOBinaryVisible) != 0);
+        obj->setClickable((flags & DSOBinaryClickable) != 0);
+
+        // Globulars depend on the position, so they're completed last
+        if (record[0] == DSOBinaryGlobular) {
+            auto globular = std::static_pointer_cast<Globular>(obj);
+            globular->setDetail(readFloat(record + 56));
+            if (!templateName.empty())
+                globular->setCustomTmpName(templateName);
+            globular->setCoreRadius(readFloat(record + 60));
+            if (flags & DSOBinaryConcentration)
+                globular->setConcentration(readFloat(record + 64));
+        }
+
+        uint32_t catalogNumber = readUint32(record + 4);
+        if (flags & DSOBinaryAutoCatalogNumber)
+            catalogNumber = nextAutoCatalogNumber--;
+        obj->setCatalogNumber(catalogNumber);
+        addNames(catalogNumber, names);
+
+        DSOs.push_back(obj);
+    }
+
+    clog << nDSOsInFile << _(" deep sky objects in binary catalog\n");
     return true;
 }
 
+bool DSODatabase::saveBinary(ostream& out) const {
+    vector<uint8_t> records(DSOs.size() * DSO_BINARY_RECORD_SIZE);
+    string strings(1, '\0');
+    auto addString = [&strings](const string& s) {
+        if (s.empty())
+            return (uint32_t)0;
+        uint32_t offset = (uint32_t)strings.size();
+        strings.append(s.c_str(), s.size() + 1);
+        return offset;
+    };
+
+    for (size_t i = 0; i < DSOs.size(); i++) {
+        const auto& obj = DSOs[i];
+        uint8_t* record = records.data() + i * DSO_BINARY_RECORD_SIZE;
+
+        uint8_t flags = (obj->isVisible() ? DSOBinaryVisible : 0) | (obj->isClickable() ? DSOBinaryClickable : 0);
+        // Generated catalog numbers count down from the top of the range
+        uint32_t catalogNumber = obj->getCatalogNumber();
+        if (catalogNumber > nextAutoCatalogNumber)
+            flags |= DSOBinaryAutoCatalogNumber;
+
+        string names;
+        if (namesDB != NULL) {
+            for (const auto& name : namesDB->getNamesByCatalogNumber(catalogNumber))
+                names += (names.empty() ? "" : ":") + name;
+        }
+
+        string typeName, templateName;
+        float detail = 1.0f, coreRadius = 0.0f, concentration = 0.0f;
+        if (auto galaxy = std::dynamic_pointer_cast<Galaxy>(obj)) {
+            record[0] = DSOBinaryGalaxy;
+            detail = galaxy->getDetail();
+            typeName = galaxy->getType();
+            templateName = galaxy->getCustomTmpName();
+        } else if (auto globular = std::dynamic_pointer_cast<Globular>(obj)) {
+            record[0] = DSOBinaryGlobular;
+            detail = globular->getDetail();
+            templateName = globular->getCustomTmpName();
+            coreRadius = globular->getCoreRadius();
+            concentration = globular->getConcentration();
+            // Without a concentration the globular has no form
+            if (globular->getForm() != NULL)
+                flags |= DSOBinaryConcentration;
+        } else if (auto nebula = std::dynamic_pointer_cast<Nebula>(obj)) {
+            record[0] = DSOBinaryNebula;
+            templateName = nebula->getGeometryFileName();
+        } else if (std::dynamic_pointer_cast<OpenCluster>(obj)) {
+            record[0] = DSOBinaryOpenCluster;
+        } else {
+            return false;
+        }
+
+        record[1] = flags;
+        writeUint32(record + 4, catalogNumber);
+        Vector3d position = obj->getPosition();
+        writeDouble(record + 8, position.x());
+        writeDouble(record + 16, position.y());
+        writeDouble(record + 24, position.z());
+        Quaternionf orientation = obj->getOrientation();
+        writeFloat(record + 32, orientation.w());
+        writeFloat(record + 36, orientation.x());
+        writeFloat(record + 40, orientation.y());
+        writeFloat(record + 44, orientation.z());
+        writeFloat(record + 48, obj->getRadius());
+        writeFloat(record + 52, obj->getAbsoluteMagnitude());
+        writeFloat(record + 56, detail);
+        writeFloat(record + 60, coreRadius);
+        writeFloat(record + 64, concentration);
+        writeUint32(record + 68, addString(names));
+        writeUint32(record + 72, addString(obj->getInfoURL()));
+        writeUint32(record + 76, addString(typeName));
+        writeUint32(record + 80, addString(templateName));
+    }
+
+    uint8_t preamble[DSO_BINARY_PREAMBLE_SIZE];
+    memcpy(preamble, FILE_HEADER, 8);
+    uint16_t version = DSO_BINARY_VERSION;
+    LE_TO_CPU_INT16(version, version);
+    memcpy(preamble + 8, &version, sizeof version);
+    writeUint32(preamble + 10, (uint32_t)DSOs.size());
+    writeUint32(preamble + 14, (uint32_t)strings.size());
+
+    out.write((const char*)preamble, sizeof preamble);
+    out.write((const char*)records.data(), records.size());
+    out.write(strings.data(), strings.size());
+    return out.good();
+}
+
+string BinaryDSOCatalogFilename(const string& source) {
+    return source + ".cdsc";
+}
+
 void DSODatabase::finish() {
+    PROFILE_ZONE("DSODatabase::finish");
     buildOctree();
     buildIndexes();
     calcAvgAbsMag();
@@ -277,18 +580,15 @@ void DSODatabase::buildOctree() {
     }
 
     DPRINTF(1, "Spatially sorting DSOs for improved locality of reference . . .\n");
-    std::vector<DeepSkyObject::Pointer> sortedDSOs = DSOs;
-
-    // The spatial sorting part is useless for DSOs since we
-    // are storing pointers to objects and not the objects themselves:
-    root.rebuildAndSort(octreeRoot, sortedDSOs);
+    // The static octree nodes refer to ranges of the sorted DSO list, so the
+    // list must be rebuilt in place rather than appended to a copy.
+    DSOs.clear();
+    root.rebuildAndSort(octreeRoot, DSOs);
 
-    DPRINTF(1, "%d DSOs total\n", (int)(sortedDSOs.size()));
+    DPRINTF(1, "%d DSOs total\n", (int)(DSOs.size()));
     DPRINTF(1, "Octree has %d nodes and %d DSOs.\n", 1 + octreeRoot->countChildren(), octreeRoot->countObjects());
     //cout<<"DSOs:  "<< octreeRoot->countObjects()<<"   Nodes:"
     //    <<octreeRoot->countChildren() <<endl;
-    // Clean up . . .
-    DSOs = sortedDSOs;
 }
 
 void DSODatabase::calcAvgAbsMag() {
@@ -19,6 +19,8 @@
 #include "deepskyobj.h"
 #include "dsooctree.h"
 #include "parser.h"
+#include "catalogrecord.h"
+#include <celutil/storage.hpp>
 
 static const uint32_t MAX_DSO_NAMES = 10;
 
@@ -37,7 +39,7 @@ public:
     DeepSkyObject::Pointer find(const uint32_t catalogNumber) const;
     DeepSkyObject::Pointer find(const std::string&) const;
 
-    std::vector<std::string> getCompletion(const std::string&) const;
+    std::vector<std::string> getCompletion(const std::string&, size_t maxCount = SIZE_MAX) const;
 
     void findVisibleDSOs(DSOHandler& dsoHandler,
                          const Eigen::Vector3d& obsPosition,
@@ -55,7 +57,13 @@ public:
     void setNameDatabase(const DSONameDatabase::Pointer& _namesDB) { namesDB = _namesDB; }
 
     bool load(std::istream&, const std::string& resourcePath);
-    bool loadBinary(std::istream&);
+    bool load(const CatalogRecordList&, const std::string& resourcePath);
+    // Binary catalogs are written by saveBinary from the objects loaded so
+    // far; objects are created exactly as the text catalog would create them,
+    // with relative info URLs resolved against resourcePath.
+    bool loadBinary(std::istream&, const std::string& resourcePath = "");
+    bool loadBinary(const storage::StoragePointer&, const std::string& resourcePath = "");
+    bool saveBinary(std::ostream&) const;
     void finish();
 
     static DSODatabase* read(std::istream&);
@@ -65,6 +73,7 @@ public:
     double getAverageAbsoluteMagnitude() const;
 
 private:
+    void addNames(uint32_t catalogNumber, const std::string& names);
     void buildIndexes();
     void buildOctree();
     void calcAvgAbsMag();
@@ -79,4 +88,8 @@ private:
     double avgAbsMag;
 };
 
+// Name of the binary catalog compiled from a text deep sky catalog; it's
+// used in place of the text catalog when it's at least as recent.
+std::string BinaryDSOCatalogFilename(const std::string& source);
+
 #endif  // _DSODB_H_
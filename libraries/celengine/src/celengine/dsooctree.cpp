@@ -35,6 +35,10 @@ DynamicOctree<DeepSkyObject, double>::Pointer DynamicOctree<DeepSkyObject, doubl
 template <>
 uint32_t DynamicOctree<DeepSkyObject, double>::SPLIT_THRESHOLD = 10;
 
+template <>
+DynamicOctree<DeepSkyObject, double>::LimitingFactorFunction DynamicOctree<DeepSkyObject, double>::limitingFactorFunction =
+    [](const DeepSkyObjectPtr& dso) -> float { return dso->getAbsoluteMagnitude(); };
+
 template <>
 DynamicOctree<DeepSkyObject, double>::LimitingFactorPredicate DynamicOctree<DeepSkyObject, double>::limitingFactorPredicate =
     [](const std::shared_ptr<DeepSkyObject>& _dso, const double absMag) -> bool {
@@ -60,11 +64,18 @@ DynamicOctree<DeepSkyObject, double>::ExclusionFactorDecayFunction DynamicOctree
 
 // total specialization of the StaticOctree template process*() methods for DSOs:
 template <>
-void StaticOctree<DeepSkyObject, double>::processVisibleObjects(DSOHandler& processor,
-                                      const PointType& obsPosition,
-                                      const Frustum& frustumPlanes,
-                                      float limitingFactor,
-                                      double scale) const {
+void StaticOctree<DeepSkyObject, double>::processVisibleNode(uint32_t nodeIndex,
+                                                             DSOHandler& processor,
+                                                             const PointType& obsPosition,
+                                                             const Frustum& frustumPlanes,
+                                                             float limitingFactor,
+                                                             double scale) const {
+    if (deferNode(nodeIndex, scale))
+        return;
+
+    const Node& node = _nodes[nodeIndex];
+    const PointType& cellCenterPos = node.cellCenterPos;
+
     // See if this node lies within the view frustum
 
     // Test the cubic octree node against each one of the five
@@ -91,7 +102,9 @@ void StaticOctree<DeepSkyObject, double>::processVisibleObjects(DSOHandler& proc
     // Process the objects in this node
     double dimmest = minDistance > 0.0 ? astro::appToAbsMag((double)limitingFactor, minDistance) : 1000.0;
 
-    for (const auto& _obj : _objects) {
+    const uint32_t lastObject = node.firstObject + node.objectCount;
+    for (uint32_t i = node.firstObject; i < lastObject; ++i) {
+        const auto& _obj = _objects[i];
         float absMag = _obj->getAbsoluteMagnitude();
         if (absMag < dimmest) {
             double distance = (obsPosition - _obj->getPosition()).norm() - _obj->getBoundingSphereRadius();
@@ -104,20 +117,27 @@ void StaticOctree<DeepSkyObject, double>::processVisibleObjects(DSOHandler& proc
 
     // See if any of the objects in child nodes are potentially included
     // that we need to recurse deeper.
-    if (minDistance <= 0.0 || astro::absToAppMag((double)exclusionFactor, minDistance) <= limitingFactor) {
+    if (minDistance <= 0.0 || astro::absToAppMag((double)node.exclusionFactor, minDistance) <= limitingFactor) {
         // Recurse into the child nodes
-        if (_children) {
-            for (const auto& child : *_children)
-                child->processVisibleObjects(processor, obsPosition, frustumPlanes, limitingFactor, scale * 0.5f);
+        if (node.hasChildren()) {
+            for (uint32_t i = 0; i < 8; ++i)
+                processVisibleNode(node.firstChild + i, processor, obsPosition, frustumPlanes, limitingFactor, scale * 0.5f);
         }
     }
 }
 
 template <>
-void StaticOctree<DeepSkyObject, double>::processCloseObjects(DSOHandler& processor,
-                                    const PointType& obsPosition,
-                                    double boundingRadius,
-                                    double scale) const {
+void StaticOctree<DeepSkyObject, double>::processCloseNode(uint32_t nodeIndex,
+                                                           DSOHandler& processor,
+                                                           const PointType& obsPosition,
+                                                           double boundingRadius,
+                                                           double scale) const {
+    if (deferNode(nodeIndex, scale))
+        return;
+
+    const Node& node = _nodes[nodeIndex];
+    const PointType& cellCenterPos = node.cellCenterPos;
+
     // Compute the distance to node; this is equal to the distance to
     // the cellCenterPos of the node minus the boundingRadius of the node, scale * SQRT3.
     double nodeDistance = (obsPosition - cellCenterPos).norm() - scale * DSOOctree::SQRT3;  //
@@ -133,7 +153,9 @@ void StaticOctree<DeepSkyObject, double>::processCloseObjects(DSOHandler& proces
     double radiusSquared = boundingRadius * boundingRadius;  //
 
     // Check all the objects in the node.
-    for (const auto& _obj : _objects) {
+    const uint32_t lastObject = node.firstObject + node.objectCount;
+    for (uint32_t i = node.firstObject; i < lastObject; ++i) {
+        const auto& _obj = _objects[i];
         if ((obsPosition - _obj->getPosition()).squaredNorm() < radiusSquared)  //
         {
             float absMag = _obj->getAbsoluteMagnitude();
@@ -144,9 +166,9 @@ void StaticOctree<DeepSkyObject, double>::processCloseObjects(DSOHandler& proces
     }
 
     // Recurse into the child nodes
-    if (_children != NULL) {
-        for (const auto& child : *_children) {
-            child->processCloseObjects(processor, obsPosition, boundingRadius, scale * 0.5f);
+    if (node.hasChildren()) {
+        for (uint32_t i = 0; i < 8; ++i) {
+            processCloseNode(node.firstChild + i, processor, obsPosition, boundingRadius, scale * 0.5f);
         }
     }
 }
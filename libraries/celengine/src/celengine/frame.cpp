@@ -304,37 +304,44 @@ uint32_t BodyMeanEquatorFrame::nestingDepth(uint32_t depth, uint32_t maxDepth, F
 
 /*** CachingFrame ***/
 
-CachingFrame::CachingFrame(Selection _center) :
-    ReferenceFrame(_center), lastTime(-1.0e50), lastOrientation(Quaterniond::Identity()), lastAngularVelocity(0.0, 0.0, 0.0),
-    orientationCacheValid(false), angularVelocityCacheValid(false) {
+CachingFrame::CachingFrame(Selection _center) : ReferenceFrame(_center) {
+}
+
+TimeCacheStatistics& CachingFrame::getCacheStatistics() {
+    static TimeCacheStatistics statistics;
+    return statistics;
 }
 
 Quaterniond CachingFrame::getOrientation(double tjd) const {
-    if (tjd != lastTime) {
-        lastTime = tjd;
-        lastOrientation = computeOrientation(tjd);
-        orientationCacheValid = true;
-        angularVelocityCacheValid = false;
-    } else if (!orientationCacheValid) {
-        lastOrientation = computeOrientation(tjd);
-        orientationCacheValid = true;
-    }
+    Quaterniond q;
+    if (cache.find(tjd, getCacheStatistics(), [&](const CacheEntry& e) {
+            q = e.orientation;
+            return e.orientationValid;
+        }))
+        return q;
 
-    return lastOrientation;
+    q = computeOrientation(tjd);
+    cache.store(tjd, [&](CacheEntry& e) {
+        e.orientation = q;
+        e.orientationValid = true;
+    });
+    return q;
 }
 
 Vector3d CachingFrame::getAngularVelocity(double tjd) const {
-    if (tjd != lastTime) {
-        lastTime = tjd;
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        orientationCacheValid = false;
-        angularVelocityCacheValid = true;
-    } else if (!angularVelocityCacheValid) {
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        angularVelocityCacheValid = true;
-    }
-
-    return lastAngularVelocity;
+    Vector3d w;
+    if (cache.find(tjd, getCacheStatistics(), [&](const CacheEntry& e) {
+            w = e.angularVelocity;
+            return e.angularVelocityValid;
+        }))
+        return w;
+
+    w = computeAngularVelocity(tjd);
+    cache.store(tjd, [&](CacheEntry& e) {
+        e.angularVelocity = w;
+        e.angularVelocityValid = true;
+    });
+    return w;
 }
 
 /*! Calculate the angular velocity at the specified time (units are
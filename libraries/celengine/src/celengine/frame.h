@@ -12,6 +12,7 @@
 #define _CELENGINE_FRAME_H_
 
 #include <celastro/astro.h>
+#include <celutil/timecache.h>
 #include "selection.h"
 #include <Eigen/Core>
 #include <Eigen/Geometry>
@@ -73,12 +74,18 @@ public:
     virtual Eigen::Quaterniond computeOrientation(double tjd) const = 0;
     virtual Eigen::Vector3d computeAngularVelocity(double tjd) const;
 
+    // Hits and misses of all caching frames while profiling
+    static TimeCacheStatistics& getCacheStatistics();
+
 private:
-    mutable double lastTime;
-    mutable Eigen::Quaterniond lastOrientation;
-    mutable Eigen::Vector3d lastAngularVelocity;
-    mutable bool orientationCacheValid;
-    mutable bool angularVelocityCacheValid;
+    struct CacheEntry {
+        Eigen::Quaterniond orientation;
+        Eigen::Vector3d angularVelocity;
+        bool orientationValid{ false };
+        bool angularVelocityValid{ false };
+    };
+
+    TimeCache<CacheEntry> cache;
 };
 
 //! J2000.0 Earth ecliptic frame
@@ -18,6 +18,17 @@
 #include "timeline.h"
 #include "timelinephase.h"
 #include "frame.h"
+#include <celutil/profiler.h>
+#include <celutil/threadpool.h>
+
+using namespace Eigen;
+
+// Trees with at least this many children have their states computed in
+// chunks on the thread pool. This relies on every orbit, rotation model and
+// frame being safe to evaluate from several threads at once; the SPICE
+// backends get there by serializing their calls on SpiceMutex.
+static const size_t PARALLEL_STATE_THRESHOLD = 1024;
+static const size_t STATE_CHUNK_SIZE = 256;
 
 /* A FrameTree is hierarchy of solar system bodies organized according to
  * the relationship of their reference frames. An object will appear in as
@@ -37,6 +48,12 @@
  * objects themselves. Change tracking is performed whenever the frame tree
  * is modified: adding a node, removing a node, or changing the radius of an
  * object will all cause the tree to be marked as changed.
+ *
+ * Each node also keeps a table with the state of its children at one time:
+ * the astrocentric position of the body and its culling radius. The table
+ * is filled once per frame by updateStates, and the render, orbit, label
+ * and picking passes read it instead of evaluating orbits again. Changing
+ * the tree invalidates the table.
  */
 
 /*! Create a frame tree associated with a star.
@@ -68,6 +85,9 @@ const ReferenceFramePtr& FrameTree::getDefaultReferenceFrame() const {
  *  is propagated up toward the root of the tree.
  */
 void FrameTree::markChanged() {
+    m_statesTime = std::numeric_limits<double>::quiet_NaN();
+    m_stateTimes.clear();
+
     if (!m_changed) {
         m_changed = true;
         if (bodyParent != NULL)
@@ -126,6 +146,7 @@ void FrameTree::recomputeBoundingSphere() {
  */
 void FrameTree::addChild(const TimelinePhasePtr& phase) {
     phase->addRef();
+    phase->m_childIndex = children.size();
     children.push_back(phase);
     markChanged();
 }
@@ -137,7 +158,9 @@ void FrameTree::removeChild(const TimelinePhasePtr& phase) {
     auto iter = find(children.begin(), children.end(), phase);
     if (iter != children.end()) {
         (*iter)->release();
-        children.erase(iter);
+        iter = children.erase(iter);
+        for (; iter != children.end(); ++iter)
+            (*iter)->m_childIndex--;
         markChanged();
     }
 }
@@ -151,3 +174,86 @@ const TimelinePhasePtr& FrameTree::getChild(size_t n) const {
 size_t FrameTree::childCount() const {
     return children.size();
 }
+
+/*! Compute the state of every body in this tree and its subtrees that is
+ *  active at time tdb. Nodes whose table already holds tdb are only
+ *  recomputed when the position of their parent was.
+ */
+void FrameTree::updateStates(double tdb) {
+    PROFILE_ZONE("FrameTree::updateStates");
+    updateStates(tdb, Vector3d::Zero(), false);
+}
+
+void FrameTree::updateStates(double tdb, const Vector3d& center, bool force) {
+    bool recompute = force || m_statesTime != tdb;
+    size_t nChildren = children.size();
+    if (recompute) {
+        m_statesTime = tdb;
+        m_stateTimes.assign(nChildren, std::numeric_limits<double>::quiet_NaN());
+        m_positions.resize(nChildren);
+        m_cullingRadii.resize(nChildren);
+    }
+
+    auto updateRange = [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++) {
+            const TimelinePhase* phase = children[i].get();
+            if (recompute) {
+                if (!phase->includes(tdb))
+                    continue;
+                Vector3d p = phase->orbit()->positionAtTime(tdb);
+                m_positions[i] = center + phase->orbitFrame()->getOrientation(tdb).conjugate() * p;
+                m_cullingRadii[i] = phase->body()->getCullingRadius();
+                m_stateTimes[i] = tdb;
+            } else if (m_stateTimes[i] != tdb) {
+                continue;
+            }
+
+            const auto& subtree = phase->body()->getFrameTree();
+            if (subtree)
+                subtree->updateStates(tdb, m_positions[i], recompute);
+        }
+    };
+
+    if (nChildren < PARALLEL_STATE_THRESHOLD) {
+        updateRange(0, nChildren);
+    } else {
+        size_t nChunks = (nChildren + STATE_CHUNK_SIZE - 1) / STATE_CHUNK_SIZE;
+        ThreadPool::getDefault().parallelFor(nChunks, [&](size_t chunk) {
+            size_t first = chunk * STATE_CHUNK_SIZE;
+            updateRange(first, std::min(first + STATE_CHUNK_SIZE, nChildren));
+        });
+    }
+}
+
+/*! Get the astrocentric position of the body of child n at time tdb. It
+ *  comes from the state table when that holds tdb, and is computed
+ *  otherwise.
+ */
+Vector3d FrameTree::getChildPosition(size_t n, double tdb) const {
+    if (hasChildState(n, tdb))
+        return m_positions[n];
+
+    const TimelinePhase* phase = children[n].get();
+    return phase->orbitFrame()->convertToAstrocentric(phase->orbit()->positionAtTime(tdb), tdb);
+}
+
+/*! Get the culling radius of the body of child n, as it was when the state
+ *  table was filled for time tdb.
+ */
+float FrameTree::getChildCullingRadius(size_t n, double tdb) const {
+    if (hasChildState(n, tdb))
+        return m_cullingRadii[n];
+
+    return children[n]->body()->getCullingRadius();
+}
+
+/*! Get the astrocentric position at time tdb of the body of a phase that
+ *  belongs to this tree.
+ */
+Vector3d FrameTree::getAstrocentricPosition(const TimelinePhase& phase, double tdb) const {
+    size_t n = phase.m_childIndex;
+    if (hasChildState(n, tdb) && children[n].get() == &phase)
+        return m_positions[n];
+
+    return phase.orbitFrame()->convertToAstrocentric(phase.orbit()->positionAtTime(tdb), tdb);
+}
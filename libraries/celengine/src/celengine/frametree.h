@@ -15,6 +15,8 @@
 
 #include <vector>
 #include <cstddef>
+#include <limits>
+#include <Eigen/Core>
 #include "forward.h"
 
 class FrameTree {
@@ -62,7 +64,22 @@ public:
      */
     int childClassMask() const { return m_childClassMask; }
 
+    void updateStates(double tdb);
+
+    /*! Return whether the state table holds the state of child n at
+     *  time tdb.
+     */
+    bool hasChildState(size_t n, double tdb) const {
+        return n < m_stateTimes.size() && m_stateTimes[n] == tdb;
+    }
+
+    Eigen::Vector3d getChildPosition(size_t n, double tdb) const;
+    float getChildCullingRadius(size_t n, double tdb) const;
+    Eigen::Vector3d getAstrocentricPosition(const TimelinePhase& phase, double tdb) const;
+
 private:
+    void updateStates(double tdb, const Eigen::Vector3d& center, bool force);
+
     const StarPtr starParent;
     const BodyPtr bodyParent;
     std::vector<TimelinePhasePtr> children;
@@ -73,6 +90,13 @@ private:
     bool m_changed{ true };
     int m_childClassMask;
 
+    // State table of the children at m_statesTime, one column per value.
+    // Children that aren't active at that time have a NaN state time.
+    double m_statesTime{ std::numeric_limits<double>::quiet_NaN() };
+    std::vector<double> m_stateTimes;
+    std::vector<Eigen::Vector3d> m_positions;
+    std::vector<float> m_cullingRadii;
+
     ReferenceFramePtr defaultFrame;
 };
 
@@ -15,13 +15,18 @@
 #include <cstdio>
 #include <cstring>
 #include <fstream>
+#include <mutex>
 
 #include <celastro/astro.h>
 #include <celmath/mathlib.h>
 #include <celmath/perlin.h>
 #include <celmath/intersect.h>
+#include <celmath/random.h>
 #include <celutil/util.h>
 #include <celutil/debug.h>
+#include <celutil/profiler.h>
+#include <celutil/storage.hpp>
+#include <celutil/threadpool.h>
 
 #include "render.h"
 #include "celestia.h"
@@ -33,8 +38,23 @@ using namespace std;
 static int width = 128, height = 128;
 static Vector3f colorTable[256];
 static const uint32_t GALAXY_POINTS = 3500;
+static const float IRREGULAR_NOISE_FREQUENCY = 8.0f;
+static const float IRREGULAR_BRIGHTNESS = 64.0f;
 
-static bool formsInitialized = false;
+// Every form is generated from its own seed, FORM_SEED plus its index, so
+// the forms come out the same on every run whichever thread builds them.
+static const uint32_t FORM_SEED = 0x67616c78;
+
+// The forms built by InitializeForms, in the order they're generated and
+// cached: the seven spiral templates, the E0 template shared by all
+// ellipticals, and the irregular form.
+static const char* const FormTemplates[] = { "models/S0.png",  "models/Sa.png",  "models/Sb.png", "models/Sc.png",
+                                             "models/SBa.png", "models/SBb.png", "models/SBc.png", "models/E0.png" };
+static const uint32_t E0_FORM = 7;
+static const uint32_t IRREGULAR_FORM = 8;
+static const uint32_t FORM_COUNT = 9;
+
+static std::once_flag formsInitialized;
 
 static GalacticForm** spiralForms = NULL;
 static GalacticForm** ellipticalForms = NULL;
@@ -42,8 +62,8 @@ static GalacticForm* irregularForm = NULL;
 
 static Texture* galaxyTex = NULL;
 
-static void InitializeForms();
-static GalacticForm* buildGalacticForms(const std::string& filename);
+static void InitializeForms(const std::string& cacheFile);
+static GalacticForm* buildGalacticForms(const std::string& filename, uint32_t seed);
 
 float Galaxy::lightGain = 0.0f;
 
@@ -126,11 +146,10 @@ void Galaxy::setType(const string& typeStr) {
         }
     }
 
-    if (!formsInitialized)
-        InitializeForms();
+    initializeForms("");
 
     if (customTmpName != NULL) {
-        form = buildGalacticForms("models/" + *customTmpName);
+        form = buildGalacticForms("models/" + *customTmpName, FORM_SEED);
     } else {
         switch (type) {
             case S0:
@@ -451,10 +470,11 @@ void Galaxy::setLightGain(float lg) {
         lightGain = lg;
 }
 
-GalacticForm* buildGalacticForms(const std::string& filename) {
+static BlobVector* buildGalacticBlobs(const std::string& filename, uint32_t seed) {
 #if 0
     Blob b;
     BlobVector* galacticPoints = new BlobVector;
+    celmath::RandomGenerator rng(seed);
 
     // Load templates in standard .png format
     int width, height, rgb, j = 0, kmin = 9;
@@ -477,8 +497,8 @@ GalacticForm* buildGalacticForms(const std::string& filename) {
             z = floor(i / (float)width);
             x = (i - width * z - 0.5f * (width - 1)) / (float)width;
             z = (0.5f * (height - 1) - z) / (float)height;
-            x += Mathf::sfrand() * 0.008f;
-            z += Mathf::sfrand() * 0.008f;
+            x += rng.sfrand() * 0.008f;
+            z += rng.sfrand() * 0.008f;
             r2 = x * x + z * z;
 
             if (strcmp(filename.c_str(), "models/E0.png") != 0) {
@@ -490,19 +510,19 @@ GalacticForm* buildGalacticForms(const std::string& filename) {
                     // generate "thickness" y of spirals with emulation of a dust lane
                     // in galctic plane (y=0)
 
-                    yr = Mathf::sfrand() * h;
+                    yr = rng.sfrand() * h;
                     prob = (1.0f - B * exp(-yr * yr)) / p0;
 
-                } while (Mathf::frand() > prob);
+                } while (rng.frand() > prob);
                 b.brightness = value * prob;
                 y = y0 * yr / h;
             } else {
                 // generate spherically symmetric distribution from E0.png
                 do {
-                    yy = Mathf::sfrand();
+                    yy = rng.sfrand();
                     float ry2 = 1.0f - yy * yy;
                     prob = ry2 > 0 ? sqrt(ry2) : 0.0f;
-                } while (Mathf::frand() > prob);
+                } while (rng.frand() > prob);
                 y = yy * sqrt(0.25f - r2);
                 b.brightness = value;
                 kmin = 12;
@@ -527,19 +547,180 @@ GalacticForm* buildGalacticForms(const std::string& filename) {
     // reshuffle the galaxy points randomly...except the first kmin+1 in the center!
     // the higher that number the stronger the central "glow"
 
-    random_shuffle(galacticPoints->begin() + kmin, galacticPoints->end());
+    rng.shuffle(galacticPoints->begin() + kmin, galacticPoints->end());
 
-    GalacticForm* galacticForm = new GalacticForm();
-    galacticForm->blobs = galacticPoints;
-    galacticForm->scale = Vector3f::Ones();
+    return galacticPoints;
+#else
+    (void)filename;
+    (void)seed;
+    return nullptr;
+#endif
+}
+
+static BlobVector* buildIrregularBlobs(uint32_t seed) {
+    uint32_t galaxySize = GALAXY_POINTS, ip = 0;
+    Blob b;
+    Point3f p;
+    celmath::RandomGenerator rng(seed);
+
+    BlobVector* irregularPoints = new BlobVector;
+    irregularPoints->reserve(galaxySize);
+
+    while (ip < galaxySize) {
+        p = Point3f(rng.sfrand(), rng.sfrand(), rng.sfrand());
+        float r = p.distanceFromOrigin();
+        if (r < 1) {
+            float prob = (1 - r) * (fractalsum(Vector3f(p.x + 5, p.y + 5, p.z + 5), IRREGULAR_NOISE_FREQUENCY) + 1) * 0.5f;
+            if (rng.frand() < prob) {
+                b.position = Vector4f(p.x, p.y, p.z, 1.0f);
+                b.brightness = IRREGULAR_BRIGHTNESS;
+                uint32_t rr = (uint32_t)(r * 511);
+                b.colorIndex = rr < 256 ? rr : 255;
+                irregularPoints->push_back(b);
+                ++ip;
+            }
+        }
+    }
+    return irregularPoints;
+}
 
+static GalacticForm* makeGalacticForm(BlobVector* blobs, const Vector3f& scale) {
+    if (blobs == NULL)
+        return NULL;
+
+    GalacticForm* galacticForm = new GalacticForm();
+    galacticForm->blobs = blobs;
+    galacticForm->scale = scale;
     return galacticForm;
-#endif
-    return nullptr;
 }
 
+GalacticForm* buildGalacticForms(const std::string& filename, uint32_t seed) {
+    return makeGalacticForm(buildGalacticBlobs(filename, seed), Vector3f::Ones());
+}
+
+// Layout of the galaxy form cache, in native byte order:
+//
+//   char[8]    "CELGXFRM"
+//   uint32_t   version, parameter hash, form count
+//   for each form:
+//     uint32_t blob count, or NO_FORM if the form couldn't be built
+//     float    x, y, z, w, brightness; uint32_t colorIndex    for each blob
+static const char* FORM_CACHE_HEADER = "CELGXFRM";
+// Bump the version whenever the form generators, or the noise and random
+// number generators they draw from, change. The constants the forms are
+// built from go into the parameter hash instead.
+static const uint32_t FORM_CACHE_VERSION = 0x0101;
+static const size_t FORM_CACHE_PREAMBLE_SIZE = 8 + 3 * sizeof(uint32_t);
+static const size_t FORM_CACHE_BLOB_SIZE = 6 * sizeof(uint32_t);
+static const uint32_t NO_FORM = ~0u;
+
+static uint32_t hashFormParameters() {
+    // FNV-1a, one 32-bit word at a time
+    uint32_t hash = 0x811c9dc5u;
+    auto mix = [&hash](uint32_t word) { hash = (hash ^ word) * 0x01000193u; };
+    auto mixFloat = [&mix](float f) {
+        uint32_t word;
+        memcpy(&word, &f, sizeof word);
+        mix(word);
+    };
+    mix(FORM_SEED);
+    mix(FORM_COUNT);
+    mix(GALAXY_POINTS);
+    mixFloat(IRREGULAR_NOISE_FREQUENCY);
+    mixFloat(IRREGULAR_BRIGHTNESS);
+    return hash;
+}
+
+static bool loadFormCache(const std::string& cacheFile, BlobVector* forms[FORM_COUNT]) {
+    storage::StoragePointer file;
+    try {
+        file = storage::Storage::readFile(cacheFile);
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+
+    const uint8_t* data = file->data();
+    const uint8_t* end = data + file->size();
+    if (file->size() < FORM_CACHE_PREAMBLE_SIZE || strncmp((const char*)data, FORM_CACHE_HEADER, 8))
+        return false;
+
+    uint32_t preamble[3];
+    memcpy(preamble, data + 8, sizeof preamble);
+    data += FORM_CACHE_PREAMBLE_SIZE;
+    if (preamble[0] != FORM_CACHE_VERSION || preamble[1] != hashFormParameters() || preamble[2] != FORM_COUNT)
+        return false;
+
+    // Check the layout before building anything from it
+    const uint8_t* formData[FORM_COUNT];
+    uint32_t blobCounts[FORM_COUNT];
+    for (uint32_t i = 0; i < FORM_COUNT; i++) {
+        if (end - data < (ptrdiff_t)sizeof(uint32_t))
+            return false;
+        memcpy(&blobCounts[i], data, sizeof(uint32_t));
+        data += sizeof(uint32_t);
+        formData[i] = data;
+        if (blobCounts[i] != NO_FORM) {
+            if ((uint64_t)(end - data) < (uint64_t)blobCounts[i] * FORM_CACHE_BLOB_SIZE)
+                return false;
+            data += (size_t)blobCounts[i] * FORM_CACHE_BLOB_SIZE;
+        }
+    }
+    if (data != end)
+        return false;
+
+    for (uint32_t i = 0; i < FORM_COUNT; i++) {
+        forms[i] = NULL;
+        if (blobCounts[i] == NO_FORM)
+            continue;
+
+        forms[i] = new BlobVector(blobCounts[i]);
+        const uint8_t* record = formData[i];
+        for (Blob& b : *forms[i]) {
+            float values[5];
+            memcpy(values, record, sizeof values);
+            memcpy(&b.colorIndex, record + sizeof values, sizeof(uint32_t));
+            b.position = Vector4f(values[0], values[1], values[2], values[3]);
+            b.brightness = values[4];
+            record += FORM_CACHE_BLOB_SIZE;
+        }
+    }
+    return true;
+}
+
+static bool saveFormCache(const std::string& cacheFile, BlobVector* const forms[FORM_COUNT]) {
+    ofstream out(cacheFile, ios::out | ios::binary | ios::trunc);
+    if (!out.good())
+        return false;
+
+    uint32_t preamble[3] = { FORM_CACHE_VERSION, hashFormParameters(), FORM_COUNT };
+    out.write(FORM_CACHE_HEADER, 8);
+    out.write((const char*)preamble, sizeof preamble);
+    for (uint32_t i = 0; i < FORM_COUNT; i++) {
+        uint32_t blobCount = forms[i] != NULL ? (uint32_t)forms[i]->size() : NO_FORM;
+        out.write((const char*)&blobCount, sizeof blobCount);
+        if (forms[i] == NULL)
+            continue;
+
+        vector<uint8_t> records(forms[i]->size() * FORM_CACHE_BLOB_SIZE);
+        uint8_t* record = records.data();
+        for (const Blob& b : *forms[i]) {
+            float values[5] = { b.position.x(), b.position.y(), b.position.z(), b.position.w(), b.brightness };
+            memcpy(record, values, sizeof values);
+            memcpy(record + sizeof values, &b.colorIndex, sizeof(uint32_t));
+            record += FORM_CACHE_BLOB_SIZE;
+        }
+        out.write((const char*)records.data(), records.size());
+    }
+    return out.good();
+}
+
+void Galaxy::initializeForms(const std::string& cacheFile) {
+    std::call_once(formsInitialized, InitializeForms, cacheFile);
+}
+
+void InitializeForms(const std::string& cacheFile) {
+    PROFILE_ZONE("Galaxy::initializeForms");
 
-void InitializeForms() {
     // build color table:
 
     for (uint32_t i = 0; i < 256; i++) {
@@ -556,71 +737,48 @@ void InitializeForms() {
         Color c(rr, gg, bb);
         colorTable[i] = Vector3f(c.red(), c.green(), c.blue());
     }
+
+    BlobVector* forms[FORM_COUNT] = { NULL };
+    if (cacheFile.empty() || !loadFormCache(cacheFile, forms)) {
+        // The forms are independent of each other, and each has its own seed
+        ThreadPool::getDefault().parallelFor(FORM_COUNT, [&forms](size_t i) {
+            if (i == IRREGULAR_FORM)
+                forms[i] = buildIrregularBlobs(FORM_SEED + (uint32_t)i);
+            else
+                forms[i] = buildGalacticBlobs(FormTemplates[i], FORM_SEED + (uint32_t)i);
+        });
+        if (!cacheFile.empty() && !saveFormCache(cacheFile, forms))
+            cerr << _("Error writing galaxy form cache ") << cacheFile << '\n';
+    }
+
     // Spiral Galaxies, 7 classical Hubble types
 
     spiralForms = new GalacticForm*[7];
-
-    spiralForms[Galaxy::S0] = buildGalacticForms("models/S0.png");
-    spiralForms[Galaxy::Sa] = buildGalacticForms("models/Sa.png");
-    spiralForms[Galaxy::Sb] = buildGalacticForms("models/Sb.png");
-    spiralForms[Galaxy::Sc] = buildGalacticForms("models/Sc.png");
-    spiralForms[Galaxy::SBa] = buildGalacticForms("models/SBa.png");
-    spiralForms[Galaxy::SBb] = buildGalacticForms("models/SBb.png");
-    spiralForms[Galaxy::SBc] = buildGalacticForms("models/SBc.png");
+    for (uint32_t sform = 0; sform < 7; ++sform)
+        spiralForms[sform] = makeGalacticForm(forms[sform], Vector3f::Ones());
 
     // Elliptical Galaxies , 8 classical Hubble types, E0..E7,
     //
     // To save space: generate spherical E0 template from S0 disk
-    // via rescaling by (1.0f, 3.8f, 1.0f).
+    // via rescaling by (1.0f, 3.8f, 1.0f). E0 is built only once; all
+    // elliptical forms share its blobs and differ only in scale.
+
+    // account for reddening of ellipticals rel.to spirals
+    if (forms[E0_FORM] != NULL) {
+        for (Blob& b : *forms[E0_FORM])
+            b.colorIndex = (uint32_t)ceil(0.76f * b.colorIndex);
+    }
 
     ellipticalForms = new GalacticForm*[8];
     for (uint32_t eform = 0; eform <= 7; ++eform) {
         float ell = 1.0f - (float)eform / 8.0f;
 
         // note the correct x,y-alignment of 'ell' scaling!!
-        // build all elliptical templates from rescaling E0
-
-        ellipticalForms[eform] = buildGalacticForms("models/E0.png");
-        if (*ellipticalForms)
-            ellipticalForms[eform]->scale = Vector3f(ell, ell, 1.0f);
-
-        // account for reddening of ellipticals rel.to spirals
-        if (*ellipticalForms) {
-            uint32_t nPoints = (uint32_t)(ellipticalForms[eform]->blobs->size());
-            for (uint32_t i = 0; i < nPoints; ++i) {
-                (*ellipticalForms[eform]->blobs)[i].colorIndex =
-                    (uint32_t)ceil(0.76f * (*ellipticalForms[eform]->blobs)[i].colorIndex);
-            }
-        }
-    }
-    //Irregular Galaxies
-    uint32_t galaxySize = GALAXY_POINTS, ip = 0;
-    Blob b;
-    Point3f p;
-
-    BlobVector* irregularPoints = new BlobVector;
-    irregularPoints->reserve(galaxySize);
-
-    while (ip < galaxySize) {
-        p = Point3f(Mathf::sfrand(), Mathf::sfrand(), Mathf::sfrand());
-        float r = p.distanceFromOrigin();
-        if (r < 1) {
-            float prob = (1 - r) * (fractalsum(Vector3f(p.x + 5, p.y + 5, p.z + 5), 8) + 1) * 0.5f;
-            if (Mathf::frand() < prob) {
-                b.position = Vector4f(p.x, p.y, p.z, 1.0f);
-                b.brightness = 64u;
-                uint32_t rr = (uint32_t)(r * 511);
-                b.colorIndex = rr < 256 ? rr : 255;
-                irregularPoints->push_back(b);
-                ++ip;
-            }
-        }
+        ellipticalForms[eform] = makeGalacticForm(forms[E0_FORM], Vector3f(ell, ell, 1.0f));
     }
-    irregularForm = new GalacticForm();
-    irregularForm->blobs = irregularPoints;
-    irregularForm->scale = Vector3f::Constant(0.5f);
 
-    formsInitialized = true;
+    //Irregular Galaxies
+    irregularForm = makeGalacticForm(forms[IRREGULAR_FORM], Vector3f::Constant(0.5f));
 }
 
 ostream& operator<<(ostream& s, const Galaxy::GalaxyType& sc) {
@@ -54,6 +54,12 @@ class Galaxy : public DeepSkyObject
     static float getLightGain();
     static void  setLightGain(float);
 
+    /*! Build the point clouds shared by all galaxies of a type. This happens
+     *  once, on first use at the latest; when cacheFile is given, the forms
+     *  are read from it if possible and written to it otherwise.
+     */
+    static void initializeForms(const std::string& cacheFile);
+
     uint32_t getRenderMask() const override;
     uint32_t getLabelMask() const override;
     
@@ -17,13 +17,19 @@
 #include <cassert>
 #include <cmath>
 #include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <mutex>
 
 #include <celutil/util.h>
 #include <celutil/debug.h>
+#include <celutil/profiler.h>
+#include <celutil/storage.hpp>
+#include <celutil/threadpool.h>
 #include <celmath/mathlib.h>
 #include <celmath/perlin.h>
 #include <celmath/intersect.h>
+#include <celmath/random.h>
 #include <celastro/astro.h>
 
 #include "render.h"
@@ -38,6 +44,11 @@ static int cntrTexWidth = 512, cntrTexHeight = 512;
 static int starTexWidth = 128, starTexHeight = 128;
 static Color colorTable[256];
 static const uint32_t GLOBULAR_POINTS = 8192;
+
+// Every form is generated from its own seed, FORM_SEED plus its c-bin, so
+// the forms come out the same on every run whichever thread builds them.
+static const uint32_t FORM_SEED = 0x676c6f62;
+static const uint32_t FORM_COUNT = 8;
 static const float LumiShape = 3.0f, Lumi0 = exp(-LumiShape);
 
 // Reference values ( = data base averages) of core radius, King concentration
@@ -60,9 +71,9 @@ static float CBin, RRatio, XI, DiskSizeInPixels, Rr = 1.0f, Gg = 1.0f, Bb = 1.0f
 static GlobularForm** globularForms = NULL;
 static Texture* globularTex = NULL;
 static Texture* centerTex[8] = { NULL };
-static void InitializeForms();
-static GlobularForm* buildGlobularForms(float);
-static bool formsInitialized = false;
+static void InitializeForms(const std::string& cacheFile);
+static std::vector<GBlob>* buildGlobularBlobs(float, uint32_t seed);
+static std::once_flag formsInitialized;
 
 static bool decreasing(const GBlob& b1, const GBlob& b2) {
     return (b1.radius_2d > b2.radius_2d);
@@ -217,8 +228,7 @@ float Globular::getConcentration() const {
 }
 void Globular::setConcentration(const float conc) {
     c = conc;
-    if (!formsInitialized)
-        InitializeForms();
+    initializeForms("");
 
     // For saving time, account for the c dependence via 8 bins only,
 
@@ -278,6 +288,9 @@ bool Globular::load(const HashPtr& params, const string& resPath) {
     if (params->getNumber("KingConcentration", c))
         setConcentration(c);
 
+    // The tidal radius depends on the position, which was only just set
+    recomputeTidalRadius();
+
     return true;
 }
 
@@ -475,9 +488,10 @@ void Globular::recomputeTidalRadius() {
     tidalRadius = coreRadiusLy * std::pow(10.0f, c);
 }
 
-GlobularForm* buildGlobularForms(float c) {
+vector<GBlob>* buildGlobularBlobs(float c, uint32_t seed) {
     GBlob b;
     vector<GBlob>* globularPoints = new vector<GBlob>;
+    celmath::RandomGenerator rng(seed);
 
     float rRatio = pow(10.0f, c);  //  = r_t / r_c
     float prob;
@@ -505,7 +519,7 @@ GlobularForm* buildGlobularForms(float c) {
          * parameters and variables!
          */
 
-        float uu = Mathf::frand();
+        float uu = rng.frand();
 
         /* First step: eta distributed as inverse power distribution (~1/Z^2) 
          * that majorizes the exact King profile. Compute eta in terms of uniformly 
@@ -530,14 +544,14 @@ GlobularForm* buildGlobularForms(float c) {
 
         k++;
 
-        if (Mathf::frand() < prob / cH) {
+        if (rng.frand() < prob / cH) {
             /* Generate 3d points of globular cluster stars in polar coordinates:
              * Distribution in eta (<=> r) according to King's profile. 
              * Uniform distribution on any spherical surface for given eta. 
              * Note: u = cos(phi) must be used as a stochastic variable to get uniformity in angle!
              */
-            float u = Mathf::sfrand();
-            float theta = 2 * (float)PI * Mathf::frand();
+            float u = rng.sfrand();
+            float theta = 2 * (float)PI * rng.frand();
             float sthetu2 = sin(theta) * sqrt(1.0f - u * u);
 
             // x,y,z points within -0.5..+0.5, as required for consistency:
@@ -566,14 +580,104 @@ GlobularForm* buildGlobularForms(float c) {
     // Check for efficiency of sprite-star generation => close to 100 %!
     //cout << "c =  "<< c <<"  i =  " << i - 1 <<"  k =  " << k - 1 <<                                                       "  Efficiency:  " << 100.0f * i / (float)k<<"%" << endl;
 
-    GlobularForm* globularForm = new GlobularForm();
-    globularForm->gblobs = globularPoints;
-    globularForm->scale = Vec3f(1.0f, 1.0f, 1.0f);
+    return globularPoints;
+}
 
-    return globularForm;
+// Layout of the globular form cache, in native byte order:
+//
+//   char[8]    "CELGCFRM"
+//   uint32_t   version, parameter hash, form count, points per form
+//   for each form and point:
+//     float    x, y, z; uint32_t colorIndex; float radius_2d
+static const char* FORM_CACHE_HEADER = "CELGCFRM";
+// Bump the version whenever the form generator, or the random number
+// generator it draws from, changes. The constants the forms are built from
+// go into the parameter hash instead.
+static const uint32_t FORM_CACHE_VERSION = 0x0101;
+static const size_t FORM_CACHE_PREAMBLE_SIZE = 8 + 4 * sizeof(uint32_t);
+static const size_t FORM_CACHE_BLOB_SIZE = 5 * sizeof(uint32_t);
+
+static uint32_t hashFormParameters() {
+    // FNV-1a, one 32-bit word at a time
+    uint32_t hash = 0x811c9dc5u;
+    auto mix = [&hash](uint32_t word) { hash = (hash ^ word) * 0x01000193u; };
+    auto mixFloat = [&mix](float f) {
+        uint32_t word;
+        memcpy(&word, &f, sizeof word);
+        mix(word);
+    };
+    mix(FORM_SEED);
+    mix(FORM_COUNT);
+    mix(GLOBULAR_POINTS);
+    mixFloat(MinC);
+    mixFloat(BinWidth);
+    return hash;
 }
 
-void InitializeForms() {
+static bool loadFormCache(const std::string& cacheFile, vector<GBlob>* forms[FORM_COUNT]) {
+    storage::StoragePointer file;
+    try {
+        file = storage::Storage::readFile(cacheFile);
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+
+    const uint8_t* data = file->data();
+    if (file->size() != FORM_CACHE_PREAMBLE_SIZE + (size_t)FORM_COUNT * GLOBULAR_POINTS * FORM_CACHE_BLOB_SIZE ||
+        strncmp((const char*)data, FORM_CACHE_HEADER, 8))
+        return false;
+
+    uint32_t preamble[4];
+    memcpy(preamble, data + 8, sizeof preamble);
+    data += FORM_CACHE_PREAMBLE_SIZE;
+    if (preamble[0] != FORM_CACHE_VERSION || preamble[1] != hashFormParameters() || preamble[2] != FORM_COUNT ||
+        preamble[3] != GLOBULAR_POINTS)
+        return false;
+
+    for (uint32_t ic = 0; ic < FORM_COUNT; ++ic) {
+        forms[ic] = new vector<GBlob>(GLOBULAR_POINTS);
+        for (GBlob& b : *forms[ic]) {
+            float position[3];
+            memcpy(position, data, sizeof position);
+            memcpy(&b.colorIndex, data + 12, sizeof(uint32_t));
+            memcpy(&b.radius_2d, data + 16, sizeof(float));
+            b.position = Point3f(position[0], position[1], position[2]);
+            data += FORM_CACHE_BLOB_SIZE;
+        }
+    }
+    return true;
+}
+
+static bool saveFormCache(const std::string& cacheFile, vector<GBlob>* const forms[FORM_COUNT]) {
+    ofstream out(cacheFile, ios::out | ios::binary | ios::trunc);
+    if (!out.good())
+        return false;
+
+    uint32_t preamble[4] = { FORM_CACHE_VERSION, hashFormParameters(), FORM_COUNT, GLOBULAR_POINTS };
+    out.write(FORM_CACHE_HEADER, 8);
+    out.write((const char*)preamble, sizeof preamble);
+    for (uint32_t ic = 0; ic < FORM_COUNT; ++ic) {
+        vector<uint8_t> records(forms[ic]->size() * FORM_CACHE_BLOB_SIZE);
+        uint8_t* record = records.data();
+        for (const GBlob& b : *forms[ic]) {
+            float position[3] = { b.position.x, b.position.y, b.position.z };
+            memcpy(record, position, sizeof position);
+            memcpy(record + 12, &b.colorIndex, sizeof(uint32_t));
+            memcpy(record + 16, &b.radius_2d, sizeof(float));
+            record += FORM_CACHE_BLOB_SIZE;
+        }
+        out.write((const char*)records.data(), records.size());
+    }
+    return out.good();
+}
+
+void Globular::initializeForms(const std::string& cacheFile) {
+    std::call_once(formsInitialized, InitializeForms, cacheFile);
+}
+
+void InitializeForms(const std::string& cacheFile) {
+    PROFILE_ZONE("Globular::initializeForms");
+
     // Build RGB color table, using hue, saturation, value as input.
     // Hue in degrees.
 
@@ -612,11 +716,21 @@ void InitializeForms() {
     }
     // Define globularForms corresponding to 8 different bins of King concentration c
 
+    vector<GBlob>* forms[FORM_COUNT] = { NULL };
+    if (cacheFile.empty() || !loadFormCache(cacheFile, forms)) {
+        ThreadPool::getDefault().parallelFor(FORM_COUNT, [&forms](size_t ic) {
+            float CBin = MinC + ((float)ic + 0.5f) * BinWidth;
+            forms[ic] = buildGlobularBlobs(CBin, FORM_SEED + (uint32_t)ic);
+        });
+        if (!cacheFile.empty() && !saveFormCache(cacheFile, forms))
+            cerr << _("Error writing globular form cache ") << cacheFile << '\n';
+    }
+
     globularForms = new GlobularForm*[8];
 
     for (uint32_t ic = 0; ic <= 7; ++ic) {
-        float CBin = MinC + ((float)ic + 0.5f) * BinWidth;
-        globularForms[ic] = buildGlobularForms(CBin);
+        globularForms[ic] = new GlobularForm();
+        globularForms[ic]->gblobs = forms[ic];
+        globularForms[ic]->scale = Vec3f(1.0f, 1.0f, 1.0f);
     }
-    formsInitialized = true;
 }
@@ -47,6 +47,13 @@ public:
     float getHalfMassRadius() const;
     uint32_t cSlot(float) const;
 
+    /*! Build the star clouds shared by all globulars with similar King
+     *  concentrations. This happens once, on first use at the latest; when
+     *  cacheFile is given, the forms are read from it if possible and
+     *  written to it otherwise.
+     */
+    static void initializeForms(const std::string& cacheFile);
+
     float getBoundingSphereRadius() const override { return tidalRadius; }
 
     bool pick(const Ray3d& ray, double& distanceToPicker, double& cosAngleToBoundCenter) const override;
@@ -19,9 +19,12 @@
 #include <unordered_map>
 #include <vector>
 #include <list>
+#include <mutex>
+#include <cstdint>
 #include <celutil/debug.h>
 #include <celutil/util.h>
 #include <celutil/utf8.h>
+#include "completionindex.h"
 
 // TODO: this can be "detemplatized" by creating e.g. a global-scope enum InvalidCatalogNumber since there
 // lies the one and only need for type genericity.
@@ -44,7 +47,11 @@ public:
     void add(const uint32_t, const std::string&);
 
     // delete all names associated with the specified catalog number
-    void erase(const uint32_t catalogNumber) { numberIndex.erase(catalogNumber); }
+    void erase(const uint32_t catalogNumber) {
+        std::lock_guard<std::mutex> lock(completionMutex);
+        numberIndex.erase(catalogNumber);
+        completionIndexValid = false;
+    }
 
     uint32_t getCatalogNumberByName(const std::string&) const;
     std::string getNameByCatalogNumber(const uint32_t) const;
@@ -55,11 +62,20 @@ public:
         return iter == numberIndex.end() ? empty : iter->second;
     }
 
-    NameVec getCompletion(const std::string& name) const;
+    // Names starting with the given prefix, compared with UTF8StringCompare
+    // normalization, in a deterministic order. The prefix index is rebuilt
+    // on the first call after names have changed.
+    NameVec getCompletion(const std::string& name, size_t maxCount = SIZE_MAX) const;
 
 private:
     NewNameIndex nameIndex;
     NewNumberIndex numberIndex;
+
+    // Guards the completion index and its validity flag, and the number
+    // index while the completion index is rebuilt from it
+    mutable std::mutex completionMutex;
+    mutable CompletionIndex completionIndex;
+    mutable bool completionIndexValid{ false };
 };
 
 template <class OBJ>
@@ -74,8 +90,10 @@ void NameDatabase<OBJ>::add(const uint32_t catalogNumber, const std::string& nam
         //nameIndex.insert(NameIndex::value_type(name, catalogNumber));
 
         
+        std::lock_guard<std::mutex> lock(completionMutex);
         nameIndex[toUpperStr(name)] = catalogNumber;
         numberIndex[catalogNumber].emplace_back(name);
+        completionIndexValid = false;
     }
 }
 
@@ -116,15 +134,20 @@ std::string NameDatabase<OBJ>::getNameByCatalogNumber(const uint32_t catalogNumb
 // but it works on the implementations I've tried so far.)
 
 template <class OBJ>
-std::vector<std::string> NameDatabase<OBJ>::getCompletion(const std::string& name) const {
-    std::vector<std::string> completion;
-    auto name_length = UTF8Length(name);
-
-    for (auto iter = nameIndex.begin(); iter != nameIndex.end(); ++iter) {
-        if (!UTF8StringCompare(iter->first, name, name_length)) {
-            completion.push_back(iter->first);
+std::vector<std::string> NameDatabase<OBJ>::getCompletion(const std::string& name, size_t maxCount) const {
+    std::lock_guard<std::mutex> lock(completionMutex);
+    if (!completionIndexValid) {
+        completionIndex.clear();
+        for (const auto& entry : numberIndex) {
+            for (const auto& objectName : entry.second)
+                completionIndex.add(objectName);
         }
+        completionIndex.build();
+        completionIndexValid = true;
     }
+
+    std::vector<std::string> completion;
+    completionIndex.find(name, maxCount, completion);
     return completion;
 }
 
@@ -28,6 +28,9 @@ public:
     uint32_t getLabelMask() const override;
     const char* getObjTypeName() const override;
 
+    const std::string& getGeometryFileName() const { return geometryFileName; }
+    void setGeometryFileName(const std::string& filename) { geometryFileName = filename; }
+
 public:
     enum NebulaType
     {
@@ -16,9 +16,14 @@
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 #include <celmath/plane.h>
+#include <celutil/threadpool.h>
 #include "observer.h"
 #include <vector>
 #include <array>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
 
 // The DynamicOctree and StaticOctree template arguments are:
 // OBJ:  object hanging from the node,
@@ -36,6 +41,98 @@ public:
     virtual void process(const std::shared_ptr<OBJ>& obj, PREC distance, float appMag) = 0;
 };
 
+// There are two classes implemented in this module: StaticOctree and
+// DynamicOctree.  The DynamicOctree is built first by inserting
+// objects from a database or catalog and is then 'compiled' into a StaticOctree.
+// In the process of building the StaticOctree, the original object database is
+// reorganized, with objects in the same octree node all placed adjacent to each
+// other.  This spatial sorting of the objects dramatically improves the
+// performance of octree operations through much more coherent memory access.
+enum
+{
+    XPos = 1,
+    YPos = 2,
+    ZPos = 4,
+};
+
+// An OctreeRangeProcessor is handed whole octree nodes rather than individual
+// objects: first and count select a contiguous range of the spatially sorted
+// object list, and limitingFactor is the node level bound (e.g. the faintest
+// absolute magnitude that can still be visible.)  Per object tests are left
+// to the processor, which can then work on packed arrays in bulk.
+template <class PREC>
+class OctreeRangeProcessor {
+public:
+    OctreeRangeProcessor(){};
+    virtual ~OctreeRangeProcessor(){};
+
+    virtual void processRange(uint32_t first, uint32_t count, float limitingFactor) = 0;
+};
+
+// Processors used by the parallel traversals: each task records what it would
+// have reported, and the records are replayed to the caller's processor in
+// octree order once all tasks have finished.
+template <class OBJ, class PREC>
+class OctreeObjectBuffer : public OctreeProcessor<OBJ, PREC> {
+public:
+    struct Entry {
+        const std::shared_ptr<OBJ>* obj;
+        PREC distance;
+        float appMag;
+    };
+
+    void process(const std::shared_ptr<OBJ>& obj, PREC distance, float appMag) override {
+        entries.push_back(Entry{ &obj, distance, appMag });
+    }
+
+    void replay(OctreeProcessor<OBJ, PREC>& processor, size_t begin, size_t end) const {
+        for (size_t i = begin; i < end; ++i) {
+            processor.process(*entries[i].obj, entries[i].distance, entries[i].appMag);
+        }
+    }
+
+    std::vector<Entry> entries;
+};
+
+template <class PREC>
+class OctreeRangeBuffer : public OctreeRangeProcessor<PREC> {
+public:
+    struct Entry {
+        uint32_t first;
+        uint32_t count;
+        float limitingFactor;
+    };
+
+    void processRange(uint32_t first, uint32_t count, float limitingFactor) override {
+        entries.push_back(Entry{ first, count, limitingFactor });
+    }
+
+    void replay(OctreeRangeProcessor<PREC>& processor, size_t begin, size_t end) const {
+        for (size_t i = begin; i < end; ++i) {
+            processor.processRange(entries[i].first, entries[i].count, entries[i].limitingFactor);
+        }
+    }
+
+    std::vector<Entry> entries;
+};
+
+// Subtrees deferred by the calling thread of a parallel traversal.  position
+// is the number of records the calling thread had produced when the subtree
+// was reached, which is where the subtree's records belong in the output.
+template <class PREC>
+struct OctreeTaskCollector {
+    struct Task {
+        uint32_t nodeIndex;
+        PREC scale;
+        size_t position;
+    };
+
+    uint32_t minTaskObjects;
+    uint32_t maxTaskObjects;
+    std::function<size_t()> outputPosition;
+    std::vector<Task> tasks;
+};
+
 struct OctreeLevelStatistics {
     uint32_t nodeCount;
     uint32_t objectCount;
@@ -60,6 +157,7 @@ private:
     //using StaticPtr = ;
     //using StaticPtrArray = std::array<StaticPtr, 8>;
 
+    using LimitingFactorFunction = std::function<float(const ObjectPtr&)>;
     using LimitingFactorPredicate = std::function<bool(const ObjectPtr&, const PREC)>;
     using StraddlingPredicate = std::function<bool(const PointType&, const ObjectPtr&, const PREC)>;
     using ExclusionFactorDecayFunction = std::function<PREC(const PREC)>;
@@ -95,25 +193,22 @@ public:
         }
     }
 
-    void rebuildAndSort(std::shared_ptr<StaticOctree<OBJ, PREC>>& outStaticNode, ObjectList& outSortedObjects) {
-        outStaticNode = std::make_shared<StaticOctree<OBJ, PREC>>(cellCenterPos, exclusionFactor, _objects);
-        outSortedObjects.insert(outSortedObjects.end(), _objects.begin(), _objects.end());
-        if (_children) {
-            auto& children = *_children;
-            auto& staticNode = *outStaticNode;
-            auto& staticNodeChildren = staticNode._children;
-            staticNodeChildren.reset(new std::array<std::shared_ptr<StaticOctree<OBJ, PREC>>, 8>());
-            for (int i = 0; i < 8; ++i) {
-                const auto& child = (*_children)[i];
-                auto& outChild = (*outStaticNode->_children)[i];
-                child->rebuildAndSort(outChild, outSortedObjects);
-            }
-        }
+    // Compile this dynamic octree into a flat StaticOctree.  The objects of every
+    // node are sorted in depth first order, so that each static node can refer
+    // to its objects by a contiguous index range; outSortedObjects is set to a
+    // copy of the sorted list.
+    void rebuildAndSort(std::shared_ptr<StaticOctree<OBJ, PREC>>& outStaticOctree, ObjectList& outSortedObjects) {
+        outStaticOctree = std::make_shared<StaticOctree<OBJ, PREC>>();
+        auto& nodes = outStaticOctree->_nodes;
+        nodes.resize(1);
+        flatten(nodes, 0, outStaticOctree->_objects);
+        outSortedObjects = outStaticOctree->_objects;
     }
 
 private:
     static uint32_t SPLIT_THRESHOLD;
 
+    static LimitingFactorFunction limitingFactorFunction;
     static LimitingFactorPredicate limitingFactorPredicate;
     static StraddlingPredicate straddlingPredicate;
     static ExclusionFactorDecayFunction decayFunction;
@@ -157,6 +252,37 @@ private:
         _objects.resize(nKeptInParent);
     }
 
+    // Store this node into nodes[nodeIndex].  The eight children of a node are
+    // always allocated as one contiguous block, so only the index of the first
+    // child needs to be kept.
+    void flatten(std::vector<typename StaticOctree<OBJ, PREC>::Node>& nodes, uint32_t nodeIndex, ObjectList& outSortedObjects) const {
+        auto& node = nodes[nodeIndex];
+        node.cellCenterPos = cellCenterPos;
+        node.exclusionFactor = (float)exclusionFactor;
+        node.firstObject = (uint32_t)outSortedObjects.size();
+        node.objectCount = (uint32_t)_objects.size();
+        node.firstChild = StaticOctree<OBJ, PREC>::InvalidIndex;
+        outSortedObjects.insert(outSortedObjects.end(), _objects.begin(), _objects.end());
+
+        float brightestFactor = std::numeric_limits<float>::infinity();
+        for (const auto& obj : _objects)
+            brightestFactor = std::min(brightestFactor, limitingFactorFunction(obj));
+
+        if (_children) {
+            // Resizing invalidates the node reference, so index the vector again
+            uint32_t firstChild = (uint32_t)nodes.size();
+            nodes[nodeIndex].firstChild = firstChild;
+            nodes.resize(nodes.size() + 8);
+            for (uint32_t i = 0; i < 8; ++i) {
+                (*_children)[i]->flatten(nodes, firstChild + i, outSortedObjects);
+                brightestFactor = std::min(brightestFactor, nodes[firstChild + i].brightestFactor);
+            }
+        }
+
+        nodes[nodeIndex].brightestFactor = brightestFactor;
+        nodes[nodeIndex].subtreeObjectCount = (uint32_t)outSortedObjects.size() - nodes[nodeIndex].firstObject;
+    }
+
     Pointer getChild(const ObjectPtr&, const PointType&);
 
     std::unique_ptr<std::array<Pointer, 8>> _children;
@@ -165,6 +291,13 @@ private:
     ObjectList _objects;
 };
 
+// The StaticOctree is stored as a single flat array of nodes rather than as a
+// tree of individually allocated nodes.  The root is always node 0, and the
+// eight children of a node are stored contiguously starting at firstChild.
+// Objects are not held by the nodes themselves: each node refers to the range
+// [firstObject, firstObject + objectCount) of the spatially sorted object list
+// produced by DynamicOctree::rebuildAndSort. The octree keeps its own copy of
+// that list, so it stays valid whatever the database does with its own.
 template <class OBJ, class PREC>
 class StaticOctree {
     friend class DynamicOctree<OBJ, PREC>;
@@ -176,16 +309,30 @@ public:
     using ObjectPtr = std::shared_ptr<OBJ>;
     using ObjectList = std::vector<ObjectPtr>;
 
+    static const uint32_t InvalidIndex = ~(uint32_t)0;
+
+    struct Node {
+        PointType cellCenterPos;
+        float exclusionFactor;
+        uint32_t firstChild;
+        uint32_t firstObject;
+        uint32_t objectCount;
+        uint32_t subtreeObjectCount;
+        // Smallest limiting factor of any object in the subtree, e.g. the
+        // absolute magnitude of its brightest star
+        float brightestFactor;
+
+        bool hasChildren() const { return firstChild != InvalidIndex; }
+    };
+
 public:
-    StaticOctree(const PointType& cellCenterPos, const float exclusionFactor, const ObjectList& objects) :
-        cellCenterPos(cellCenterPos), exclusionFactor(exclusionFactor), _objects(objects) {}
+    StaticOctree() = default;
+    // Adopt an already flattened node array, e.g. one restored from a cache
+    // file; objects must be in the order the nodes were built against.
+    StaticOctree(const ObjectList& objects, std::vector<Node>&& nodes) : _nodes(std::move(nodes)), _objects(objects) {}
 
     ~StaticOctree() {}
 
-    // These methods are only declared at the template level; we'll implement them as
-    // full specializations, allowing for different traversal strategies depending on the
-    // object type and nature.
-
     // This method searches the octree for objects that are likely to be visible
     // to a viewer with the specified obsPosition and limitingFactor.  The
     // octreeProcessor is invoked for each potentially visible object --no object with
@@ -197,79 +344,260 @@ public:
                                const PointType& obsPosition,
                                const Frustum& frustumPlanes,
                                float limitingFactor,
-                               PREC scale) const;
+                               PREC scale) const {
+        processVisibleNode(0, processor, obsPosition, frustumPlanes, limitingFactor, scale);
+    }
+
+    // Same traversal as processVisibleObjects, but the processor receives the
+    // object range of every node that survives the node level culling.
+    void processVisibleRanges(OctreeRangeProcessor<PREC>& processor,
+                              const PointType& obsPosition,
+                              const Frustum& frustumPlanes,
+                              float limitingFactor,
+                              PREC scale) const {
+        processVisibleRangeNode(0, processor, obsPosition, frustumPlanes, limitingFactor, scale);
+    }
+
+    void processCloseObjects(OctreeProcessor<OBJ, PREC>& processor,
+                             const PointType& obsPosition,
+                             PREC boundingRadius,
+                             PREC scale) const {
+        processCloseNode(0, processor, obsPosition, boundingRadius, scale);
+    }
+
+    // Parallel versions of the traversals above.  Subtrees holding enough
+    // objects are traversed as separate tasks on the thread pool; the
+    // processor itself is only ever called from the calling thread, with
+    // exactly the same sequence of objects as the serial traversal.
+    void processVisibleObjects(OctreeProcessor<OBJ, PREC>& processor,
+                               const PointType& obsPosition,
+                               const Frustum& frustumPlanes,
+                               float limitingFactor,
+                               PREC scale,
+                               ThreadPool& threadPool) const {
+        processParallel<OctreeObjectBuffer<OBJ, PREC>>(
+            processor, threadPool, scale, [&](uint32_t nodeIndex, OctreeObjectBuffer<OBJ, PREC>& buffer, PREC nodeScale) {
+                processVisibleNode(nodeIndex, buffer, obsPosition, frustumPlanes, limitingFactor, nodeScale);
+            });
+    }
+
+    void processVisibleRanges(OctreeRangeProcessor<PREC>& processor,
+                              const PointType& obsPosition,
+                              const Frustum& frustumPlanes,
+                              float limitingFactor,
+                              PREC scale,
+                              ThreadPool& threadPool) const {
+        processParallel<OctreeRangeBuffer<PREC>>(
+            processor, threadPool, scale, [&](uint32_t nodeIndex, OctreeRangeBuffer<PREC>& buffer, PREC nodeScale) {
+                processVisibleRangeNode(nodeIndex, buffer, obsPosition, frustumPlanes, limitingFactor, nodeScale);
+            });
+    }
 
     void processCloseObjects(OctreeProcessor<OBJ, PREC>& processor,
                              const PointType& obsPosition,
                              PREC boundingRadius,
-                             PREC scale) const;
+                             PREC scale,
+                             ThreadPool& threadPool) const {
+        processParallel<OctreeObjectBuffer<OBJ, PREC>>(
+            processor, threadPool, scale, [&](uint32_t nodeIndex, OctreeObjectBuffer<OBJ, PREC>& buffer, PREC nodeScale) {
+                processCloseNode(nodeIndex, buffer, obsPosition, boundingRadius, nodeScale);
+            });
+    }
 
-    size_t countChildren() const {
-        size_t count = 0;
-        if (_children) {
-            for (const auto& child : *_children) {
-                count += 1 + child->countChildren();
+    // Best first traversal: visit(index, key) is called for objects in
+    // increasing order of objectKey(obj), with index referring to the sorted
+    // object list, until visit returns false or no object with a key up to
+    // maxKey is left.  nodeKey(node, scale) must not exceed the key of any
+    // object in the subtree of the node; a node is only opened once every
+    // object with a smaller key has been visited, so queries for a handful of
+    // objects touch a small part of the tree.
+    template <class NODEKEY, class OBJECTKEY, class VISIT>
+    void processObjectsInOrder(NODEKEY nodeKey, OBJECTKEY objectKey, PREC maxKey, PREC scale, VISIT visit) const {
+        struct Item {
+            PREC key;
+            PREC scale;
+            uint32_t index;
+            bool isObject;
+        };
+        // Objects come out before nodes with the same key, and otherwise in
+        // octree order, so that the result doesn't depend on the heap.
+        auto after = [](const Item& a, const Item& b) {
+            if (a.key != b.key)
+                return a.key > b.key;
+            if (a.isObject != b.isObject)
+                return b.isObject;
+            return a.index > b.index;
+        };
+        std::priority_queue<Item, std::vector<Item>, decltype(after)> queue(after);
+
+        if (!_nodes.empty())
+            queue.push(Item{ nodeKey(_nodes[0], scale), scale, 0, false });
+
+        while (!queue.empty() && queue.top().key <= maxKey) {
+            Item item = queue.top();
+            queue.pop();
+            if (item.isObject) {
+                if (!visit(item.index, item.key))
+                    return;
+                continue;
+            }
+
+            const Node& node = _nodes[item.index];
+            const uint32_t lastObject = node.firstObject + node.objectCount;
+            for (uint32_t i = node.firstObject; i < lastObject; ++i) {
+                PREC key = objectKey(*_objects[i]);
+                if (key <= maxKey)
+                    queue.push(Item{ key, 0, i, true });
+            }
+
+            if (node.hasChildren()) {
+                PREC childScale = item.scale * (PREC)0.5;
+                for (uint32_t i = 0; i < 8; ++i) {
+                    PREC key = nodeKey(_nodes[node.firstChild + i], childScale);
+                    if (key <= maxKey)
+                        queue.push(Item{ key, childScale, node.firstChild + i, false });
+                }
             }
         }
-        return count;
     }
 
+    // Call visit(index, distance) for the objects within maxDistance of
+    // position, nearest first, until visit returns false.
+    template <class VISIT>
+    void processObjectsByDistance(const PointType& position, PREC maxDistance, PREC scale, VISIT visit) const {
+        processObjectsInOrder([&position](const Node& node, PREC nodeScale) { return nodeDistance(node, position, nodeScale); },
+                              [&position](const OBJ& obj) { return (PREC)(position - obj.getPosition()).norm(); },
+                              maxDistance,
+                              scale,
+                              visit);
+    }
+
+    // Distance from position to the bounding sphere of a node, or zero if
+    // position is inside it.
+    static PREC nodeDistance(const Node& node, const PointType& position, PREC scale) {
+        return std::max((PREC)0, (position - node.cellCenterPos).norm() - scale * SQRT3);
+    }
+
+    size_t countChildren() const { return _nodes.empty() ? 0 : _nodes.size() - 1; }
+
     size_t countObjects() const {
-        size_t count = _objects.size();
-        if (_children) {
-            for (const auto& child : *_children) {
-                count += child->countObjects();
-            }
+        size_t count = 0;
+        for (const auto& node : _nodes) {
+            count += node.objectCount;
         }
         return count;
     }
 
-    void computeStatistics(std::vector<OctreeLevelStatistics>& stats, uint32_t level = 0) {
-        if (level >= stats.size()) {
-            while (level >= stats.size()) {
-                OctreeLevelStatistics levelStats;
-                levelStats.nodeCount = 0;
-                levelStats.objectCount = 0;
-                levelStats.size = 0.0;
-                stats.push_back(levelStats);
-            }
+    void computeStatistics(std::vector<OctreeLevelStatistics>& stats, uint32_t nodeIndex = 0, uint32_t level = 0) const {
+        while (level >= stats.size()) {
+            OctreeLevelStatistics levelStats;
+            levelStats.nodeCount = 0;
+            levelStats.objectCount = 0;
+            levelStats.size = 0.0;
+            stats.push_back(levelStats);
         }
 
+        const auto& node = _nodes[nodeIndex];
         stats[level].nodeCount++;
-        stats[level].objectCount += _objects.size();
+        stats[level].objectCount += node.objectCount;
         stats[level].size = 0.0;
 
-        if (_children) {
-            for (const auto& child : *_children) {
-                child->computeStatistics(stats, level + 1);
+        if (node.hasChildren()) {
+            for (uint32_t i = 0; i < 8; ++i) {
+                computeStatistics(stats, node.firstChild + i, level + 1);
             }
         }
     }
 
+    const std::vector<Node>& getNodes() const { return _nodes; }
+    const ObjectList& getObjects() const { return _objects; }
+
 private:
+    // These methods are only declared at the template level; we'll implement them as
+    // full specializations, allowing for different traversal strategies depending on the
+    // object type and nature.
+    void processVisibleNode(uint32_t nodeIndex,
+                            OctreeProcessor<OBJ, PREC>& processor,
+                            const PointType& obsPosition,
+                            const Frustum& frustumPlanes,
+                            float limitingFactor,
+                            PREC scale) const;
+
+    void processVisibleRangeNode(uint32_t nodeIndex,
+                                 OctreeRangeProcessor<PREC>& processor,
+                                 const PointType& obsPosition,
+                                 const Frustum& frustumPlanes,
+                                 float limitingFactor,
+                                 PREC scale) const;
+
+    void processCloseNode(uint32_t nodeIndex,
+                          OctreeProcessor<OBJ, PREC>& processor,
+                          const PointType& obsPosition,
+                          PREC boundingRadius,
+                          PREC scale) const;
+
+    // Called by the node traversals before doing anything else.  During the
+    // serial part of a parallel traversal, subtrees of a suitable size are
+    // recorded as tasks instead of being traversed immediately.
+    bool deferNode(uint32_t nodeIndex, PREC scale) const {
+        OctreeTaskCollector<PREC>* collector = taskCollector;
+        if (collector == nullptr || nodeIndex == 0)
+            return false;
+
+        uint32_t nObjects = _nodes[nodeIndex].subtreeObjectCount;
+        if (nObjects < collector->minTaskObjects || nObjects > collector->maxTaskObjects)
+            return false;
+
+        collector->tasks.push_back({ nodeIndex, scale, collector->outputPosition() });
+        return true;
+    }
+
+    template <class BUFFER, class PROCESSOR, class VISIT>
+    void processParallel(PROCESSOR& processor, ThreadPool& threadPool, PREC scale, VISIT visit) const {
+        uint32_t nThreads = threadPool.getThreadCount() + 1;
+        uint32_t nObjects = _nodes.empty() ? 0 : _nodes[0].subtreeObjectCount;
+        if (nThreads == 1 || nObjects < 2 * MIN_TASK_OBJECTS) {
+            BUFFER buffer;
+            visit(0, buffer, scale);
+            buffer.replay(processor, 0, buffer.entries.size());
+            return;
+        }
+
+        // Aim for several tasks per thread so that stealing can even out
+        // the uneven cost of culled and unculled subtrees.
+        BUFFER top;
+        OctreeTaskCollector<PREC> collector;
+        collector.maxTaskObjects = std::max(MIN_TASK_OBJECTS, nObjects / (nThreads * 8));
+        collector.minTaskObjects = collector.maxTaskObjects / 8;
+        collector.outputPosition = [&top]() { return top.entries.size(); };
+
+        taskCollector = &collector;
+        visit(0, top, scale);
+        taskCollector = nullptr;
+
+        const auto& tasks = collector.tasks;
+        std::vector<BUFFER> results(tasks.size());
+        threadPool.parallelFor(tasks.size(), [&](size_t i) { visit(tasks[i].nodeIndex, results[i], tasks[i].scale); });
+
+        size_t position = 0;
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            top.replay(processor, position, tasks[i].position);
+            position = tasks[i].position;
+            results[i].replay(processor, 0, results[i].entries.size());
+        }
+        top.replay(processor, position, top.entries.size());
+    }
+
     static const PREC SQRT3;
 
-private:
-    std::unique_ptr<std::array<Pointer, 8>> _children;
-    PointType cellCenterPos;
-    float exclusionFactor;
-    std::vector<ObjectPtr> _objects;
-    //OBJ* _firstObject;
-    //uint32_t nObjects;
-};
+    // Subtrees with fewer objects than this are never worth a task of their own
+    static const uint32_t MIN_TASK_OBJECTS = 2048;
 
-// There are two classes implemented in this module: StaticOctree and
-// DynamicOctree.  The DynamicOctree is built first by inserting
-// objects from a database or catalog and is then 'compiled' into a StaticOctree.
-// In the process of building the StaticOctree, the original object database is
-// reorganized, with objects in the same octree node all placed adjacent to each
-// other.  This spatial sorting of the objects dramatically improves the
-// performance of octree operations through much more coherent memory access.
-enum
-{
-    XPos = 1,
-    YPos = 2,
-    ZPos = 4,
+    static thread_local OctreeTaskCollector<PREC>* taskCollector;
+
+private:
+    std::vector<Node> _nodes;
+    ObjectList _objects;
 };
 
 // The SPLIT_THRESHOLD is the number of objects a node must contain before its
@@ -281,7 +609,10 @@ enum
 template <class OBJ, class PREC>
 const PREC StaticOctree<OBJ, PREC>::SQRT3 = (PREC)1.732050807568877;
 
+template <class OBJ, class PREC>
+const uint32_t StaticOctree<OBJ, PREC>::MIN_TASK_OBJECTS;
 
 template <class OBJ, class PREC>
+thread_local OctreeTaskCollector<PREC>* StaticOctree<OBJ, PREC>::taskCollector = nullptr;
 
 #endif  // _OCTREE_H_
@@ -16,22 +16,35 @@ using namespace std;
 
 /****** Value method implementations *******/
 
-Value::Value(double d) : type(NumberType), data(d) {
+Value::Value(double d) : type(NumberType), d(d) {
 }
 
-Value::Value(const std::string& s) : type(StringType), data(s) {
+Value::Value(const std::string& s) : type(StringType), s(s) {
 }
 
-Value::Value(const ValueArrayPtr& a) : type(ArrayType), data(a) {
+Value::Value(const ValueArrayPtr& a) : type(ArrayType), a(a) {
 }
 
-Value::Value(const HashPtr& h) : type(HashType), data(h) {
+Value::Value(const HashPtr& h) : type(HashType), h(h) {
 }
 
-Value::Value(bool b) : type{ BooleanType }, data(b ? 1.0 : 0.0) {
+Value::Value(bool b) : type{ BooleanType }, d(b ? 1.0 : 0.0) {
 }
 
 Value::~Value() {
+    switch (type) {
+        case StringType:
+            s.~basic_string();
+            break;
+        case ArrayType:
+            a.~ValueArrayPtr();
+            break;
+        case HashType:
+            h.~HashPtr();
+            break;
+        default:
+            break;
+    }
 }
 
 Value::ValueType Value::getType() const {
@@ -39,34 +52,41 @@ Value::ValueType Value::getType() const {
 }
 
 const double& Value::getNumber() const {
+    static const double ZERO = 0.0;
     // ASSERT(type == NumberType);
-    return data.d;
+    return type == NumberType || type == BooleanType ? d : ZERO;
 }
 
 const string& Value::getString() const {
     static const std::string EMPTY;
     // ASSERT(type == StringType);
-    return data.s ? *data.s : EMPTY;
+    return type == StringType ? s : EMPTY;
 }
 
 const ValueArrayPtr& Value::getArray() const {
+    static const ValueArrayPtr NONE;
     // ASSERT(type == ArrayType);
-    return data.a;
+    return type == ArrayType ? a : NONE;
 }
 
 const HashPtr& Value::getHash() const {
+    static const HashPtr NONE;
     // ASSERT(type == HashType);
-    return data.h;
+    return type == HashType ? h : NONE;
 }
 
 bool Value::getBoolean() const {
     // ASSERT(type == BooleanType);
-    return (data.d != 0.0);
+    return (type == NumberType || type == BooleanType) && d != 0.0;
 }
 
 /****** Parser method implementation ******/
 
-Parser::Parser(Tokenizer* _tokenizer) : tokenizer(_tokenizer) {
+// Property lists of a typical catalog file fit in a few blocks of this size
+static const uint32_t ParserArenaBlockSize = 256 * 1024;
+
+Parser::Parser(Tokenizer* _tokenizer) :
+    tokenizer(_tokenizer), arena(std::make_shared<Arena>(ParserArenaBlockSize)) {
 }
 
 ValueArrayPtr Parser::readArray() {
@@ -76,20 +96,24 @@ ValueArrayPtr Parser::readArray() {
         return nullptr;
     }
 
-    auto array = std::make_shared<ValueArray>();
-
+    size_t first = valueStack.size();
     auto v = readValue();
     while (v) {
-        array->insert(array->end(), v);
+        valueStack.push_back(std::move(v));
         v = readValue();
     }
 
+    ValueArrayPtr array;
     tok = tokenizer->nextToken();
     if (tok != Tokenizer::TokenEndArray) {
         tokenizer->pushBack();
-        return nullptr;
+    } else {
+        ArenaAllocator<ValueArray> allocator(arena);
+        array = std::allocate_shared<ValueArray>(allocator, std::make_move_iterator(valueStack.begin() + first),
+                                                 std::make_move_iterator(valueStack.end()), allocator);
     }
 
+    valueStack.resize(first);
     return array;
 }
 
@@ -100,17 +124,24 @@ HashPtr Parser::readHash() {
         return nullptr;
     }
 
-    auto hash = std::make_shared<Hash>();
+    size_t first = entryStack.size();
+    // Drops the entries of a bad hash on the way out
+    struct StackGuard {
+        std::vector<AssociativeArray::Entry>& stack;
+        size_t size;
+        ~StackGuard() { stack.resize(size); }
+    } guard{ entryStack, first };
+
     tok = tokenizer->nextToken();
     while (tok != Tokenizer::TokenEndGroup) {
         if (tok != Tokenizer::TokenName) {
             tokenizer->pushBack();
             return nullptr;
         }
-        string name = tokenizer->getNameValue();
+        const string* name = arena->intern(tokenizer->getNameValue());
 
 #ifndef USE_POSTFIX_UNITS
-        readUnits(name, hash);
+        readUnits(*name);
 #endif
 
         auto value = readValue();
@@ -118,25 +149,26 @@ HashPtr Parser::readHash() {
             return nullptr;
         }
 
-        hash->addValue(name, value);
+        entryStack.push_back({ name, std::move(value) });
 
 #ifdef USE_POSTFIX_UNITS
-        readUnits(name, hash);
+        readUnits(*name);
 #endif
 
         tok = tokenizer->nextToken();
     }
 
+    auto hash = std::allocate_shared<Hash>(ArenaAllocator<Hash>(arena), arena);
+    hash->addEntries(entryStack.data() + first, entryStack.data() + entryStack.size());
     return hash;
 }
 
 /**
- * Reads a units section into the hash.
+ * Reads a units section into the hash being read.
  * @param[in] propertyName Name of the current property.
- * @param[in] hash Hash to add units quantities into.
  * @return True if a units section was successfully read, false otherwise.
  */
-bool Parser::readUnits(const string& propertyName, const HashPtr& hash) {
+bool Parser::readUnits(const string& propertyName) {
     Tokenizer::TokenType tok = tokenizer->nextToken();
     if (tok != Tokenizer::TokenBeginUnits) {
         tokenizer->pushBack();
@@ -151,17 +183,14 @@ bool Parser::readUnits(const string& propertyName, const HashPtr& hash) {
         }
 
         string unit = tokenizer->getNameValue();
-        auto value = std::make_shared<Value>(unit);
+        auto value = makeValue(unit);
 
         if (astro::isLengthUnit(unit)) {
-            string keyName(propertyName + "%Length");
-            hash->addValue(keyName, value);
+            entryStack.push_back({ arena->intern(propertyName + "%Length"), value });
         } else if (astro::isTimeUnit(unit)) {
-            string keyName(propertyName + "%Time");
-            hash->addValue(keyName, value);
+            entryStack.push_back({ arena->intern(propertyName + "%Time"), value });
         } else if (astro::isAngleUnit(unit)) {
-            string keyName(propertyName + "%Angle");
-            hash->addValue(keyName, value);
+            entryStack.push_back({ arena->intern(propertyName + "%Angle"), value });
         } else {
             return false;
         }
@@ -176,16 +205,16 @@ ValuePtr Parser::readValue() {
     Tokenizer::TokenType tok = tokenizer->nextToken();
     switch (tok) {
         case Tokenizer::TokenNumber:
-            return std::make_shared<Value>(tokenizer->getNumberValue());
+            return makeValue(tokenizer->getNumberValue());
 
         case Tokenizer::TokenString:
-            return std::make_shared<Value>(tokenizer->getStringValue());
+            return makeValue(tokenizer->getStringValue());
 
         case Tokenizer::TokenName:
             if (tokenizer->getNameValue() == "false")
-                return std::make_shared<Value>(false);
+                return makeValue(false);
             else if (tokenizer->getNameValue() == "true")
-                return std::make_shared<Value>(true);
+                return makeValue(true);
             else {
                 tokenizer->pushBack();
                 return nullptr;
@@ -198,7 +227,7 @@ ValuePtr Parser::readValue() {
                 if (!array)
                     return nullptr;
                 else
-                    return std::make_shared<Value>(array);
+                    return makeValue(array);
             }
 
         case Tokenizer::TokenBeginGroup:
@@ -208,7 +237,7 @@ ValuePtr Parser::readValue() {
                 if (!hash)
                     return nullptr;
                 else
-                    return std::make_shared<Value>(hash);
+                    return makeValue(hash);
             }
 
         default:
@@ -217,16 +246,38 @@ ValuePtr Parser::readValue() {
     }
 }
 
+/****** AssociativeArray method implementation ******/
+
+AssociativeArray::AssociativeArray() : AssociativeArray(std::make_shared<Arena>(4096)) {
+}
+
+AssociativeArray::AssociativeArray(const std::shared_ptr<Arena>& _arena) :
+    arena(_arena), entries(ArenaAllocator<Entry>(_arena)) {
+}
+
 ValuePtr AssociativeArray::getValue(const string& key) const {
-    auto iter = assoc.find(key);
-    if (iter == assoc.end())
-        return nullptr;
-    else
-        return iter->second;
+    for (const auto& entry : entries) {
+        if (*entry.key == key)
+            return entry.value;
+    }
+    return nullptr;
 }
 
 void AssociativeArray::addValue(const string& key, const ValuePtr& val) {
-    assoc.insert({ key, val });
+    if (getValue(key) == nullptr)
+        entries.push_back({ arena->intern(key), val });
+}
+
+void AssociativeArray::addEntries(Entry* first, Entry* last) {
+    entries.reserve(entries.size() + (last - first));
+    for (Entry* entry = first; entry != last; ++entry) {
+        // Interned keys can be compared by address
+        bool present = false;
+        for (const auto& e : entries)
+            present = present || e.key == entry->key;
+        if (!present)
+            entries.push_back(std::move(*entry));
+    }
 }
 
 bool AssociativeArray::getNumber(const string& key, double& val) const {
@@ -694,11 +745,3 @@ bool AssociativeArray::getTimeScale(const string& key, float& scale) const {
     scale = ((float)dscale);
     return true;
 }
-
-HashIterator AssociativeArray::begin() {
-    return assoc.begin();
-}
-
-HashIterator AssociativeArray::end() {
-    return assoc.end();
-}
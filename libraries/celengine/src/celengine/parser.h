@@ -16,6 +16,7 @@
 #include <celmath/vecmath.h>
 #include <celmath/quaternion.h>
 #include <celutil/color.h>
+#include <celutil/arena.h>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 #include "tokenizer.h"
@@ -23,12 +24,29 @@
 class Value;
 using ValuePtr = std::shared_ptr<Value>;
 
-typedef std::map<std::string, ValuePtr>::const_iterator HashIterator;
-
+/*! Properties of an object definition. Definitions have a handful to a few
+ *  dozen properties, so they're kept in insertion order in a flat array and
+ *  found with a linear search. Keys are interned in the arena, which every
+ *  file's worth of keys share; like the Values themselves, the entries are
+ *  allocated from the parser's arena.
+ *
+ *  As before, when a key is added twice the first value wins.
+ */
 class AssociativeArray {
 public:
     using Pointer = std::shared_ptr<AssociativeArray>;
 
+    struct Entry {
+        const std::string* key;
+        ValuePtr value;
+    };
+    using EntryList = std::vector<Entry, ArenaAllocator<Entry>>;
+    using const_iterator = EntryList::const_iterator;
+
+    // A hash built outside the parser gets a small arena of its own
+    AssociativeArray();
+    explicit AssociativeArray(const std::shared_ptr<Arena>&);
+
     ValuePtr getValue(const std::string&) const;
     void addValue(const std::string&, const ValuePtr&);
 
@@ -62,15 +80,24 @@ public:
     bool getTimeScale(const std::string&, double&) const;
     bool getTimeScale(const std::string&, float&) const;
 
-    HashIterator begin();
-    HashIterator end();
+    const_iterator begin() const { return entries.begin(); }
+    const_iterator end() const { return entries.end(); }
+    size_t size() const { return entries.size(); }
 
 private:
-    std::map<std::string, ValuePtr> assoc;
+    // Move in the entries [first, last), skipping keys already present
+    void addEntries(Entry* first, Entry* last);
+
+    std::shared_ptr<Arena> arena;
+    EntryList entries;
+
+    friend class Parser;
 };
 
-using Array = std::vector<ValuePtr>;
-using ValueArray = std::vector<ValuePtr>;
+using HashIterator = AssociativeArray::const_iterator;
+
+using Array = std::vector<ValuePtr, ArenaAllocator<ValuePtr>>;
+using ValueArray = Array;
 using ValueArrayPtr = std::shared_ptr<ValueArray>;
 using StringPtr = std::shared_ptr<std::string>;
 using Hash = AssociativeArray;
@@ -94,6 +121,9 @@ public:
     Value(bool);
     ~Value();
 
+    Value(const Value&) = delete;
+    Value& operator=(const Value&) = delete;
+
     ValueType getType() const;
 
     const double& getNumber() const;
@@ -105,18 +135,20 @@ public:
 private:
     const ValueType type;
 
-    const struct Data {
-        Data(double d) : d(d) {}
-        Data(const std::string& s) : s(std::make_shared<std::string>(s)), d(0) {}
-        Data(const ValueArrayPtr& a) : a(a), d(0) {}
-        Data(const HashPtr& h) : h(h), d(0) {}
-        const StringPtr s;
-        const double d;
-        const ValueArrayPtr a;
-        const HashPtr h;
-    } data;
+    // Only the member selected by type is constructed; booleans are stored
+    // as a number.
+    union {
+        double d;
+        std::string s;
+        ValueArrayPtr a;
+        HashPtr h;
+    };
 };
 
+/*! Everything a parser reads is allocated from one arena, which is released
+ *  in one go once the last value read from it is gone. Parse a file with a
+ *  single Parser so that its definitions end up together.
+ */
 class Parser {
 public:
     Parser(Tokenizer*);
@@ -125,8 +157,20 @@ public:
 
 private:
     Tokenizer* tokenizer;
+    std::shared_ptr<Arena> arena;
+
+    // Scratch space for the arrays and hashes being read; nested ones use
+    // the top of the stacks. The items are copied into the arena with an
+    // exact size once complete.
+    std::vector<ValuePtr> valueStack;
+    std::vector<AssociativeArray::Entry> entryStack;
+
+    template <class T>
+    ValuePtr makeValue(T&& v) {
+        return std::allocate_shared<Value>(ArenaAllocator<Value>(arena), std::forward<T>(v));
+    }
 
-    bool readUnits(const std::string&, const HashPtr&);
+    bool readUnits(const std::string&);
     ValueArrayPtr readArray();
     HashPtr readHash();
 };
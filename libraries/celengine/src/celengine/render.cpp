@@ -15,6 +15,7 @@
 #include <cassert>
 
 #include <algorithm>
+#include <chrono>
 #include <iomanip>
 #include <sstream>
 
@@ -28,6 +29,8 @@
 #include <celutil/timer.h>
 
 #include <celastro/astro.h>
+#include <celutil/profiler.h>
+#include <celutil/threadpool.h>
 
 #include "atmosphere.h"
 #include "boundaries.h"
@@ -565,11 +568,19 @@ static void setupSecondaryLightSources(vector<SecondaryIlluminator>& secondaryIl
     }
 }
 
+using PhaseClock = std::chrono::steady_clock;
+
+static double millisecondsSince(const PhaseClock::time_point& start) {
+    return std::chrono::duration<double, std::milli>(PhaseClock::now() - start).count();
+}
+
 void Renderer::preRender(const Observer& observer, const Universe& universe, float faintestMagNight, const Selection& sel) {
+    PROFILE_ZONE("Renderer::preRender");
     // Get the observer's time
     double now = observer.getTime();
     realTime = observer.getRealTime();
     settingsChanged = false;
+    preRenderTimings = PreRenderTimings();
 
     // Compute the size of a pixel
     auto fov = radToDeg(PI / 2.0f);
@@ -642,6 +653,11 @@ void Renderer::preRender(const Observer& observer, const Universe& universe, flo
                         solarSysTree->markUpdated();
                     }
 
+                    // Evaluate the positions of all bodies once; the render,
+                    // orbit, label and picking passes all read them.
+                    auto phaseStart = PhaseClock::now();
+                    solarSysTree->updateStates(now);
+
                     // Compute the position of the observer in astrocentric coordinates
                     Vector3d astrocentricObserverPos = astrocentricPosition(observer.getPosition(), *sun, now);
 
@@ -649,8 +665,11 @@ void Renderer::preRender(const Observer& observer, const Universe& universe, flo
                     buildRenderLists(astrocentricObserverPos, xfrustum,
                                      observer.getOrientation().conjugate() * -Vector3d::UnitZ(), Vector3d::Zero(), solarSysTree,
                                      observer, now);
+                    preRenderTimings.renderLists += millisecondsSince(phaseStart);
                     if (renderFlags & ShowOrbits) {
+                        phaseStart = PhaseClock::now();
                         buildOrbitLists(astrocentricObserverPos, observer.getOrientation(), xfrustum, solarSysTree, now);
+                        preRenderTimings.orbitLists += millisecondsSince(phaseStart);
                     }
                 }
             }
@@ -659,7 +678,9 @@ void Renderer::preRender(const Observer& observer, const Universe& universe, flo
         }
 
         if ((labelMode & (BodyLabelMask)) != 0) {
+            auto phaseStart = PhaseClock::now();
             buildLabelLists(xfrustum, now);
+            preRenderTimings.labelLists = millisecondsSince(phaseStart);
         }
     }
 
@@ -727,6 +748,13 @@ void Renderer::preRender(const Observer& observer, const Universe& universe, flo
         brightnessScale = 0.1667f;
 
     ambientColor = Color(ambientLightLevel, ambientLightLevel, ambientLightLevel);
+
+    PROFILE_COUNTER("Orbit cache hits", CachingOrbit::getCacheStatistics().hits.exchange(0));
+    PROFILE_COUNTER("Orbit cache misses", CachingOrbit::getCacheStatistics().misses.exchange(0));
+    PROFILE_COUNTER("Rotation cache hits", CachingRotationModel::getCacheStatistics().hits.exchange(0));
+    PROFILE_COUNTER("Rotation cache misses", CachingRotationModel::getCacheStatistics().misses.exchange(0));
+    PROFILE_COUNTER("Frame cache hits", CachingFrame::getCacheStatistics().hits.exchange(0));
+    PROFILE_COUNTER("Frame cache misses", CachingFrame::getCacheStatistics().misses.exchange(0));
 }
 
 // Helper function to compute the luminosity of a perfectly
@@ -757,7 +785,10 @@ static float cometDustTailLength(float distanceToSun, float radius) {
     return (1.0e8f / distanceToSun) * (radius / 5.0f) * 1.0e7f;
 }
 
-void Renderer::addRenderListEntries(RenderListEntry& rle, const BodyPtr& bodyPtr, bool isLabeled) {
+void Renderer::addRenderListEntries(RenderListEntry& rle,
+                                    const BodyPtr& bodyPtr,
+                                    bool isLabeled,
+                                    vector<RenderListEntry>& entries) const {
     const auto& body = *bodyPtr;
     bool visibleAsPoint = rle.appMag < faintestPlanetMag && body.isVisibleAsPoint();
 
@@ -766,7 +797,7 @@ void Renderer::addRenderListEntries(RenderListEntry& rle, const BodyPtr& bodyPtr
         rle.body = bodyPtr;
         rle.isOpaque = true;
         rle.radius = body.getRadius();
-        renderList.push_back(rle);
+        entries.push_back(rle);
     }
 
     if (body.getClassification() == Body::Comet && (renderFlags & ShowCometTails) != 0) {
@@ -778,7 +809,7 @@ void Renderer::addRenderListEntries(RenderListEntry& rle, const BodyPtr& bodyPtr
             rle.isOpaque = false;
             rle.radius = radius;
             rle.discSizeInPixels = discSize;
-            renderList.push_back(rle);
+            entries.push_back(rle);
         }
     }
 
@@ -787,7 +818,7 @@ void Renderer::addRenderListEntries(RenderListEntry& rle, const BodyPtr& bodyPtr
         rle.refMark = rm;
         rle.isOpaque = rm->isOpaque();
         rle.radius = rm->boundingSphereRadius();
-        renderList.push_back(rle);
+        entries.push_back(rle);
     }
 }
 
@@ -798,186 +829,241 @@ void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
                                 const FrameTreePtr& tree,
                                 const Observer& observer,
                                 double now) {
+    PROFILE_ZONE("Renderer::buildRenderLists");
 
-    int labelClassMask = translateLabelModeToClassMask(labelMode);
     Matrix3f viewMat = observer.getOrientationf().toRotationMatrix();
-    Vector3f viewMatZ = viewMat.row(2);
-
-    auto nChildren = tree ? tree->childCount() : 0;
-    for (unsigned int i = 0; i < nChildren; i++) {
-        auto phase = tree->getChild(i);
-
-        // No need to do anything if the phase isn't active now
-        if (!phase->includes(now))
-            continue;
+    RenderListTraversal traversal{ astrocentricObserverPos, viewFrustum, viewPlaneNormal, viewMat.row(2),
+                                   translateLabelModeToClassMask(labelMode), now };
+    addFrameTreeToRenderLists(traversal, frameCenter, tree, renderList, secondaryIlluminators);
+}
 
-        auto body = phase->body();
+// Frame trees with at least this many children, such as the Sun's when large
+// asteroid catalogs are loaded, are traversed in parallel in chunks of
+// RENDER_LIST_CHUNK_SIZE phases.
+static const size_t PARALLEL_RENDER_LIST_THRESHOLD = 1024;
+static const size_t RENDER_LIST_CHUNK_SIZE = 256;
+
+void Renderer::addFrameTreeToRenderLists(const RenderListTraversal& traversal,
+                                         const Vector3d& frameCenter,
+                                         const FrameTreePtr& tree,
+                                         vector<RenderListEntry>& entries,
+                                         vector<SecondaryIlluminator>& illuminators) const {
+    size_t nChildren = tree ? tree->childCount() : 0;
+    if (nChildren < PARALLEL_RENDER_LIST_THRESHOLD) {
+        for (size_t i = 0; i < nChildren; i++)
+            addPhaseToRenderLists(traversal, frameCenter, tree, i, entries, illuminators);
+        return;
+    }
 
-        // pos_s: sun-relative position of object
-        // pos_v: viewer-relative position of object
+    // Each chunk of consecutive phases, subtrees included, is added to its
+    // own lists, and the lists are joined in chunk order so that the result
+    // is the same as that of a serial traversal.
+    struct Chunk {
+        vector<RenderListEntry> entries;
+        vector<SecondaryIlluminator> illuminators;
+    };
+    vector<Chunk> chunks((nChildren + RENDER_LIST_CHUNK_SIZE - 1) / RENDER_LIST_CHUNK_SIZE);
+    ThreadPool::getDefault().parallelFor(chunks.size(), [&](size_t c) {
+        size_t end = min(nChildren, (c + 1) * RENDER_LIST_CHUNK_SIZE);
+        for (size_t i = c * RENDER_LIST_CHUNK_SIZE; i < end; i++)
+            addPhaseToRenderLists(traversal, frameCenter, tree, i, chunks[c].entries, chunks[c].illuminators);
+    });
+
+    for (const auto& chunk : chunks) {
+        entries.insert(entries.end(), chunk.entries.begin(), chunk.entries.end());
+        illuminators.insert(illuminators.end(), chunk.illuminators.begin(), chunk.illuminators.end());
+    }
+}
 
-        // Get the position of the body relative to the sun.
+// Add phase n of a frame tree to the render lists if it's active now, along
+// with its subtree unless that can be culled. Only reads the renderer, so
+// phases may be added from several threads at once.
+void Renderer::addPhaseToRenderLists(const RenderListTraversal& traversal,
+                                     const Vector3d& frameCenter,
+                                     const FrameTreePtr& tree,
+                                     size_t n,
+                                     vector<RenderListEntry>& entries,
+                                     vector<SecondaryIlluminator>& illuminators) const {
+    const double now = traversal.now;
+    const Vector3d& viewPlaneNormal = traversal.viewPlaneNormal;
+    const auto& phase = tree->getChild(n);
+
+    // No need to do anything if the phase isn't active now
+    if (!phase->includes(now))
+        return;
+
+    auto body = phase->body();
+
+    // pos_s: sun-relative position of object
+    // pos_v: viewer-relative position of object
+
+    // Get the position of the body relative to the sun, from the state
+    // table unless it hasn't been filled for now.
+    Vector3d pos_s;
+    float cullingRadius;
+    if (tree->hasChildState(n, now)) {
+        pos_s = tree->getChildPosition(n, now);
+        cullingRadius = tree->getChildCullingRadius(n, now);
+    } else {
         Vector3d p = phase->orbit()->positionAtTime(now);
-        const auto& frame = phase->orbitFrame();
-        Vector3d pos_s = frameCenter + frame->getOrientation(now).conjugate() * p;
-
-        // We now have the positions of the observer and the planet relative
-        // to the sun.  From these, compute the position of the body
-        // relative to the observer.
-        Vector3d pos_v = pos_s - astrocentricObserverPos;
-
-        // dist_vn: distance along view normal from the viewer to the
-        // projection of the object's center.
-        double dist_vn = viewPlaneNormal.dot(pos_v);
-
-        // Vector from object center to its projection on the view normal.
-        Vector3d toViewNormal = pos_v - dist_vn * viewPlaneNormal;
-
-        float cullingRadius = body->getCullingRadius();
+        pos_s = frameCenter + phase->orbitFrame()->getOrientation(now).conjugate() * p;
+        cullingRadius = body->getCullingRadius();
+    }
 
-        // The result of the planetshine test can be reused for the view cone
-        // test, but only when the object's light influence sphere is larger
-        // than the geometry. This is not
-        bool viewConeTestFailed = false;
-        if (body->isSecondaryIlluminator()) {
-            float influenceRadius = body->getBoundingRadius() + (body->getRadius() * PLANETSHINE_DISTANCE_LIMIT_FACTOR);
-            if (dist_vn > -influenceRadius) {
-                double maxPerpDist = (influenceRadius + dist_vn * sinViewAngle) * invCosViewAngle;
-                double perpDistSq = toViewNormal.squaredNorm();
-                if (perpDistSq < maxPerpDist * maxPerpDist) {
-                    if ((body->getRadius() / (float)pos_v.norm()) / pixelSize > PLANETSHINE_PIXEL_SIZE_LIMIT) {
-                        // add to planetshine list if larger than 1/10 pixel
-                        SecondaryIlluminator illum;
-                        illum.body = body;
-                        illum.position_v = pos_v;
-                        illum.radius = body->getRadius();
-                        secondaryIlluminators.push_back(illum);
-                    }
-                } else {
-                    viewConeTestFailed = influenceRadius > cullingRadius;
+    // We now have the positions of the observer and the planet relative
+    // to the sun.  From these, compute the position of the body
+    // relative to the observer.
+    Vector3d pos_v = pos_s - traversal.astrocentricObserverPos;
+
+    // dist_vn: distance along view normal from the viewer to the
+    // projection of the object's center.
+    double dist_vn = viewPlaneNormal.dot(pos_v);
+
+    // Vector from object center to its projection on the view normal.
+    Vector3d toViewNormal = pos_v - dist_vn * viewPlaneNormal;
+
+    // The result of the planetshine test can be reused for the view cone
+    // test, but only when the object's light influence sphere is larger
+    // than the geometry. This is not
+    bool viewConeTestFailed = false;
+    if (body->isSecondaryIlluminator()) {
+        float influenceRadius = body->getBoundingRadius() + (body->getRadius() * PLANETSHINE_DISTANCE_LIMIT_FACTOR);
+        if (dist_vn > -influenceRadius) {
+            double maxPerpDist = (influenceRadius + dist_vn * sinViewAngle) * invCosViewAngle;
+            double perpDistSq = toViewNormal.squaredNorm();
+            if (perpDistSq < maxPerpDist * maxPerpDist) {
+                if ((body->getRadius() / (float)pos_v.norm()) / pixelSize > PLANETSHINE_PIXEL_SIZE_LIMIT) {
+                    // add to planetshine list if larger than 1/10 pixel
+                    SecondaryIlluminator illum;
+                    illum.body = body;
+                    illum.position_v = pos_v;
+                    illum.radius = body->getRadius();
+                    illuminators.push_back(illum);
                 }
             } else {
                 viewConeTestFailed = influenceRadius > cullingRadius;
             }
+        } else {
+            viewConeTestFailed = influenceRadius > cullingRadius;
         }
+    }
 
-        bool insideViewCone = false;
-        if (!viewConeTestFailed) {
-            float radius = body->getCullingRadius();
-            if (dist_vn > -radius) {
-                double maxPerpDist = (radius + dist_vn * sinViewAngle) * invCosViewAngle;
-                double perpDistSq = toViewNormal.squaredNorm();
-                insideViewCone = perpDistSq < maxPerpDist * maxPerpDist;
-            }
+    bool insideViewCone = false;
+    if (!viewConeTestFailed) {
+        float radius = cullingRadius;
+        if (dist_vn > -radius) {
+            double maxPerpDist = (radius + dist_vn * sinViewAngle) * invCosViewAngle;
+            double perpDistSq = toViewNormal.squaredNorm();
+            insideViewCone = perpDistSq < maxPerpDist * maxPerpDist;
         }
+    }
 
-        if (insideViewCone) {
-            // Calculate the distance to the viewer
-            double dist_v = pos_v.norm();
+    if (insideViewCone) {
+        // Calculate the distance to the viewer
+        double dist_v = pos_v.norm();
 
-            // Calculate the size of the planet/moon disc in pixels
-            float discSize = (body->getCullingRadius() / (float)dist_v) / pixelSize;
+        // Calculate the size of the planet/moon disc in pixels
+        float discSize = (cullingRadius / (float)dist_v) / pixelSize;
 
-            // Compute the apparent magnitude; instead of summing the reflected
-            // light from all nearby stars, we just consider the one with the
-            // highest apparent brightness.
-            float appMag = 100.0f;
-            for (unsigned int li = 0; li < lightSourceList.size(); li++) {
-                Vector3d sunPos = pos_v - lightSourceList[li].position;
-                appMag = min(appMag, body->getApparentMagnitude(lightSourceList[li].luminosity, sunPos, pos_v));
-            }
+        // Compute the apparent magnitude; instead of summing the reflected
+        // light from all nearby stars, we just consider the one with the
+        // highest apparent brightness.
+        float appMag = 100.0f;
+        for (unsigned int li = 0; li < lightSourceList.size(); li++) {
+            Vector3d sunPos = pos_v - lightSourceList[li].position;
+            appMag = min(appMag, body->getApparentMagnitude(lightSourceList[li].luminosity, sunPos, pos_v));
+        }
 
-            bool visibleAsPoint = appMag < faintestPlanetMag && body->isVisibleAsPoint();
-            bool isLabeled = (body->getOrbitClassification() & labelClassMask) != 0;
-            bool visible = body->isVisible();
+        bool visibleAsPoint = appMag < faintestPlanetMag && body->isVisibleAsPoint();
+        bool isLabeled = (body->getOrbitClassification() & traversal.labelClassMask) != 0;
+        bool visible = body->isVisible();
 
-            if ((discSize > 1 || visibleAsPoint || isLabeled) && visible) {
-                RenderListEntry rle;
+        if ((discSize > 1 || visibleAsPoint || isLabeled) && visible) {
+            RenderListEntry rle;
 
-                rle.position = pos_v.cast<float>();
-                rle.distance = (float)dist_v;
-                rle.centerZ = pos_v.cast<float>().dot(viewMatZ);
-                rle.appMag = appMag;
-                rle.discSizeInPixels = body->getRadius() / ((float)dist_v * pixelSize);
+            rle.position = pos_v.cast<float>();
+            rle.distance = (float)dist_v;
+            rle.centerZ = pos_v.cast<float>().dot(traversal.viewMatZ);
+            rle.appMag = appMag;
+            rle.discSizeInPixels = body->getRadius() / ((float)dist_v * pixelSize);
 
-                // TODO: Remove this. It's only used in two places: for calculating comet tail
-                // length, and for calculating sky brightness to adjust the limiting magnitude.
-                // In both cases, it's the wrong quantity to use (e.g. for objects with orbits
-                // defined relative to the SSB.)
-                rle.sun = -pos_s.cast<float>();
+            // TODO: Remove this. It's only used in two places: for calculating comet tail
+            // length, and for calculating sky brightness to adjust the limiting magnitude.
+            // In both cases, it's the wrong quantity to use (e.g. for objects with orbits
+            // defined relative to the SSB.)
+            rle.sun = -pos_s.cast<float>();
 
-                addRenderListEntries(rle, body, isLabeled);
-            }
+            addRenderListEntries(rle, body, isLabeled, entries);
         }
+    }
 
-        const auto& subtree = body->getFrameTree();
-        if (subtree) {
-            double dist_v = pos_v.norm();
-            bool traverseSubtree = false;
-
-            // There are two different tests available to determine whether we can reject
-            // the object's subtree. If the subtree contains no light reflecting objects,
-            // then render the subtree only when:
-            //    - the subtree bounding sphere intersects the view frustum, and
-            //    - the subtree contains an object bright or large enough to be visible.
-            // Otherwise, render the subtree when any of the above conditions are
-            // true or when a subtree object could potentially illuminate something
-            // in the view cone.
-            float minPossibleDistance = (float)(dist_v - subtree->boundingSphereRadius());
-            float brightestPossible = 0.0;
-            float largestPossible = 0.0;
-
-            // If the viewer is not within the subtree bounding sphere, see if we can cull it because
-            // it contains no objects brighter than the limiting magnitude and no objects that will
-            // be larger than one pixel in size.
-            if (minPossibleDistance > 1.0f) {
-                // Figure out the magnitude of the brightest possible object in the subtree.
-
-                // Compute the luminosity from reflected light of the largest object in the subtree
-                float lum = 0.0f;
-                for (unsigned int li = 0; li < lightSourceList.size(); li++) {
-                    Vector3d sunPos = pos_v - lightSourceList[li].position;
-                    lum += luminosityAtOpposition(lightSourceList[li].luminosity, (float)sunPos.norm(),
-                                                  (float)subtree->maxChildRadius());
-                }
-                brightestPossible = astro::lumToAppMag(lum, astro::kilometersToLightYears(minPossibleDistance));
-                largestPossible = (float)subtree->maxChildRadius() / (float)minPossibleDistance / pixelSize;
-            } else {
-                // Viewer is within the bounding sphere, so the object could be very close.
-                // Assume that an object in the subree could be very bright or large,
-                // so no culling will occur.
-                brightestPossible = -100.0f;
-                largestPossible = 100.0f;
+    const auto& subtree = body->getFrameTree();
+    if (subtree) {
+        double dist_v = pos_v.norm();
+        bool traverseSubtree = false;
+
+        // There are two different tests available to determine whether we can reject
+        // the object's subtree. If the subtree contains no light reflecting objects,
+        // then render the subtree only when:
+        //    - the subtree bounding sphere intersects the view frustum, and
+        //    - the subtree contains an object bright or large enough to be visible.
+        // Otherwise, render the subtree when any of the above conditions are
+        // true or when a subtree object could potentially illuminate something
+        // in the view cone.
+        float minPossibleDistance = (float)(dist_v - subtree->boundingSphereRadius());
+        float brightestPossible = 0.0;
+        float largestPossible = 0.0;
+
+        // If the viewer is not within the subtree bounding sphere, see if we can cull it because
+        // it contains no objects brighter than the limiting magnitude and no objects that will
+        // be larger than one pixel in size.
+        if (minPossibleDistance > 1.0f) {
+            // Figure out the magnitude of the brightest possible object in the subtree.
+
+            // Compute the luminosity from reflected light of the largest object in the subtree
+            float lum = 0.0f;
+            for (unsigned int li = 0; li < lightSourceList.size(); li++) {
+                Vector3d sunPos = pos_v - lightSourceList[li].position;
+                lum += luminosityAtOpposition(lightSourceList[li].luminosity, (float)sunPos.norm(),
+                                              (float)subtree->maxChildRadius());
             }
+            brightestPossible = astro::lumToAppMag(lum, astro::kilometersToLightYears(minPossibleDistance));
+            largestPossible = (float)subtree->maxChildRadius() / (float)minPossibleDistance / pixelSize;
+        } else {
+            // Viewer is within the bounding sphere, so the object could be very close.
+            // Assume that an object in the subree could be very bright or large,
+            // so no culling will occur.
+            brightestPossible = -100.0f;
+            largestPossible = 100.0f;
+        }
 
-            if (brightestPossible < faintestPlanetMag || largestPossible > 1.0f) {
-                // See if the object or any of its children are within the view frustum
-                if (viewFrustum.testSphere(pos_v.cast<float>(), (float)subtree->boundingSphereRadius()) != Frustum::Outside) {
-                    traverseSubtree = true;
-                }
+        if (brightestPossible < faintestPlanetMag || largestPossible > 1.0f) {
+            // See if the object or any of its children are within the view frustum
+            if (traversal.viewFrustum.testSphere(pos_v.cast<float>(), (float)subtree->boundingSphereRadius()) != Frustum::Outside) {
+                traverseSubtree = true;
             }
+        }
 
-            // If the subtree contains secondary illuminators, do one last check if it hasn't
-            // already been determined if we need to traverse the subtree: see if something
-            // in the subtree could possibly contribute significant illumination to an
-            // object in the view cone.
-            if (subtree->containsSecondaryIlluminators() && !traverseSubtree &&
-                largestPossible > PLANETSHINE_PIXEL_SIZE_LIMIT) {
-                float influenceRadius =
-                    (float)(subtree->boundingSphereRadius() + (subtree->maxChildRadius() * PLANETSHINE_DISTANCE_LIMIT_FACTOR));
-                if (dist_vn > -influenceRadius) {
-                    double maxPerpDist = (influenceRadius + dist_vn * sinViewAngle) * invCosViewAngle;
-                    double perpDistSq = toViewNormal.squaredNorm();
-                    if (perpDistSq < maxPerpDist * maxPerpDist)
-                        traverseSubtree = true;
-                }
+        // If the subtree contains secondary illuminators, do one last check if it hasn't
+        // already been determined if we need to traverse the subtree: see if something
+        // in the subtree could possibly contribute significant illumination to an
+        // object in the view cone.
+        if (subtree->containsSecondaryIlluminators() && !traverseSubtree &&
+            largestPossible > PLANETSHINE_PIXEL_SIZE_LIMIT) {
+            float influenceRadius =
+                (float)(subtree->boundingSphereRadius() + (subtree->maxChildRadius() * PLANETSHINE_DISTANCE_LIMIT_FACTOR));
+            if (dist_vn > -influenceRadius) {
+                double maxPerpDist = (influenceRadius + dist_vn * sinViewAngle) * invCosViewAngle;
+                double perpDistSq = toViewNormal.squaredNorm();
+                if (perpDistSq < maxPerpDist * maxPerpDist)
+                    traverseSubtree = true;
             }
+        }
 
-            if (traverseSubtree) {
-                buildRenderLists(astrocentricObserverPos, viewFrustum, viewPlaneNormal, pos_s, subtree, observer, now);
-            }
-        }  // end subtree traverse
-    }
+        if (traverseSubtree) {
+            addFrameTreeToRenderLists(traversal, pos_s, subtree, entries, illuminators);
+        }
+    }  // end subtree traverse
 }
 
 void Renderer::buildOrbitLists(const Vector3d& astrocentricObserverPos,
@@ -985,6 +1071,7 @@ void Renderer::buildOrbitLists(const Vector3d& astrocentricObserverPos,
                                const Frustum& viewFrustum,
                                const FrameTreePtr& tree,
                                double now) {
+    PROFILE_ZONE("Renderer::buildOrbitLists");
     Matrix3d viewMat = observerOrientation.toRotationMatrix();
     Vector3d viewMatZ = viewMat.row(2);
 
@@ -1002,7 +1089,7 @@ void Renderer::buildOrbitLists(const Vector3d& astrocentricObserverPos,
         // pos_v: viewer-relative position of object
 
         // Get the position of the body relative to the sun.
-        Vector3d pos_s = body->getAstrocentricPosition(now);
+        Vector3d pos_s = tree->getChildPosition(i, now);
 
         // We now have the positions of the observer and the planet relative
         // to the sun.  From these, compute the position of the body
@@ -1071,6 +1158,7 @@ void Renderer::buildOrbitLists(const Vector3d& astrocentricObserverPos,
 }
 
 void Renderer::buildLabelLists(const Frustum& viewFrustum, double now) {
+    PROFILE_ZONE("Renderer::buildLabelLists");
     int labelClassMask = translateLabelModeToClassMask(labelMode);
     BodyConstPtr lastPrimary;
     Sphered primarySphere;
@@ -1152,8 +1240,7 @@ void Renderer::buildLabelLists(const Frustum& viewFrustum, double now) {
                         // calling getPosition() by caching the last primary
                         // position.
                         if (primary != lastPrimary) {
-                            Vector3d p =
-                                phase->orbitFrame()->getOrientation(now).conjugate() * phase->orbit()->positionAtTime(now);
+                            Vector3d p = body->getAstrocentricPosition(now) - primary->getAstrocentricPosition(now);
                             Vector3d v = iter->position.cast<double>() - p;
 
                             primarySphere = Sphered(v, primary->getRadius());
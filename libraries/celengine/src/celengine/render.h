@@ -88,6 +88,15 @@ public:
 
     void preRender(const Observer&, const Universe&, float faintestVisible, const Selection& sel);
 
+    // Wall clock time in milliseconds spent in the phases of the last
+    // preRender() call, summed over all nearby solar systems.
+    struct PreRenderTimings {
+        double renderLists{ 0.0 };
+        double orbitLists{ 0.0 };
+        double labelLists{ 0.0 };
+    };
+    const PreRenderTimings& getPreRenderTimings() const { return preRenderTimings; }
+
     virtual void render(const ObserverPtr&, const UniversePtr&, float faintestVisible, const Selection& sel) = 0;
     enum
     {
@@ -341,6 +350,26 @@ private:
                           const FrameTreePtr& tree,
                           const Observer& observer,
                           double now);
+    // The inputs shared by every step of one buildRenderLists traversal
+    struct RenderListTraversal {
+        const Eigen::Vector3d& astrocentricObserverPos;
+        const Frustum& viewFrustum;
+        const Eigen::Vector3d& viewPlaneNormal;
+        Eigen::Vector3f viewMatZ;
+        int labelClassMask;
+        double now;
+    };
+    void addFrameTreeToRenderLists(const RenderListTraversal& traversal,
+                                   const Eigen::Vector3d& frameCenter,
+                                   const FrameTreePtr& tree,
+                                   std::vector<RenderListEntry>& entries,
+                                   std::vector<SecondaryIlluminator>& illuminators) const;
+    void addPhaseToRenderLists(const RenderListTraversal& traversal,
+                               const Eigen::Vector3d& frameCenter,
+                               const FrameTreePtr& tree,
+                               size_t n,
+                               std::vector<RenderListEntry>& entries,
+                               std::vector<SecondaryIlluminator>& illuminators) const;
     void buildOrbitLists(const Eigen::Vector3d& astrocentricObserverPos,
                          const Eigen::Quaterniond& observerOrientation,
                          const Frustum& viewFrustum,
@@ -348,7 +377,10 @@ private:
                          double now);
     void buildLabelLists(const Frustum& viewFrustum, double now);
 
-    void addRenderListEntries(RenderListEntry& rle, const BodyPtr& body, bool isLabeled);
+    void addRenderListEntries(RenderListEntry& rle,
+                              const BodyPtr& body,
+                              bool isLabeled,
+                              std::vector<RenderListEntry>& entries) const;
 
     void addStarOrbitToRenderList(const StarConstPtr& star, const Observer& observer, double now);
 
@@ -409,6 +441,7 @@ private:
     Selection highlightObject;
     bool settingsChanged;
     double realTime;
+    PreRenderTimings preRenderTimings;
 
     double cosViewConeAngle;
     double invCosViewAngle;
@@ -11,6 +11,7 @@
 // of the License, or (at your option) any later version.
 
 #include "simulation.h"
+#include <celutil/profiler.h>
 #include <algorithm>
 //#include "render.h"
 
@@ -46,6 +47,7 @@ void Simulation::setTime(double jd) {
 
 // Tick the simulation by dt seconds
 void Simulation::update(double dt) {
+    PROFILE_ZONE("Simulation::update");
     realTime += dt;
 
     for (const auto& observer : observers) {
@@ -20,6 +20,7 @@
 #include <celmath/mathlib.h>
 #include <celutil/util.h>
 #include <celastro/astro.h>
+#include <celutil/profiler.h>
 #include <memory>
 #include "parser.h"
 #include "texmanager.h"
@@ -82,12 +83,12 @@ enum BodyType
   The name and parent name are both mandatory.
 */
 
-static void errorMessagePrelude(const Tokenizer& tok) {
-    cerr << _("Error in .ssc file (line ") << tok.getLineNumber() << "): ";
+static void errorMessagePrelude(int lineNumber) {
+    cerr << _("Error in .ssc file (line ") << lineNumber << "): ";
 }
 
-static void sscError(const Tokenizer& tok, const string& msg) {
-    errorMessagePrelude(tok);
+static void sscError(int lineNumber, const string& msg) {
+    errorMessagePrelude(lineNumber);
     cerr << msg << '\n';
 }
 
@@ -910,55 +911,63 @@ static BodyPtr CreateReferencePoint(const string& name,
 }
 
 bool LoadSolarSystemObjects(istream& in, Universe& universe, const std::string& directory) {
-    Tokenizer tokenizer(&in);
-    Parser parser(&tokenizer);
+    CatalogRecordList records;
+    bool parsed = ReadCatalogRecords(in, records);
+    return LoadSolarSystemObjects(records, universe, directory) && parsed;
+}
+
+bool LoadSolarSystemObjects(const CatalogRecordList& records, Universe& universe, const std::string& directory) {
+    PROFILE_ZONE("LoadSolarSystemObjects");
+    for (const auto& record : records) {
+        CatalogHeaderReader header(record);
 
-    while (tokenizer.nextToken() != Tokenizer::TokenEnd) {
         // Read the disposition; if none is specified, the default is Add.
         Disposition disposition = AddObject;
-        if (tokenizer.getTokenType() == Tokenizer::TokenName) {
-            if (tokenizer.getNameValue() == "Add") {
+        if (header.getTokenType() == Tokenizer::TokenName) {
+            if (header.getNameValue() == "Add") {
                 disposition = AddObject;
-                tokenizer.nextToken();
-            } else if (tokenizer.getNameValue() == "Replace") {
+                header.next();
+            } else if (header.getNameValue() == "Replace") {
                 disposition = ReplaceObject;
-                tokenizer.nextToken();
-            } else if (tokenizer.getNameValue() == "Modify") {
+                header.next();
+            } else if (header.getNameValue() == "Modify") {
                 disposition = ModifyObject;
-                tokenizer.nextToken();
+                header.next();
             }
         }
 
         // Read the item type; if none is specified the default is Body
         string itemType("Body");
-        if (tokenizer.getTokenType() == Tokenizer::TokenName) {
-            itemType = tokenizer.getNameValue();
-            tokenizer.nextToken();
+        if (header.getTokenType() == Tokenizer::TokenName) {
+            itemType = header.getNameValue();
+            header.next();
         }
 
-        if (tokenizer.getTokenType() != Tokenizer::TokenString) {
-            sscError(tokenizer, "object name expected");
+        if (header.getTokenType() != Tokenizer::TokenString) {
+            sscError(record.lineNumber, "object name expected");
             return false;
         }
 
         // The name list is a string with zero more names. Multiple names are
         // delimited by colons.
-        string nameList = tokenizer.getStringValue().c_str();
+        string nameList = header.getStringValue();
+        header.next();
 
-        if (tokenizer.nextToken() != Tokenizer::TokenString) {
-            sscError(tokenizer, "bad parent object name");
+        if (header.getTokenType() != Tokenizer::TokenString) {
+            sscError(record.lineNumber, "bad parent object name");
             return false;
         }
-        string parentName = tokenizer.getStringValue().c_str();
+        string parentName = header.getStringValue();
+        header.next();
 
-        auto objectDataValue = parser.readValue();
-        if (objectDataValue == NULL) {
-            sscError(tokenizer, "bad object definition");
+        const auto& objectDataValue = record.value;
+        if (!header.atEnd()) {
+            sscError(record.lineNumber, "bad object definition");
             return false;
         }
 
         if (objectDataValue->getType() != Value::HashType) {
-            sscError(tokenizer, "{ expected");
+            sscError(record.lineNumber, "{ expected");
             return false;
         }
         const auto& objectData = objectDataValue->getHash();
@@ -1015,7 +1024,7 @@ bool LoadSolarSystemObjects(istream& in, Universe& universe, const std::string&
                 }
                 //orbitsPlanet = true;
             } else {
-                errorMessagePrelude(tokenizer);
+                errorMessagePrelude(record.lineNumber);
                 cerr << _("parent body '") << parentName << _("' of '") << primaryName << _("' not found.") << endl;
             }
 
@@ -1023,7 +1032,7 @@ bool LoadSolarSystemObjects(istream& in, Universe& universe, const std::string&
                 auto existingBody = parentSystem->find(primaryName);
                 if (existingBody) {
                     if (disposition == AddObject) {
-                        errorMessagePrelude(tokenizer);
+                        errorMessagePrelude(record.lineNumber);
                         cerr << _("warning duplicate definition of ") << parentName << " " << primaryName << '\n';
                     } else if (disposition == ReplaceObject) {
                         existingBody->setDefaultProperties();
@@ -1055,7 +1064,7 @@ bool LoadSolarSystemObjects(istream& in, Universe& universe, const std::string&
             if (surface != NULL && parent.body() != NULL)
                 parent.body()->addAlternateSurface(primaryName, surface);
             else
-                sscError(tokenizer, _("bad alternate surface"));
+                sscError(record.lineNumber, _("bad alternate surface"));
         } else if (itemType == "Location") {
             if (parent.body() != NULL) {
                 auto location = CreateLocation(objectData, parent.body());
@@ -1063,10 +1072,10 @@ bool LoadSolarSystemObjects(istream& in, Universe& universe, const std::string&
                     location->setName(primaryName);
                     parent.body()->addLocation(location);
                 } else {
-                    sscError(tokenizer, _("bad location"));
+                    sscError(record.lineNumber, _("bad location"));
                 }
             } else {
-                errorMessagePrelude(tokenizer);
+                errorMessagePrelude(record.lineNumber);
                 cerr << _("parent body '") << parentName << _("' of '") << primaryName << _("' not found.\n");
             }
         }
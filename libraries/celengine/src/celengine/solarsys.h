@@ -16,6 +16,7 @@
 #include <Eigen/Core>
 
 #include "forward.h"
+#include "catalogrecord.h"
 
 class FrameTree;
 
@@ -41,5 +42,6 @@ using SolarSystemCatalogPtr = std::shared_ptr<SolarSystemCatalog>;
 class Universe;
 
 bool LoadSolarSystemObjects(std::istream& in, Universe& universe, const std::string& dir = "");
+bool LoadSolarSystemObjects(const CatalogRecordList& records, Universe& universe, const std::string& dir = "");
 
 #endif  // _SOLARSYS_H_
@@ -0,0 +1,272 @@
+// starcull.cpp
+//
+// Copyright (C) 2001-2009, the Celestia Development Team
+//
+// Batch visibility culling of star octree nodes.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "starcull.h"
+
+#include <atomic>
+#include <cmath>
+
+#include <celastro/astro.h>
+
+#include <celutil/cpufeatures.h>
+
+#include "staroctree.h"
+
+#ifdef CELESTIA_X86_64
+#include <immintrin.h>
+#endif
+
+// The vector kernels keep every star whose approximate apparent magnitude is
+// within this margin of the limit.  The approximation below is good to about
+// 1e-5 magnitudes, so the margin only needs to cover float rounding.
+static const float APPMAG_MARGIN = 0.01f;
+
+// appMag = absMag - 5 + 5 * log10(d / pc)
+//        = absMag + APPMAG_OFFSET + 2.5 * log10(d^2)
+static const float APPMAG_OFFSET = (float)(-5.0 - 5.0 * std::log10(LY_PER_PARSEC));
+
+// Exact test, identical to the one in StarOctree::processVisibleNode
+static inline bool cullStar(const StarStore& stars,
+                            uint32_t i,
+                            const Eigen::Vector3f& obsPosition,
+                            float dimmest,
+                            float limitingMag,
+                            VisibleStar& out) {
+    float absMag = stars.getAbsoluteMagnitudes()[i];
+    if (absMag >= dimmest)
+        return false;
+
+    float dx = obsPosition.x() - stars.getPositionX()[i];
+    float dy = obsPosition.y() - stars.getPositionY()[i];
+    float dz = obsPosition.z() - stars.getPositionZ()[i];
+    float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+    float appMag = astro::absToAppMag(absMag, distance);
+
+    if (appMag < limitingMag || (distance < MAX_STAR_ORBIT_RADIUS && (stars.getFlags()[i] & StarStore::HasOrbit) != 0)) {
+        out.index = i;
+        out.distance = distance;
+        out.appMag = appMag;
+        return true;
+    }
+
+    return false;
+}
+
+static uint32_t cullScalar(const StarStore& stars,
+                           uint32_t first,
+                           uint32_t last,
+                           const Eigen::Vector3f& obsPosition,
+                           float dimmest,
+                           float limitingMag,
+                           VisibleStar* outStars) {
+    uint32_t nVisible = 0;
+    for (uint32_t i = first; i < last; ++i) {
+        if (cullStar(stars, i, obsPosition, dimmest, limitingMag, outStars[nVisible]))
+            ++nVisible;
+    }
+    return nVisible;
+}
+
+#ifdef CELESTIA_X86_64
+
+// log10(x) for x >= 0, using the float exponent and the series
+// ln(m) = 2 * (s + s^3/3 + s^5/5 + s^7/7 + s^9/9), s = (m - 1) / (m + 1)
+// for the mantissa m in [1, 2).
+static inline __m128 log10_sse2(__m128 x) {
+    const __m128i bits = _mm_castps_si128(x);
+    const __m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_castps_si128(one)));
+    const __m128 s = _mm_div_ps(_mm_sub_ps(m, one), _mm_add_ps(m, one));
+    const __m128 s2 = _mm_mul_ps(s, s);
+    __m128 p = _mm_set1_ps(1.0f / 9.0f);
+    p = _mm_add_ps(_mm_mul_ps(p, s2), _mm_set1_ps(1.0f / 7.0f));
+    p = _mm_add_ps(_mm_mul_ps(p, s2), _mm_set1_ps(1.0f / 5.0f));
+    p = _mm_add_ps(_mm_mul_ps(p, s2), _mm_set1_ps(1.0f / 3.0f));
+    p = _mm_add_ps(_mm_mul_ps(p, s2), one);
+    const __m128 lnm = _mm_mul_ps(_mm_mul_ps(p, s), _mm_set1_ps(2.0f));
+    const __m128 ln = _mm_add_ps(_mm_mul_ps(e, _mm_set1_ps(0.693147180559945f)), lnm);
+    return _mm_mul_ps(ln, _mm_set1_ps(0.434294481903252f));
+}
+
+static uint32_t cullSSE2(const StarStore& stars,
+                         uint32_t first,
+                         uint32_t last,
+                         const Eigen::Vector3f& obsPosition,
+                         float dimmest,
+                         float limitingMag,
+                         VisibleStar* outStars) {
+    const float* posX = stars.getPositionX();
+    const float* posY = stars.getPositionY();
+    const float* posZ = stars.getPositionZ();
+    const float* absMags = stars.getAbsoluteMagnitudes();
+
+    const __m128 ox = _mm_set1_ps(obsPosition.x());
+    const __m128 oy = _mm_set1_ps(obsPosition.y());
+    const __m128 oz = _mm_set1_ps(obsPosition.z());
+    const __m128 dimmestV = _mm_set1_ps(dimmest);
+    const __m128 limitV = _mm_set1_ps(limitingMag + APPMAG_MARGIN);
+    const __m128 offsetV = _mm_set1_ps(APPMAG_OFFSET);
+    const __m128 twoPointFive = _mm_set1_ps(2.5f);
+    const __m128 orbitRadius2 = _mm_set1_ps(MAX_STAR_ORBIT_RADIUS * MAX_STAR_ORBIT_RADIUS * (1.0f + APPMAG_MARGIN));
+
+    uint32_t nVisible = 0;
+    uint32_t i = first;
+    for (; i + 4 <= last; i += 4) {
+        const __m128 absMag = _mm_loadu_ps(absMags + i);
+        const __m128 dx = _mm_sub_ps(ox, _mm_loadu_ps(posX + i));
+        const __m128 dy = _mm_sub_ps(oy, _mm_loadu_ps(posY + i));
+        const __m128 dz = _mm_sub_ps(oz, _mm_loadu_ps(posZ + i));
+        const __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        const __m128 appMag = _mm_add_ps(_mm_add_ps(absMag, offsetV), _mm_mul_ps(twoPointFive, log10_sse2(d2)));
+
+        const __m128 candidate = _mm_and_ps(_mm_cmplt_ps(absMag, dimmestV),
+                                            _mm_or_ps(_mm_cmplt_ps(appMag, limitV), _mm_cmplt_ps(d2, orbitRadius2)));
+        int mask = _mm_movemask_ps(candidate);
+        while (mask != 0) {
+            int lane = 0;
+            while ((mask & (1 << lane)) == 0)
+                ++lane;
+            mask &= ~(1 << lane);
+            if (cullStar(stars, i + lane, obsPosition, dimmest, limitingMag, outStars[nVisible]))
+                ++nVisible;
+        }
+    }
+
+    return nVisible + cullScalar(stars, i, last, obsPosition, dimmest, limitingMag, outStars + nVisible);
+}
+
+CELESTIA_TARGET_AVX2
+static inline __m256 log10_avx2(__m256 x) {
+    const __m256i bits = _mm256_castps_si256(x);
+    const __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 m =
+        _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_castps_si256(one)));
+    const __m256 s = _mm256_div_ps(_mm256_sub_ps(m, one), _mm256_add_ps(m, one));
+    const __m256 s2 = _mm256_mul_ps(s, s);
+    __m256 p = _mm256_set1_ps(1.0f / 9.0f);
+    p = _mm256_add_ps(_mm256_mul_ps(p, s2), _mm256_set1_ps(1.0f / 7.0f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, s2), _mm256_set1_ps(1.0f / 5.0f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, s2), _mm256_set1_ps(1.0f / 3.0f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, s2), one);
+    const __m256 lnm = _mm256_mul_ps(_mm256_mul_ps(p, s), _mm256_set1_ps(2.0f));
+    const __m256 ln = _mm256_add_ps(_mm256_mul_ps(e, _mm256_set1_ps(0.693147180559945f)), lnm);
+    return _mm256_mul_ps(ln, _mm256_set1_ps(0.434294481903252f));
+}
+
+CELESTIA_TARGET_AVX2
+static uint32_t cullAVX2(const StarStore& stars,
+                         uint32_t first,
+                         uint32_t last,
+                         const Eigen::Vector3f& obsPosition,
+                         float dimmest,
+                         float limitingMag,
+                         VisibleStar* outStars) {
+    const float* posX = stars.getPositionX();
+    const float* posY = stars.getPositionY();
+    const float* posZ = stars.getPositionZ();
+    const float* absMags = stars.getAbsoluteMagnitudes();
+
+    const __m256 ox = _mm256_set1_ps(obsPosition.x());
+    const __m256 oy = _mm256_set1_ps(obsPosition.y());
+    const __m256 oz = _mm256_set1_ps(obsPosition.z());
+    const __m256 dimmestV = _mm256_set1_ps(dimmest);
+    const __m256 limitV = _mm256_set1_ps(limitingMag + APPMAG_MARGIN);
+    const __m256 offsetV = _mm256_set1_ps(APPMAG_OFFSET);
+    const __m256 twoPointFive = _mm256_set1_ps(2.5f);
+    const __m256 orbitRadius2 = _mm256_set1_ps(MAX_STAR_ORBIT_RADIUS * MAX_STAR_ORBIT_RADIUS * (1.0f + APPMAG_MARGIN));
+
+    uint32_t nVisible = 0;
+    uint32_t i = first;
+    for (; i + 8 <= last; i += 8) {
+        const __m256 absMag = _mm256_loadu_ps(absMags + i);
+        const __m256 dx = _mm256_sub_ps(ox, _mm256_loadu_ps(posX + i));
+        const __m256 dy = _mm256_sub_ps(oy, _mm256_loadu_ps(posY + i));
+        const __m256 dz = _mm256_sub_ps(oz, _mm256_loadu_ps(posZ + i));
+        const __m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+        const __m256 appMag = _mm256_add_ps(_mm256_add_ps(absMag, offsetV), _mm256_mul_ps(twoPointFive, log10_avx2(d2)));
+
+        const __m256 candidate =
+            _mm256_and_ps(_mm256_cmp_ps(absMag, dimmestV, _CMP_LT_OQ),
+                          _mm256_or_ps(_mm256_cmp_ps(appMag, limitV, _CMP_LT_OQ), _mm256_cmp_ps(d2, orbitRadius2, _CMP_LT_OQ)));
+        int mask = _mm256_movemask_ps(candidate);
+        while (mask != 0) {
+            int lane = 0;
+            while ((mask & (1 << lane)) == 0)
+                ++lane;
+            mask &= ~(1 << lane);
+            if (cullStar(stars, i + lane, obsPosition, dimmest, limitingMag, outStars[nVisible]))
+                ++nVisible;
+        }
+    }
+
+    return nVisible + cullSSE2(stars, i, last, obsPosition, dimmest, limitingMag, outStars + nVisible);
+}
+
+#endif  // CELESTIA_X86_64
+
+static StarCullKernel bestKernel() {
+#ifdef CELESTIA_X86_64
+    static const StarCullKernel best = CPUSupportsAVX2() ? StarCullKernel::AVX2 : StarCullKernel::SSE2;
+    return best;
+#else
+    return StarCullKernel::Scalar;
+#endif
+}
+
+// The kernel may be changed while pool threads are reading it
+static std::atomic<StarCullKernel>& currentKernel() {
+    static std::atomic<StarCullKernel> kernel{ bestKernel() };
+    return kernel;
+}
+
+StarCullKernel GetStarCullKernel() {
+    return currentKernel().load(std::memory_order_relaxed);
+}
+
+void SetStarCullKernel(StarCullKernel kernel) {
+    // SSE2 is part of the x86-64 baseline, so only AVX2 needs checking
+    if ((int)kernel > (int)bestKernel())
+        kernel = bestKernel();
+    currentKernel().store(kernel, std::memory_order_relaxed);
+}
+
+const char* GetStarCullKernelName(StarCullKernel kernel) {
+    switch (kernel) {
+        case StarCullKernel::SSE2:
+            return "SSE2";
+        case StarCullKernel::AVX2:
+            return "AVX2";
+        default:
+            return "scalar";
+    }
+}
+
+uint32_t CullStarRange(const StarStore& stars,
+                       uint32_t first,
+                       uint32_t count,
+                       const Eigen::Vector3f& obsPosition,
+                       float dimmest,
+                       float limitingMag,
+                       VisibleStar* outStars) {
+    uint32_t last = first + count;
+    switch (currentKernel().load(std::memory_order_relaxed)) {
+#ifdef CELESTIA_X86_64
+        case StarCullKernel::AVX2:
+            return cullAVX2(stars, first, last, obsPosition, dimmest, limitingMag, outStars);
+        case StarCullKernel::SSE2:
+            return cullSSE2(stars, first, last, obsPosition, dimmest, limitingMag, outStars);
+#endif
+        default:
+            return cullScalar(stars, first, last, obsPosition, dimmest, limitingMag, outStars);
+    }
+}
@@ -0,0 +1,59 @@
+// starcull.h
+//
+// Copyright (C) 2001-2009, the Celestia Development Team
+//
+// Batch visibility culling of star octree nodes.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef _CELENGINE_STARCULL_H_
+#define _CELENGINE_STARCULL_H_
+
+#include <cstdint>
+
+#include <Eigen/Core>
+
+#include "starstore.h"
+
+struct VisibleStar {
+    uint32_t index;
+    float distance;
+    float appMag;
+};
+
+enum class StarCullKernel
+{
+    Scalar,
+    SSE2,
+    AVX2,
+};
+
+/*! Apply the per-star visibility test of the star octree to the stars
+ *  [first, first + count) of a StarStore: a star is kept if its absolute
+ *  magnitude is below dimmest and either its apparent magnitude is below
+ *  limitingMag, or it has an orbit and lies within MAX_STAR_ORBIT_RADIUS.
+ *  Survivors are written to outStars, which must have room for count
+ *  entries, in index order; the number of survivors is returned.
+ *
+ *  The vector kernels only use an approximate apparent magnitude to discard
+ *  stars that are clearly too faint.  Every remaining star is re-tested with
+ *  the scalar code, so all kernels produce bit-for-bit identical output.
+ */
+uint32_t CullStarRange(const StarStore& stars,
+                       uint32_t first,
+                       uint32_t count,
+                       const Eigen::Vector3f& obsPosition,
+                       float dimmest,
+                       float limitingMag,
+                       VisibleStar* outStars);
+
+// The kernel is chosen from the CPU features on first use; setting an
+// unsupported kernel falls back to the best supported one.
+StarCullKernel GetStarCullKernel();
+void SetStarCullKernel(StarCullKernel);
+const char* GetStarCullKernelName(StarCullKernel);
+
+#endif  // _CELENGINE_STARCULL_H_
@@ -11,18 +11,23 @@
 #include "stardb.h"
 
 #include <cstring>
+#include <fstream>
 #include <cmath>
 #include <cstdlib>
 #include <cstdio>
 #include <cassert>
 #include <algorithm>
+#include <limits>
+#include <unordered_map>
 
 #include <celmath/mathlib.h>
 #include <celmath/plane.h>
 #include <celutil/util.h>
 #include <celutil/bytes.h>
 #include <celutil/debug.h>
+#include <celutil/threadpool.h>
 #include <celastro/astro.h>
+#include <celutil/profiler.h>
 
 #include "celestia.h"
 #include "parser.h"
@@ -51,6 +56,9 @@ static const float STAR_OCTREE_ROOT_SIZE = 10000000.0f;
 static const float STAR_OCTREE_MAGNITUDE = 6.0f;
 static const float STAR_EXTRA_ROOM = 0.01f;  // Reserve 1% capacity for extra stars
 
+// Approximate number of stars culled by one task of findVisibleStars
+static const uint32_t STAR_CULL_BATCH_SIZE = 16384;
+
 const char* StarDatabase::FILE_HEADER = "CELSTARS";
 const char* StarDatabase::CROSSINDEX_FILE_HEADER = "CELINDEX";
 
@@ -135,13 +143,9 @@ StarDatabase::~StarDatabase() {
 }
 
 StarPtr StarDatabase::find(uint32_t catalogNumber) const {
-    auto refStar = std::make_shared<Star>();
-    refStar->setCatalogNumber(catalogNumber);
-
-    auto iter = lower_bound(catalogNumberIndex.begin(), catalogNumberIndex.end(), refStar, PtrCatalogNumberOrderingPredicate);
-
-    if (iter != catalogNumberIndex.end() && (*iter)->getCatalogNumber() == catalogNumber)
-        return *iter;
+    uint32_t index = catalogNumberIndex.find(catalogNumber);
+    if (index != CatalogIndex::InvalidValue)
+        return stars[index];
     else
         return NULL;
 }
@@ -185,18 +189,7 @@ uint32_t StarDatabase::crossIndex(const Catalog catalog, const uint32_t celCatal
     if (static_cast<uint32_t>(catalog) >= crossIndexes.size())
         return Star::InvalidCatalogNumber;
 
-    auto xindex = crossIndexes[catalog];
-    if (xindex == NULL)
-        return Star::InvalidCatalogNumber;
-
-    // A simple linear search.  We could store cross indices sorted by
-    // both catalog numbers and trade memory for speed
-    for (const auto entry : *xindex) {
-        if (celCatalogNumber == entry.celCatalogNumber)
-            return entry.catalogNumber;
-    }
-
-    return Star::InvalidCatalogNumber;
+    return crossIndexes[catalog].fromCelestia.find(celCatalogNumber);
 }
 
 // Return the Celestia catalog number for the star with a specified number
@@ -205,18 +198,7 @@ uint32_t StarDatabase::searchCrossIndexForCatalogNumber(const Catalog catalog, c
     if (static_cast<uint32_t>(catalog) >= crossIndexes.size())
         return Star::InvalidCatalogNumber;
 
-    auto xindex = crossIndexes[catalog];
-    if (!xindex)
-        return Star::InvalidCatalogNumber;
-
-    CrossIndexEntry xindexEnt;
-    xindexEnt.catalogNumber = number;
-
-    CrossIndex::iterator iter = lower_bound(xindex->begin(), xindex->end(), xindexEnt);
-    if (iter == xindex->end() || iter->catalogNumber != number)
-        return Star::InvalidCatalogNumber;
-    else
-        return iter->celCatalogNumber;
+    return crossIndexes[catalog].toCelestia.find(number);
 }
 
 StarPtr StarDatabase::searchCrossIndex(const Catalog catalog, const uint32_t number) const {
@@ -227,12 +209,12 @@ StarPtr StarDatabase::searchCrossIndex(const Catalog catalog, const uint32_t num
         return NULL;
 }
 
-vector<string> StarDatabase::getCompletion(const string& name) const {
+vector<string> StarDatabase::getCompletion(const string& name, size_t maxCount) const {
     vector<string> completion;
 
     // only named stars are supported by completion.
     if (!name.empty() && namesDB != NULL)
-        return namesDB->getCompletion(name);
+        return namesDB->getCompletion(name, maxCount);
     else
         return completion;
 }
@@ -347,11 +329,125 @@ void StarDatabase::findVisibleStars(StarHandler& starHandler,
                                     const Quaternionf& orientation,
                                     const StarOctree::Frustum& frustum,
                                     float limitingMag) const {
-    octreeRoot->processVisibleObjects(starHandler, position, frustum, limitingMag, STAR_OCTREE_ROOT_SIZE);
+    PROFILE_ZONE("StarDatabase::findVisibleStars");
+    octreeRoot->processVisibleObjects(starHandler, position, frustum, limitingMag, STAR_OCTREE_ROOT_SIZE, ThreadPool::getDefault());
+}
+
+void StarDatabase::findVisibleStars(StarRangeHandler& starHandler,
+                                    const Vector3f& position,
+                                    const StarOctree::Frustum& frustum,
+                                    float limitingMag) const {
+    PROFILE_ZONE("StarDatabase::findVisibleStars");
+    octreeRoot->processVisibleRanges(starHandler, position, frustum, limitingMag, STAR_OCTREE_ROOT_SIZE, ThreadPool::getDefault());
+}
+
+void StarDatabase::findVisibleStars(vector<VisibleStar>& visibleStars,
+                                    const Vector3f& position,
+                                    const StarOctree::Frustum& frustum,
+                                    float limitingMag) const {
+    PROFILE_ZONE("StarDatabase::findVisibleStars");
+    visibleStars.clear();
+
+    auto& threadPool = ThreadPool::getDefault();
+    OctreeRangeBuffer<float> ranges;
+    octreeRoot->processVisibleRanges(ranges, position, frustum, limitingMag, STAR_OCTREE_ROOT_SIZE, threadPool);
+
+    // Group consecutive ranges into batches of roughly equal star counts.
+    // Each batch is culled into its own buffer, and the buffers are joined
+    // in batch order so the result doesn't depend on the scheduling.
+    struct Batch {
+        size_t firstRange;
+        size_t endRange;
+        uint32_t nStars;
+        vector<VisibleStar> stars;
+    };
+    vector<Batch> batches;
+    for (size_t i = 0; i < ranges.entries.size(); ++i) {
+        if (batches.empty() || batches.back().nStars >= STAR_CULL_BATCH_SIZE)
+            batches.push_back(Batch{ i, i, 0, {} });
+        batches.back().endRange = i + 1;
+        batches.back().nStars += ranges.entries[i].count;
+    }
+
+    threadPool.parallelFor(batches.size(), [&](size_t b) {
+        auto& batch = batches[b];
+        batch.stars.resize(batch.nStars);
+        uint32_t nVisible = 0;
+        for (size_t i = batch.firstRange; i < batch.endRange; ++i) {
+            const auto& range = ranges.entries[i];
+            nVisible += CullStarRange(starStore, range.first, range.count, position, range.limitingFactor, limitingMag,
+                                      batch.stars.data() + nVisible);
+        }
+        batch.stars.resize(nVisible);
+    });
+
+    for (const auto& batch : batches) {
+        visibleStars.insert(visibleStars.end(), batch.stars.begin(), batch.stars.end());
+    }
+    PROFILE_COUNTER("Visible stars", visibleStars.size());
 }
 
 void StarDatabase::findCloseStars(StarHandler& starHandler, const Vector3f& position, float radius) const {
-    octreeRoot->processCloseObjects(starHandler, position, radius, STAR_OCTREE_ROOT_SIZE);
+    PROFILE_ZONE("StarDatabase::findCloseStars");
+    octreeRoot->processCloseObjects(starHandler, position, radius, STAR_OCTREE_ROOT_SIZE, ThreadPool::getDefault());
+}
+
+void StarDatabase::processStarsByDistance(const Vector3f& position,
+                                          float radius,
+                                          const std::function<bool(const StarPtr&, float)>& visit) const {
+    PROFILE_ZONE("StarDatabase::processStarsByDistance");
+    octreeRoot->processObjectsByDistance(position, radius, STAR_OCTREE_ROOT_SIZE,
+                                         [&](uint32_t index, float distance) { return visit(stars[index], distance); });
+}
+
+vector<StarPtr> StarDatabase::findNearestStars(const Vector3f& position, uint32_t nStars) const {
+    vector<StarPtr> nearest;
+    if (nStars == 0)
+        return nearest;
+
+    processStarsByDistance(position, numeric_limits<float>::infinity(), [&](const StarPtr& star, float) {
+        nearest.push_back(star);
+        return nearest.size() < nStars;
+    });
+    return nearest;
+}
+
+vector<StarPtr> StarDatabase::findBrightestStars(const Vector3f& position, uint32_t nStars) const {
+    PROFILE_ZONE("StarDatabase::findBrightestStars");
+    vector<StarPtr> brightest;
+    if (nStars == 0)
+        return brightest;
+
+    // A subtree can't hold a star that appears brighter than its brightest
+    // star would at the nearest point of the subtree.
+    auto nodeKey = [&position](const StarOctree::Node& node, float scale) {
+        float distance = StarOctree::nodeDistance(node, position, scale);
+        return distance > 0.0f ? astro::absToAppMag(node.brightestFactor, distance) : -numeric_limits<float>::infinity();
+    };
+    auto starKey = [&position](const Star& star) {
+        return star.getApparentMagnitude((position - star.getPosition()).norm());
+    };
+    octreeRoot->processObjectsInOrder(nodeKey, starKey, numeric_limits<float>::infinity(), STAR_OCTREE_ROOT_SIZE,
+                                      [&](uint32_t index, float) {
+                                          brightest.push_back(stars[index]);
+                                          return brightest.size() < nStars;
+                                      });
+    return brightest;
+}
+
+vector<StarPtr> StarDatabase::findIntrinsicallyBrightestStars(uint32_t nStars) const {
+    vector<StarPtr> brightest;
+    if (nStars == 0)
+        return brightest;
+
+    auto nodeKey = [](const StarOctree::Node& node, float) { return node.brightestFactor; };
+    auto starKey = [](const Star& star) { return star.getAbsoluteMagnitude(); };
+    octreeRoot->processObjectsInOrder(nodeKey, starKey, numeric_limits<float>::infinity(), STAR_OCTREE_ROOT_SIZE,
+                                      [&](uint32_t index, float) {
+                                          brightest.push_back(stars[index]);
+                                          return brightest.size() < nStars;
+                                      });
+    return brightest;
 }
 
 const StarNameDatabase::Pointer& StarDatabase::getNameDatabase() const {
@@ -363,10 +459,13 @@ void StarDatabase::setNameDatabase(const StarNameDatabase::Pointer& _namesDB) {
 }
 
 bool StarDatabase::loadCrossIndex(const Catalog catalog, istream& in) {
+    PROFILE_ZONE("StarDatabase::loadCrossIndex");
     if (static_cast<uint32_t>(catalog) >= crossIndexes.size())
         return false;
 
-    crossIndexes[catalog].reset();
+    auto& tables = crossIndexes[catalog];
+    tables.toCelestia.clear();
+    tables.fromCelestia.clear();
 
     // Verify that the star database file has a correct header
     {
@@ -391,7 +490,7 @@ bool StarDatabase::loadCrossIndex(const Catalog catalog, istream& in) {
         }
     }
 
-    auto xindex = std::make_shared<CrossIndex>();
+    CrossIndex xindex;
     uint32_t record = 0;
     for (;;) {
         CrossIndexEntry ent;
@@ -407,19 +506,31 @@ bool StarDatabase::loadCrossIndex(const Catalog catalog, istream& in) {
             return false;
         }
 
-        xindex->insert(xindex->end(), ent);
+        xindex.push_back(ent);
 
         record++;
     }
 
-    sort(xindex->begin(), xindex->end());
-
-    crossIndexes[catalog] = xindex;
+    // Sort as the linear search used to, so that where a catalog has
+    // duplicate entries the first entry for a key, the one kept, still
+    // carries the smallest number.
+    sort(xindex.begin(), xindex.end(), [](const CrossIndexEntry& a, const CrossIndexEntry& b) {
+        return a.catalogNumber != b.catalogNumber ? a.catalogNumber < b.catalogNumber
+                                                  : a.celCatalogNumber < b.celCatalogNumber;
+    });
+
+    tables.toCelestia.reset(xindex.size());
+    tables.fromCelestia.reset(xindex.size());
+    for (const auto& ent : xindex) {
+        tables.toCelestia.insert(ent.catalogNumber, ent.celCatalogNumber);
+        tables.fromCelestia.insert(ent.celCatalogNumber, ent.catalogNumber);
+    }
 
     return true;
 }
 
 bool StarDatabase::loadBinary(istream& in) {
+    PROFILE_ZONE("StarDatabase::loadBinary");
     uint32_t nStarsInFile = 0;
 
     // Verify that the star database file has a correct header
@@ -510,10 +621,118 @@ bool StarDatabase::loadBinary(istream& in) {
     return true;
 }
 
+bool StarDatabase::loadBinary(const storage::StoragePointer& file) {
+    PROFILE_ZONE("StarDatabase::loadBinary");
+    // header, version, star count
+    static const size_t headerLength = strlen(FILE_HEADER);
+    static const size_t preambleSize = headerLength + sizeof(uint16_t) + sizeof(uint32_t);
+    // catalog number, x, y, z, absolute magnitude, spectral type
+    static const size_t recordSize = sizeof(uint32_t) + 3 * sizeof(float) + sizeof(int16_t) + sizeof(uint16_t);
+
+    if (!file || file->size() < preambleSize)
+        return false;
+
+    const uint8_t* data = file->data();
+    if (strncmp((const char*)data, FILE_HEADER, headerLength))
+        return false;
+    data += headerLength;
+
+    uint16_t version;
+    memcpy(&version, data, sizeof version);
+    LE_TO_CPU_INT16(version, version);
+    if (version != 0x0100)
+        return false;
+    data += sizeof version;
+
+    uint32_t nStarsInFile;
+    memcpy(&nStarsInFile, data, sizeof nStarsInFile);
+    LE_TO_CPU_INT32(nStarsInFile, nStarsInFile);
+    data += sizeof nStarsInFile;
+
+    if ((file->size() - preambleSize) / recordSize < nStarsInFile)
+        return false;
+
+    // All of the stars in the file share a single allocation; the pointers
+    // handed out alias the block, which lives until the last of them goes.
+    std::shared_ptr<Star> block(new Star[nStarsInFile], std::default_delete<Star[]>());
+
+    // There are only a few hundred distinct spectral types in a catalog of
+    // millions of stars, so avoid repeating the details lookup per record.
+    std::map<uint16_t, StarDetails::Pointer> detailsCache;
+
+    auto firstStar = stars.size();
+    stars.reserve(firstStar + nStarsInFile);
+    for (uint32_t i = 0; i < nStarsInFile; i++, data += recordSize) {
+        uint32_t catNo;
+        float x, y, z;
+        int16_t absMag;
+        uint16_t spectralType;
+
+        memcpy(&catNo, data, sizeof catNo);
+        memcpy(&x, data + 4, sizeof x);
+        memcpy(&y, data + 8, sizeof y);
+        memcpy(&z, data + 12, sizeof z);
+        memcpy(&absMag, data + 16, sizeof absMag);
+        memcpy(&spectralType, data + 18, sizeof spectralType);
+        LE_TO_CPU_INT32(catNo, catNo);
+        LE_TO_CPU_FLOAT(x, x);
+        LE_TO_CPU_FLOAT(y, y);
+        LE_TO_CPU_FLOAT(z, z);
+        LE_TO_CPU_INT16(absMag, absMag);
+        LE_TO_CPU_INT16(spectralType, spectralType);
+
+        StarDetails::Pointer& details = detailsCache[spectralType];
+        if (!details) {
+            StellarClass sc;
+            if (sc.unpack(spectralType))
+                details = StarDetails::GetStarDetails(sc);
+        }
+
+        if (!details) {
+            cerr << _("Bad spectral type in star database, star #") << firstStar + i << "\n";
+            stars.resize(firstStar);
+            return false;
+        }
+
+        Star* star = block.get() + i;
+        star->setPosition(x, y, z);
+        star->setAbsoluteMagnitude((float)absMag / 256.0f);
+        star->setDetails(details);
+        star->setCatalogNumber(catNo);
+        stars.push_back(StarPtr(block, star));
+    }
+
+    DPRINTF(0, "StarDatabase::read: nStars = %d\n", nStarsInFile);
+    clog << stars.size() << _(" stars in binary database\n");
+
+    // See loadBinary(istream&); stars.dat is normally written in catalog
+    // number order already, in which case the sort can be skipped.
+    if (stars.size() > 0) {
+        binFileCatalogNumberIndex = stars;
+        if (!std::is_sorted(binFileCatalogNumberIndex.begin(), binFileCatalogNumberIndex.end(), PtrCatalogNumberOrderingPredicate))
+            std::sort(binFileCatalogNumberIndex.begin(), binFileCatalogNumberIndex.end(), PtrCatalogNumberOrderingPredicate);
+    }
+
+    return true;
+}
+
 void StarDatabase::finish() {
+    PROFILE_ZONE("StarDatabase::finish");
     clog << _("Total star count: ") << stars.size() << endl;
 
-    buildOctree();
+    if (octreeCacheFile.empty()) {
+        buildOctree();
+    } else {
+        uint64_t inputHash = hashOctreeInputs();
+        if (loadOctreeCache(inputHash)) {
+            clog << _("Loaded star octree from ") << octreeCacheFile << endl;
+        } else {
+            std::vector<StarPtr> loadOrder = stars;
+            buildOctree();
+            if (!saveOctreeCache(inputHash, loadOrder))
+                cerr << _("Error writing star octree cache ") << octreeCacheFile << '\n';
+        }
+    }
     buildIndexes();
 
     // Delete the temporary indices used only during loading
@@ -537,14 +756,18 @@ void StarDatabase::finish() {
     }
 
     barycenters.clear();
+
+    // Orbital radii are final only once the barycenters are resolved, so the
+    // packed star data has to be built last.
+    starStore.build(stars);
 }
 
-static void errorMessagePrelude(const Tokenizer& tok) {
-    cerr << _("Error in .stc file (line ") << tok.getLineNumber() << "): ";
+static void errorMessagePrelude(int lineNumber) {
+    cerr << _("Error in .stc file (line ") << lineNumber << "): ";
 }
 
-static void stcError(const Tokenizer& tok, const string& msg) {
-    errorMessagePrelude(tok);
+static void stcError(int lineNumber, const string& msg) {
+    errorMessagePrelude(lineNumber);
     cerr << msg << '\n';
 }
 
@@ -872,55 +1095,60 @@ bool StarDatabase::createStar(const StarPtr& star,
  *  Modify <number>   : error
  */
 bool StarDatabase::load(istream& in, const string& resourcePath) {
-    Tokenizer tokenizer(&in);
-    Parser parser(&tokenizer);
+    CatalogRecordList records;
+    bool parsed = ReadCatalogRecords(in, records);
+    return load(records, resourcePath) && parsed;
+}
 
-    while (tokenizer.nextToken() != Tokenizer::TokenEnd) {
+bool StarDatabase::load(const CatalogRecordList& records, const string& resourcePath) {
+    PROFILE_ZONE("StarDatabase::load");
+    for (const auto& record : records) {
+        CatalogHeaderReader header(record);
         bool isStar = true;
 
         // Parse the disposition--either Add, Replace, or Modify. The disposition
         // may be omitted. The default value is Add.
         StcDisposition disposition = AddStar;
-        if (tokenizer.getTokenType() == Tokenizer::TokenName) {
-            if (tokenizer.getNameValue() == "Modify") {
+        if (header.getTokenType() == Tokenizer::TokenName) {
+            if (header.getNameValue() == "Modify") {
                 disposition = ModifyStar;
-                tokenizer.nextToken();
-            } else if (tokenizer.getNameValue() == "Replace") {
+                header.next();
+            } else if (header.getNameValue() == "Replace") {
                 disposition = ReplaceStar;
-                tokenizer.nextToken();
-            } else if (tokenizer.getNameValue() == "Add") {
+                header.next();
+            } else if (header.getNameValue() == "Add") {
                 disposition = AddStar;
-                tokenizer.nextToken();
+                header.next();
             }
         }
 
         // Parse the object type--either Star or Barycenter. The object type
         // may be omitted. The default is Star.
-        if (tokenizer.getTokenType() == Tokenizer::TokenName) {
-            if (tokenizer.getNameValue() == "Star") {
+        if (header.getTokenType() == Tokenizer::TokenName) {
+            if (header.getNameValue() == "Star") {
                 isStar = true;
-            } else if (tokenizer.getNameValue() == "Barycenter") {
+            } else if (header.getNameValue() == "Barycenter") {
                 isStar = false;
             } else {
-                stcError(tokenizer, "unrecognized object type");
+                stcError(record.lineNumber, "unrecognized object type");
                 return false;
             }
-            tokenizer.nextToken();
+            header.next();
         }
 
         // Parse the catalog number; it may be omitted if a name is supplied.
         uint32_t catalogNumber = Star::InvalidCatalogNumber;
-        if (tokenizer.getTokenType() == Tokenizer::TokenNumber) {
-            catalogNumber = (uint32_t)tokenizer.getNumberValue();
-            tokenizer.nextToken();
+        if (header.getTokenType() == Tokenizer::TokenNumber) {
+            catalogNumber = (uint32_t)header.getNumberValue();
+            header.next();
         }
 
         string objName;
         string firstName;
-        if (tokenizer.getTokenType() == Tokenizer::TokenString) {
+        if (header.getTokenType() == Tokenizer::TokenString) {
             // A star name (or names) is present
-            objName = tokenizer.getStringValue();
-            tokenizer.nextToken();
+            objName = header.getStringValue();
+            header.next();
             if (!objName.empty()) {
                 string::size_type next = objName.find(':', 0);
                 firstName = objName.substr(0, next);
@@ -969,15 +1197,8 @@ bool StarDatabase::load(istream& in, const string& resourcePath) {
 
         bool isNewStar = star == NULL;
 
-        tokenizer.pushBack();
-
-        auto starDataValue = parser.readValue();
-        if (starDataValue == NULL) {
-            clog << "Error reading star." << endl;
-            return false;
-        }
-
-        if (starDataValue->getType() != Value::HashType) {
+        const auto& starDataValue = record.value;
+        if (!header.atEnd() || starDataValue->getType() != Value::HashType) {
             DPRINTF(0, "Bad star definition.\n");
             return false;
         }
@@ -1033,6 +1254,7 @@ bool StarDatabase::load(istream& in, const string& resourcePath) {
 }
 
 void StarDatabase::buildOctree() {
+    PROFILE_ZONE("StarDatabase::buildOctree");
     // This should only be called once for the database
     // ASSERT(octreeRoot == NULL);
 
@@ -1048,10 +1270,6 @@ void StarDatabase::buildOctree() {
 
     DPRINTF(1, "Spatially sorting stars for improved locality of reference . . .\n");
     root->rebuildAndSort(octreeRoot, stars);
-    auto starCount = stars.size();
-    for (size_t i = 0; i < starCount; ++i) {
-        starIndices[stars[i]] = i;
-    }
 
     // ASSERT((int) (firstStar - sortedStars) == nStars);
     //DPRINTF(1, "%d stars total\n", (int)(firstStar - sortedStars));
@@ -1072,8 +1290,192 @@ void StarDatabase::buildIndexes() {
     // This should only be called once for the database
     // assert(catalogNumberIndexes[0] == NULL);
     DPRINTF(1, "Building catalog number indexes . . .\n");
-    catalogNumberIndex = stars;
-    sort(catalogNumberIndex.begin(), catalogNumberIndex.end(), PtrCatalogNumberOrderingPredicate);
+    catalogNumberIndex.reset(stars.size());
+    for (size_t i = 0; i < stars.size(); ++i)
+        catalogNumberIndex.insert(stars[i]->getCatalogNumber(), (uint32_t)i);
+}
+
+// Star octree cache file layout (native byte order, the cache is never
+// shared between machines):
+//
+//   char[8]    "CELSTOCT"
+//   uint32_t   version, node record size
+//   uint32_t   star count, node count
+//   uint64_t   hash of the octree inputs
+//   uint32_t   sorted order[star count]    load order index of each star
+//   node records[node count], each:
+//     float    cell center x, y, z
+//     float    exclusion factor
+//     uint32_t first child, first object, object count, subtree object count
+//     float    brightest factor
+static const char* OCTREE_CACHE_HEADER = "CELSTOCT";
+static const uint32_t OCTREE_CACHE_VERSION = 0x0201;
+static const size_t OCTREE_CACHE_PREAMBLE_SIZE = 8 + 4 * sizeof(uint32_t) + sizeof(uint64_t);
+static const size_t OCTREE_CACHE_NODE_SIZE = 9 * 4;
+
+// Hash everything the octree construction depends on: the order in which the
+// stars were loaded and the position, magnitude and orbit of each. Any change
+// to the star catalogs or stc files shows up here.
+uint64_t StarDatabase::hashOctreeInputs() const {
+    // FNV-1a, one 32-bit word at a time
+    uint64_t hash = 0xcbf29ce484222325ull;
+    auto mix = [&hash](uint32_t word) { hash = (hash ^ word) * 0x100000001b3ull; };
+    auto mixFloat = [&mix](float f) {
+        uint32_t word;
+        memcpy(&word, &f, sizeof word);
+        mix(word);
+    };
+
+    mix((uint32_t)stars.size());
+    mixFloat(STAR_OCTREE_ROOT_SIZE);
+    mixFloat(STAR_OCTREE_MAGNITUDE);
+    for (const auto& star : stars) {
+        const Vector3f& pos = star->getPosition();
+        mix(star->getCatalogNumber());
+        mixFloat(pos.x());
+        mixFloat(pos.y());
+        mixFloat(pos.z());
+        mixFloat(star->getAbsoluteMagnitude());
+        mixFloat(star->getOrbitalRadius());
+    }
+    return hash;
+}
+
+bool StarDatabase::loadOctreeCache(uint64_t inputHash) {
+    PROFILE_ZONE("StarDatabase::loadOctreeCache");
+    using Node = StarOctree::Node;
+
+    storage::StoragePointer file;
+    try {
+        file = storage::Storage::readFile(octreeCacheFile);
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+    if (file->size() < OCTREE_CACHE_PREAMBLE_SIZE)
+        return false;
+
+    const uint8_t* data = file->data();
+    if (strncmp((const char*)data, OCTREE_CACHE_HEADER, 8))
+        return false;
+
+    uint32_t preamble[4];
+    uint64_t hash;
+    memcpy(preamble, data + 8, sizeof preamble);
+    memcpy(&hash, data + 8 + sizeof preamble, sizeof hash);
+    data += OCTREE_CACHE_PREAMBLE_SIZE;
+
+    uint32_t starCount = preamble[2];
+    uint32_t nodeCount = preamble[3];
+    if (preamble[0] != OCTREE_CACHE_VERSION || preamble[1] != OCTREE_CACHE_NODE_SIZE || hash != inputHash ||
+        starCount != stars.size() || nodeCount == 0)
+        return false;
+    if (file->size() != OCTREE_CACHE_PREAMBLE_SIZE + sizeof(uint32_t) * (size_t)starCount + OCTREE_CACHE_NODE_SIZE * (size_t)nodeCount)
+        return false;
+
+    // Validate the permutation before touching the database, so that a
+    // damaged cache can't leave it half sorted.
+    std::vector<uint32_t> order(starCount);
+    memcpy(order.data(), data, starCount * sizeof(uint32_t));
+    data += starCount * sizeof(uint32_t);
+
+    std::vector<bool> seen(starCount);
+    for (uint32_t index : order) {
+        if (index >= starCount || seen[index])
+            return false;
+        seen[index] = true;
+    }
+
+    std::vector<Node> nodes(nodeCount);
+    for (auto& node : nodes) {
+        float x, y, z;
+        memcpy(&x, data, sizeof x);
+        memcpy(&y, data + 4, sizeof y);
+        memcpy(&z, data + 8, sizeof z);
+        memcpy(&node.exclusionFactor, data + 12, sizeof node.exclusionFactor);
+        memcpy(&node.firstChild, data + 16, sizeof node.firstChild);
+        memcpy(&node.firstObject, data + 20, sizeof node.firstObject);
+        memcpy(&node.objectCount, data + 24, sizeof node.objectCount);
+        memcpy(&node.subtreeObjectCount, data + 28, sizeof node.subtreeObjectCount);
+        memcpy(&node.brightestFactor, data + 32, sizeof node.brightestFactor);
+        node.cellCenterPos = Vector3f(x, y, z);
+        data += OCTREE_CACHE_NODE_SIZE;
+
+        if ((uint64_t)node.firstObject + node.objectCount > starCount)
+            return false;
+    }
+
+    // The children of a node always follow it, and every node but the root
+    // is the child of exactly one node. Anything else could make the
+    // recursive traversals loop.
+    std::vector<bool> reached(nodeCount);
+    reached[0] = true;
+    for (uint32_t i = 0; i < nodeCount; i++) {
+        const Node& node = nodes[i];
+        if (!node.hasChildren())
+            continue;
+        if (node.firstChild <= i || (uint64_t)node.firstChild + 8 > nodeCount)
+            return false;
+        for (uint32_t c = node.firstChild; c < node.firstChild + 8; c++) {
+            if (reached[c])
+                return false;
+            reached[c] = true;
+        }
+    }
+    if (std::find(reached.begin(), reached.end(), false) != reached.end())
+        return false;
+
+    std::vector<StarPtr> sortedStars(starCount);
+    for (uint32_t i = 0; i < starCount; i++)
+        sortedStars[i] = stars[order[i]];
+    stars.swap(sortedStars);
+
+    octreeRoot = std::make_shared<StarOctree>(stars, std::move(nodes));
+
+    return true;
+}
+
+bool StarDatabase::saveOctreeCache(uint64_t inputHash, const std::vector<StarPtr>& loadOrder) const {
+    using Node = StarOctree::Node;
+
+    uint32_t starCount = (uint32_t)stars.size();
+    const auto& nodes = octreeRoot->getNodes();
+
+    // The load order index of each star, in sorted order
+    std::unordered_map<const Star*, uint32_t> loadIndices;
+    loadIndices.reserve(starCount);
+    for (uint32_t i = 0; i < starCount; i++)
+        loadIndices[loadOrder[i].get()] = i;
+
+    std::vector<uint32_t> order(starCount);
+    for (uint32_t i = 0; i < starCount; i++)
+        order[i] = loadIndices.at(stars[i].get());
+
+    ofstream out(octreeCacheFile, ios::out | ios::binary | ios::trunc);
+    if (!out.good())
+        return false;
+
+    uint32_t preamble[4] = { OCTREE_CACHE_VERSION, (uint32_t)OCTREE_CACHE_NODE_SIZE, starCount, (uint32_t)nodes.size() };
+    out.write(OCTREE_CACHE_HEADER, 8);
+    out.write((const char*)preamble, sizeof preamble);
+    out.write((const char*)&inputHash, sizeof inputHash);
+    out.write((const char*)order.data(), starCount * sizeof(uint32_t));
+
+    std::vector<char> records(nodes.size() * OCTREE_CACHE_NODE_SIZE);
+    char* record = records.data();
+    for (const Node& node : nodes) {
+        memcpy(record, &node.cellCenterPos.x(), 4);
+        memcpy(record + 4, &node.cellCenterPos.y(), 4);
+        memcpy(record + 8, &node.cellCenterPos.z(), 4);
+        memcpy(record + 12, &node.exclusionFactor, 4);
+        memcpy(record + 16, &node.firstChild, 4);
+        memcpy(record + 20, &node.firstObject, 4);
+        memcpy(record + 24, &node.objectCount, 4);
+        memcpy(record + 28, &node.subtreeObjectCount, 4);
+        memcpy(record + 32, &node.brightestFactor, 4);
+        record += OCTREE_CACHE_NODE_SIZE;
+    }
+    out.write(records.data(), records.size());
+    return out.good();
 }
 
 /*! While loading the star catalogs, this function must be called instead of
@@ -1090,11 +1492,11 @@ void StarDatabase::buildIndexes() {
 StarPtr StarDatabase::findWhileLoading(uint32_t catalogNumber) const {
     // First check for stars loaded from the binary database
     if (!binFileCatalogNumberIndex.empty()) {
-        auto refStar = std::make_shared<Star>();
-        refStar->setCatalogNumber(catalogNumber);
         auto begin = binFileCatalogNumberIndex.begin();
         auto end = binFileCatalogNumberIndex.end();
-        auto iter = lower_bound(begin, end, refStar, PtrCatalogNumberOrderingPredicate);
+        auto iter = lower_bound(begin, end, catalogNumber, [](const StarPtr& star, uint32_t catalogNumber) {
+            return star->getCatalogNumber() < catalogNumber;
+        });
         if (iter != end && (*iter)->getCatalogNumber() == catalogNumber)
             return *iter;
     }
@@ -12,13 +12,20 @@
 #define _CELENGINE_STARDB_H_
 
 #include <iostream>
+#include <functional>
 #include <vector>
 #include <map>
 #include "constellation.h"
 #include "starname.h"
 #include "star.h"
 #include "staroctree.h"
+#include "starstore.h"
+#include "starcull.h"
 #include "parser.h"
+#include "catalogrecord.h"
+#include "catalogindex.h"
+
+#include <celutil/storage.hpp>
 
 static const uint32_t MAX_STAR_NAMES = 10;
 
@@ -96,7 +103,7 @@ public:
     StarPtr find(const std::string&) const;
     uint32_t findCatalogNumberByName(const std::string&) const;
 
-    std::vector<std::string> getCompletion(const std::string&) const;
+    std::vector<std::string> getCompletion(const std::string&, size_t maxCount = SIZE_MAX) const;
 
     void findVisibleStars(StarHandler& starHandler,
                           const Eigen::Vector3f& obsPosition,
@@ -104,17 +111,53 @@ public:
                           const StarOctree::Frustum& frustum,
                           float limitingMag) const;
 
+    // Range based variant of findVisibleStars; the handler receives index
+    // ranges into getStarStore() and applies the per-star tests itself.
+    void findVisibleStars(StarRangeHandler& starHandler,
+                          const Eigen::Vector3f& obsPosition,
+                          const StarOctree::Frustum& frustum,
+                          float limitingMag) const;
+
+    // Collect every star that passes the visibility test into visibleStars,
+    // in octree order.  Traversal and culling are spread over the default
+    // thread pool.
+    void findVisibleStars(std::vector<VisibleStar>& visibleStars,
+                          const Eigen::Vector3f& obsPosition,
+                          const StarOctree::Frustum& frustum,
+                          float limitingMag) const;
+
     void findCloseStars(StarHandler& starHandler, const Eigen::Vector3f& obsPosition, float radius) const;
 
+    // Call visit(star, distance) for the stars within radius of position,
+    // nearest first, until visit returns false.
+    void processStarsByDistance(const Eigen::Vector3f& position,
+                                float radius,
+                                const std::function<bool(const StarPtr&, float)>& visit) const;
+
+    // The nStars stars closest to position, nearest first
+    std::vector<StarPtr> findNearestStars(const Eigen::Vector3f& position, uint32_t nStars) const;
+
+    // The nStars stars that appear brightest from position, brightest first
+    std::vector<StarPtr> findBrightestStars(const Eigen::Vector3f& position, uint32_t nStars) const;
+
+    // The nStars stars with the brightest absolute magnitude, brightest first
+    std::vector<StarPtr> findIntrinsicallyBrightestStars(uint32_t nStars) const;
+
     std::string getStarName(const Star&, bool i18n = false) const;
     void getStarName(const Star& star, char* nameBuffer, uint32_t bufferSize, bool i18n = false) const;
     std::string getStarNameList(const Star&, const uint32_t maxNames = MAX_STAR_NAMES) const;
 
+    const StarStore& getStarStore() const { return starStore; }
+
     const StarNameDatabase::Pointer& getNameDatabase() const;
     void setNameDatabase(const StarNameDatabase::Pointer&);
 
     bool load(std::istream&, const std::string& resourcePath);
+    bool load(const CatalogRecordList&, const std::string& resourcePath);
     bool loadBinary(std::istream&);
+    // Parse a stars.dat image in place; the records are decoded straight out
+    // of the (typically memory mapped) storage into one preallocated block.
+    bool loadBinary(const storage::StoragePointer&);
 
     enum Catalog
     {
@@ -143,13 +186,17 @@ public:
     };
 
     typedef std::vector<CrossIndexEntry> CrossIndex;
-    using CrossIndexPtr = std::shared_ptr<CrossIndex>;
 
     bool loadCrossIndex(const Catalog, std::istream&);
     uint32_t searchCrossIndexForCatalogNumber(const Catalog, const uint32_t number) const;
     StarPtr searchCrossIndex(const Catalog, const uint32_t number) const;
     uint32_t crossIndex(const Catalog, const uint32_t number) const;
 
+    // Optional file used to persist the spatially sorted star order and the
+    // octree between runs. The cache is keyed on the loaded star data and
+    // silently rebuilt when it doesn't match.
+    void setOctreeCacheFile(const std::string& filename) { octreeCacheFile = filename; }
+
     void finish();
 
     static const char* FILE_HEADER;
@@ -165,16 +212,27 @@ private:
 
     void buildOctree();
     void buildIndexes();
+    uint64_t hashOctreeInputs() const;
+    bool loadOctreeCache(uint64_t inputHash);
+    bool saveOctreeCache(uint64_t inputHash, const std::vector<StarPtr>& loadOrder) const;
     StarPtr findWhileLoading(uint32_t catalogNumber) const;
 
     std::vector<StarPtr> stars;
-    std::unordered_map<StarPtr, size_t> starIndices;
     StarNameDatabase::Pointer namesDB;
-    std::vector<StarPtr> catalogNumberIndex;
+    // Catalog number -> index in stars
+    CatalogIndex catalogNumberIndex;
     StarOctreePtr octreeRoot;
+    StarStore starStore;
     uint32_t nextAutoCatalogNumber;
+    std::string octreeCacheFile;
 
-    std::vector<CrossIndexPtr> crossIndexes;
+    // Each cross index is hashed both ways: from the other catalog's numbers
+    // to Celestia's and back.
+    struct CrossIndexTables {
+        CatalogIndex toCelestia;
+        CatalogIndex fromCelestia;
+    };
+    std::vector<CrossIndexTables> crossIndexes;
 
     // These values are used by the star database loader; they are
     // not used after loading is complete.
@@ -22,7 +22,7 @@ using namespace Eigen;
 // star is very faint, this estimate may not work when the star is
 // far from the barycenter. Thus, the star octree traversal will always
 // render stars with orbits that are closer than MAX_STAR_ORBIT_RADIUS.
-static const float MAX_STAR_ORBIT_RADIUS = 1.0f;
+const float MAX_STAR_ORBIT_RADIUS = 1.0f;
 
 // The octree node into which a star is placed is dependent on two properties:
 // its obsPosition and its luminosity--the fainter the star, the deeper the node
@@ -52,6 +52,10 @@ DynamicStarOctreePtr DynamicOctree<Star, float>::getChild(const StarPtr& obj, co
 template <>
 uint32_t DynamicOctree<Star, float>::SPLIT_THRESHOLD = 75;
 
+template <>
+DynamicOctree<Star, float>::LimitingFactorFunction DynamicOctree<Star, float>::limitingFactorFunction =
+    [](const StarPtr& star) -> float { return star->getAbsoluteMagnitude(); };
+
 template <>
 DynamicOctree<Star, float>::LimitingFactorPredicate DynamicOctree<Star, float>::limitingFactorPredicate =
     [](const StarPtr& star, const float absMag) -> bool { return star->getAbsoluteMagnitude() <= absMag; };
@@ -74,11 +78,18 @@ DynamicOctree<Star, float>::ExclusionFactorDecayFunction DynamicOctree<Star, flo
 
 // total specialization of the StaticOctree template process*() methods for stars:
 template <>
-void StarOctree::processVisibleObjects(StarHandler& processor,
-                                       const Vector3f& obsPosition,
-                                       const Frustum& frustumPlanes,
-                                       float limitingFactor,
-                                       float scale) const {
+void StarOctree::processVisibleNode(uint32_t nodeIndex,
+                                    StarHandler& processor,
+                                    const Vector3f& obsPosition,
+                                    const Frustum& frustumPlanes,
+                                    float limitingFactor,
+                                    float scale) const {
+    if (deferNode(nodeIndex, scale))
+        return;
+
+    const Node& node = _nodes[nodeIndex];
+    const Vector3f& cellCenterPos = node.cellCenterPos;
+
     // See if this node lies within the view frustum
 
     // Test the cubic octree node against each one of the five
@@ -97,7 +108,9 @@ void StarOctree::processVisibleObjects(StarHandler& processor,
     // Process the objects in this node
     float dimmest = minDistance > 0 ? astro::appToAbsMag(limitingFactor, minDistance) : 1000;
 
-    for (const auto& starPtr : _objects) {
+    const uint32_t lastObject = node.firstObject + node.objectCount;
+    for (uint32_t i = node.firstObject; i < lastObject; ++i) {
+        const auto& starPtr = _objects[i];
         const auto& obj = *starPtr;
         if (obj.getAbsoluteMagnitude() < dimmest) {
             float distance = (obsPosition - obj.getPosition()).norm();
@@ -110,21 +123,63 @@ void StarOctree::processVisibleObjects(StarHandler& processor,
 
     // See if any of the objects in child nodes are potentially included
     // that we need to recurse deeper.
-    if (minDistance <= 0 || astro::absToAppMag(exclusionFactor, minDistance) <= limitingFactor) {
+    if (minDistance <= 0 || astro::absToAppMag(node.exclusionFactor, minDistance) <= limitingFactor) {
         // Recurse into the child nodes
-        if (_children) {
-            for (const auto& child : *_children) {
-                child->processVisibleObjects(processor, obsPosition, frustumPlanes, limitingFactor, scale * 0.5f);
+        if (node.hasChildren()) {
+            for (uint32_t i = 0; i < 8; ++i) {
+                processVisibleNode(node.firstChild + i, processor, obsPosition, frustumPlanes, limitingFactor, scale * 0.5f);
             }
         }
     }
 }
 
 template <>
-void StarOctree::processCloseObjects(StarHandler& processor,
-                                     const Vector3f& obsPosition,
-                                     float boundingRadius,
-                                     float scale) const {
+void StarOctree::processVisibleRangeNode(uint32_t nodeIndex,
+                                         StarRangeHandler& processor,
+                                         const Vector3f& obsPosition,
+                                         const Frustum& frustumPlanes,
+                                         float limitingFactor,
+                                         float scale) const {
+    if (deferNode(nodeIndex, scale))
+        return;
+
+    const Node& node = _nodes[nodeIndex];
+    const Vector3f& cellCenterPos = node.cellCenterPos;
+
+    for (uint32_t i = 0; i < 5; ++i) {
+        const Hyperplane<float, 3>& plane = frustumPlanes[i];
+        float r = scale * plane.normal().cwiseAbs().sum();
+        if (plane.signedDistance(cellCenterPos) < -r)
+            return;
+    }
+
+    float minDistance = (obsPosition - cellCenterPos).norm() - scale * StarOctree::SQRT3;
+    float dimmest = minDistance > 0 ? astro::appToAbsMag(limitingFactor, minDistance) : 1000;
+
+    if (node.objectCount > 0)
+        processor.processRange(node.firstObject, node.objectCount, dimmest);
+
+    if (minDistance <= 0 || astro::absToAppMag(node.exclusionFactor, minDistance) <= limitingFactor) {
+        if (node.hasChildren()) {
+            for (uint32_t i = 0; i < 8; ++i) {
+                processVisibleRangeNode(node.firstChild + i, processor, obsPosition, frustumPlanes, limitingFactor, scale * 0.5f);
+            }
+        }
+    }
+}
+
+template <>
+void StarOctree::processCloseNode(uint32_t nodeIndex,
+                                  StarHandler& processor,
+                                  const Vector3f& obsPosition,
+                                  float boundingRadius,
+                                  float scale) const {
+    if (deferNode(nodeIndex, scale))
+        return;
+
+    const Node& node = _nodes[nodeIndex];
+    const Vector3f& cellCenterPos = node.cellCenterPos;
+
     // Compute the distance to node; this is equal to the distance to
     // the cellCenterPos of the node minus the boundingRadius of the node, scale * SQRT3.
     float nodeDistance = (obsPosition - cellCenterPos).norm() - scale * StarOctree::SQRT3;
@@ -140,7 +195,9 @@ void StarOctree::processCloseObjects(StarHandler& processor,
     float radiusSquared = boundingRadius * boundingRadius;
 
     // Check all the objects in the node.
-    for (const auto& starPtr : _objects) {
+    const uint32_t lastObject = node.firstObject + node.objectCount;
+    for (uint32_t i = node.firstObject; i < lastObject; ++i) {
+        const auto& starPtr = _objects[i];
         const auto& obj = *starPtr;
 
         if ((obsPosition - obj.getPosition()).squaredNorm() < radiusSquared) {
@@ -152,9 +209,27 @@ void StarOctree::processCloseObjects(StarHandler& processor,
     }
 
     // Recurse into the child nodes
-    if (_children) {
-        for (const auto& child : *_children) {
-            child->processCloseObjects(processor, obsPosition, boundingRadius, scale * 0.5f);
+    if (node.hasChildren()) {
+        for (uint32_t i = 0; i < 8; ++i) {
+            processCloseNode(node.firstChild + i, processor, obsPosition, boundingRadius, scale * 0.5f);
         }
     }
 }
+
+StarOctree::Frustum ComputeStarOctreeFrustum(const Vector3f& position, const Quaternionf& orientation, float fovY, float aspectRatio) {
+    StarOctree::Frustum frustumPlanes;
+    Vector3f planeNormals[5];
+    Matrix3f rot = orientation.toRotationMatrix();
+    float h = (float)tan(fovY / 2);
+    float w = h * aspectRatio;
+    planeNormals[0] = Vector3f(0.0f, 1.0f, -h);
+    planeNormals[1] = Vector3f(0.0f, -1.0f, -h);
+    planeNormals[2] = Vector3f(1.0f, 0.0f, -w);
+    planeNormals[3] = Vector3f(-1.0f, 0.0f, -w);
+    planeNormals[4] = Vector3f(0.0f, 0.0f, -1.0f);
+    for (int i = 0; i < 5; i++) {
+        planeNormals[i] = rot.transpose() * planeNormals[i].normalized();
+        frustumPlanes[i] = Hyperplane<float, 3>(planeNormals[i], position);
+    }
+    return frustumPlanes;
+}
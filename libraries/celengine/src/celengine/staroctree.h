@@ -21,5 +21,17 @@ using DynamicStarOctreePtr = std::shared_ptr<DynamicOctree<Star, float>>;
 using StarOctree = StaticOctree<Star, float>;
 using StarOctreePtr = std::shared_ptr<StaticOctree<Star, float>>;
 using StarHandler = OctreeProcessor<Star, float>;
+using StarRangeHandler = OctreeRangeProcessor<float>;
+
+// Stars with an orbit closer than this to the viewer are always processed,
+// regardless of their apparent magnitude.
+extern const float MAX_STAR_ORBIT_RADIUS;
+
+// Bounding planes of the infinite view frustum of a camera at position with
+// the given orientation, for culling the star octree.
+StarOctree::Frustum ComputeStarOctreeFrustum(const Eigen::Vector3f& position,
+                                             const Eigen::Quaternionf& orientation,
+                                             float fovY,
+                                             float aspectRatio);
 
 #endif  // _CELENGINE_STAROCTREE_H_
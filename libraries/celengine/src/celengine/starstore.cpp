@@ -0,0 +1,52 @@
+// starstore.cpp
+//
+// Copyright (C) 2001-2009, the Celestia Development Team
+//
+// Structure of arrays copy of the star data used by the culling and
+// vertex generation passes.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "starstore.h"
+
+#include "star.h"
+
+void StarStore::build(const std::vector<StarPtr>& stars) {
+    clear();
+
+    size_t nStars = stars.size();
+    positionX.reserve(nStars);
+    positionY.reserve(nStars);
+    positionZ.reserve(nStars);
+    absMags.reserve(nStars);
+    temperatures.reserve(nStars);
+    orbitalRadii.reserve(nStars);
+    flags.reserve(nStars);
+    catalogNumbers.reserve(nStars);
+
+    for (const auto& star : stars) {
+        const Eigen::Vector3f& pos = star->getPosition();
+        positionX.push_back(pos.x());
+        positionY.push_back(pos.y());
+        positionZ.push_back(pos.z());
+        absMags.push_back(star->getAbsoluteMagnitude());
+        temperatures.push_back(star->getTemperature());
+        orbitalRadii.push_back(star->getOrbitalRadius());
+        flags.push_back(star->getOrbit() ? (uint8_t)HasOrbit : (uint8_t)0);
+        catalogNumbers.push_back(star->getCatalogNumber());
+    }
+}
+
+void StarStore::clear() {
+    positionX.clear();
+    positionY.clear();
+    positionZ.clear();
+    absMags.clear();
+    temperatures.clear();
+    orbitalRadii.clear();
+    flags.clear();
+    catalogNumbers.clear();
+}
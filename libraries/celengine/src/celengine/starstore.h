@@ -0,0 +1,69 @@
+// starstore.h
+//
+// Copyright (C) 2001-2009, the Celestia Development Team
+//
+// Structure of arrays copy of the star data used by the culling and
+// vertex generation passes.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef _CELENGINE_STARSTORE_H_
+#define _CELENGINE_STARSTORE_H_
+
+#include <vector>
+#include <cstdint>
+
+#include <Eigen/Core>
+
+#include "forward.h"
+
+// A StarStore holds the handful of star properties that are needed for every
+// star on every frame in packed, parallel arrays.  It is built by the star
+// database once the stars have been spatially sorted, so index i refers to
+// StarDatabase::getStar(i) and each octree node covers a contiguous index
+// range.  Anything else (names, textures, exact orbital positions) must still
+// be looked up through the Star object.
+class StarStore {
+public:
+    enum
+    {
+        HasOrbit = 0x1,
+    };
+
+    void build(const std::vector<StarPtr>& stars);
+    void clear();
+
+    inline uint32_t size() const { return (uint32_t)catalogNumbers.size(); }
+
+    inline Eigen::Vector3f getPosition(uint32_t i) const { return Eigen::Vector3f(positionX[i], positionY[i], positionZ[i]); }
+    inline float getAbsoluteMagnitude(uint32_t i) const { return absMags[i]; }
+    inline float getTemperature(uint32_t i) const { return temperatures[i]; }
+    inline float getOrbitalRadius(uint32_t i) const { return orbitalRadii[i]; }
+    inline bool hasOrbit(uint32_t i) const { return (flags[i] & HasOrbit) != 0; }
+    inline uint32_t getCatalogNumber(uint32_t i) const { return catalogNumbers[i]; }
+
+    // Raw arrays, for loops that want to stream over a whole index range
+    const float* getPositionX() const { return positionX.data(); }
+    const float* getPositionY() const { return positionY.data(); }
+    const float* getPositionZ() const { return positionZ.data(); }
+    const float* getAbsoluteMagnitudes() const { return absMags.data(); }
+    const float* getTemperatures() const { return temperatures.data(); }
+    const float* getOrbitalRadii() const { return orbitalRadii.data(); }
+    const uint8_t* getFlags() const { return flags.data(); }
+    const uint32_t* getCatalogNumbers() const { return catalogNumbers.data(); }
+
+private:
+    std::vector<float> positionX;
+    std::vector<float> positionY;
+    std::vector<float> positionZ;
+    std::vector<float> absMags;
+    std::vector<float> temperatures;
+    std::vector<float> orbitalRadii;
+    std::vector<uint8_t> flags;
+    std::vector<uint32_t> catalogNumbers;
+};
+
+#endif  // _CELENGINE_STARSTORE_H_
@@ -13,6 +13,7 @@
 #ifndef _CELENGINE_TIMELINEPHASE_H_
 #define _CELENGINE_TIMELINEPHASE_H_
 
+#include <cstddef>
 #include "forward.h"
 
 class TimelinePhase {
@@ -84,7 +85,12 @@ private:
     const RotationModelPtr m_rotationModel;
     const FrameTreePtr m_owner;
 
+    // Index of this phase among the children of its frame tree
+    size_t m_childIndex{ 0 };
+
     mutable int refCount;
+
+    friend class FrameTree;
 };
 
 #endif  // _CELENGINE_TIMELINEPHASE_H_
@@ -25,6 +25,12 @@ Tokenizer::Tokenizer(istream* _in) :
     lineNum(1) {
 }
 
+Tokenizer::Tokenizer(const storage::StoragePointer& _storage) :
+    in(nullptr), storage(_storage), bufferPos((const char*)_storage->data()),
+    bufferEnd((const char*)_storage->data() + _storage->size()), tokenType(TokenBegin), haveValidNumber(false),
+    haveValidName(false), haveValidString(false), pushedBack(false), lineNum(1) {
+}
+
 Tokenizer::TokenType Tokenizer::nextToken() {
     State state = StartState;
 
@@ -33,14 +39,16 @@ Tokenizer::TokenType Tokenizer::nextToken() {
         return tokenType;
     }
 
-    textToken = "";
+    textToken.clear();
+    textLength = 0;
+    textInStorage = storage != nullptr;
     haveValidNumber = false;
     haveValidName = false;
     haveValidString = false;
 
     if (tokenType == TokenBegin) {
         nextChar = readChar();
-        if (in->eof())
+        if (atEnd())
             return TokenEnd;
     } else if (tokenType == TokenEnd) {
         return tokenType;
@@ -76,7 +84,7 @@ Tokenizer::TokenType Tokenizer::nextToken() {
                     integerValue = 0;
                 } else if (isalpha(nextChar) || nextChar == '_') {
                     state = NameState;
-                    textToken += (char)nextChar;
+                    appendText((char)nextChar);
                 } else if (nextChar == '#') {
                     state = CommentState;
                 } else if (nextChar == '"') {
@@ -116,7 +124,7 @@ Tokenizer::TokenType Tokenizer::nextToken() {
             case NameState:
                 if (isalpha(nextChar) || isdigit(nextChar) || nextChar == '_') {
                     state = NameState;
-                    textToken += (char)nextChar;
+                    appendText((char)nextChar);
                 } else {
                     newToken = TokenName;
                     haveValidName = true;
@@ -134,13 +142,14 @@ Tokenizer::TokenType Tokenizer::nextToken() {
                     haveValidString = true;
                     nextChar = readChar();
                 } else if (nextChar == '\\') {
+                    detachText();
                     state = StringEscapeState;
                 } else if (nextChar == char_traits<char>::eof()) {
                     newToken = TokenError;
                     syntaxError("Unterminated string");
                 } else {
                     state = StringState;
-                    textToken += (char)nextChar;
+                    appendText((char)nextChar);
                 }
                 break;
 
@@ -294,21 +303,62 @@ double Tokenizer::getNumberValue() const {
 }
 
 string Tokenizer::getNameValue() const {
-    return textToken;
+    return string(getTextData(), getTextLength());
 }
 
 string Tokenizer::getStringValue() const {
-    return textToken;
+    return string(getTextData(), getTextLength());
+}
+
+const char* Tokenizer::getTextData() const {
+    return textInStorage ? textStart : textToken.data();
+}
+
+size_t Tokenizer::getTextLength() const {
+    return textInStorage ? textLength : textToken.length();
 }
 
 int Tokenizer::readChar() {
-    int c = (int)in->get();
+    int c;
+    if (storage != nullptr)
+        c = bufferPos < bufferEnd ? (unsigned char)*bufferPos++ : char_traits<char>::eof();
+    else
+        c = (int)in->get();
+
     if (c == '\n')
         lineNum++;
 
     return c;
 }
 
+bool Tokenizer::atEnd() const {
+    if (storage != nullptr)
+        return nextChar == char_traits<char>::eof();
+    return in->eof();
+}
+
+// Add the current character, nextChar, to the token text.  In storage mode
+// the characters of a token are contiguous until an escape sequence, so only
+// the range needs to be tracked.
+void Tokenizer::appendText(char c) {
+    if (textInStorage) {
+        if (textLength == 0)
+            textStart = bufferPos - 1;
+        ++textLength;
+    } else {
+        textToken += c;
+    }
+}
+
+// Switch the current token over to a copied string, so that characters
+// which don't appear verbatim in the storage can be added.
+void Tokenizer::detachText() {
+    if (textInStorage) {
+        textToken.assign(textStart, textLength);
+        textInStorage = false;
+    }
+}
+
 void Tokenizer::syntaxError(const char* message) {
     cerr << message << '\n';
 }
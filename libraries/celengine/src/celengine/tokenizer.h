@@ -40,6 +40,10 @@ public:
     };
 
     Tokenizer(std::istream*);
+    // Tokenize the contents of a storage (typically a mapped file) directly.
+    // Names and strings without escapes are then referenced in place rather
+    // than copied character by character.
+    Tokenizer(const storage::StoragePointer&);
 
     TokenType nextToken();
     TokenType getTokenType();
@@ -47,6 +51,10 @@ public:
     double getNumberValue() const;
     std::string getNameValue() const;
     std::string getStringValue() const;
+    // The text of the current name or string token, valid until the next
+    // call to nextToken.  Doesn't allocate.
+    const char* getTextData() const;
+    size_t getTextLength() const;
 
     int getLineNumber() const;
 
@@ -69,6 +77,11 @@ private:
 
     std::istream* in;
 
+    // Storage mode: the remaining characters are [bufferPos, bufferEnd)
+    storage::StoragePointer storage;
+    const char* bufferPos{ nullptr };
+    const char* bufferEnd{ nullptr };
+
     int nextChar;
     TokenType tokenType;
     bool haveValidNumber;
@@ -81,11 +94,19 @@ private:
     bool pushedBack;
 
     int readChar();
+    bool atEnd() const;
+    void appendText(char);
+    void detachText();
     void syntaxError(const char*);
 
     double numberValue;
 
+    // Token text is either textToken or, in storage mode until an escape
+    // sequence forces a copy, a range of the storage.
     std::string textToken;
+    const char* textStart{ nullptr };
+    size_t textLength{ 0 };
+    bool textInStorage{ false };
 
     int lineNum;
 };
@@ -12,6 +12,8 @@
 #include <iostream>
 #include <fstream>
 #include <cassert>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #include <celutil/debug.h>
 #include <celutil/filetype.h>
@@ -48,6 +50,15 @@ string TrajectoryInfo::resolve(const string& baseDir) {
     return baseDir + "/" + source + uniquifyingSuffix;
 }
 
+// A binary trajectory beside the source is used unless the source has been
+// modified since it was written.
+static bool HaveCurrentBinaryTrajectory(const string& source, const string& binary) {
+    struct stat binaryStat, sourceStat;
+    if (stat(binary.c_str(), &binaryStat) != 0)
+        return false;
+    return stat(source.c_str(), &sourceStat) != 0 || sourceStat.st_mtime <= binaryStat.st_mtime;
+}
+
 Orbit::Pointer TrajectoryInfo::load(const string& filename) {
     // strip off the uniquifying suffix
     string::size_type uniquifyingSuffixStart = filename.rfind(UniqueSuffixChar);
@@ -58,6 +69,13 @@ Orbit::Pointer TrajectoryInfo::load(const string& filename) {
 
     Orbit::Pointer sampTrajectory;
 
+    string binaryFilename = BinaryTrajectoryFilename(strippedFilename);
+    if (HaveCurrentBinaryTrajectory(strippedFilename, binaryFilename)) {
+        sampTrajectory = LoadBinaryTrajectory(binaryFilename, interpolation);
+        if (sampTrajectory != nullptr)
+            return sampTrajectory;
+    }
+
     if (filetype == Content_CelestiaXYZVTrajectory) {
         switch (precision) {
             case TrajectoryPrecisionSingle:
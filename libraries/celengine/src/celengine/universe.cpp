@@ -137,53 +137,6 @@ bool Universe::isMarked(const Selection& sel, int priority) const {
     });
 }
 
-class ClosestStarFinder : public StarHandler {
-public:
-    ClosestStarFinder(float _maxDistance, const UniverseConstPtr& _universe);
-    ~ClosestStarFinder(){};
-    void process(const StarPtr& star, float distance, float appMag) override;
-
-public:
-    float maxDistance;
-    float closestDistance;
-    StarConstPtr closestStar;
-    UniverseConstPtr universe;
-    bool withPlanets;
-};
-
-ClosestStarFinder::ClosestStarFinder(float _maxDistance, const UniverseConstPtr& _universe) :
-    maxDistance(_maxDistance), closestDistance(_maxDistance), closestStar(NULL), universe(_universe), withPlanets(false) {
-}
-
-void ClosestStarFinder::process(const StarPtr& star, float distance, float) {
-    if (distance < closestDistance) {
-        if (!withPlanets || universe->getSolarSystem(std::static_pointer_cast<const Star>(star))) {
-            closestStar = star;
-            closestDistance = distance;
-        }
-    }
-}
-
-class NearStarFinder : public StarHandler {
-public:
-    NearStarFinder(float _maxDistance, vector<StarConstPtr>& nearStars);
-    ~NearStarFinder(){};
-    void process(const StarPtr& star, float distance, float appMag) override;
-
-private:
-    float maxDistance;
-    vector<StarConstPtr>& nearStars;
-};
-
-NearStarFinder::NearStarFinder(float _maxDistance, vector<StarConstPtr>& _nearStars) :
-    maxDistance(_maxDistance), nearStars(_nearStars) {
-}
-
-void NearStarFinder::process(const StarPtr& star, float distance, float) {
-    if (distance < maxDistance)
-        nearStars.push_back(star);
-}
-
 struct PlanetPickInfo {
     double sinAngle2Closest;
     double closestDistance;
@@ -784,7 +737,11 @@ Selection Universe::findPath(const string& s, Selection contexts[], int nContext
     return sel;
 }
 
-vector<string> Universe::getCompletion(const string& s, Selection* contexts, int nContexts, bool withLocations) {
+vector<string> Universe::getCompletion(const string& s,
+                                       Selection* contexts,
+                                       int nContexts,
+                                       bool withLocations,
+                                       size_t maxCount) {
     vector<string> completion;
     auto s_length = UTF8Length(s);
 
@@ -808,28 +765,37 @@ vector<string> Universe::getCompletion(const string& s, Selection* contexts, int
         }
     }
 
+    if (completion.size() >= maxCount) {
+        completion.resize(maxCount);
+        return completion;
+    }
+
     // Deep sky objects:
     if (dsoCatalog != NULL) {
-        vector<string> dsos = dsoCatalog->getCompletion(s);
+        vector<string> dsos = dsoCatalog->getCompletion(s, maxCount - completion.size());
         completion.insert(completion.end(), dsos.begin(), dsos.end());
     }
 
     // and finally stars;
-    if (starCatalog != NULL) {
-        vector<string> stars = starCatalog->getCompletion(s);
+    if (starCatalog != NULL && completion.size() < maxCount) {
+        vector<string> stars = starCatalog->getCompletion(s, maxCount - completion.size());
         completion.insert(completion.end(), stars.begin(), stars.end());
     }
 
     return completion;
 }
 
-vector<string> Universe::getCompletionPath(const string& s, Selection* contexts, int nContexts, bool withLocations) {
+vector<string> Universe::getCompletionPath(const string& s,
+                                           Selection* contexts,
+                                           int nContexts,
+                                           bool withLocations,
+                                           size_t maxCount) {
     vector<string> completion;
     vector<string> locationCompletion;
     string::size_type pos = s.rfind('/', s.length());
 
     if (pos == string::npos)
-        return getCompletion(s, contexts, nContexts, withLocations);
+        return getCompletion(s, contexts, nContexts, withLocations, maxCount);
 
     string base(s, 0, pos);
     Selection sel = findPath(base, contexts, nContexts, true);
@@ -865,6 +831,8 @@ vector<string> Universe::getCompletionPath(const string& s, Selection* contexts,
         completion = worlds->getCompletion(s.substr(pos + 1), false);
 
     completion.insert(completion.end(), locationCompletion.begin(), locationCompletion.end());
+    if (completion.size() > maxCount)
+        completion.resize(maxCount);
 
     return completion;
 }
@@ -873,14 +841,19 @@ vector<string> Universe::getCompletionPath(const string& s, Selection* contexts,
 // with in one light year.
 SolarSystemPtr Universe::getNearestSolarSystem(const UniversalCoord& position) const {
     Vector3f pos = position.toLy().cast<float>();
-    ClosestStarFinder closestFinder(1.0f, shared_from_this());
-    closestFinder.withPlanets = true;
-    starCatalog->findCloseStars(closestFinder, pos, 1.0f);
-    return getSolarSystem(closestFinder.closestStar);
+    SolarSystemPtr nearest;
+    starCatalog->processStarsByDistance(pos, 1.0f, [&](const StarPtr& star, float) {
+        nearest = getSolarSystem(std::static_pointer_cast<const Star>(star));
+        return nearest == NULL;
+    });
+    return nearest;
 }
 
+// Find the stars within maxDistance of position, nearest first.
 void Universe::getNearStars(const UniversalCoord& position, float maxDistance, vector<StarConstPtr>& nearStars) const {
     Vector3f pos = position.toLy().cast<float>();
-    NearStarFinder finder(1.0f, nearStars);
-    starCatalog->findCloseStars(finder, pos, maxDistance);
+    starCatalog->processStarsByDistance(pos, maxDistance, [&](const StarPtr& star, float) {
+        nearStars.push_back(star);
+        return true;
+    });
 }
@@ -52,14 +52,18 @@ public:
     Selection findChildObject(const Selection& sel, const std::string& name, bool i18n = false) const;
     Selection findObjectInContext(const Selection& sel, const std::string& name, bool i18n = false) const;
 
+    // At most maxCount completions: locations and solar system bodies of the
+    // contexts first, then deep sky objects, then stars.
     std::vector<std::string> getCompletion(const std::string& s,
                                            Selection* contexts = NULL,
                                            int nContexts = 0,
-                                           bool withLocations = false);
+                                           bool withLocations = false,
+                                           size_t maxCount = SIZE_MAX);
     std::vector<std::string> getCompletionPath(const std::string& s,
                                                Selection* contexts = NULL,
                                                int nContexts = 0,
-                                               bool withLocations = false);
+                                               bool withLocations = false,
+                                               size_t maxCount = SIZE_MAX);
 
     SolarSystemPtr getNearestSolarSystem(const UniversalCoord& position) const;
     SolarSystemPtr getSolarSystem(const StarPtr& star) const {
@@ -17,6 +17,7 @@
 #include <vector>
 #include <fstream>
 #include <iomanip>
+#include <stdexcept>
 
 using namespace Eigen;
 using namespace std;
@@ -2479,9 +2480,11 @@ Orbit::Pointer GetCustomOrbit(const string& name) {
     // Attempt to load JPL ephemeris data if we haven't tried already
     if (!jplephInitialized) {
         jplephInitialized = true;
-        ifstream in("data/jpleph.dat", ios::in | ios::binary);
-        if (in.good())
-            jpleph = JPLEphemeris::load(in);
+        // The file is mapped, so loading costs the same for any ephemeris size
+        try {
+            jpleph = JPLEphemeris::load(storage::Storage::readFile("data/jpleph.dat"));
+        } catch (const std::runtime_error&) {
+        }
         if (jpleph != NULL) {
             clog << "Loaded DE" << jpleph->getDENumber() << " ephemeris. Valid from JD" << setprecision(8)
                  << jpleph->getStartDate() << " to JD" << jpleph->getEndDate() << '\n';
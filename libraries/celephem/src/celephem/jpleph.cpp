@@ -7,15 +7,17 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 //
-// Load JPL's DE200, DE405, and DE406 ephemerides and compute planet
-// positions.
+// Load JPL's DE200, DE405, DE406, DE421, DE430 and DE440 ephemerides and
+// compute planet positions.
 
 #include "jpleph.h"
 
 #include <fstream>
 #include <iomanip>
+#include <iterator>
+#include <algorithm>
 #include <cstdio>
-#include <cassert>
+#include <cstring>
 #include <celutil/bytes.h>
 
 using namespace Eigen;
@@ -24,6 +26,8 @@ using namespace std;
 static const uint32_t DE200RecordSize = 826;
 static const uint32_t DE405RecordSize = 1018;
 static const uint32_t DE406RecordSize = 728;
+// DE421, DE430 and DE440 share the layout of DE405
+static const uint32_t DE4xxRecordSize = 1018;
 
 static const uint32_t NConstants = 400;
 static const uint32_t ConstantNameLength = 6;
@@ -32,26 +36,46 @@ static const uint32_t MaxChebyshevCoeffs = 32;
 
 static const int LabelSize = 84;
 
-// Read a big-endian 32-bit unsigned integer
-static int32_t readUint(istream& in) {
-    int32_t ret;
-    in.read((char*)&ret, sizeof(int32_t));
-    BE_TO_CPU_INT32(ret, ret);
-    return (uint32_t)ret;
+// Offsets of the fields of the first header record
+static const size_t StartDateOffset = LabelSize * 3 + NConstants * ConstantNameLength;
+static const size_t AUOffset = StartDateOffset + 3 * sizeof(double) + sizeof(uint32_t);
+static const size_t CoeffInfoOffset = AUOffset + 2 * sizeof(double);
+static const size_t DENumOffset = CoeffInfoOffset + JPLEph_NItems * 3 * sizeof(uint32_t);
+static const size_t LibrationOffset = DENumOffset + sizeof(uint32_t);
+
+// The two header records hold the same number of doubles as a data record
+static const uint32_t HeaderRecords = 2;
+
+// Read a 32-bit unsigned integer stored in the byte order of the file
+static uint32_t readUint(const uint8_t* data, bool swapBytes) {
+    uint32_t ret;
+    memcpy(&ret, data, sizeof(uint32_t));
+    return swapBytes ? bswap_32(ret) : ret;
 }
 
-// Read a big-endian 64-bit IEEE double--if the native double format isn't
-// IEEE 754, there will be troubles.
-static double readDouble(istream& in) {
+// Read a 64-bit IEEE double stored in the byte order of the file--if the
+// native double format isn't IEEE 754, there will be troubles.
+static double readDouble(const uint8_t* data, bool swapBytes) {
     double d;
-    in.read((char*)&d, sizeof(double));
-    BE_TO_CPU_DOUBLE(d, d);
-    return d;
+    memcpy(&d, data, sizeof(double));
+    return swapBytes ? bswap_double(d) : d;
 }
 
-JPLEphRecord::~JPLEphRecord() {
-    if (coeffs != NULL)
-        delete coeffs;
+static uint32_t recordSizeForDE(uint32_t DENum) {
+    switch (DENum) {
+        case 200:
+            return DE200RecordSize;
+        case 405:
+            return DE405RecordSize;
+        case 406:
+            return DE406RecordSize;
+        case 421:
+        case 430:
+        case 440:
+            return DE4xxRecordSize;
+        default:
+            return 0;
+    }
 }
 
 JPLEphemeris::JPLEphemeris() {
@@ -100,37 +124,47 @@ Vector3d JPLEphemeris::getPlanetPosition(JPLEphemItem planet, double tjd) const
         tjd = endDate;
 
     // recNo is always >= 0:
-    size_t recNo = (uint32_t)((tjd - startDate) / daysPerInterval);
-    // Make sure we don't go past the end of the array if t == endDate
-    if (recNo >= records.size())
-        recNo = records.size() - 1;
-    const JPLEphRecord* rec = &records[recNo];
+    uint32_t recNo = (uint32_t)((tjd - startDate) / daysPerInterval);
+    // Make sure we don't go past the last record if t == endDate
+    if (recNo >= nRecords)
+        recNo = nRecords - 1;
 
-    assert(coeffInfo[planet].nGranules >= 1);
-    assert(coeffInfo[planet].nGranules <= 32);
-    assert(coeffInfo[planet].nCoeffs <= MaxChebyshevCoeffs);
+    // A record starts with its start and end times, followed by the
+    // coefficients
+    const uint8_t* rec = file->data() + (size_t)(HeaderRecords + recNo) * recordSize * sizeof(double);
+    double t0 = readDouble(rec, swapBytes);
+    const uint8_t* recCoeffs = rec + 2 * sizeof(double);
 
     // u is the normalized time (in [-1, 1]) for interpolating
-    // coeffs is a pointer to the Chebyshev coefficients
+    // first is the index of the first Chebyshev coefficient in the record
     double u = 0.0;
-    double* coeffs = NULL;
+    uint32_t first = 0;
+    uint32_t nCoeffs = coeffInfo[planet].nCoeffs;
 
     // nGranules is uint32_t so it will be compared against FFFFFFFF:
     if (coeffInfo[planet].nGranules == (uint32_t)-1) {
-        coeffs = rec->coeffs + coeffInfo[planet].offset;
-        u = 2.0 * (tjd - rec->t0) / daysPerInterval - 1.0;
+        first = coeffInfo[planet].offset;
+        u = 2.0 * (tjd - t0) / daysPerInterval - 1.0;
     } else {
         double daysPerGranule = daysPerInterval / coeffInfo[planet].nGranules;
-        int granule = (int)((tjd - rec->t0) / daysPerGranule);
-        double granuleStartDate = rec->t0 + daysPerGranule * (double)granule;
-        coeffs = rec->coeffs + coeffInfo[planet].offset + granule * coeffInfo[planet].nCoeffs * 3;
+        uint32_t granule = (uint32_t)max(0.0, (tjd - t0) / daysPerGranule);
+        // tjd may be the end of the last record
+        if (granule >= coeffInfo[planet].nGranules)
+            granule = coeffInfo[planet].nGranules - 1;
+        double granuleStartDate = t0 + daysPerGranule * (double)granule;
+        first = coeffInfo[planet].offset + granule * nCoeffs * 3;
         u = 2.0 * (tjd - granuleStartDate) / daysPerGranule - 1.0;
     }
 
+    // Only the coefficients needed are read out of the record, converting
+    // them to the CPU byte order on the way.
+    double coeffs[MaxChebyshevCoeffs * 3];
+    for (uint32_t i = 0; i < nCoeffs * 3; i++)
+        coeffs[i] = readDouble(recCoeffs + (size_t)(first + i) * sizeof(double), swapBytes);
+
     // Evaluate the Chebyshev polynomials
     double sum[3];
     double cc[MaxChebyshevCoeffs];
-    uint32_t nCoeffs = coeffInfo[planet].nCoeffs;
     for (int i = 0; i < 3; i++) {
         cc[0] = 1.0;
         cc[1] = u;
@@ -145,91 +179,74 @@ Vector3d JPLEphemeris::getPlanetPosition(JPLEphemItem planet, double tjd) const
 }
 
 JPLEphemeris::Pointer JPLEphemeris::load(istream& in) {
-    JPLEphemeris::Pointer eph = std::make_shared<JPLEphemeris>();
+    vector<uint8_t> data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    return load(storage::Storage::create(data.size(), data.data()));
+}
 
-    // Skip past three header labels
-    in.ignore(LabelSize * 3);
-    if (!in.good())
+/*! Load an ephemeris from a (typically mapped) file. Only the header is
+ *  read and checked here; the Chebyshev coefficients are read straight from
+ *  the file by getPlanetPosition. Files in either byte order are accepted.
+ */
+JPLEphemeris::Pointer JPLEphemeris::load(const storage::StoragePointer& file) {
+    if (file == nullptr || file->size() < LibrationOffset + 3 * sizeof(uint32_t))
         return NULL;
+    const uint8_t* header = file->data();
 
-    // Skip past the constant names
-    in.ignore(NConstants * ConstantNameLength);
-    if (!in.good())
+    JPLEphemeris::Pointer eph = std::make_shared<JPLEphemeris>();
+    eph->file = file;
+
+    // The files were originally big-endian, but are now distributed in both
+    // byte orders; the ephemeris number tells which one this is.
+    eph->swapBytes = false;
+    eph->DENum = readUint(header + DENumOffset, false);
+    if (recordSizeForDE(eph->DENum) == 0) {
+        eph->swapBytes = true;
+        eph->DENum = readUint(header + DENumOffset, true);
+    }
+    eph->recordSize = recordSizeForDE(eph->DENum);
+    if (eph->recordSize == 0)
         return NULL;
+    bool swapBytes = eph->swapBytes;
 
     // Read the start time, end time, and time interval
-    eph->startDate = readDouble(in);
-    eph->endDate = readDouble(in);
-    eph->daysPerInterval = readDouble(in);
-    if (!in.good()) {
+    eph->startDate = readDouble(header + StartDateOffset, swapBytes);
+    eph->endDate = readDouble(header + StartDateOffset + sizeof(double), swapBytes);
+    eph->daysPerInterval = readDouble(header + StartDateOffset + 2 * sizeof(double), swapBytes);
+    if (!(eph->daysPerInterval > 0.0) || !(eph->endDate > eph->startDate))
         return NULL;
-    }
 
-    // Number of constants with valid values; not useful for us
-    (void)readUint(in);
-
-    eph->au = readDouble(in);  // kilometers per astronomical unit
-    eph->earthMoonMassRatio = readDouble(in);
-
-    // Read the coefficient information for each item in the ephemeris
-    uint32_t i;
-    for (i = 0; i < JPLEph_NItems; i++) {
-        eph->coeffInfo[i].offset = readUint(in) - 3;
-        eph->coeffInfo[i].nCoeffs = readUint(in);
-        eph->coeffInfo[i].nGranules = readUint(in);
-    }
-    if (!in.good()) {
-        return NULL;
-    }
-
-    eph->DENum = readUint(in);
-
-    switch (eph->DENum) {
-        case 200:
-            eph->recordSize = DE200RecordSize;
-            break;
-        case 405:
-            eph->recordSize = DE405RecordSize;
-            break;
-        case 406:
-            eph->recordSize = DE406RecordSize;
-            break;
-        default:
+    eph->au = readDouble(header + AUOffset, swapBytes);  // kilometers per astronomical unit
+    eph->earthMoonMassRatio = readDouble(header + AUOffset + sizeof(double), swapBytes);
+
+    // Read the coefficient information for each item in the ephemeris, and
+    // make sure that every item lies within a record
+    const uint8_t* info = header + CoeffInfoOffset;
+    for (uint32_t i = 0; i < JPLEph_NItems; i++, info += 3 * sizeof(uint32_t)) {
+        JPLEphCoeffInfo& item = eph->coeffInfo[i];
+        item.offset = readUint(info, swapBytes) - 3;
+        item.nCoeffs = readUint(info + sizeof(uint32_t), swapBytes);
+        item.nGranules = readUint(info + 2 * sizeof(uint32_t), swapBytes);
+
+        // The twelfth item of the file is the nutations, which are unused;
+        // the Earth is derived from the Earth-Moon barycenter and the Moon.
+        if (i == JPLEph_Earth)
+            continue;
+        uint64_t nGranules = item.nGranules == (uint32_t)-1 ? 1 : item.nGranules;
+        if (item.nCoeffs < 2 || item.nCoeffs > MaxChebyshevCoeffs || nGranules < 1 || nGranules > 32 ||
+            (uint64_t)item.offset + nGranules * item.nCoeffs * 3 > eph->recordSize - 2)
             return NULL;
     }
 
-    eph->librationCoeffInfo.offset = readUint(in);
-    eph->librationCoeffInfo.nCoeffs = readUint(in);
-    eph->librationCoeffInfo.nGranules = readUint(in);
-    if (!in.good()) {
-        return NULL;
-    }
+    eph->librationCoeffInfo.offset = readUint(header + LibrationOffset, swapBytes);
+    eph->librationCoeffInfo.nCoeffs = readUint(header + LibrationOffset + sizeof(uint32_t), swapBytes);
+    eph->librationCoeffInfo.nGranules = readUint(header + LibrationOffset + 2 * sizeof(uint32_t), swapBytes);
 
-    // Skip past the rest of the record
-    in.ignore(eph->recordSize * 8 - 2856);
-    // The next record contains constant values (which we don't need)
-    in.ignore(eph->recordSize * 8);
-    if (!in.good()) {
+    // The second header record contains constant values (which we don't
+    // need); the data records follow it.
+    eph->nRecords = (uint32_t)((eph->endDate - eph->startDate) / eph->daysPerInterval);
+    size_t recordBytes = (size_t)eph->recordSize * sizeof(double);
+    if (eph->nRecords == 0 || file->size() / recordBytes < (size_t)HeaderRecords + eph->nRecords)
         return NULL;
-    }
-
-    uint32_t nRecords = (uint32_t)((eph->endDate - eph->startDate) / eph->daysPerInterval);
-    eph->records.resize(nRecords);
-    for (i = 0; i < nRecords; i++) {
-        eph->records[i].t0 = readDouble(in);
-        eph->records[i].t1 = readDouble(in);
-
-        // Allocate coefficient array for this record; the first two
-        // 'coefficients' are actually the start and end time (t0 and t1)
-        eph->records[i].coeffs = new double[eph->recordSize - 2];
-        for (uint32_t j = 0; j < eph->recordSize - 2; j++)
-            eph->records[i].coeffs[j] = readDouble(in);
-
-        // Make sure that we read this record successfully
-        if (!in.good()) {
-            return NULL;
-        }
-    }
 
     return eph;
 }
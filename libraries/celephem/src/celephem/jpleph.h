@@ -7,8 +7,8 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 //
-// Load JPL's DE200, DE405, and DE406 ephemerides and compute planet
-// positions.
+// Load JPL's DE200, DE405, DE406, DE421, DE430 and DE440 ephemerides and
+// compute planet positions.
 
 #ifndef _CELENGINE_JPLEPH_H_
 #define _CELENGINE_JPLEPH_H_
@@ -17,6 +17,7 @@
 #include <vector>
 #include <memory>
 #include <Eigen/Core>
+#include <celutil/storage.hpp>
 
 enum JPLEphemItem
 {
@@ -46,17 +47,6 @@ struct JPLEphCoeffInfo
 };
 
 
-struct JPLEphRecord
-{
-    JPLEphRecord() : coeffs(NULL) {};
-    ~JPLEphRecord();
-
-    double t0;
-    double t1;
-    double* coeffs;
-};
-
-
 class JPLEphemeris
 {
 private:
@@ -69,6 +59,7 @@ public:
     Eigen::Vector3d getPlanetPosition(JPLEphemItem, double t) const;
 
     static Pointer load(std::istream&);
+    static Pointer load(const storage::StoragePointer&);
 
     uint32_t getDENumber() const;
     double getStartDate() const;
@@ -87,8 +78,11 @@ private:
 
     uint32_t DENum;       // ephemeris version
     uint32_t recordSize;  // number of doubles per record
+    uint32_t nRecords;
+    bool swapBytes;       // file byte order differs from the CPU's
 
-    std::vector<JPLEphRecord> records;
+    // The records are read from the file as they are needed
+    storage::StoragePointer file;
 };
 
 #endif // _CELENGINE_JPLEPH_H_
@@ -30,6 +30,15 @@ static Vector3d cubicInterpolate(const Vector3d& p0, const Vector3d& v0, const V
     return p0 + (((2.0 * (p0 - p1) + v1 + v0) * (t * t * t)) + ((3.0 * (p1 - p0) - 2.0 * v0 - v1) * (t * t)) + (v0 * t));
 }
 
+void Orbit::statesAtTimes(const double* jds, size_t count, Vector3d* positions, Vector3d* velocities) const {
+    for (size_t i = 0; i < count; i++) {
+        if (positions != nullptr)
+            positions[i] = positionAtTime(jds[i]);
+        if (velocities != nullptr)
+            velocities[i] = velocityAtTime(jds[i]);
+    }
+}
+
 /** Sample the orbit over the time range [ startTime, endTime ] using the
   * default sampling parameters for the orbit type.
   *
@@ -80,58 +89,52 @@ void Orbit::adaptiveSample(double startTime,
     double t = startTime;
     const double stepFactor = 1.25;
 
-    Vector3d lastP = positionAtTime(t);
-    Vector3d lastV = velocityAtTime(t);
+    Vector3d lastP;
+    Vector3d lastV;
+    statesAtTimes(&t, 1, &lastP, &lastV);
     proc(t, lastP, lastV);
     int sampCount = 0;
     int nTests = 0;
 
+    // Each trial step evaluates the midpoint and the end of the step
+    // together, in increasing time order. The end velocity is requested
+    // last so that caching orbits can reuse the end position for it.
+    double times[2];
+    Vector3d positions[2];
+    Vector3d p1;
+    Vector3d v1;
+    auto interpolationError = [&](double dt) {
+        times[0] = t + dt / 2.0;
+        times[1] = t + dt;
+        statesAtTimes(times, 2, positions, nullptr);
+        p1 = positions[1];
+        v1 = velocityAtTime(times[1]);
+        nTests++;
+
+        Vector3d pInterp = cubicInterpolate(lastP, lastV * dt, p1, v1 * dt, 0.5);
+        return (pInterp - positions[0]).norm();
+    };
+
     while (t < endTime) {
         // Make sure that we don't go past the end of the sample interval
         maxStepSize = min(maxStepSize, endTime - t);
         double dt = min(maxStepSize, startStepSize * 2.0);
 
-        Vector3d p1 = positionAtTime(t + dt);
-        Vector3d v1 = velocityAtTime(t + dt);
-
-        double tmid = t + dt / 2.0;
-        Vector3d pTest = positionAtTime(tmid);
-        Vector3d pInterp = cubicInterpolate(lastP, lastV * dt, p1, v1 * dt, 0.5);
-        nTests++;
-
-        double positionError = (pInterp - pTest).norm();
+        double positionError = interpolationError(dt);
 
         // Error is greater than tolerance; decrease the step until the
         // error is within the tolerance.
         if (positionError > tolerance) {
             while (positionError > tolerance && dt > minStepSize) {
                 dt /= stepFactor;
-
-                p1 = positionAtTime(t + dt);
-                v1 = velocityAtTime(t + dt);
-
-                tmid = t + dt / 2.0;
-                pTest = positionAtTime(tmid);
-                pInterp = cubicInterpolate(lastP, lastV * dt, p1, v1 * dt, 0.5);
-                nTests++;
-
-                positionError = (pInterp - pTest).norm();
+                positionError = interpolationError(dt);
             }
         } else {
             // Error is less than the tolerance; increase the step size until the
             // tolerance is just exceeded.
             while (positionError < tolerance && dt < maxStepSize) {
                 dt *= stepFactor;
-
-                p1 = positionAtTime(t + dt);
-                v1 = velocityAtTime(t + dt);
-
-                tmid = t + dt / 2.0;
-                pTest = positionAtTime(tmid);
-                pInterp = cubicInterpolate(lastP, lastV * dt, p1, v1 * dt, 0.5);
-                nTests++;
-
-                positionError = (pInterp - pTest).norm();
+                positionError = interpolationError(dt);
             }
         }
 
@@ -371,38 +374,47 @@ double EllipticalOrbit::getBoundingRadius() const {
     return pericenterDistance * ((1.0 + eccentricity) / (1.0 - eccentricity));
 }
 
-CachingOrbit::CachingOrbit() : lastTime(-1.0e30), positionCacheValid(false), velocityCacheValid(false) {
+CachingOrbit::CachingOrbit() {
 }
 
 CachingOrbit::~CachingOrbit() {
 }
 
-Vector3d CachingOrbit::positionAtTime(double jd) const {
-    if (jd != lastTime) {
-        lastTime = jd;
-        lastPosition = computePosition(jd);
-        positionCacheValid = true;
-        velocityCacheValid = false;
-    } else if (!positionCacheValid) {
-        lastPosition = computePosition(jd);
-        positionCacheValid = true;
-    }
+TimeCacheStatistics& CachingOrbit::getCacheStatistics() {
+    static TimeCacheStatistics statistics;
+    return statistics;
+}
 
-    return lastPosition;
+Vector3d CachingOrbit::positionAtTime(double jd) const {
+    Vector3d position;
+    if (cache.find(jd, getCacheStatistics(), [&](const CacheEntry& e) {
+            position = e.position;
+            return e.positionValid;
+        }))
+        return position;
+
+    position = computePosition(jd);
+    cache.store(jd, [&](CacheEntry& e) {
+        e.position = position;
+        e.positionValid = true;
+    });
+    return position;
 }
 
 Vector3d CachingOrbit::velocityAtTime(double jd) const {
-    if (jd != lastTime) {
-        lastVelocity = computeVelocity(jd);
-        lastTime = jd;  // must be set *after* call to computeVelocity
-        positionCacheValid = false;
-        velocityCacheValid = true;
-    } else if (!velocityCacheValid) {
-        lastVelocity = computeVelocity(jd);
-        velocityCacheValid = true;
-    }
+    Vector3d velocity;
+    if (cache.find(jd, getCacheStatistics(), [&](const CacheEntry& e) {
+            velocity = e.velocity;
+            return e.velocityValid;
+        }))
+        return velocity;
 
-    return lastVelocity;
+    velocity = computeVelocity(jd);
+    cache.store(jd, [&](CacheEntry& e) {
+        e.velocity = velocity;
+        e.velocityValid = true;
+    });
+    return velocity;
 }
 
 /*! Calculate the velocity at the specified time (units are
@@ -535,6 +547,27 @@ void MixedOrbit::sample(double startTime, double endTime, const OrbitSampleProc&
     o->sample(startTime, endTime, proc);
 }
 
+// Runs of times within the span of the primary orbit are passed on to it
+// whole.
+void MixedOrbit::statesAtTimes(const double* jds, size_t count, Vector3d* positions, Vector3d* velocities) const {
+    size_t i = 0;
+    while (i < count) {
+        size_t j = i;
+        while (j < count && jds[j] >= begin && jds[j] < end)
+            j++;
+
+        if (j == i) {
+            Orbit::statesAtTimes(jds + i, 1, positions != nullptr ? positions + i : nullptr,
+                                 velocities != nullptr ? velocities + i : nullptr);
+            j = i + 1;
+        } else {
+            primary->statesAtTimes(jds + i, j - i, positions != nullptr ? positions + i : nullptr,
+                                   velocities != nullptr ? velocities + i : nullptr);
+        }
+        i = j;
+    }
+}
+
 /*** FixedOrbit ***/
 
 FixedOrbit::FixedOrbit(const Vector3d& pos) : position(pos) {
@@ -10,10 +10,12 @@
 #ifndef _CELENGINE_ORBIT_H_
 #define _CELENGINE_ORBIT_H_
 
+#include <cstddef>
 #include <functional>
 #include <memory>
 
 #include <Eigen/Core>
+#include <celutil/timecache.h>
 
 using OrbitSampleProc = std::function<void(double t, const Eigen::Vector3d& position, const Eigen::Vector3d& velocity)>;
 
@@ -34,6 +36,17 @@ public:
      */
     virtual Eigen::Vector3d velocityAtTime(double) const;
 
+    /*! Compute the positions and velocities at count times; either output
+     * array may be null. Trajectories backed by tables walk them in a single
+     * pass when the times are in increasing order, so evaluating a whole
+     * run of times costs little more than one lookup. The default
+     * implementation calls positionAtTime and velocityAtTime for each time.
+     */
+    virtual void statesAtTimes(const double* jds,
+                               size_t count,
+                               Eigen::Vector3d* positions,
+                               Eigen::Vector3d* velocities) const;
+
     virtual double getPeriod() const = 0;
     virtual double getBoundingRadius() const = 0;
 
@@ -94,8 +107,8 @@ private:
  * orbits can be expensive to compute, with more than 50 periodic terms.
  * Celestia may need require position of a planet more than once per frame; in
  * order to avoid redundant calculation, the CachingOrbit class saves the
- * result of the last calculation and uses it if the time matches the cached
- * time.
+ * results for the last few times and uses them if the time matches a cached
+ * time. Several threads may query the same orbit at once.
  */
 class CachingOrbit : public Orbit {
 public:
@@ -110,12 +123,18 @@ public:
     Eigen::Vector3d positionAtTime(double jd) const override final;
     Eigen::Vector3d velocityAtTime(double jd) const override final;
 
+    // Hits and misses of all caching orbits while profiling
+    static TimeCacheStatistics& getCacheStatistics();
+
 private:
-    mutable Eigen::Vector3d lastPosition;
-    mutable Eigen::Vector3d lastVelocity;
-    mutable double lastTime;
-    mutable bool positionCacheValid;
-    mutable bool velocityCacheValid;
+    struct CacheEntry {
+        Eigen::Vector3d position;
+        Eigen::Vector3d velocity;
+        bool positionValid{ false };
+        bool velocityValid{ false };
+    };
+
+    TimeCache<CacheEntry> cache;
 };
 
 /*! A mixed orbit is a composite orbit, typically used when you have a
@@ -134,6 +153,10 @@ public:
     double getPeriod() const override;
     double getBoundingRadius() const override;
     void sample(double startTime, double endTime, const OrbitSampleProc& proc) const override;
+    void statesAtTimes(const double* jds,
+                       size_t count,
+                       Eigen::Vector3d* positions,
+                       Eigen::Vector3d* velocities) const override;
 
 private:
     Orbit::Pointer primary;
@@ -59,11 +59,7 @@ RotationModel::angularVelocityAtTime(double tdb) const
 
 /***** CachingRotationModel *****/
 
-CachingRotationModel::CachingRotationModel() :
-    lastTime(365.0),
-    spinCacheValid(false),
-    equatorCacheValid(false),
-    angularVelocityCacheValid(false)
+CachingRotationModel::CachingRotationModel()
 {
 }
 
@@ -73,66 +69,68 @@ CachingRotationModel::~CachingRotationModel()
 }
 
 
+TimeCacheStatistics&
+CachingRotationModel::getCacheStatistics()
+{
+    static TimeCacheStatistics statistics;
+    return statistics;
+}
+
+
 Quaterniond
 CachingRotationModel::spin(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastTime = tjd;
-        lastSpin = computeSpin(tjd);
-        spinCacheValid = true;
-        equatorCacheValid = false;
-        angularVelocityCacheValid = false;
-    }
-    else if (!spinCacheValid)
-    {
-        lastSpin = computeSpin(tjd);
-        spinCacheValid = true;
-    }
-    
-    return lastSpin;
+    Quaterniond q;
+    if (cache.find(tjd, getCacheStatistics(), [&](const CacheEntry& e) {
+            q = e.spin;
+            return e.spinValid;
+        }))
+        return q;
+
+    q = computeSpin(tjd);
+    cache.store(tjd, [&](CacheEntry& e) {
+        e.spin = q;
+        e.spinValid = true;
+    });
+    return q;
 }
 
 
 Quaterniond
 CachingRotationModel::equatorOrientationAtTime(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastTime = tjd;
-        lastEquator = computeEquatorOrientation(tjd);
-        spinCacheValid = false;
-        equatorCacheValid = true;
-        angularVelocityCacheValid = false;
-    }
-    else if (!equatorCacheValid)
-    {
-        lastEquator = computeEquatorOrientation(tjd);
-        equatorCacheValid = true;
-    }
-    
-    return lastEquator;    
+    Quaterniond q;
+    if (cache.find(tjd, getCacheStatistics(), [&](const CacheEntry& e) {
+            q = e.equator;
+            return e.equatorValid;
+        }))
+        return q;
+
+    q = computeEquatorOrientation(tjd);
+    cache.store(tjd, [&](CacheEntry& e) {
+        e.equator = q;
+        e.equatorValid = true;
+    });
+    return q;
 }
 
 
 Vector3d
 CachingRotationModel::angularVelocityAtTime(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        lastTime = tjd;
-        spinCacheValid = false;
-        equatorCacheValid = false;
-        angularVelocityCacheValid = true;
-    }
-    else if (!angularVelocityCacheValid)
-    {
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        angularVelocityCacheValid = true;
-    }
-    
-    return lastAngularVelocity;    
+    Vector3d w;
+    if (cache.find(tjd, getCacheStatistics(), [&](const CacheEntry& e) {
+            w = e.angularVelocity;
+            return e.angularVelocityValid;
+        }))
+        return w;
+
+    w = computeAngularVelocity(tjd);
+    cache.store(tjd, [&](CacheEntry& e) {
+        e.angularVelocity = w;
+        e.angularVelocityValid = true;
+    });
+    return w;
 }
 
 
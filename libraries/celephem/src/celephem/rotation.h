@@ -13,6 +13,7 @@
 
 #include <memory>
 #include <Eigen/Geometry>
+#include <celutil/timecache.h>
 
 /*! A RotationModel object describes the orientation of an object
  *  over some time range.
@@ -76,9 +77,10 @@ class RotationModel
 
 
 /*! CachingRotationModel is an abstract base class for complicated rotation
- *  models that are computationally expensive. The last calculated spin,
- *  equator orientation, and angular velocity are all cached and reused in
- *  order to avoid redundant calculation. Subclasses must override computeSpin(),
+ *  models that are computationally expensive. The spin, equator orientation,
+ *  and angular velocity calculated for the last few times are all cached
+ *  and reused in order to avoid redundant calculation; the cache may be used
+ *  from several threads at once. Subclasses must override computeSpin(),
  *  computeEquatorOrientation(), and getPeriod(). The default implementation
  *  of computeAngularVelocity uses differentiation to approximate the
  *  the instantaneous angular velocity. It may be overridden if there is some
@@ -102,15 +104,22 @@ class CachingRotationModel : public RotationModel
     virtual Eigen::Vector3d computeAngularVelocity(double tjd) const;
     virtual double getPeriod() const = 0;
     virtual bool isPeriodic() const = 0;
-    
+
+    // Hits and misses of all caching rotation models while profiling
+    static TimeCacheStatistics& getCacheStatistics();
+
 private:
-    mutable Eigen::Quaterniond lastSpin;
-    mutable Eigen::Quaterniond lastEquator;
-    mutable Eigen::Vector3d lastAngularVelocity;
-    mutable double lastTime;
-    mutable bool spinCacheValid;
-    mutable bool equatorCacheValid;
-    mutable bool angularVelocityCacheValid;
+    struct CacheEntry
+    {
+        Eigen::Quaterniond spin;
+        Eigen::Quaterniond equator;
+        Eigen::Vector3d angularVelocity;
+        bool spinValid{ false };
+        bool equatorValid{ false };
+        bool angularVelocityValid{ false };
+    };
+
+    TimeCache<CacheEntry> cache;
 };
 
 
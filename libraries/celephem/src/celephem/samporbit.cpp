@@ -14,13 +14,17 @@
 #include "samporbit.h"
 #include <celastro/astro.h>
 #include <celmath/mathlib.h>
+#include <celutil/storage.hpp>
 #include <cmath>
+#include <cstring>
 #include <string>
 #include <algorithm>
 #include <vector>
 #include <iostream>
 #include <fstream>
 #include <limits>
+#include <atomic>
+#include <mutex>
 #include <iomanip>
 
 using namespace Eigen;
@@ -48,6 +52,11 @@ struct SampleXYZV {
     Eigen::Matrix<T, 3, 1> velocity;
 };
 
+// Binary trajectories store the samples exactly as they are laid out in
+// memory, so that they can be used straight from the mapped file.
+static_assert(sizeof(Sample<float>) == 24 && sizeof(Sample<double>) == 32, "Unexpected sample layout");
+static_assert(sizeof(SampleXYZV<float>) == 32 && sizeof(SampleXYZV<double>) == 56, "Unexpected sample layout");
+
 template <typename T>
 bool operator<(const Sample<T>& a, const Sample<T>& b) {
     return a.t < b.t;
@@ -58,6 +67,109 @@ bool operator<(const SampleXYZV<T>& a, const SampleXYZV<T>& b) {
     return a.t < b.t;
 }
 
+// Finds the segment holding a given time without searching the whole
+// trajectory. The time span is cut into equal buckets, each of which
+// remembers the first sample at or after its start, so a lookup only has
+// to search the few samples of one bucket. The index is built on first use
+// and is safe to share between threads; reset() must be called if the
+// samples change.
+class SampleTimeIndex {
+public:
+    SampleTimeIndex() = default;
+    SampleTimeIndex(const SampleTimeIndex&) = delete;
+    SampleTimeIndex& operator=(const SampleTimeIndex&) = delete;
+
+    void reset() {
+        buckets.clear();
+        built.store(false);
+    }
+
+    // Return the index of the first sample at or after jd, as lower_bound
+    // would, or count if there is none.
+    template <typename S>
+    size_t find(const S* samples, size_t count, double jd) const;
+
+    // Same as above, but first try the segment found by a previous lookup
+    // and the ones just after it, which is where increasing times land.
+    template <typename S>
+    size_t find(const S* samples, size_t count, double jd, size_t hint) const;
+
+private:
+    template <typename S>
+    void build(const S* samples, size_t count) const;
+
+    mutable std::mutex mutex;
+    mutable std::atomic<bool> built{ false };
+    mutable vector<uint32_t> buckets;
+    mutable double startTime{ 0.0 };
+    mutable double bucketsPerDay{ 0.0 };
+};
+
+template <typename S>
+void SampleTimeIndex::build(const S* samples, size_t count) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (built.load(std::memory_order_relaxed))
+        return;
+
+    buckets.clear();
+    double span = samples[count - 1].t - samples[0].t;
+    if (count <= numeric_limits<uint32_t>::max() && span > 0.0) {
+        // Two samples per bucket on average
+        size_t bucketCount = max((size_t)1, count / 2);
+        startTime = samples[0].t;
+        bucketsPerDay = (double)bucketCount / span;
+        buckets.resize(bucketCount);
+
+        size_t n = 0;
+        for (size_t b = 0; b < bucketCount; b++) {
+            double bucketStart = startTime + (double)b / bucketsPerDay;
+            while (n < count && samples[n].t < bucketStart)
+                n++;
+            buckets[b] = (uint32_t)n;
+        }
+    }
+
+    built.store(true, std::memory_order_release);
+}
+
+template <typename S>
+size_t SampleTimeIndex::find(const S* samples, size_t count, double jd) const {
+    auto before = [](const S& s, double t) { return s.t < t; };
+
+    if (count == 0 || !(jd > samples[0].t))
+        return 0;
+    if (jd > samples[count - 1].t)
+        return count;
+
+    if (!built.load(std::memory_order_acquire))
+        build(samples, count);
+
+    if (!buckets.empty()) {
+        size_t b = min((size_t)((jd - startTime) * bucketsPerDay), buckets.size() - 1);
+        size_t first = buckets[b];
+        size_t last = b + 1 < buckets.size() ? min((size_t)buckets[b + 1], count - 1) : count - 1;
+        size_t n = lower_bound(samples + first, samples + last + 1, jd, before) - samples;
+
+        // Rounding may place jd just outside of the bucket it was mapped to
+        if (n < count && samples[n].t >= jd && (n == 0 || samples[n - 1].t < jd))
+            return n;
+    }
+
+    return lower_bound(samples, samples + count, jd, before) - samples;
+}
+
+template <typename S>
+size_t SampleTimeIndex::find(const S* samples, size_t count, double jd, size_t hint) const {
+    if (hint > 0 && hint < count && samples[hint - 1].t < jd) {
+        for (size_t n = hint; n < count && n < hint + 4; n++) {
+            if (samples[n].t >= jd)
+                return n;
+        }
+    }
+
+    return find(samples, count, jd);
+}
+
 template <typename T>
 class SampledOrbit : public CachingOrbit {
 public:
@@ -65,6 +177,11 @@ public:
     virtual ~SampledOrbit();
 
     void addSample(double t, double x, double y, double z);
+    // Use samples held in storage, such as a mapped binary trajectory,
+    // instead of added ones.
+    void setSamples(const storage::StoragePointer&, const Sample<T>* samples, size_t count, double boundingRadius);
+    const Sample<T>* getSamples() const { return samples; }
+    size_t getSampleCount() const { return sampleCount; }
     void setPeriod();
 
     double getPeriod() const override;
@@ -76,12 +193,21 @@ public:
     void getValidRange(double& begin, double& end) const override;
 
     void sample(double startTime, double endTime, const OrbitSampleProc& proc) const override;
+    void statesAtTimes(const double* jds, size_t count, Vector3d* positions, Vector3d* velocities) const override;
 
 private:
-    vector<Sample<T>> samples;
+    // Evaluate the trajectory at jd, which lies before sample n and at or
+    // after sample n - 1
+    Vector3d interpolatePosition(size_t n, double jd) const;
+    Vector3d interpolateVelocity(size_t n, double jd) const;
+
+    vector<Sample<T>> ownedSamples;
+    storage::StoragePointer storage;
+    const Sample<T>* samples{ nullptr };
+    size_t sampleCount{ 0 };
     double boundingRadius{ 0 };
     double period{ 1 };
-    mutable size_t lastSample{ 0 };
+    SampleTimeIndex index;
 
     const TrajectoryInterpolation interpolation;
 };
@@ -100,17 +226,33 @@ void SampledOrbit<T>::addSample(double t, double x, double y, double z) {
     if (r > boundingRadius)
         boundingRadius = r;
 
-    Sample<T> samp;
+    Sample<T> samp{};
     samp.x = (T)x;
     samp.y = (T)y;
     samp.z = (T)z;
     samp.t = t;
-    samples.insert(samples.end(), samp);
+    ownedSamples.push_back(samp);
+    samples = ownedSamples.data();
+    sampleCount = ownedSamples.size();
+    index.reset();
+}
+
+template <typename T>
+void SampledOrbit<T>::setSamples(const storage::StoragePointer& _storage,
+                                 const Sample<T>* _samples,
+                                 size_t count,
+                                 double radius) {
+    ownedSamples.clear();
+    storage = _storage;
+    samples = _samples;
+    sampleCount = count;
+    boundingRadius = radius;
+    index.reset();
 }
 
 template <typename T>
 double SampledOrbit<T>::getPeriod() const {
-    return samples[samples.size() - 1].t - samples[0].t;
+    return samples[sampleCount - 1].t - samples[0].t;
 }
 
 template <typename T>
@@ -121,7 +263,7 @@ bool SampledOrbit<T>::isPeriodic() const {
 template <typename T>
 void SampledOrbit<T>::getValidRange(double& begin, double& end) const {
     begin = samples[0].t;
-    end = samples[samples.size() - 1].t;
+    end = samples[sampleCount - 1].t;
 }
 
 template <typename T>
@@ -142,85 +284,68 @@ static Vector3d cubicInterpolateVelocity(const Vector3d& p0,
 }
 
 template <typename T>
-Vector3d SampledOrbit<T>::computePosition(double jd) const {
+Vector3d SampledOrbit<T>::interpolatePosition(size_t n, double jd) const {
     Vector3d pos;
-    if (samples.size() == 0) {
+    if (sampleCount == 0) {
         pos = Vector3d::Zero();
-    } else if (samples.size() == 1) {
-        pos = Vector3d(samples[0].x, samples[0].y, samples[0].z);
-    } else {
-        Sample<T> samp;
-        samp.t = jd;
-        size_t n = lastSample;
-
-        if (n < 1 || n >= (int)samples.size() || jd < samples[n - 1].t || jd > samples[n].t) {
-            auto iter = lower_bound(samples.begin(), samples.end(), samp);
-            if (iter == samples.end())
-                n = samples.size();
+    } else if (n == 0) {
+        pos = Vector3d(samples[n].x, samples[n].y, samples[n].z);
+    } else if (n < sampleCount) {
+        if (interpolation == TrajectoryInterpolationLinear) {
+            Sample<T> s0 = samples[n - 1];
+            Sample<T> s1 = samples[n];
+
+            double t = (jd - s0.t) / (s1.t - s0.t);
+            pos = Vector3d(Mathd::lerp(t, (double)s0.x, (double)s1.x), Mathd::lerp(t, (double)s0.y, (double)s1.y),
+                           Mathd::lerp(t, (double)s0.z, (double)s1.z));
+        } else if (interpolation == TrajectoryInterpolationCubic) {
+            Sample<T> s0, s1, s2, s3;
+            if (n > 1)
+                s0 = samples[n - 2];
             else
-                n = iter - samples.begin();
-            lastSample = n;
-        }
-
-        if (n == 0) {
-            pos = Vector3d(samples[n].x, samples[n].y, samples[n].z);
-        } else if (n < (int)samples.size()) {
-            if (interpolation == TrajectoryInterpolationLinear) {
-                Sample<T> s0 = samples[n - 1];
-                Sample<T> s1 = samples[n];
-
-                double t = (jd - s0.t) / (s1.t - s0.t);
-                pos = Vector3d(Mathd::lerp(t, (double)s0.x, (double)s1.x), Mathd::lerp(t, (double)s0.y, (double)s1.y),
-                               Mathd::lerp(t, (double)s0.z, (double)s1.z));
-            } else if (interpolation == TrajectoryInterpolationCubic) {
-                Sample<T> s0, s1, s2, s3;
-                if (n > 1)
-                    s0 = samples[n - 2];
-                else
-                    s0 = samples[n - 1];
-                s1 = samples[n - 1];
-                s2 = samples[n];
-                if (n < (int)samples.size() - 1)
-                    s3 = samples[n + 1];
-                else
-                    s3 = samples[n];
-
-                double h = s2.t - s1.t;
-                double ih = 1.0 / h;
-                double t = (jd - s1.t) * ih;
-                Vector3d p0(s1.x, s1.y, s1.z);
-                Vector3d p1(s2.x, s2.y, s2.z);
-
-                Vector3d v10((double)s1.x - (double)s0.x, (double)s1.y - (double)s0.y, (double)s1.z - (double)s0.z);
-                Vector3d v21((double)s2.x - (double)s1.x, (double)s2.y - (double)s1.y, (double)s2.z - (double)s1.z);
-                Vector3d v32((double)s3.x - (double)s2.x, (double)s3.y - (double)s2.y, (double)s3.z - (double)s2.z);
-
-                // Estimate velocities by averaging the differences at adjacent spans
-                // (except at the end spans, where we just use a single velocity.)
-                Vector3d v0;
-                if (n > 1) {
-                    v0 = v10 * (0.5 / (s1.t - s0.t)) + v21 * (0.5 * ih);
-                    v0 *= h;
-                } else {
-                    v0 = v21;
-                }
-
-                Vector3d v1;
-                if (n < (int)samples.size() - 1) {
-                    v1 = v21 * (0.5 * ih) + v32 * (0.5 / (s3.t - s2.t));
-                    v1 *= h;
-                } else {
-                    v1 = v21;
-                }
+                s0 = samples[n - 1];
+            s1 = samples[n - 1];
+            s2 = samples[n];
+            if (n < sampleCount - 1)
+                s3 = samples[n + 1];
+            else
+                s3 = samples[n];
+
+            double h = s2.t - s1.t;
+            double ih = 1.0 / h;
+            double t = (jd - s1.t) * ih;
+            Vector3d p0(s1.x, s1.y, s1.z);
+            Vector3d p1(s2.x, s2.y, s2.z);
+
+            Vector3d v10((double)s1.x - (double)s0.x, (double)s1.y - (double)s0.y, (double)s1.z - (double)s0.z);
+            Vector3d v21((double)s2.x - (double)s1.x, (double)s2.y - (double)s1.y, (double)s2.z - (double)s1.z);
+            Vector3d v32((double)s3.x - (double)s2.x, (double)s3.y - (double)s2.y, (double)s3.z - (double)s2.z);
+
+            // Estimate velocities by averaging the differences at adjacent spans
+            // (except at the end spans, where we just use a single velocity.)
+            Vector3d v0;
+            if (n > 1) {
+                v0 = v10 * (0.5 / (s1.t - s0.t)) + v21 * (0.5 * ih);
+                v0 *= h;
+            } else {
+                v0 = v21;
+            }
 
-                pos = cubicInterpolate(p0, v0, p1, v1, t);
+            Vector3d v1;
+            if (n < sampleCount - 1) {
+                v1 = v21 * (0.5 * ih) + v32 * (0.5 / (s3.t - s2.t));
+                v1 *= h;
             } else {
-                // Unknown interpolation type
-                pos = Vector3d::Zero();
+                v1 = v21;
             }
+
+            pos = cubicInterpolate(p0, v0, p1, v1, t);
         } else {
-            pos = Vector3d(samples[n - 1].x, samples[n - 1].y, samples[n - 1].z);
+            // Unknown interpolation type
+            pos = Vector3d::Zero();
         }
+    } else {
+        pos = Vector3d(samples[n - 1].x, samples[n - 1].y, samples[n - 1].z);
     }
 
     // Add correction for Celestia's coordinate system
@@ -228,100 +353,101 @@ Vector3d SampledOrbit<T>::computePosition(double jd) const {
 }
 
 template <typename T>
-Vector3d SampledOrbit<T>::computeVelocity(double jd) const {
+Vector3d SampledOrbit<T>::interpolateVelocity(size_t n, double jd) const {
     Vector3d vel;
-    if (samples.size() < 2) {
+    if (sampleCount < 2 || n == 0 || n >= sampleCount) {
         vel = Vector3d::Zero();
-    } else {
-        Sample<T> samp;
-        samp.t = jd;
-        int n = lastSample;
-
-        if (n < 1 || n >= (int)samples.size() || jd < samples[n - 1].t || jd > samples[n].t) {
-            typename vector<Sample<T>>::const_iterator iter = lower_bound(samples.begin(), samples.end(), samp);
-            if (iter == samples.end())
-                n = samples.size();
-            else
-                n = iter - samples.begin();
-            lastSample = n;
+    } else if (interpolation == TrajectoryInterpolationLinear) {
+        Sample<T> s0 = samples[n - 1];
+        Sample<T> s1 = samples[n];
+
+        double dt = (s1.t - s0.t);
+        return (Vector3d(s1.x, s1.y, s1.z) - Vector3d(s0.x, s0.y, s0.z)) * (1.0 / dt);
+    } else if (interpolation == TrajectoryInterpolationCubic) {
+        Sample<T> s0, s1, s2, s3;
+        if (n > 1)
+            s0 = samples[n - 2];
+        else
+            s0 = samples[n - 1];
+        s1 = samples[n - 1];
+        s2 = samples[n];
+        if (n < sampleCount - 1)
+            s3 = samples[n + 1];
+        else
+            s3 = samples[n];
+
+        double h = s2.t - s1.t;
+        double ih = 1.0 / h;
+        double t = (jd - s1.t) * ih;
+        Vector3d p0(s1.x, s1.y, s1.z);
+        Vector3d p1(s2.x, s2.y, s2.z);
+
+        Vector3d v10((double)s1.x - (double)s0.x, (double)s1.y - (double)s0.y, (double)s1.z - (double)s0.z);
+        Vector3d v21((double)s2.x - (double)s1.x, (double)s2.y - (double)s1.y, (double)s2.z - (double)s1.z);
+        Vector3d v32((double)s3.x - (double)s2.x, (double)s3.y - (double)s2.y, (double)s3.z - (double)s2.z);
+
+        // Estimate velocities by averaging the differences at adjacent spans
+        // (except at the end spans, where we just use a single velocity.)
+        Vector3d v0;
+        if (n > 1) {
+            v0 = v10 * (0.5 / (s1.t - s0.t)) + v21 * (0.5 * ih);
+            v0 *= h;
+        } else {
+            v0 = v21;
         }
 
-        if (n == 0) {
-            vel = Vector3d::Zero();
-        } else if (n < (int)samples.size()) {
-            if (interpolation == TrajectoryInterpolationLinear) {
-                Sample<T> s0 = samples[n - 1];
-                Sample<T> s1 = samples[n];
-
-                double dt = (s1.t - s0.t);
-                return (Vector3d(s1.x, s1.y, s1.z) - Vector3d(s0.x, s0.y, s0.z)) * (1.0 / dt);
-            } else if (interpolation == TrajectoryInterpolationCubic) {
-                Sample<T> s0, s1, s2, s3;
-                if (n > 1)
-                    s0 = samples[n - 2];
-                else
-                    s0 = samples[n - 1];
-                s1 = samples[n - 1];
-                s2 = samples[n];
-                if (n < (int)samples.size() - 1)
-                    s3 = samples[n + 1];
-                else
-                    s3 = samples[n];
-
-                double h = s2.t - s1.t;
-                double ih = 1.0 / h;
-                double t = (jd - s1.t) * ih;
-                Vector3d p0(s1.x, s1.y, s1.z);
-                Vector3d p1(s2.x, s2.y, s2.z);
-
-                Vector3d v10((double)s1.x - (double)s0.x, (double)s1.y - (double)s0.y, (double)s1.z - (double)s0.z);
-                Vector3d v21((double)s2.x - (double)s1.x, (double)s2.y - (double)s1.y, (double)s2.z - (double)s1.z);
-                Vector3d v32((double)s3.x - (double)s2.x, (double)s3.y - (double)s2.y, (double)s3.z - (double)s2.z);
-
-                // Estimate velocities by averaging the differences at adjacent spans
-                // (except at the end spans, where we just use a single velocity.)
-                Vector3d v0;
-                if (n > 1) {
-                    v0 = v10 * (0.5 / (s1.t - s0.t)) + v21 * (0.5 * ih);
-                    v0 *= h;
-                } else {
-                    v0 = v21;
-                }
-
-                Vector3d v1;
-                if (n < (int)samples.size() - 1) {
-                    v1 = v21 * (0.5 * ih) + v32 * (0.5 / (s3.t - s2.t));
-                    v1 *= h;
-                } else {
-                    v1 = v21;
-                }
-
-                vel = cubicInterpolateVelocity(p0, v0, p1, v1, t);
-                vel *= 1.0 / h;
-            } else {
-                // Unknown interpolation type
-                vel = Vector3d::Zero();
-            }
+        Vector3d v1;
+        if (n < sampleCount - 1) {
+            v1 = v21 * (0.5 * ih) + v32 * (0.5 / (s3.t - s2.t));
+            v1 *= h;
         } else {
-            vel = Vector3d::Zero();
+            v1 = v21;
         }
+
+        vel = cubicInterpolateVelocity(p0, v0, p1, v1, t);
+        vel *= 1.0 / h;
+    } else {
+        // Unknown interpolation type
+        vel = Vector3d::Zero();
     }
 
     return Vector3d(vel.x(), vel.z(), -vel.y());
 }
 
+template <typename T>
+Vector3d SampledOrbit<T>::computePosition(double jd) const {
+    return interpolatePosition(index.find(samples, sampleCount, jd), jd);
+}
+
+template <typename T>
+Vector3d SampledOrbit<T>::computeVelocity(double jd) const {
+    return interpolateVelocity(index.find(samples, sampleCount, jd), jd);
+}
+
+template <typename T>
+void SampledOrbit<T>::statesAtTimes(const double* jds, size_t count, Vector3d* positions, Vector3d* velocities) const {
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        n = index.find(samples, sampleCount, jds[i], n);
+        if (positions != nullptr)
+            positions[i] = interpolatePosition(n, jds[i]);
+        if (velocities != nullptr)
+            velocities[i] = interpolateVelocity(n, jds[i]);
+    }
+}
+
 template <typename T>
 void SampledOrbit<T>::sample(double /* startTime */, double /* endTime */, const OrbitSampleProc& proc) const {
-    for (uint32_t i = 0; i < samples.size(); i++) {
+    for (uint32_t i = 0; i < sampleCount; i++) {
         Vector3d v;
         Vector3d p(samples[i].x, samples[i].y, samples[i].z);
 
-        if (samples.size() == 1) {
+        if (sampleCount == 1) {
             v = Vector3d::Zero();
         } else if (i == 0) {
             double dt = samples[i + 1].t - samples[i].t;
             v = (Vector3d(samples[i + 1].x, samples[i + 1].y, samples[i + 1].z) - p) / dt;
-        } else if (i == samples.size() - 1) {
+        } else if (i == sampleCount - 1) {
             double dt = samples[i].t - samples[i - 1].t;
             v = (p - Vector3d(samples[i - 1].x, samples[i - 1].y, samples[i - 1].z)) / dt;
         } else {
@@ -344,6 +470,9 @@ public:
     virtual ~SampledOrbitXYZV();
 
     void addSample(double t, const Vector3d& position, const Vector3d& velocity);
+    void setSamples(const storage::StoragePointer&, const SampleXYZV<T>* samples, size_t count, double boundingRadius);
+    const SampleXYZV<T>* getSamples() const { return samples; }
+    size_t getSampleCount() const { return sampleCount; }
     void setPeriod();
 
     double getPeriod() const override;
@@ -355,12 +484,21 @@ public:
     void getValidRange(double& begin, double& end) const override;
 
     void sample(double startTime, double endTime, const OrbitSampleProc& proc) const override;
+    void statesAtTimes(const double* jds, size_t count, Vector3d* positions, Vector3d* velocities) const override;
 
 private:
-    vector<SampleXYZV<T>> samples;
+    // Evaluate the trajectory at jd, which lies before sample n and at or
+    // after sample n - 1
+    Vector3d interpolatePosition(size_t n, double jd) const;
+    Vector3d interpolateVelocity(size_t n, double jd) const;
+
+    vector<SampleXYZV<T>> ownedSamples;
+    storage::StoragePointer storage;
+    const SampleXYZV<T>* samples{ nullptr };
+    size_t sampleCount{ 0 };
     double boundingRadius{ 0 };
     double period{ 1 };
-    mutable int lastSample{ 0 };
+    SampleTimeIndex index;
 
     const TrajectoryInterpolation interpolation;
 };
@@ -382,21 +520,37 @@ void SampledOrbitXYZV<T>::addSample(double t, const Vector3d& position, const Ve
     if (r > boundingRadius)
         boundingRadius = r;
 
-    SampleXYZV<T> samp;
+    SampleXYZV<T> samp{};
     samp.t = t;
     //samp.position = Matrix<T, 3, 1>((T) position.x, (T) position.y, (T) position.z);
     //samp.velocity = Matrix<T, 3, 1>((T) velocity.x, (T) velocity.y, (T) velocity.z);
     samp.position = position.cast<T>();
     samp.velocity = velocity.cast<T>();
-    samples.push_back(samp);
+    ownedSamples.push_back(samp);
+    samples = ownedSamples.data();
+    sampleCount = ownedSamples.size();
+    index.reset();
+}
+
+template <typename T>
+void SampledOrbitXYZV<T>::setSamples(const storage::StoragePointer& _storage,
+                                     const SampleXYZV<T>* _samples,
+                                     size_t count,
+                                     double radius) {
+    ownedSamples.clear();
+    storage = _storage;
+    samples = _samples;
+    sampleCount = count;
+    boundingRadius = radius;
+    index.reset();
 }
 
 template <typename T>
 double SampledOrbitXYZV<T>::getPeriod() const {
-    if (samples.empty())
+    if (sampleCount == 0)
         return 0.0;
     else
-        return samples[samples.size() - 1].t - samples[0].t;
+        return samples[sampleCount - 1].t - samples[0].t;
 }
 
 template <typename T>
@@ -407,7 +561,7 @@ bool SampledOrbitXYZV<T>::isPeriodic() const {
 template <typename T>
 void SampledOrbitXYZV<T>::getValidRange(double& begin, double& end) const {
     begin = samples[0].t;
-    end = samples[samples.size() - 1].t;
+    end = samples[sampleCount - 1].t;
 }
 
 template <typename T>
@@ -416,56 +570,38 @@ double SampledOrbitXYZV<T>::getBoundingRadius() const {
 }
 
 template <typename T>
-Vector3d SampledOrbitXYZV<T>::computePosition(double jd) const {
+Vector3d SampledOrbitXYZV<T>::interpolatePosition(size_t n, double jd) const {
     Vector3d pos;
-    if (samples.size() == 0) {
+    if (sampleCount == 0) {
         pos = Vector3d::Zero();
-    } else if (samples.size() == 1) {
-        pos = Vector3d(samples[0].position.x(), samples[1].position.y(), samples[2].position.z());
-    } else {
-        SampleXYZV<T> samp;
-        samp.t = jd;
-        int n = lastSample;
-
-        if (n < 1 || n >= (int)samples.size() || jd < samples[n - 1].t || jd > samples[n].t) {
-            typename vector<SampleXYZV<T>>::const_iterator iter = lower_bound(samples.begin(), samples.end(), samp);
-            if (iter == samples.end())
-                n = samples.size();
-            else
-                n = iter - samples.begin();
-
-            lastSample = n;
-        }
-
-        if (n == 0) {
-            pos = Vector3d(samples[n].position.x(), samples[n].position.y(), samples[n].position.z());
-        } else if (n < (int)samples.size()) {
-            SampleXYZV<T> s0 = samples[n - 1];
-            SampleXYZV<T> s1 = samples[n];
-
-            if (interpolation == TrajectoryInterpolationLinear) {
-                double t = (jd - s0.t) / (s1.t - s0.t);
-
-                Vector3d p0(s0.position.x(), s0.position.y(), s0.position.z());
-                Vector3d p1(s1.position.x(), s1.position.y(), s1.position.z());
-                pos = p0 + t * (p1 - p0);
-            } else if (interpolation == TrajectoryInterpolationCubic) {
-                double h = s1.t - s0.t;
-                double ih = 1.0 / h;
-                double t = (jd - s0.t) * ih;
-
-                Vector3d p0(s0.position.x(), s0.position.y(), s0.position.z());
-                Vector3d v0(s0.velocity.x(), s0.velocity.y(), s0.velocity.z());
-                Vector3d p1(s1.position.x(), s1.position.y(), s1.position.z());
-                Vector3d v1(s1.velocity.x(), s1.velocity.y(), s1.velocity.z());
-                pos = cubicInterpolate(p0, v0 * h, p1, v1 * h, t);
-            } else {
-                // Unknown interpolation type
-                pos = Vector3d::Zero();
-            }
+    } else if (n == 0) {
+        pos = samples[n].position.template cast<double>();
+    } else if (n < sampleCount) {
+        SampleXYZV<T> s0 = samples[n - 1];
+        SampleXYZV<T> s1 = samples[n];
+
+        if (interpolation == TrajectoryInterpolationLinear) {
+            double t = (jd - s0.t) / (s1.t - s0.t);
+
+            Vector3d p0(s0.position.x(), s0.position.y(), s0.position.z());
+            Vector3d p1(s1.position.x(), s1.position.y(), s1.position.z());
+            pos = p0 + t * (p1 - p0);
+        } else if (interpolation == TrajectoryInterpolationCubic) {
+            double h = s1.t - s0.t;
+            double ih = 1.0 / h;
+            double t = (jd - s0.t) * ih;
+
+            Vector3d p0(s0.position.x(), s0.position.y(), s0.position.z());
+            Vector3d v0(s0.velocity.x(), s0.velocity.y(), s0.velocity.z());
+            Vector3d p1(s1.position.x(), s1.position.y(), s1.position.z());
+            Vector3d v1(s1.velocity.x(), s1.velocity.y(), s1.velocity.z());
+            pos = cubicInterpolate(p0, v0 * h, p1, v1 * h, t);
         } else {
-            pos = Vector3d(samples[n - 1].position.x(), samples[n - 1].position.y(), samples[n - 1].position.z());
+            // Unknown interpolation type
+            pos = Vector3d::Zero();
         }
+    } else {
+        pos = Vector3d(samples[n - 1].position.x(), samples[n - 1].position.y(), samples[n - 1].position.z());
     }
 
     // Add correction for Celestia's coordinate system
@@ -475,48 +611,32 @@ Vector3d SampledOrbitXYZV<T>::computePosition(double jd) const {
 // Velocity is computed as the derivative of the interpolating function
 // for position.
 template <typename T>
-Vector3d SampledOrbitXYZV<T>::computeVelocity(double jd) const {
+Vector3d SampledOrbitXYZV<T>::interpolateVelocity(size_t n, double jd) const {
     Vector3d vel(Vector3d::Zero());
 
-    if (samples.size() >= 2) {
-        SampleXYZV<T> samp;
-        samp.t = jd;
-        int n = lastSample;
-
-        if (n < 1 || n >= (int)samples.size() || jd < samples[n - 1].t || jd > samples[n].t) {
-            typename vector<SampleXYZV<T>>::const_iterator iter = lower_bound(samples.begin(), samples.end(), samp);
-            if (iter == samples.end())
-                n = samples.size();
-            else
-                n = iter - samples.begin();
-
-            lastSample = n;
-        }
-
-        if (n > 0 && n < (int)samples.size()) {
-            SampleXYZV<T> s0 = samples[n - 1];
-            SampleXYZV<T> s1 = samples[n];
-
-            if (interpolation == TrajectoryInterpolationLinear) {
-                double h = s1.t - s0.t;
-                vel = Vector3d(s1.position.x() - s0.position.x(), s1.position.y() - s0.position.y(),
-                               s1.position.z() - s0.position.z()) *
-                      (1.0 / h) * astro::daysToSecs(1.0);
-            } else if (interpolation == TrajectoryInterpolationCubic) {
-                double h = s1.t - s0.t;
-                double ih = 1.0 / h;
-                double t = (jd - s0.t) * ih;
-
-                Vector3d p0(s0.position.x(), s0.position.y(), s0.position.z());
-                Vector3d p1(s1.position.x(), s1.position.y(), s1.position.z());
-                Vector3d v0(s0.velocity.x(), s0.velocity.y(), s0.velocity.z());
-                Vector3d v1(s1.velocity.x(), s1.velocity.y(), s1.velocity.z());
-
-                vel = cubicInterpolateVelocity(p0, v0 * h, p1, v1 * h, t) * ih;
-            } else {
-                // Unknown interpolation type
-                vel = Vector3d::Zero();
-            }
+    if (sampleCount >= 2 && n > 0 && n < sampleCount) {
+        SampleXYZV<T> s0 = samples[n - 1];
+        SampleXYZV<T> s1 = samples[n];
+
+        if (interpolation == TrajectoryInterpolationLinear) {
+            double h = s1.t - s0.t;
+            vel = Vector3d(s1.position.x() - s0.position.x(), s1.position.y() - s0.position.y(),
+                           s1.position.z() - s0.position.z()) *
+                  (1.0 / h) * astro::daysToSecs(1.0);
+        } else if (interpolation == TrajectoryInterpolationCubic) {
+            double h = s1.t - s0.t;
+            double ih = 1.0 / h;
+            double t = (jd - s0.t) * ih;
+
+            Vector3d p0(s0.position.x(), s0.position.y(), s0.position.z());
+            Vector3d p1(s1.position.x(), s1.position.y(), s1.position.z());
+            Vector3d v0(s0.velocity.x(), s0.velocity.y(), s0.velocity.z());
+            Vector3d v1(s1.velocity.x(), s1.velocity.y(), s1.velocity.z());
+
+            vel = cubicInterpolateVelocity(p0, v0 * h, p1, v1 * h, t) * ih;
+        } else {
+            // Unknown interpolation type
+            vel = Vector3d::Zero();
         }
     }
 
@@ -524,9 +644,34 @@ Vector3d SampledOrbitXYZV<T>::computeVelocity(double jd) const {
     return Vector3d(vel.x(), vel.z(), -vel.y());
 }
 
+template <typename T>
+Vector3d SampledOrbitXYZV<T>::computePosition(double jd) const {
+    return interpolatePosition(index.find(samples, sampleCount, jd), jd);
+}
+
+template <typename T>
+Vector3d SampledOrbitXYZV<T>::computeVelocity(double jd) const {
+    return interpolateVelocity(index.find(samples, sampleCount, jd), jd);
+}
+
+template <typename T>
+void SampledOrbitXYZV<T>::statesAtTimes(const double* jds,
+                                        size_t count,
+                                        Vector3d* positions,
+                                        Vector3d* velocities) const {
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        n = index.find(samples, sampleCount, jds[i], n);
+        if (positions != nullptr)
+            positions[i] = interpolatePosition(n, jds[i]);
+        if (velocities != nullptr)
+            velocities[i] = interpolateVelocity(n, jds[i]);
+    }
+}
+
 template <typename T>
 void SampledOrbitXYZV<T>::sample(double /* startTime */, double /* endTime */, const OrbitSampleProc& proc) const {
-    for (typename vector<SampleXYZV<T>>::const_iterator iter = samples.begin(); iter != samples.end(); iter++) {
+    for (const SampleXYZV<T>* iter = samples; iter != samples + sampleCount; iter++) {
         proc(iter->t, Vector3d(iter->position.x(), iter->position.z(), -iter->position.y()),
              Vector3d(iter->velocity.x(), iter->velocity.z(), -iter->velocity.y()));
     }
@@ -667,6 +812,147 @@ std::shared_ptr<SampledOrbitXYZV<T>> LoadSampledOrbitXYZV(const string& filename
     return orbit;
 }
 
+// Binary trajectory file: a header followed by the samples in time order.
+// Each sample is a Sample<T> or SampleXYZV<T> record in native byte order;
+// positions are in km and velocities in km per Julian day.
+struct BinaryTrajectoryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t recordSize;
+    uint32_t byteOrder;
+    uint64_t sampleCount;
+    double boundingRadius;
+    double startTime;
+    double endTime;
+    uint64_t reserved;
+};
+
+static const char BinaryTrajectoryMagic[8] = { 'C', 'E', 'L', 'T', 'R', 'A', 'J', 0 };
+static const uint32_t BinaryTrajectoryVersion = 0x0100;
+static const uint32_t BinaryTrajectoryByteOrder = 0x01020304;
+static const uint32_t BinaryTrajectoryVelocity = 0x1;
+static const uint32_t BinaryTrajectoryDouble = 0x2;
+
+template <typename ORBIT, typename SAMPLE>
+static Orbit::Pointer CreateMappedOrbit(const storage::StoragePointer& file,
+                                        const BinaryTrajectoryHeader& header,
+                                        TrajectoryInterpolation interpolation) {
+    if (header.recordSize != sizeof(SAMPLE))
+        return nullptr;
+
+    auto orbit = std::make_shared<ORBIT>(interpolation);
+    auto samples = reinterpret_cast<const SAMPLE*>(file->data() + sizeof(header));
+    orbit->setSamples(file, samples, (size_t)header.sampleCount, header.boundingRadius);
+    return orbit;
+}
+
+/*! Load a binary trajectory written by ConvertTrajectoryToBinary. The file
+ *  is mapped and interpolated in place rather than read into memory. The
+ *  precision and the presence of velocities are those of the file.
+ */
+Orbit::Pointer LoadBinaryTrajectory(const string& filename, TrajectoryInterpolation interpolation) {
+    storage::StoragePointer file;
+    try {
+        file = storage::Storage::readFile(filename);
+    } catch (const std::runtime_error&) {
+        return nullptr;
+    }
+
+    BinaryTrajectoryHeader header;
+    if (file->size() < sizeof(header)) {
+        clog << "Binary trajectory " << filename << " is truncated\n";
+        return nullptr;
+    }
+    memcpy(&header, file->data(), sizeof(header));
+
+    if (memcmp(header.magic, BinaryTrajectoryMagic, sizeof(header.magic)) != 0 ||
+        header.version != BinaryTrajectoryVersion || header.byteOrder != BinaryTrajectoryByteOrder ||
+        header.sampleCount == 0 || header.recordSize == 0 ||
+        (file->size() - sizeof(header)) / header.recordSize != header.sampleCount ||
+        (file->size() - sizeof(header)) % header.recordSize != 0) {
+        clog << "Bad binary trajectory " << filename << '\n';
+        return nullptr;
+    }
+
+    Orbit::Pointer orbit;
+    switch (header.flags) {
+        case 0:
+            orbit = CreateMappedOrbit<SampledOrbit<float>, Sample<float>>(file, header, interpolation);
+            break;
+        case BinaryTrajectoryDouble:
+            orbit = CreateMappedOrbit<SampledOrbit<double>, Sample<double>>(file, header, interpolation);
+            break;
+        case BinaryTrajectoryVelocity:
+            orbit = CreateMappedOrbit<SampledOrbitXYZV<float>, SampleXYZV<float>>(file, header, interpolation);
+            break;
+        case BinaryTrajectoryVelocity | BinaryTrajectoryDouble:
+            orbit = CreateMappedOrbit<SampledOrbitXYZV<double>, SampleXYZV<double>>(file, header, interpolation);
+            break;
+    }
+
+    if (orbit == nullptr)
+        clog << "Bad binary trajectory " << filename << '\n';
+    return orbit;
+}
+
+template <typename ORBIT>
+static bool WriteBinaryTrajectory(const ORBIT& orbit, uint32_t flags, const string& filename) {
+    size_t count = orbit.getSampleCount();
+    if (count == 0)
+        return false;
+
+    BinaryTrajectoryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BinaryTrajectoryMagic, sizeof(header.magic));
+    header.version = BinaryTrajectoryVersion;
+    header.flags = flags;
+    header.recordSize = sizeof(*orbit.getSamples());
+    header.byteOrder = BinaryTrajectoryByteOrder;
+    header.sampleCount = count;
+    header.boundingRadius = orbit.getBoundingRadius();
+    orbit.getValidRange(header.startTime, header.endTime);
+
+    ofstream out(filename, ios::out | ios::binary);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(orbit.getSamples()), count * header.recordSize);
+    return out.good();
+}
+
+/*! Convert an ASCII xyz or xyzv trajectory into the binary format read by
+ *  LoadBinaryTrajectory. The samples are stored with the requested
+ *  precision.
+ */
+bool ConvertTrajectoryToBinary(const string& source,
+                               const string& destination,
+                               bool hasVelocities,
+                               TrajectoryPrecision precision) {
+    bool single = precision == TrajectoryPrecisionSingle;
+    uint32_t flags = (hasVelocities ? BinaryTrajectoryVelocity : 0) | (single ? 0 : BinaryTrajectoryDouble);
+
+    // The interpolation isn't stored; it's chosen when the file is loaded
+    const auto interpolation = TrajectoryInterpolationLinear;
+    if (hasVelocities) {
+        if (single) {
+            auto orbit = LoadSampledOrbitXYZV(source, interpolation, 0.0f);
+            return orbit != nullptr && WriteBinaryTrajectory(*orbit, flags, destination);
+        }
+        auto orbit = LoadSampledOrbitXYZV(source, interpolation, 0.0);
+        return orbit != nullptr && WriteBinaryTrajectory(*orbit, flags, destination);
+    }
+
+    if (single) {
+        auto orbit = LoadSampledOrbit(source, interpolation, 0.0f);
+        return orbit != nullptr && WriteBinaryTrajectory(*orbit, flags, destination);
+    }
+    auto orbit = LoadSampledOrbit(source, interpolation, 0.0);
+    return orbit != nullptr && WriteBinaryTrajectory(*orbit, flags, destination);
+}
+
+string BinaryTrajectoryFilename(const string& source) {
+    return source + ".ctraj";
+}
+
 /*! Load a trajectory file containing single precision positions.
  */
 Orbit::Pointer LoadSampledTrajectorySinglePrec(const string& filename, TrajectoryInterpolation interpolation) {
@@ -30,4 +30,14 @@ extern Orbit::Pointer LoadSampledTrajectorySinglePrec(const std::string& name, T
 extern Orbit::Pointer LoadXYZVTrajectoryDoublePrec(const std::string& name, TrajectoryInterpolation interpolation);
 extern Orbit::Pointer LoadXYZVTrajectorySinglePrec(const std::string& name, TrajectoryInterpolation interpolation);
 
+// Binary trajectories hold the samples of an xyz or xyzv file in a form that
+// is mapped and used in place. A converted copy of source lives beside it
+// under BinaryTrajectoryFilename(source).
+extern Orbit::Pointer LoadBinaryTrajectory(const std::string& name, TrajectoryInterpolation interpolation);
+extern bool ConvertTrajectoryToBinary(const std::string& source,
+                                      const std::string& destination,
+                                      bool hasVelocities,
+                                      TrajectoryPrecision precision);
+extern std::string BinaryTrajectoryFilename(const std::string& source);
+
 #endif // _CELENGINE_SAMPORBIT_H_
@@ -94,7 +94,6 @@ private:
 
 private:
     OrientationSampleVector samples;
-    mutable int lastSample;
 
     enum InterpolationType
     {
@@ -105,7 +104,7 @@ private:
     InterpolationType interpolation;
 };
 
-SampledOrientation::SampledOrientation() : lastSample(0), interpolation(Linear) {
+SampledOrientation::SampledOrientation() : interpolation(Linear) {
 }
 
 SampledOrientation::~SampledOrientation() {
@@ -146,20 +145,12 @@ Quaternionf SampledOrientation::getOrientation(double tjd) const {
     } else {
         OrientationSample samp;
         samp.t = tjd;
-        int n = lastSample;
 
         // Do a binary search to find the samples that define the orientation
-        // at the current time. Cache the previous sample used and avoid
-        // the search if the covers the requested time.
-        if (n < 1 || n >= (int)samples.size() || tjd < samples[n - 1].t || tjd > samples[n].t) {
-            OrientationSampleVector::const_iterator iter = lower_bound(samples.begin(), samples.end(), samp);
-            if (iter == samples.end())
-                n = samples.size();
-            else
-                n = iter - samples.begin();
-
-            lastSample = n;
-        }
+        // at the current time. There's no cached hint from the previous call,
+        // so that orientations may be computed from several threads at once.
+        auto iter = lower_bound(samples.begin(), samples.end(), samp);
+        int n = (int)(iter - samples.begin());
 
         if (n == 0) {
             orientation = samples[0].q;
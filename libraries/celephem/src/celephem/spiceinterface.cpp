@@ -22,9 +22,13 @@ using namespace std;
 // kernel pool.
 static set<string> ResidentSpiceKernels;
 
+std::recursive_mutex SpiceMutex;
+
 /*! Perform one-time initialization of SPICE.
  */
 bool InitializeSpice() {
+    lock_guard<recursive_mutex> lock(SpiceMutex);
+
     // Set the error behavior to the RETURN action, so that
     // Celestia do its own handling of SPICE errors.
     erract_c("SET", 0, (SpiceChar*)"RETURN");
@@ -43,6 +47,7 @@ bool GetNaifId(const string& name, int& id) {
     // Don't call bodn2c on an empty string because SPICE generates
     // an error if we do.
     if (!name.empty()) {
+        lock_guard<recursive_mutex> lock(SpiceMutex);
         bodn2c_c(name.c_str(), &spiceID, &found);
         if (found) {
             id = (int)spiceID;
@@ -64,6 +69,7 @@ bool GetNaifId(const string& name, int& id) {
 /*! Return true if a SPICE kernel has already been loaded, false if not.
  */
 bool IsSpiceKernelLoaded(const string& filepath) {
+    lock_guard<recursive_mutex> lock(SpiceMutex);
     return ResidentSpiceKernels.find(filepath) != ResidentSpiceKernels.end();
 }
 
@@ -71,6 +77,8 @@ bool IsSpiceKernelLoaded(const string& filepath) {
  *  is already resident, it will not be reloaded.
  */
 bool LoadSpiceKernel(const string& filepath) {
+    lock_guard<recursive_mutex> lock(SpiceMutex);
+
     // Only load the kernel if it is not already resident. Note that this detection
     // of duplicate kernels will not work if a file was originally loaded through
     // a metakernel.
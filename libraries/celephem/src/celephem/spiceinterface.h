@@ -12,8 +12,15 @@
 #ifndef _CELENGINE_SPICEINTERFACE_H_
 #define _CELENGINE_SPICEINTERFACE_H_
 
+#include <mutex>
 #include <string>
 
+// CSPICE keeps its kernel pool and error state in globals and isn't
+// reentrant, so every call into it must hold this lock. It's recursive
+// because orbit and rotation initialization call the utility functions
+// below while holding it.
+extern std::recursive_mutex SpiceMutex;
+
 extern bool InitializeSpice();
 
 // SPICE utility functions
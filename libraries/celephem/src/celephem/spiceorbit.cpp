@@ -68,6 +68,8 @@ double SpiceOrbit::getPeriod() const {
 }
 
 bool SpiceOrbit::init(const string& path, const list<string>& requiredKernels) {
+    lock_guard<recursive_mutex> lock(SpiceMutex);
+
     // Load required kernel files
     for (auto kernel : requiredKernels) {
         string filepath = path + string("/data/") + kernel;
@@ -202,6 +204,7 @@ Vector3d SpiceOrbit::computePosition(double jd) const {
         double position[3];
         double lt;  // One way light travel time
 
+        lock_guard<recursive_mutex> lock(SpiceMutex);
         spkgps_c(targetID, t, "eclipj2000", originID, position, &lt);
 
         // This shouldn't happen, since we've already computed the valid
@@ -235,6 +238,7 @@ Vector3d SpiceOrbit::computeVelocity(double jd) const {
         double state[6];
         double lt;  // One way light travel time
 
+        lock_guard<recursive_mutex> lock(SpiceMutex);
         spkgeo_c(targetID, t, "eclipj2000", originID, state, &lt);
 
         // This shouldn't happen, since we've already computed the valid
@@ -74,6 +74,8 @@ double SpiceRotation::getPeriod() const {
 }
 
 bool SpiceRotation::init(const string& path, const list<string>& requiredKernels) {
+    lock_guard<recursive_mutex> lock(SpiceMutex);
+
     // Load required kernel files
     for (const auto& kernel : requiredKernels) {
         string filepath = path + string("/data/") + kernel;
@@ -118,6 +120,7 @@ Quaterniond SpiceRotation::computeSpin(double jd) const {
         double t = astro::daysToSecs(jd - astro::J2000);
         double xform[3][3];
 
+        lock_guard<recursive_mutex> lock(SpiceMutex);
         pxform_c(m_frameName.c_str(), m_baseFrameName.c_str(), t, xform);
 
         if (failed_c()) {
@@ -13,9 +13,18 @@
 // of the License, or (at your option) any later version.
 
 #include "vsop87.h"
+#include <atomic>
 #include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
 #include <celmath/mathlib.h>
 #include <celastro/astro.h>
+#include <celutil/cpufeatures.h>
+
+#ifdef CELESTIA_X86_64
+#include <immintrin.h>
+#endif
 
 #include "orbit.h"
 
@@ -9731,40 +9740,447 @@ static VSOPSeries sun_Z[] = {
     VSOP_SERIES(sun_Z2),
 };
 
-static double SumSeries(const VSOPSeries& series, double t) {
-    if (series.nTerms < 1)
-        return 0.0;
+// The series of the three coordinates of each body: l, b and r for the
+// planets, x, y and z for the Sun. Some of the highest powers are left out.
+struct VSOPBody {
+    VSOPSeries* series[3];
+    int nSeries[3];
+};
 
-    double x = 0.0;
-    VSOPTerm* term = &series.terms[0];
-    for (int i = 0; i < series.nTerms; i++, term++)
-        x += term->A * cos(term->B + term->C * t);
+static const int MaxSeriesPerCoordinate = 6;
+static const int BodyCount = (int)VSOP87Body::Count;
 
-    return x;
+static const VSOPBody vsopBodies[BodyCount] = {
+    { { mercury_L, mercury_B, mercury_R }, { 6, 6, 5 } },
+    { { venus_L, venus_B, venus_R }, { 6, 6, 5 } },
+    { { earth_L, earth_B, earth_R }, { 6, 3, 6 } },
+    { { mars_L, mars_B, mars_R }, { 6, 6, 6 } },
+    { { jupiter_L, jupiter_B, jupiter_R }, { 6, 6, 6 } },
+    { { saturn_L, saturn_B, saturn_R }, { 6, 6, 6 } },
+    { { uranus_L, uranus_B, uranus_R }, { 5, 4, 5 } },
+    { { neptune_L, neptune_B, neptune_R }, { 4, 4, 5 } },
+    { { sun_X, sun_Y, sun_Z }, { 5, 5, 3 } },
 };
 
+// Number of terms the vector kernels handle at once; every series is padded
+// with zero terms to a multiple of it.
+static const uint32_t TermBlock = 4;
+
+// All the terms of all bodies, with A, B and C in separate arrays so that the
+// kernels can load several terms at once. The series of a body are stored
+// together, by coordinate and then by power of t, so evaluating a body, or
+// every body, is one forward sweep over the arrays.
+class VSOPTermTable {
+public:
+    struct Range {
+        uint32_t first;
+        uint32_t count;
+    };
+
+    static const VSOPTermTable& get() {
+        static VSOPTermTable table;
+        return table;
+    }
+
+    vector<double> A;
+    vector<double> B;
+    vector<double> C;
+    Range series[BodyCount][3][MaxSeriesPerCoordinate];
+
+private:
+    VSOPTermTable();
+};
+
+VSOPTermTable::VSOPTermTable() {
+    for (int body = 0; body < BodyCount; body++) {
+        for (int coord = 0; coord < 3; coord++) {
+            for (int power = 0; power < MaxSeriesPerCoordinate; power++) {
+                Range& range = series[body][coord][power];
+                range.first = (uint32_t)A.size();
+                range.count = 0;
+                if (power >= vsopBodies[body].nSeries[coord])
+                    continue;
+
+                const VSOPSeries& s = vsopBodies[body].series[coord][power];
+                for (int i = 0; i < s.nTerms; i++) {
+                    A.push_back(s.terms[i].A);
+                    B.push_back(s.terms[i].B);
+                    C.push_back(s.terms[i].C);
+                }
+                // A zero amplitude adds exactly nothing to the sum
+                while (A.size() % TermBlock != 0) {
+                    A.push_back(0.0);
+                    B.push_back(0.0);
+                    C.push_back(0.0);
+                }
+                range.count = (uint32_t)A.size() - range.first;
+            }
+        }
+    }
+}
+
+// Sum A * cos(B + C * t) over the terms of a range for each of the times,
+// and, if rates isn't null, the derivative -A * C * sin(B + C * t).
+using SumTermsProc = void (*)(const double* A,
+                              const double* B,
+                              const double* C,
+                              uint32_t nTerms,
+                              const double* t,
+                              size_t nTimes,
+                              double* sums,
+                              double* rates);
+
+static void sumTermsScalar(const double* A,
+                           const double* B,
+                           const double* C,
+                           uint32_t nTerms,
+                           const double* t,
+                           size_t nTimes,
+                           double* sums,
+                           double* rates) {
+    for (size_t j = 0; j < nTimes; j++) {
+        double x = 0.0;
+        for (uint32_t i = 0; i < nTerms; i++)
+            x += A[i] * cos(B[i] + C[i] * t[j]);
+        sums[j] = x;
+
+        if (rates != nullptr) {
+            double dx = 0.0;
+            for (uint32_t i = 0; i < nTerms; i++)
+                dx -= A[i] * C[i] * sin(B[i] + C[i] * t[j]);
+            rates[j] = dx;
+        }
+    }
+}
+
+#ifdef CELESTIA_X86_64
+
+// pi/2 split into three parts, the first two with enough trailing zero bits
+// that their products with the quadrant number are exact.
+static const double PiOver2Hi = 1.57079625129699707031e+00;
+static const double PiOver2Mid = 7.54978941586159635335e-08;
+static const double PiOver2Lo = 5.39030285815811905290e-15;
+
+// Minimax polynomials for sin and cos on [-pi/4, pi/4], from Cephes.
+static const double SinCoeffs[6] = {
+    1.58962301576546568060e-10, -2.50507477628578072866e-08, 2.75573136213857245213e-06,
+    -1.98412698295895385996e-04, 8.33333333332211858878e-03, -1.66666666666666307295e-01,
+};
+static const double CosCoeffs[6] = {
+    -1.13585365213876817300e-11, 2.08757008419747316778e-09, -2.75573141792967388112e-07,
+    2.48015872888517045348e-05, -1.38888888888730564116e-03, 4.16666666666665929218e-02,
+};
+
+// cos(x) and sin(x) of two arguments. x is reduced to r in [-pi/4, pi/4]
+// plus a quadrant q, and the results picked from the polynomials for sin(r)
+// and cos(r): cos(x) is cos(r), -sin(r), -cos(r), sin(r) for q = 0..3, and
+// sin(x) the same sequence starting one quadrant later.
+static inline void sincos_sse2(__m128d x, __m128d& sinx, __m128d& cosx) {
+    const __m128i qi = _mm_cvtpd_epi32(_mm_mul_pd(x, _mm_set1_pd(2.0 / PI)));
+    const __m128d q = _mm_cvtepi32_pd(qi);
+    __m128d r = _mm_sub_pd(x, _mm_mul_pd(q, _mm_set1_pd(PiOver2Hi)));
+    r = _mm_sub_pd(r, _mm_mul_pd(q, _mm_set1_pd(PiOver2Mid)));
+    r = _mm_sub_pd(r, _mm_mul_pd(q, _mm_set1_pd(PiOver2Lo)));
+    const __m128d z = _mm_mul_pd(r, r);
+
+    __m128d ps = _mm_set1_pd(SinCoeffs[0]);
+    __m128d pc = _mm_set1_pd(CosCoeffs[0]);
+    for (int i = 1; i < 6; i++) {
+        ps = _mm_add_pd(_mm_mul_pd(ps, z), _mm_set1_pd(SinCoeffs[i]));
+        pc = _mm_add_pd(_mm_mul_pd(pc, z), _mm_set1_pd(CosCoeffs[i]));
+    }
+    const __m128d s = _mm_add_pd(r, _mm_mul_pd(_mm_mul_pd(r, z), ps));
+    const __m128d c =
+        _mm_add_pd(_mm_sub_pd(_mm_set1_pd(1.0), _mm_mul_pd(_mm_set1_pd(0.5), z)), _mm_mul_pd(_mm_mul_pd(z, z), pc));
+
+    // Widen the two 32-bit quadrants to one per 64-bit lane
+    const __m128i q64 = _mm_shuffle_epi32(qi, _MM_SHUFFLE(1, 1, 0, 0));
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i two = _mm_set1_epi32(2);
+    const __m128d odd = _mm_castsi128_pd(_mm_cmpeq_epi32(_mm_and_si128(q64, one), one));
+    const __m128d cosSign = _mm_castsi128_pd(_mm_slli_epi64(_mm_and_si128(_mm_add_epi32(q64, one), two), 62));
+    const __m128d sinSign = _mm_castsi128_pd(_mm_slli_epi64(_mm_and_si128(q64, two), 62));
+    cosx = _mm_xor_pd(_mm_or_pd(_mm_and_pd(odd, s), _mm_andnot_pd(odd, c)), cosSign);
+    sinx = _mm_xor_pd(_mm_or_pd(_mm_and_pd(odd, c), _mm_andnot_pd(odd, s)), sinSign);
+}
+
+static void sumTermsSSE2(const double* A,
+                         const double* B,
+                         const double* C,
+                         uint32_t nTerms,
+                         const double* t,
+                         size_t nTimes,
+                         double* sums,
+                         double* rates) {
+    for (size_t j = 0; j < nTimes; j++) {
+        const __m128d tv = _mm_set1_pd(t[j]);
+        __m128d x0 = _mm_setzero_pd();
+        __m128d x1 = _mm_setzero_pd();
+        __m128d dx0 = _mm_setzero_pd();
+        __m128d dx1 = _mm_setzero_pd();
+        for (uint32_t i = 0; i < nTerms; i += 4) {
+            const __m128d a0 = _mm_loadu_pd(A + i);
+            const __m128d a1 = _mm_loadu_pd(A + i + 2);
+            const __m128d c0 = _mm_loadu_pd(C + i);
+            const __m128d c1 = _mm_loadu_pd(C + i + 2);
+            __m128d sin0, cos0, sin1, cos1;
+            sincos_sse2(_mm_add_pd(_mm_loadu_pd(B + i), _mm_mul_pd(c0, tv)), sin0, cos0);
+            sincos_sse2(_mm_add_pd(_mm_loadu_pd(B + i + 2), _mm_mul_pd(c1, tv)), sin1, cos1);
+            x0 = _mm_add_pd(x0, _mm_mul_pd(a0, cos0));
+            x1 = _mm_add_pd(x1, _mm_mul_pd(a1, cos1));
+            dx0 = _mm_sub_pd(dx0, _mm_mul_pd(_mm_mul_pd(a0, c0), sin0));
+            dx1 = _mm_sub_pd(dx1, _mm_mul_pd(_mm_mul_pd(a1, c1), sin1));
+        }
+
+        double lanes[2];
+        _mm_storeu_pd(lanes, _mm_add_pd(x0, x1));
+        sums[j] = lanes[0] + lanes[1];
+        if (rates != nullptr) {
+            _mm_storeu_pd(lanes, _mm_add_pd(dx0, dx1));
+            rates[j] = lanes[0] + lanes[1];
+        }
+    }
+}
+
+CELESTIA_TARGET_AVX2
+static inline void sincos_avx2(__m256d x, __m256d& sinx, __m256d& cosx) {
+    const __m128i qi = _mm256_cvtpd_epi32(_mm256_mul_pd(x, _mm256_set1_pd(2.0 / PI)));
+    const __m256d q = _mm256_cvtepi32_pd(qi);
+    __m256d r = _mm256_sub_pd(x, _mm256_mul_pd(q, _mm256_set1_pd(PiOver2Hi)));
+    r = _mm256_sub_pd(r, _mm256_mul_pd(q, _mm256_set1_pd(PiOver2Mid)));
+    r = _mm256_sub_pd(r, _mm256_mul_pd(q, _mm256_set1_pd(PiOver2Lo)));
+    const __m256d z = _mm256_mul_pd(r, r);
+
+    __m256d ps = _mm256_set1_pd(SinCoeffs[0]);
+    __m256d pc = _mm256_set1_pd(CosCoeffs[0]);
+    for (int i = 1; i < 6; i++) {
+        ps = _mm256_add_pd(_mm256_mul_pd(ps, z), _mm256_set1_pd(SinCoeffs[i]));
+        pc = _mm256_add_pd(_mm256_mul_pd(pc, z), _mm256_set1_pd(CosCoeffs[i]));
+    }
+    const __m256d s = _mm256_add_pd(r, _mm256_mul_pd(_mm256_mul_pd(r, z), ps));
+    const __m256d c = _mm256_add_pd(_mm256_sub_pd(_mm256_set1_pd(1.0), _mm256_mul_pd(_mm256_set1_pd(0.5), z)),
+                                    _mm256_mul_pd(_mm256_mul_pd(z, z), pc));
+
+    const __m256i q64 = _mm256_cvtepi32_epi64(qi);
+    const __m256i one = _mm256_set1_epi64x(1);
+    const __m256i two = _mm256_set1_epi64x(2);
+    const __m256d odd = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(q64, one), one));
+    const __m256d cosSign = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_and_si256(_mm256_add_epi64(q64, one), two), 62));
+    const __m256d sinSign = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_and_si256(q64, two), 62));
+    cosx = _mm256_xor_pd(_mm256_blendv_pd(c, s, odd), cosSign);
+    sinx = _mm256_xor_pd(_mm256_blendv_pd(s, c, odd), sinSign);
+}
+
+CELESTIA_TARGET_AVX2
+static void sumTermsAVX2(const double* A,
+                         const double* B,
+                         const double* C,
+                         uint32_t nTerms,
+                         const double* t,
+                         size_t nTimes,
+                         double* sums,
+                         double* rates) {
+    for (size_t j = 0; j < nTimes; j++) {
+        const __m256d tv = _mm256_set1_pd(t[j]);
+        __m256d x = _mm256_setzero_pd();
+        __m256d dx = _mm256_setzero_pd();
+        for (uint32_t i = 0; i < nTerms; i += 4) {
+            const __m256d a = _mm256_loadu_pd(A + i);
+            const __m256d c = _mm256_loadu_pd(C + i);
+            __m256d sinx, cosx;
+            sincos_avx2(_mm256_add_pd(_mm256_loadu_pd(B + i), _mm256_mul_pd(c, tv)), sinx, cosx);
+            x = _mm256_add_pd(x, _mm256_mul_pd(a, cosx));
+            dx = _mm256_sub_pd(dx, _mm256_mul_pd(_mm256_mul_pd(a, c), sinx));
+        }
+
+        double lanes[4];
+        _mm256_storeu_pd(lanes, x);
+        sums[j] = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+        if (rates != nullptr) {
+            _mm256_storeu_pd(lanes, dx);
+            rates[j] = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+        }
+    }
+}
+
+#endif  // CELESTIA_X86_64
+
+static VSOP87Kernel bestKernel() {
+#ifdef CELESTIA_X86_64
+    static const VSOP87Kernel best = CPUSupportsAVX2() ? VSOP87Kernel::AVX2 : VSOP87Kernel::SSE2;
+    return best;
+#else
+    return VSOP87Kernel::Scalar;
+#endif
+}
+
+// The kernel may be changed while pool threads are reading it
+static std::atomic<VSOP87Kernel>& currentKernel() {
+    static std::atomic<VSOP87Kernel> kernel{ bestKernel() };
+    return kernel;
+}
+
+VSOP87Kernel GetVSOP87Kernel() {
+    return currentKernel().load(std::memory_order_relaxed);
+}
+
+void SetVSOP87Kernel(VSOP87Kernel kernel) {
+    if ((int)kernel > (int)bestKernel())
+        kernel = bestKernel();
+    currentKernel().store(kernel, std::memory_order_relaxed);
+}
+
+const char* GetVSOP87KernelName(VSOP87Kernel kernel) {
+    switch (kernel) {
+        case VSOP87Kernel::SSE2:
+            return "SSE2";
+        case VSOP87Kernel::AVX2:
+            return "AVX2";
+        default:
+            return "Scalar";
+    }
+}
+
+static SumTermsProc currentSumTerms() {
+    switch (currentKernel().load(std::memory_order_relaxed)) {
+#ifdef CELESTIA_X86_64
+        case VSOP87Kernel::SSE2:
+            return sumTermsSSE2;
+        case VSOP87Kernel::AVX2:
+            return sumTermsAVX2;
+#endif
+        default:
+            return sumTermsScalar;
+    }
+}
+
+// Times are evaluated in batches of this many, which keeps the scratch
+// arrays on the stack.
+static const size_t TimeBatch = 64;
+
+// Evaluate the three coordinates of a body at up to TimeBatch times t (in
+// Julian millennia since J2000.0), and their rates of change per millennium
+// if rates isn't null. Both outputs hold three values per time.
+static void evaluateBody(int body, const double* t, size_t nTimes, double* values, double* rates) {
+    const VSOPTermTable& table = VSOPTermTable::get();
+    SumTermsProc sumTerms = currentSumTerms();
+
+    double sums[TimeBatch];
+    double sumRates[TimeBatch];
+    double T[TimeBatch];
+
+    fill(values, values + nTimes * 3, 0.0);
+    if (rates != nullptr)
+        fill(rates, rates + nTimes * 3, 0.0);
+
+    for (int coord = 0; coord < 3; coord++) {
+        fill(T, T + nTimes, 1.0);
+        for (int power = 0; power < vsopBodies[body].nSeries[coord]; power++) {
+            const VSOPTermTable::Range& range = table.series[body][coord][power];
+            if (range.count > 0) {
+                sumTerms(&table.A[range.first], &table.B[range.first], &table.C[range.first], range.count, t, nTimes,
+                         sums, rates != nullptr ? sumRates : nullptr);
+            } else {
+                fill(sums, sums + nTimes, 0.0);
+                fill(sumRates, sumRates + nTimes, 0.0);
+            }
+
+            // d/dt (S t^n) = S' t^n + n S t^(n-1)
+            for (size_t j = 0; j < nTimes; j++) {
+                if (power > 0) {
+                    if (rates != nullptr)
+                        rates[j * 3 + coord] += power * sums[j] * T[j];
+                    T[j] *= t[j];
+                }
+                values[j * 3 + coord] += sums[j] * T[j];
+                if (rates != nullptr)
+                    rates[j * 3 + coord] += sumRates[j] * T[j];
+            }
+        }
+    }
+}
+
+// t is Julian millenia since J2000.0
+static double millenniaSinceJ2000(double jd) {
+    return (jd - 2451545.0) / 365250.0;
+}
+
+// Convert the VSOP87 variables of a body into a position in Celestia's
+// coordinate system, and their rates into a velocity in km/day.
+static void toCelestiaCoordinates(int body, const double* v, const double* dv, Vector3d* position, Vector3d* velocity) {
+    if (body == (int)VSOP87Body::Sun) {
+        Vector3d p = Vector3d(v[0], v[1], v[2]) * KM_PER_AU;
+        if (position != nullptr)
+            *position = Vector3d(p.x(), p.z(), -p.y());
+        if (velocity != nullptr) {
+            Vector3d dp = Vector3d(dv[0], dv[1], dv[2]) * (KM_PER_AU / 365250.0);
+            *velocity = Vector3d(dp.x(), dp.z(), -dp.y());
+        }
+        return;
+    }
+
+    // Corrections for internal coordinate system
+    double l = v[0] + PI;
+    double b = v[1] - PI / 2;
+    double r = v[2] * KM_PER_AU;
+
+    double sinl = sin(l), cosl = cos(l);
+    double sinb = sin(b), cosb = cos(b);
+    if (position != nullptr)
+        *position = Vector3d(cosl * sinb * r, cosb * r, -sinl * sinb * r);
+
+    if (velocity != nullptr) {
+        double dl = dv[0] / 365250.0;
+        double db = dv[1] / 365250.0;
+        double dr = dv[2] * (KM_PER_AU / 365250.0);
+        *velocity = Vector3d(dr * cosl * sinb - r * sinl * sinb * dl + r * cosl * cosb * db,
+                             dr * cosb - r * sinb * db,
+                             -dr * sinl * sinb - r * cosl * sinb * dl - r * sinl * cosb * db);
+    }
+}
+
+void ComputeVSOP87States(VSOP87Body body,
+                         const double* jds,
+                         size_t count,
+                         Vector3d* positions,
+                         Vector3d* velocities) {
+    double t[TimeBatch];
+    double values[TimeBatch * 3];
+    double rates[TimeBatch * 3];
+
+    for (size_t first = 0; first < count; first += TimeBatch) {
+        size_t n = min(TimeBatch, count - first);
+        for (size_t j = 0; j < n; j++)
+            t[j] = millenniaSinceJ2000(jds[first + j]);
+
+        evaluateBody((int)body, t, n, values, velocities != nullptr ? rates : nullptr);
+
+        for (size_t j = 0; j < n; j++) {
+            toCelestiaCoordinates((int)body, &values[j * 3], &rates[j * 3],
+                                  positions != nullptr ? &positions[first + j] : nullptr,
+                                  velocities != nullptr ? &velocities[first + j] : nullptr);
+        }
+    }
+}
+
+void ComputeVSOP87Positions(double jd, Vector3d* positions) {
+    double t = millenniaSinceJ2000(jd);
+    for (int body = 0; body < BodyCount; body++) {
+        double values[3];
+        evaluateBody(body, &t, 1, values, nullptr);
+        toCelestiaCoordinates(body, values, nullptr, &positions[body], nullptr);
+    }
+}
+
 class VSOP87Orbit : public CachingOrbit {
 private:
-    VSOPSeries* vsL;
-    int nL;
-    VSOPSeries* vsB;
-    int nB;
-    VSOPSeries* vsR;
-    int nR;
+    VSOP87Body body;
     double period;
     double boundingRadius;
 
 public:
-    VSOP87Orbit(VSOPSeries* _vsL,
-                int _nL,
-                VSOPSeries* _vsB,
-                int _nB,
-                VSOPSeries* _vsR,
-                int _nR,
-                double _period,
-                double _boundingRadius) :
-        vsL(_vsL),
-        nL(_nL), vsB(_vsB), nB(_nB), vsR(_vsR), nR(_nR), period(_period), boundingRadius(_boundingRadius){};
+    VSOP87Orbit(VSOP87Body _body, double _period, double _boundingRadius) :
+        body(_body), period(_period), boundingRadius(_boundingRadius){};
     virtual ~VSOP87Orbit(){};
 
     double getPeriod() const { return period; }
@@ -9772,45 +10188,19 @@ public:
     double getBoundingRadius() const { return boundingRadius; }
 
     Vector3d computePosition(double jd) const {
-        // t is Julian millenia since J2000.0
-        double t = (jd - 2451545.0) / 365250.0;
-
-        // Heliocentric coordinates
-        double l = 0.0;  // longitude
-        double b = 0.0;  // latitude
-        double r = 0.0;  // radius
-
-        int i;
-        double T;
-
-        // Evaluate series for l
-        T = 1;
-        for (i = 0; i < nL; i++) {
-            l += SumSeries(vsL[i], t) * T;
-            T = t * T;
-        }
-
-        // Evaluate series for b
-        T = 1;
-        for (i = 0; i < nB; i++) {
-            b += SumSeries(vsB[i], t) * T;
-            T = t * T;
-        }
-
-        // Evaluate series for r
-        T = 1;
-        for (i = 0; i < nR; i++) {
-            r += SumSeries(vsR[i], t) * T;
-            T = t * T;
-        }
-
-        r *= KM_PER_AU;
+        Vector3d position;
+        ComputeVSOP87States(body, &jd, 1, &position, nullptr);
+        return position;
+    }
 
-        // Corrections for internal coordinate system
-        b -= PI / 2;
-        l += PI;
+    Vector3d computeVelocity(double jd) const {
+        Vector3d velocity;
+        ComputeVSOP87States(body, &jd, 1, nullptr, &velocity);
+        return velocity;
+    }
 
-        return Vector3d(cos(l) * sin(b) * r, cos(b) * r, -sin(l) * sin(b) * r);
+    void statesAtTimes(const double* jds, size_t count, Vector3d* positions, Vector3d* velocities) const override {
+        ComputeVSOP87States(body, jds, count, positions, velocities);
     }
 
     /** Custom implementation of sample() for VSOP87 orbits. The default
@@ -9836,26 +10226,13 @@ public:
 // VSOP87 orbit with rectangular variables
 class VSOP87OrbitRect : public CachingOrbit {
 private:
-    VSOPSeries* vsX;
-    int nX;
-    VSOPSeries* vsY;
-    int nY;
-    VSOPSeries* vsZ;
-    int nZ;
+    VSOP87Body body;
     double period;
     double boundingRadius;
 
 public:
-    VSOP87OrbitRect(VSOPSeries* _vsX,
-                    int _nX,
-                    VSOPSeries* _vsY,
-                    int _nY,
-                    VSOPSeries* _vsZ,
-                    int _nZ,
-                    double _period,
-                    double _boundingRadius) :
-        vsX(_vsX),
-        nX(_nX), vsY(_vsY), nY(_nY), vsZ(_vsZ), nZ(_nZ), period(_period), boundingRadius(_boundingRadius){};
+    VSOP87OrbitRect(VSOP87Body _body, double _period, double _boundingRadius) :
+        body(_body), period(_period), boundingRadius(_boundingRadius){};
     virtual ~VSOP87OrbitRect(){};
 
     double getPeriod() const { return period; }
@@ -9865,39 +10242,19 @@ public:
     double getBoundingRadius() const { return boundingRadius; }
 
     Vector3d computePosition(double jd) const {
-        // t is Julian millenia since J2000.0
-        double t = (jd - 2451545.0) / 365250.0;
-
-        Vector3d v(Vector3d::Zero());
-
-        int i;
-        double T;
-
-        // Evaluate series for x
-        T = 1;
-        for (i = 0; i < nX; i++) {
-            v.x() += SumSeries(vsX[i], t) * T;
-            T = t * T;
-        }
-
-        // Evaluate series for y
-        T = 1;
-        for (i = 0; i < nY; i++) {
-            v.y() += SumSeries(vsY[i], t) * T;
-            T = t * T;
-        }
-
-        // Evaluate series for z
-        T = 1;
-        for (i = 0; i < nZ; i++) {
-            v.z() += SumSeries(vsZ[i], t) * T;
-            T = t * T;
-        }
+        Vector3d position;
+        ComputeVSOP87States(body, &jd, 1, &position, nullptr);
+        return position;
+    }
 
-        v *= KM_PER_AU;
+    Vector3d computeVelocity(double jd) const {
+        Vector3d velocity;
+        ComputeVSOP87States(body, &jd, 1, nullptr, &velocity);
+        return velocity;
+    }
 
-        // Corrections for internal coordinate system
-        return Vector3d(v.x(), v.z(), -v.y());
+    void statesAtTimes(const double* jds, size_t count, Vector3d* positions, Vector3d* velocities) const override {
+        ComputeVSOP87States(body, jds, count, positions, velocities);
     }
 };
 
@@ -9907,31 +10264,31 @@ static double yearToJD(int year) {
 
 Orbit::Pointer CreateVSOP87Orbit(const string& name) {
     if (name == "vsop87-mercury") {
-        auto o = std::make_shared<VSOP87Orbit>(mercury_L, 6, mercury_B, 6, mercury_R, 5, 0.2408 * 365.25, 60000000.0);
+        auto o = std::make_shared<VSOP87Orbit>(VSOP87Body::Mercury, 0.2408 * 365.25, 60000000.0);
         return std::make_shared<MixedOrbit>(o, yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     } else if (name == "vsop87-venus") {
-        auto o = std::make_shared<VSOP87Orbit>(venus_L, 6, venus_B, 6, venus_R, 5, 0.6152 * 365.25, 100000000.0);
+        auto o = std::make_shared<VSOP87Orbit>(VSOP87Body::Venus, 0.6152 * 365.25, 100000000.0);
         return std::make_shared<MixedOrbit>(o, yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     } else if (name == "vsop87-earth") {
-        auto o = std::make_shared<VSOP87Orbit>(earth_L, 6, earth_B, 3, earth_R, 6, 365.25, 160000000.0);
+        auto o = std::make_shared<VSOP87Orbit>(VSOP87Body::Earth, 365.25, 160000000.0);
         return std::make_shared<MixedOrbit>(o, yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     } else if (name == "vsop87-mars") {
-        auto o = std::make_shared<VSOP87Orbit>(mars_L, 6, mars_B, 6, mars_R, 6, 1.8809 * 365.25, 240000000);
+        auto o = std::make_shared<VSOP87Orbit>(VSOP87Body::Mars, 1.8809 * 365.25, 240000000);
         return std::make_shared<MixedOrbit>(o, yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     } else if (name == "vsop87-jupiter") {
-        auto o = std::make_shared<VSOP87Orbit>(jupiter_L, 6, jupiter_B, 6, jupiter_R, 6, 11.86 * 365.25, 800000000.0);
+        auto o = std::make_shared<VSOP87Orbit>(VSOP87Body::Jupiter, 11.86 * 365.25, 800000000.0);
         return std::make_shared<MixedOrbit>(o, yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     } else if (name == "vsop87-saturn") {
-        auto o = std::make_shared<VSOP87Orbit>(saturn_L, 6, saturn_B, 6, saturn_R, 6, 29.4577 * 365.25, 1.5e9);
+        auto o = std::make_shared<VSOP87Orbit>(VSOP87Body::Saturn, 29.4577 * 365.25, 1.5e9);
         return std::make_shared<MixedOrbit>(o, yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     } else if (name == "vsop87-uranus") {
-        auto o = std::make_shared<VSOP87Orbit>(uranus_L, 5, uranus_B, 4, uranus_R, 5, 84.0139 * 365.25, 3.0e9);
+        auto o = std::make_shared<VSOP87Orbit>(VSOP87Body::Uranus, 84.0139 * 365.25, 3.0e9);
         return std::make_shared<MixedOrbit>(o, yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     } else if (name == "vsop87-neptune") {
-        auto o = std::make_shared<VSOP87Orbit>(neptune_L, 4, neptune_B, 4, neptune_R, 5, 164.793 * 365.25, 4.7e9);
+        auto o = std::make_shared<VSOP87Orbit>(VSOP87Body::Neptune, 164.793 * 365.25, 4.7e9);
         return std::make_shared<MixedOrbit>(o, yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     } else if (name == "vsop87-sun") {
-        auto o = std::make_shared<VSOP87OrbitRect>(sun_X, 5, sun_Y, 5, sun_Z, 3, 0.0, 2000000);
+        auto o = std::make_shared<VSOP87OrbitRect>(VSOP87Body::Sun, 0.0, 2000000);
         return std::make_shared<MixedOrbit>(o, yearToJD(-4000), yearToJD(6000), astro::SolarMass);
     }
 
@@ -10,9 +10,61 @@
 #ifndef _CELENGINE_VSOP87_H_
 #define _CELENGINE_VSOP87_H_
 
+#include <cstddef>
 #include <string>
+#include <Eigen/Core>
 #include "orbit.h"
 
+// The planets of VSOP87B and the Sun of VSOP87E
+enum class VSOP87Body
+{
+    Mercury,
+    Venus,
+    Earth,
+    Mars,
+    Jupiter,
+    Saturn,
+    Uranus,
+    Neptune,
+    Sun,
+    Count
+};
+
+enum class VSOP87Kernel
+{
+    Scalar,
+    SSE2,
+    AVX2,
+};
+
 extern Orbit::Pointer CreateVSOP87Orbit(const std::string& name);
 
+/*! Compute the positions of body at count times (TDB), in kilometers and in
+ *  the frame of the orbits made by CreateVSOP87Orbit: heliocentric for the
+ *  planets and barycentric for the Sun. Each series is evaluated for all of
+ *  the times while its terms are in cache. velocities may be null; when
+ *  given, they are the exact derivatives of the series in km/day.
+ */
+extern void ComputeVSOP87States(VSOP87Body body,
+                                const double* jds,
+                                size_t count,
+                                Eigen::Vector3d* positions,
+                                Eigen::Vector3d* velocities);
+
+/*! Compute the positions of all VSOP87 bodies at one time in a single sweep
+ *  over the term table; positions must have room for VSOP87Body::Count
+ *  entries.
+ */
+extern void ComputeVSOP87Positions(double jd, Eigen::Vector3d* positions);
+
+// The Scalar kernel sums the series with the C library cos and is the
+// reference. The vector kernels use a polynomial cos with a three part
+// reduction by pi/2, good to a few units in the last place for the arguments
+// met within +-10000 years of J2000. The kernel is chosen from the CPU
+// features on first use; setting an unsupported kernel falls back to the best
+// supported one.
+VSOP87Kernel GetVSOP87Kernel();
+void SetVSOP87Kernel(VSOP87Kernel);
+const char* GetVSOP87KernelName(VSOP87Kernel);
+
 #endif // _CELENGINE_VSOP87_H_
@@ -3,8 +3,10 @@
 #include <cstdlib>
 #include <cstdio>
 #include <cmath>
+#include <mutex>
 
 #include "mathlib.h"
+#include "random.h"
 
 using namespace Eigen;
 
@@ -133,7 +135,10 @@ static float g3[B + B + 2][3];
 static float g2[B + B + 2][2];
 static float g1[B + B + 2];
 
-static bool initialized = false;
+// The tables are filled from a fixed seed on first use, so that procedural
+// textures and models built from noise come out the same on every run.
+static const uint64_t NOISE_SEED = 0x5eed;
+static std::once_flag initialized;
 
 static void init(void);
 
@@ -147,8 +152,7 @@ static void init(void);
     r1 = r0 - 1.0f;
 
 float noise1(float arg) {
-    if (!initialized)
-        init();
+    std::call_once(initialized, init);
 
     int bx0, bx1;
     float rx0, rx1, t, u, v, vec[1];
@@ -168,8 +172,7 @@ float noise2(float vec[2]) {
     float rx0, rx1, ry0, ry1, *q, sx, sy, a, b, t, u, v;
     int i, j;
 
-    if (!initialized)
-        init();
+    std::call_once(initialized, init);
 
     setup(0, bx0, bx1, rx0, rx1);
     setup(1, by0, by1, ry0, ry1);
@@ -203,8 +206,7 @@ float noise2(float vec[2]) {
 }
 
 float noise3(float vec[3]) {
-    if (!initialized)
-        init();
+    std::call_once(initialized, init);
 
     int bx0, bx1, by0, by1, bz0, bz1, b00, b10, b01, b11;
     float rx0, rx1, ry0, ry1, rz0, rz1, *q, sy, sz, a, b, c, d, t, u, v;
@@ -274,17 +276,18 @@ static void normalize3(float v[3]) {
 
 static void init() {
     int i, j, k;
+    celmath::RandomGenerator rng(NOISE_SEED);
 
     for (i = 0; i < B; i++) {
-        g1[i] = Mathf::sfrand();
+        g1[i] = rng.sfrand();
 
-        g2[i][0] = Mathf::sfrand();
-        g2[i][1] = Mathf::sfrand();
+        g2[i][0] = rng.sfrand();
+        g2[i][1] = rng.sfrand();
         normalize2(g2[i]);
 
-        g3[i][0] = Mathf::sfrand();
-        g3[i][1] = Mathf::sfrand();
-        g3[i][2] = Mathf::sfrand();
+        g3[i][0] = rng.sfrand();
+        g3[i][1] = rng.sfrand();
+        g3[i][2] = rng.sfrand();
         normalize3(g3[i]);
     }
 
@@ -295,7 +298,7 @@ static void init() {
     // . . . and then shuffle it
     for (i = 0; i < B; i++) {
         k = p[i];
-        j = rand() % B;
+        j = rng.uniform(B);
         p[i] = p[j];
         p[j] = k;
     }
@@ -310,6 +313,4 @@ static void init() {
         g3[B + i][1] = g3[i][1];
         g3[B + i][2] = g3[i][2];
     }
-
-    initialized = true;
 }
@@ -0,0 +1,53 @@
+// random.h
+//
+// Copyright (C) 2001-2009, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef _CELMATH_RANDOM_H_
+#define _CELMATH_RANDOM_H_
+
+#include <cstdint>
+#include <utility>
+
+namespace celmath {
+/*! A small seeded random number generator (xorshift64*). Unlike rand(),
+ *  every generator has its own state, so generators on different threads
+ *  don't disturb each other, and a seed always yields the same sequence.
+ */
+class RandomGenerator {
+public:
+    explicit RandomGenerator(uint64_t seed) : state(seed != 0 ? seed : 0x9e3779b97f4a7c15ull) {}
+
+    uint32_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return (uint32_t)((state * 0x2545f4914f6cdd1dull) >> 32);
+    }
+
+    // return a random float in [0, 1]
+    float frand() { return (float)(next() >> 8) / 16777215.0f; }
+
+    // return a random float in [-1, 1]
+    float sfrand() { return frand() * 2 - 1; }
+
+    // return a random integer in [0, n)
+    uint32_t uniform(uint32_t n) { return (uint32_t)(((uint64_t)next() * n) >> 32); }
+
+    // Put the elements of a random access range in random order
+    template <class IT>
+    void shuffle(IT begin, IT end) {
+        for (auto n = end - begin; n > 1; n--)
+            std::swap(begin[n - 1], begin[uniform((uint32_t)n)]);
+    }
+
+private:
+    uint64_t state;
+};
+}  // namespace celmath
+
+#endif  // _CELMATH_RANDOM_H_
@@ -9,6 +9,7 @@
 // of the License, or (at your option) any later version.
 
 #include "mesh.h"
+#include "meshbvh.h"
 #include <cassert>
 #include <iostream>
 #include <algorithm>
@@ -127,6 +128,7 @@ void Mesh::setVertices(uint32_t _nVertices, const VertexDataPointer& vertexData)
     // should probably be static_cast<VertexList::VertexPart*>
     nVertices = _nVertices;
     vertices = vertexData;
+    bvh.reset();
 }
 
 bool Mesh::setVertexDescription(const VertexDescription& desc) {
@@ -134,6 +136,7 @@ bool Mesh::setVertexDescription(const VertexDescription& desc) {
         return false;
 
     vertexDesc = desc;
+    bvh.reset();
 
     return true;
 }
@@ -158,6 +161,7 @@ Mesh::PrimitiveGroup::Pointer Mesh::getGroup(uint32_t index) {
 
 uint32_t Mesh::addGroup(const PrimitiveGroup::Pointer& group) {
     groups.push_back(group);
+    bvh.reset();
     return static_cast<uint32_t>(groups.size());
 }
 
@@ -183,6 +187,7 @@ uint32_t Mesh::getGroupCount() const {
 
 void Mesh::clearGroups() {
     groups.clear();
+    bvh.reset();
 }
 
 const string& Mesh::getName() const {
@@ -199,6 +204,7 @@ void Mesh::remapIndices(const vector<index32>& indexMap) {
             i = indexMap[i];
         }
     }
+    bvh.reset();
 }
 
 void Mesh::remapMaterials(const vector<uint32_t>& materialMap) {
@@ -211,116 +217,20 @@ void Mesh::aggregateByMaterial() {
     sort(groups.begin(), groups.end(), [](const Mesh::PrimitiveGroup::Pointer& g0, const Mesh::PrimitiveGroup::Pointer& g1) {
         return g0->materialIndex < g1->materialIndex;
     });
+    bvh.reset();
 }
 
 bool Mesh::pick(const Vector3d& rayOrigin, const Vector3d& rayDirection, PickResult& result) const {
-    double maxDistance = 1.0e30;
-    double closest = maxDistance;
-
     // Pick will automatically fail without vertex positions--no reasonable
     // mesh should lack these.
-    if (vertexDesc.getAttribute(Position).semantic != Position || vertexDesc.getAttribute(Position).format != Float3) {
+    MeshBVH::Hit hit;
+    if (!getBVH()->closestHit(rayOrigin, rayDirection, 1.0e30, hit))
         return false;
-    }
-
-    uint32_t posOffset = vertexDesc.getAttribute(Position).offset;
-    char* vdata = reinterpret_cast<char*>(vertices->data());
-
-    // Iterate over all primitive groups in the mesh
-    for (auto group : groups) {
-        Mesh::PrimitiveGroupType primType = group->prim;
-        index32 nIndices = (index32)group->indices.size();
-
-        // Only attempt to compute the intersection of the ray with triangle
-        // groups.
-        if ((primType == TriList || primType == TriStrip || primType == TriFan) && (nIndices >= 3) &&
-            !(primType == TriList && nIndices % 3 != 0)) {
-            uint32_t primitiveIndex = 0;
-            index32 index = 0;
-            index32 i0 = group->indices[0];
-            index32 i1 = group->indices[1];
-            index32 i2 = group->indices[2];
-
-            // Iterate over the triangles in the primitive group
-            do {
-                // Get the triangle vertices v0, v1, and v2
-                Vector3d v0 =
-                    Map<Vector3f>(reinterpret_cast<float*>(vdata + i0 * vertexDesc.stride + posOffset)).cast<double>();
-                Vector3d v1 =
-                    Map<Vector3f>(reinterpret_cast<float*>(vdata + i1 * vertexDesc.stride + posOffset)).cast<double>();
-                Vector3d v2 =
-                    Map<Vector3f>(reinterpret_cast<float*>(vdata + i2 * vertexDesc.stride + posOffset)).cast<double>();
-
-                // Compute the edge vectors e0 and e1, and the normal n
-                Vector3d e0 = v1 - v0;
-                Vector3d e1 = v2 - v0;
-                Vector3d n = e0.cross(e1);
-
-                // c is the cosine of the angle between the ray and triangle normal
-                double c = n.dot(rayDirection);
-
-                // If the ray is parallel to the triangle, it either misses the
-                // triangle completely, or is contained in the triangle's plane.
-                // If it's contained in the plane, we'll still call it a miss.
-                if (c != 0.0) {
-                    double t = (n.dot(v0 - rayOrigin)) / c;
-                    if (t < closest && t > 0.0) {
-                        double m00 = e0.dot(e0);
-                        double m01 = e0.dot(e1);
-                        double m10 = e1.dot(e0);
-                        double m11 = e1.dot(e1);
-                        double det = m00 * m11 - m01 * m10;
-                        if (det != 0.0) {
-                            Vector3d p = rayOrigin + rayDirection * t;
-                            Vector3d q = p - v0;
-                            double q0 = e0.dot(q);
-                            double q1 = e1.dot(q);
-                            double d = 1.0 / det;
-                            double s0 = (m11 * q0 - m01 * q1) * d;
-                            double s1 = (m00 * q1 - m10 * q0) * d;
-                            if (s0 >= 0.0 && s1 >= 0.0 && s0 + s1 <= 1.0) {
-                                closest = t;
-                                result.group = group;
-                                result.primitiveIndex = primitiveIndex;
-                                result.distance = closest;
-                            }
-                        }
-                    }
-                }
-
-                // Get the indices for the next triangle
-                if (primType == TriList) {
-                    index += 3;
-                    if (index < nIndices) {
-                        i0 = group->indices[index + 0];
-                        i1 = group->indices[index + 1];
-                        i2 = group->indices[index + 2];
-                    }
-                } else if (primType == TriStrip) {
-                    index += 1;
-                    if (index < nIndices) {
-                        i0 = i1;
-                        i1 = i2;
-                        i2 = group->indices[index];
-                        // TODO: alternate orientation of triangles in a strip
-                    }
-                } else  // primType == TriFan
-                {
-                    index += 1;
-                    if (index < nIndices) {
-                        index += 1;
-                        i1 = i2;
-                        i2 = group->indices[index];
-                    }
-                }
-
-                primitiveIndex++;
-
-            } while (index < nIndices);
-        }
-    }
 
-    return closest != maxDistance;
+    result.group = groups[hit.group];
+    result.primitiveIndex = hit.primitive;
+    result.distance = hit.distance;
+    return true;
 }
 
 bool Mesh::pick(const Vector3d& rayOrigin, const Vector3d& rayDirection, double& distance) const {
@@ -332,6 +242,17 @@ bool Mesh::pick(const Vector3d& rayOrigin, const Vector3d& rayDirection, double&
     return hit;
 }
 
+std::shared_ptr<const MeshBVH> Mesh::getBVH() const {
+    // Picking may happen on more than one thread; if two threads both find
+    // the hierarchy missing, both build it and the last one is kept.
+    auto tree = std::atomic_load(&bvh);
+    if (tree == nullptr) {
+        tree = std::make_shared<MeshBVH>(*this);
+        std::atomic_store(&bvh, tree);
+    }
+    return tree;
+}
+
 AlignedBox<float, 3> Mesh::getBoundingBox() const {
     AlignedBox<float, 3> bbox;
 
@@ -374,6 +295,7 @@ void Mesh::transform(const Vector3f& translation, float scale) {
         const Vector3f tv = (Map<Vector3f>(reinterpret_cast<float*>(vdata)) + translation) * scale;
         Map<Vector3f>(reinterpret_cast<float*>(vdata)) = tv;
     }
+    bvh.reset();
 
     // Point sizes need to be scaled as well
     if (vertexDesc.getAttribute(PointSize).format == Float1) {
@@ -26,6 +26,7 @@ using VertexDataPointer = std::shared_ptr<VertexData>;
 using IndexData = std::vector<uint32_t>;
 using IndexDataPointer = std::shared_ptr<IndexData>;
 
+class MeshBVH;
 
 class Mesh {
 public:
@@ -168,6 +169,12 @@ public:
     bool pick(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction, PickResult& result) const;
     bool pick(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction, double& distance) const;
 
+    /*! Return the bounding volume hierarchy used for picking, building it
+     *  on first use. Changing the vertices or primitive groups through
+     *  the mesh discards it; changes made through a group pointer don't.
+     */
+    std::shared_ptr<const MeshBVH> getBVH() const;
+
     Eigen::AlignedBox<float, 3> getBoundingBox() const;
     void transform(const Eigen::Vector3f& translation, float scale);
 
@@ -194,6 +201,8 @@ private:
     std::vector<PrimitiveGroup::Pointer> groups;
 
     std::string name;
+
+    mutable std::shared_ptr<const MeshBVH> bvh;
 };
 
 }  // namespace cmod
@@ -0,0 +1,347 @@
+// meshbvh.cpp
+//
+// Copyright (C) 2004-2010, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "meshbvh.h"
+#include "mesh.h"
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <Eigen/Geometry>
+
+using namespace cmod;
+using namespace Eigen;
+using namespace std;
+
+// Leaves hold up to MaxLeafSize triangles, or up to MaxForcedLeafSize when
+// no split is cheaper by the surface area heuristic.
+static const uint32_t MaxLeafSize = 4;
+static const uint32_t MaxForcedLeafSize = 16;
+static const uint32_t BinCount = 16;
+
+// The build stops splitting at this depth, which bounds the traversal stack
+static const uint32_t MaxDepth = 64;
+
+// Cost of visiting a node relative to the cost of testing a triangle
+static const float TraversalCost = 1.0f;
+
+// Half the surface area of a box; only ratios matter to the heuristic
+static float surfaceArea(const AlignedBox3f& box) {
+    Vector3f d = box.sizes();
+    return d.x() * d.y() + d.y() * d.z() + d.z() * d.x();
+}
+
+MeshBVH::MeshBVH(const Mesh& mesh) {
+    const Mesh::VertexDescription& desc = mesh.getVertexDescription();
+    const Mesh::VertexAttribute& position = desc.getAttribute(Mesh::Position);
+
+    // Without vertex positions, there is nothing to hit
+    if (position.semantic != Mesh::Position || position.format != Mesh::Float3 || mesh.getVertexCount() == 0)
+        return;
+
+    const char* vdata = reinterpret_cast<const char*>(mesh.getVertexData()) + position.offset;
+    uint32_t nVertices = mesh.getVertexCount();
+    auto vertex = [&](Mesh::index32 i) {
+        return Vector3f(Map<const Vector3f>(reinterpret_cast<const float*>(vdata + (size_t)i * desc.stride)));
+    };
+
+    // Collect the triangles of every triangle list, strip and fan
+    for (uint32_t g = 0; g < mesh.getGroupCount(); g++) {
+        auto group = mesh.getGroup(g);
+        const auto& indices = group->indices;
+        auto nIndices = (uint32_t)indices.size();
+        if (nIndices < 3)
+            continue;
+
+        uint32_t nTriangles;
+        if (group->prim == Mesh::TriList && nIndices % 3 == 0)
+            nTriangles = nIndices / 3;
+        else if (group->prim == Mesh::TriStrip || group->prim == Mesh::TriFan)
+            nTriangles = nIndices - 2;
+        else
+            continue;
+
+        for (uint32_t k = 0; k < nTriangles; k++) {
+            Mesh::index32 i0, i1, i2;
+            if (group->prim == Mesh::TriList) {
+                i0 = indices[k * 3];
+                i1 = indices[k * 3 + 1];
+                i2 = indices[k * 3 + 2];
+            } else if (group->prim == Mesh::TriStrip) {
+                i0 = indices[k];
+                i1 = indices[k + 1];
+                i2 = indices[k + 2];
+            } else {
+                i0 = indices[0];
+                i1 = indices[k + 1];
+                i2 = indices[k + 2];
+            }
+            if (i0 >= nVertices || i1 >= nVertices || i2 >= nVertices)
+                continue;
+
+            triangles.push_back({ vertex(i0), vertex(i1), vertex(i2), g, k });
+        }
+    }
+
+    if (triangles.empty())
+        return;
+
+    auto nTriangles = (uint32_t)triangles.size();
+    vector<Vector3f> centroids(nTriangles);
+    for (uint32_t i = 0; i < nTriangles; i++)
+        centroids[i] = (triangles[i].v0 + triangles[i].v1 + triangles[i].v2) / 3.0f;
+
+    vector<uint32_t> order(nTriangles);
+    iota(order.begin(), order.end(), 0);
+    nodes.reserve(2 * nTriangles / MaxLeafSize + 1);
+    build(order, centroids, 0, nTriangles, 0);
+
+    // Store the triangles in leaf order
+    vector<Triangle> sorted(nTriangles);
+    for (uint32_t i = 0; i < nTriangles; i++)
+        sorted[i] = triangles[order[i]];
+    triangles.swap(sorted);
+}
+
+void MeshBVH::build(vector<uint32_t>& order,
+                    const vector<Vector3f>& centroids,
+                    uint32_t first,
+                    uint32_t count,
+                    uint32_t depth) {
+    auto index = (uint32_t)nodes.size();
+    nodes.push_back(Node());
+
+    AlignedBox3f bounds;
+    AlignedBox3f centroidBounds;
+    for (uint32_t i = first; i < first + count; i++) {
+        const Triangle& tri = triangles[order[i]];
+        bounds.extend(tri.v0);
+        bounds.extend(tri.v1);
+        bounds.extend(tri.v2);
+        centroidBounds.extend(centroids[order[i]]);
+    }
+    nodes[index].lower = bounds.min();
+    nodes[index].upper = bounds.max();
+
+    // Bin the triangle centroids along each axis and find the cheapest split
+    // between bins
+    int bestAxis = -1;
+    uint32_t bestSplit = 0;
+    float bestCost = numeric_limits<float>::max();
+    if (count > MaxLeafSize && depth < MaxDepth) {
+        for (int axis = 0; axis < 3; axis++) {
+            float lower = centroidBounds.min()[axis];
+            float extent = centroidBounds.max()[axis] - lower;
+            if (!(extent > 0.0f))
+                continue;
+
+            float scale = BinCount / extent;
+            AlignedBox3f binBounds[BinCount];
+            uint32_t binCounts[BinCount] = { 0 };
+            for (uint32_t i = first; i < first + count; i++) {
+                const Triangle& tri = triangles[order[i]];
+                uint32_t bin = min((uint32_t)((centroids[order[i]][axis] - lower) * scale), BinCount - 1);
+                binCounts[bin]++;
+                binBounds[bin].extend(tri.v0);
+                binBounds[bin].extend(tri.v1);
+                binBounds[bin].extend(tri.v2);
+            }
+
+            // Sweep from the right for the area and count above each split
+            float rightAreas[BinCount];
+            uint32_t rightCounts[BinCount];
+            AlignedBox3f side;
+            uint32_t sideCount = 0;
+            for (uint32_t bin = BinCount - 1; bin > 0; bin--) {
+                side.extend(binBounds[bin]);
+                sideCount += binCounts[bin];
+                rightAreas[bin] = sideCount > 0 ? surfaceArea(side) : 0.0f;
+                rightCounts[bin] = sideCount;
+            }
+
+            side.setEmpty();
+            sideCount = 0;
+            for (uint32_t split = 1; split < BinCount; split++) {
+                side.extend(binBounds[split - 1]);
+                sideCount += binCounts[split - 1];
+                if (sideCount == 0 || rightCounts[split] == 0)
+                    continue;
+
+                float cost = sideCount * surfaceArea(side) + rightCounts[split] * rightAreas[split];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = split;
+                }
+            }
+        }
+    }
+
+    float leafCost = count * surfaceArea(bounds);
+    float splitCost = TraversalCost * surfaceArea(bounds) + bestCost;
+    if (bestAxis < 0 || (splitCost >= leafCost && count <= MaxForcedLeafSize)) {
+        nodes[index].offset = first;
+        nodes[index].count = count;
+        return;
+    }
+
+    // Partition with exactly the same binning as above, so that both sides
+    // are known to be non-empty
+    float lower = centroidBounds.min()[bestAxis];
+    float scale = BinCount / (centroidBounds.max()[bestAxis] - lower);
+    auto begin = order.begin() + first;
+    auto middle = partition(begin, begin + count, [&](uint32_t t) {
+        return min((uint32_t)((centroids[t][bestAxis] - lower) * scale), BinCount - 1) < bestSplit;
+    });
+    auto leftCount = (uint32_t)(middle - begin);
+
+    nodes[index].count = 0;
+    build(order, centroids, first, leftCount, depth + 1);
+    nodes[index].offset = (uint32_t)nodes.size();
+    build(order, centroids, first + leftCount, count - leftCount, depth + 1);
+}
+
+// Find where the ray enters the box, if it does so before maxDistance
+static inline bool intersectBox(const Vector3f& lower,
+                                const Vector3f& upper,
+                                const Vector3d& origin,
+                                const Vector3d& invDirection,
+                                double maxDistance,
+                                double& entry) {
+    double tmin = 0.0;
+    double tmax = maxDistance;
+    for (int axis = 0; axis < 3; axis++) {
+        double t0 = (lower[axis] - origin[axis]) * invDirection[axis];
+        double t1 = (upper[axis] - origin[axis]) * invDirection[axis];
+        if (t0 > t1)
+            swap(t0, t1);
+        tmin = max(tmin, t0);
+        tmax = min(tmax, t1);
+    }
+    entry = tmin;
+    return tmin <= tmax;
+}
+
+// The same test that Mesh::pick has always used: a ray that lies in the
+// plane of the triangle misses it.
+static inline bool intersectTriangle(const Vector3f& v0f,
+                                     const Vector3f& v1f,
+                                     const Vector3f& v2f,
+                                     const Vector3d& origin,
+                                     const Vector3d& direction,
+                                     double closest,
+                                     double& distance) {
+    Vector3d v0 = v0f.cast<double>();
+    Vector3d e0 = v1f.cast<double>() - v0;
+    Vector3d e1 = v2f.cast<double>() - v0;
+    Vector3d n = e0.cross(e1);
+
+    double c = n.dot(direction);
+    if (c == 0.0)
+        return false;
+
+    double t = n.dot(v0 - origin) / c;
+    if (!(t < closest && t > 0.0))
+        return false;
+
+    double m00 = e0.dot(e0);
+    double m01 = e0.dot(e1);
+    double m11 = e1.dot(e1);
+    double det = m00 * m11 - m01 * m01;
+    if (det == 0.0)
+        return false;
+
+    Vector3d q = origin + direction * t - v0;
+    double q0 = e0.dot(q);
+    double q1 = e1.dot(q);
+    double d = 1.0 / det;
+    double s0 = (m11 * q0 - m01 * q1) * d;
+    double s1 = (m00 * q1 - m01 * q0) * d;
+    if (s0 >= 0.0 && s1 >= 0.0 && s0 + s1 <= 1.0) {
+        distance = t;
+        return true;
+    }
+    return false;
+}
+
+template <bool ANY>
+bool MeshBVH::traverse(const Vector3d& origin, const Vector3d& direction, double maxDistance, Hit* hit) const {
+    if (nodes.empty())
+        return false;
+
+    Vector3d invDirection = direction.cwiseInverse();
+    double closest = maxDistance;
+    bool found = false;
+    double entry;
+    if (!intersectBox(nodes[0].lower, nodes[0].upper, origin, invDirection, closest, entry))
+        return false;
+
+    // Visit the nearer child first and defer the other; a deferred node
+    // is skipped if a closer hit has been found by the time it is popped.
+    uint32_t stack[MaxDepth + 1];
+    uint32_t stackSize = 0;
+    uint32_t current = 0;
+    for (;;) {
+        const Node& node = nodes[current];
+        if (node.count > 0) {
+            for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+                const Triangle& tri = triangles[i];
+                double t;
+                if (intersectTriangle(tri.v0, tri.v1, tri.v2, origin, direction, closest, t)) {
+                    if (ANY)
+                        return true;
+                    closest = t;
+                    found = true;
+                    hit->distance = t;
+                    hit->group = tri.group;
+                    hit->primitive = tri.primitive;
+                }
+            }
+        } else {
+            uint32_t nearChild = current + 1;
+            uint32_t farChild = node.offset;
+            double nearEntry, farEntry;
+            bool hitNear = intersectBox(nodes[nearChild].lower, nodes[nearChild].upper, origin, invDirection, closest,
+                                        nearEntry);
+            bool hitFar = intersectBox(nodes[farChild].lower, nodes[farChild].upper, origin, invDirection, closest,
+                                       farEntry);
+            if (hitNear && hitFar) {
+                if (farEntry < nearEntry)
+                    swap(nearChild, farChild);
+                stack[stackSize++] = farChild;
+                current = nearChild;
+                continue;
+            }
+            if (hitNear || hitFar) {
+                current = hitNear ? nearChild : farChild;
+                continue;
+            }
+        }
+
+        bool next = false;
+        while (stackSize > 0 && !next) {
+            current = stack[--stackSize];
+            next = intersectBox(nodes[current].lower, nodes[current].upper, origin, invDirection, closest, entry);
+        }
+        if (!next)
+            return found;
+    }
+}
+
+bool MeshBVH::closestHit(const Vector3d& origin, const Vector3d& direction, double maxDistance, Hit& hit) const {
+    Hit closest;
+    if (!traverse<false>(origin, direction, maxDistance, &closest))
+        return false;
+
+    hit = closest;
+    return true;
+}
+
+bool MeshBVH::anyHit(const Vector3d& origin, const Vector3d& direction, double maxDistance) const {
+    return traverse<true>(origin, direction, maxDistance, nullptr);
+}
@@ -0,0 +1,90 @@
+// meshbvh.h
+//
+// Copyright (C) 2004-2010, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef _CELMODEL_MESHBVH_H_
+#define _CELMODEL_MESHBVH_H_
+
+#include <vector>
+#include <Eigen/Core>
+
+namespace cmod {
+
+class Mesh;
+
+/*! A bounding volume hierarchy over the triangles of a mesh, so that ray
+ *  queries only test the triangles near the ray. It's built with binned
+ *  SAH and kept as a flat array of nodes in depth first order: the first
+ *  child of an interior node directly follows it in the array.
+ *
+ *  Distances along a ray are measured in units of the length of its
+ *  direction, as in Mesh::pick.
+ */
+class MeshBVH {
+public:
+    struct Hit {
+        double distance;
+        uint32_t group;      // index of the primitive group in the mesh
+        uint32_t primitive;  // index of the triangle in the group
+    };
+
+    explicit MeshBVH(const Mesh& mesh);
+
+    /*! Find the closest triangle hit by the ray at a distance between zero
+     *  and maxDistance. Return false and leave hit unmodified if there is
+     *  none.
+     */
+    bool closestHit(const Eigen::Vector3d& origin,
+                    const Eigen::Vector3d& direction,
+                    double maxDistance,
+                    Hit& hit) const;
+
+    /*! Return true if the ray hits any triangle at a distance between zero
+     *  and maxDistance. This stops at the first hit found, so it is cheaper
+     *  than closestHit for occlusion tests.
+     */
+    bool anyHit(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction, double maxDistance) const;
+
+    uint32_t getTriangleCount() const { return (uint32_t)triangles.size(); }
+    uint32_t getNodeCount() const { return (uint32_t)nodes.size(); }
+
+private:
+    struct Triangle {
+        Eigen::Vector3f v0, v1, v2;
+        uint32_t group;
+        uint32_t primitive;
+    };
+
+    struct Node {
+        Eigen::Vector3f lower;
+        Eigen::Vector3f upper;
+        // The first triangle of a leaf, or the second child of an interior node
+        uint32_t offset;
+        // The number of triangles in a leaf; zero for an interior node
+        uint32_t count;
+    };
+
+    void build(std::vector<uint32_t>& order,
+               const std::vector<Eigen::Vector3f>& centroids,
+               uint32_t first,
+               uint32_t count,
+               uint32_t depth);
+
+    template <bool ANY>
+    bool traverse(const Eigen::Vector3d& origin,
+                  const Eigen::Vector3d& direction,
+                  double maxDistance,
+                  Hit* hit) const;
+
+    std::vector<Triangle> triangles;
+    std::vector<Node> nodes;
+};
+
+}  // namespace cmod
+
+#endif  // _CELMODEL_MESHBVH_H_
@@ -9,6 +9,7 @@
 // of the License, or (at your option) any later version.
 
 #include "model.h"
+#include "meshbvh.h"
 #include <cassert>
 #include <functional>
 #include <algorithm>
@@ -96,14 +97,16 @@ bool Model::pick(const Eigen::Vector3d& rayOrigin, const Eigen::Vector3d& rayDir
     double closest = maxDistance;
     Mesh::PickResult closestResult;
 
+    // Each mesh only searches for hits closer than the closest one found so
+    // far, so meshes behind it are rejected at the root of their hierarchy.
     for (const auto& mesh : meshes) {
-        Mesh::PickResult localResult;
-        if (mesh->pick(rayOrigin, rayDirection, result)) {
-            if (localResult.distance < closest) {
-                closestResult = localResult;
-                closestResult.mesh = mesh;
-                closest = localResult.distance;
-            }
+        MeshBVH::Hit hit;
+        if (mesh->getBVH()->closestHit(rayOrigin, rayDirection, closest, hit)) {
+            closest = hit.distance;
+            closestResult.mesh = mesh;
+            closestResult.group = mesh->getGroup(hit.group);
+            closestResult.primitiveIndex = hit.primitive;
+            closestResult.distance = hit.distance;
         }
     }
 
@@ -124,6 +127,14 @@ bool Model::pick(const Vector3d& rayOrigin, const Vector3d& rayDirection, double
     return hit;
 }
 
+bool Model::pickAny(const Vector3d& rayOrigin, const Vector3d& rayDirection, double maxDistance) const {
+    for (const auto& mesh : meshes) {
+        if (mesh->getBVH()->anyHit(rayOrigin, rayDirection, maxDistance))
+            return true;
+    }
+    return false;
+}
+
 /*! Translate and scale a model. The transformation applied to
  *  each vertex in the model is:
  *     v' = (v + translation) * scale
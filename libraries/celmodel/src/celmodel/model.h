@@ -77,6 +77,12 @@ public:
      */
     bool pick(const Eigen::Vector3d& rayOrigin, const Eigen::Vector3d& rayDirection, double& distance) const;
 
+    /** Return true if the ray intersects the model at a distance
+     *  less than maxDistance. This stops at the first intersection
+     *  found, so it is cheaper than pick for occlusion tests.
+     */
+    bool pickAny(const Eigen::Vector3d& rayOrigin, const Eigen::Vector3d& rayDirection, double maxDistance) const;
+
     void transform(const Eigen::Vector3f& translation, float scale);
 
     /** Apply a uniform scale to the model so that it fits into
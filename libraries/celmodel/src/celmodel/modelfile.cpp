@@ -12,6 +12,8 @@
 
 #include <celutil/bytes.h>
 #include <celutil/storage.hpp>
+#include <celutil/threadpool.h>
+#include <algorithm>
 #include <cstring>
 #include <cassert>
 #include <cmath>
@@ -507,6 +509,33 @@ static Token VerticesToken = Token::NameToken("vertices");
 static Token MaterialToken = Token::NameToken("material");
 static Token EndMaterialToken = Token::NameToken("end_material");
 
+/*! A vertex description compiled into the copies that turn the vertex
+ *  records of a binary file into vertex data. A record holds the
+ *  attributes in the order of the description, packed, so for the
+ *  descriptions read from binary files the record layout is the vertex
+ *  layout and the whole array is a single copy. Big endian hosts then
+ *  swap the bytes of every float.
+ */
+class VertexDecodePlan {
+public:
+    VertexDecodePlan(const Mesh::VertexDescription& vertexDesc);
+
+    uint32_t getRecordSize() const { return recordSize; }
+    void decode(const uint8_t* records, uint32_t vertexCount, uint8_t* vertexData) const;
+
+private:
+    struct Run {
+        uint32_t source;
+        uint32_t dest;
+        uint32_t size;
+    };
+
+    uint32_t stride;
+    uint32_t recordSize{ 0 };
+    std::vector<Run> runs;
+    std::vector<uint32_t> swappedWords;
+};
+
 class BinaryModelLoader : public ModelLoader {
 public:
     BinaryModelLoader(const IncrementalStorage::Pointer& _in);
@@ -521,6 +550,26 @@ public:
     VertexDataPointer loadVertices(const Mesh::VertexDescription& vertexDesc, uint32_t& vertexCount) override;
 
 private:
+    struct GroupLayout {
+        Mesh::PrimitiveGroupType type;
+        uint32_t materialIndex;
+        uint32_t indexCount;
+        const uint8_t* indices;
+    };
+
+    // A mesh whose vertex and index arrays have been located in the file
+    // but not yet decoded
+    struct MeshLayout {
+        Mesh::VertexDescription::Pointer vertexDesc;
+        std::shared_ptr<VertexDecodePlan> plan;
+        uint32_t vertexCount;
+        const uint8_t* vertices;
+        std::vector<GroupLayout> groups;
+    };
+
+    bool scanMesh(MeshLayout& layout);
+    static Mesh::Pointer decodeMesh(const MeshLayout& layout);
+
     IncrementalStorage::Pointer inPtr;
     IncrementalStorage& in;
 };
@@ -1065,8 +1114,12 @@ static bool ignoreValue(IncrementalStorage& in) {
     return true;
 }
 
+// Models with at least this many meshes decode them in parallel
+static const size_t ParallelMeshCount = 4;
+
 Model::Pointer BinaryModelLoader::load() {
     auto model = std::make_shared<Model>();
+    std::vector<MeshLayout> layouts;
     bool seenMeshes = false;
 
     if (model == nullptr) {
@@ -1095,18 +1148,37 @@ Model::Pointer BinaryModelLoader::load() {
         } else if (tok == CMOD_Mesh) {
             seenMeshes = true;
 
-            auto mesh = loadMesh();
-            if (!mesh) {
+            MeshLayout layout;
+            if (!scanMesh(layout)) {
                 return nullptr;
             }
 
-            model->addMesh(mesh);
+            layouts.push_back(std::move(layout));
         } else {
             reportError("Error: Unknown block type in model");
             return nullptr;
         }
     }
 
+    // Decoding a mesh only copies from the file, so the meshes of a large
+    // model are decoded at the same time.
+    std::vector<Mesh::Pointer> meshes(layouts.size());
+    auto decode = [&](size_t i) { meshes[i] = decodeMesh(layouts[i]); };
+    if (layouts.size() >= ParallelMeshCount) {
+        ThreadPool::getDefault().parallelFor(layouts.size(), decode);
+    } else {
+        for (size_t i = 0; i < layouts.size(); i++)
+            decode(i);
+    }
+
+    for (const auto& mesh : meshes) {
+        if (!mesh) {
+            reportError("Index out of range");
+            return nullptr;
+        }
+        model->addMesh(mesh);
+    }
+
     return model;
 }
 
@@ -1250,21 +1322,69 @@ Mesh::VertexDescription::Pointer BinaryModelLoader::loadVertexDescription() {
     return std::make_shared<Mesh::VertexDescription>(offset, attributes);
 }
 
-Mesh::Pointer BinaryModelLoader::loadMesh() {
-    auto vertexDesc = loadVertexDescription();
-    if (!vertexDesc) {
-        return nullptr;
+VertexDecodePlan::VertexDecodePlan(const Mesh::VertexDescription& vertexDesc) : stride(vertexDesc.stride) {
+    for (const auto& attr : vertexDesc.attributes) {
+        uint32_t size = Mesh::getVertexAttributeSize(attr.format);
+        if (!runs.empty() && runs.back().source + runs.back().size == recordSize &&
+            runs.back().dest + runs.back().size == attr.offset)
+            runs.back().size += size;
+        else
+            runs.push_back({ recordSize, attr.offset, size });
+#if defined(WORDS_BIGENDIAN) || defined(__BIG_ENDIAN__)
+        if (attr.format != Mesh::UByte4) {
+            for (uint32_t word = 0; word < size; word += 4)
+                swappedWords.push_back(attr.offset + word);
+        }
+#endif
+        recordSize += size;
+    }
+}
+
+void VertexDecodePlan::decode(const uint8_t* records, uint32_t vertexCount, uint8_t* vertexData) const {
+    if (runs.size() == 1 && runs[0].size == stride && recordSize == stride) {
+        memcpy(vertexData, records, (size_t)vertexCount * stride);
+    } else {
+        const uint8_t* record = records;
+        uint8_t* vertex = vertexData;
+        for (uint32_t i = 0; i < vertexCount; i++, record += recordSize, vertex += stride) {
+            for (const auto& run : runs)
+                memcpy(vertex + run.dest, record + run.source, run.size);
+        }
     }
 
-    uint32_t vertexCount = 0;
-    auto vertexData = loadVertices(*vertexDesc, vertexCount);
-    if (!vertexData) {
-        return nullptr;
+    if (!swappedWords.empty()) {
+        uint8_t* vertex = vertexData;
+        for (uint32_t i = 0; i < vertexCount; i++, vertex += stride) {
+            for (uint32_t offset : swappedWords) {
+                float f;
+                memcpy(&f, vertex + offset, sizeof(float));
+                LE_TO_CPU_FLOAT(f, f);
+                memcpy(vertex + offset, &f, sizeof(float));
+            }
+        }
     }
+}
 
-    auto mesh = std::make_shared<Mesh>();
-    mesh->setVertexDescription(*vertexDesc);
-    mesh->setVertices(vertexCount, vertexData);
+bool BinaryModelLoader::scanMesh(MeshLayout& layout) {
+    layout.vertexDesc = loadVertexDescription();
+    if (!layout.vertexDesc) {
+        return false;
+    }
+
+    if (readToken(in) != CMOD_Vertices) {
+        reportError("Vertex data expected");
+        return false;
+    }
+
+    layout.plan = std::make_shared<VertexDecodePlan>(*layout.vertexDesc);
+    layout.vertexCount = readUint(in);
+    size_t vertexDataSize = (size_t)layout.plan->getRecordSize() * layout.vertexCount;
+    if (in.remaining() < vertexDataSize) {
+        reportError("Unexpected end of vertex data");
+        return false;
+    }
+    layout.vertices = in.current();
+    in.ignore(vertexDataSize);
 
     for (;;) {
         int16_t tok = readInt16(in);
@@ -1273,28 +1393,69 @@ Mesh::Pointer BinaryModelLoader::loadMesh() {
             break;
         } else if (tok < 0 || tok >= Mesh::PrimitiveTypeMax) {
             reportError("Bad primitive group type");
-            return nullptr;
+            return false;
         }
 
-        Mesh::PrimitiveGroupType type = static_cast<Mesh::PrimitiveGroupType>(tok);
-        uint32_t materialIndex = readUint(in);
-        uint32_t indexCount = readUint(in);
+        GroupLayout group;
+        group.type = static_cast<Mesh::PrimitiveGroupType>(tok);
+        group.materialIndex = readUint(in);
+        group.indexCount = readUint(in);
 
-        IndexData indices;
-        indices.resize(indexCount);
+        size_t indexDataSize = (size_t)group.indexCount * sizeof(uint32_t);
+        if (in.remaining() < indexDataSize) {
+            reportError("Unexpected end of index data");
+            return false;
+        }
+        group.indices = in.current();
+        in.ignore(indexDataSize);
 
-        for (uint32_t i = 0; i < indexCount; i++) {
-            uint32_t index = readUint(in);
-            if (index >= vertexCount) {
-                reportError("Index out of range");
-                return nullptr;
-            }
+        layout.groups.push_back(group);
+    }
 
-            indices[i] = index;
+    return true;
+}
+
+// Return nullptr if an index is out of range. This only reads the layout,
+// so the meshes of a model can be decoded on several threads.
+Mesh::Pointer BinaryModelLoader::decodeMesh(const MeshLayout& layout) {
+    auto vertexData = std::make_shared<VertexData>();
+    vertexData->resize((size_t)layout.vertexDesc->stride * layout.vertexCount);
+    layout.plan->decode(layout.vertices, layout.vertexCount, vertexData->data());
+
+    auto mesh = std::make_shared<Mesh>();
+    mesh->setVertexDescription(*layout.vertexDesc);
+    mesh->setVertices(layout.vertexCount, vertexData);
+
+    for (const auto& group : layout.groups) {
+        IndexData indices;
+        indices.resize(group.indexCount);
+        memcpy(indices.data(), group.indices, (size_t)group.indexCount * sizeof(uint32_t));
+
+        uint32_t maxIndex = 0;
+        for (auto& index : indices) {
+            LE_TO_CPU_INT32(index, index);
+            maxIndex = std::max(maxIndex, index);
         }
-        mesh->addGroup(type, materialIndex, indices);
+        if (group.indexCount > 0 && maxIndex >= layout.vertexCount) {
+            return nullptr;
+        }
+
+        mesh->addGroup(group.type, group.materialIndex, indices);
+    }
+
+    return mesh;
+}
+
+Mesh::Pointer BinaryModelLoader::loadMesh() {
+    MeshLayout layout;
+    if (!scanMesh(layout)) {
+        return nullptr;
     }
 
+    auto mesh = decodeMesh(layout);
+    if (!mesh) {
+        reportError("Index out of range");
+    }
     return mesh;
 }
 
@@ -1304,47 +1465,18 @@ VertexDataPointer BinaryModelLoader::loadVertices(const Mesh::VertexDescription&
         return nullptr;
     }
 
+    VertexDecodePlan plan(vertexDesc);
     vertexCount = readUint(in);
-    uint32_t vertexDataSize = vertexDesc.stride * vertexCount;
-    auto result = std::make_shared<VertexData>();
-    result->resize(vertexDataSize);
-    auto vertexData = result->data();
-
-    uint32_t offset = 0;
-    for (uint32_t i = 0; i < vertexCount; i++, offset += vertexDesc.stride) {
-        assert(offset < vertexDataSize);
-        for (const auto& attr : vertexDesc.attributes) {
-            uint32_t base = offset + attr.offset;
-            Mesh::VertexAttributeFormat fmt = attr.format;
-            /*int readCount = 0;    Unused*/
-            switch (fmt) {
-                case Mesh::Float1:
-                    reinterpret_cast<float*>(vertexData + base)[0] = readFloat(in);
-                    break;
-                case Mesh::Float2:
-                    reinterpret_cast<float*>(vertexData + base)[0] = readFloat(in);
-                    reinterpret_cast<float*>(vertexData + base)[1] = readFloat(in);
-                    break;
-                case Mesh::Float3:
-                    reinterpret_cast<float*>(vertexData + base)[0] = readFloat(in);
-                    reinterpret_cast<float*>(vertexData + base)[1] = readFloat(in);
-                    reinterpret_cast<float*>(vertexData + base)[2] = readFloat(in);
-                    break;
-                case Mesh::Float4:
-                    reinterpret_cast<float*>(vertexData + base)[0] = readFloat(in);
-                    reinterpret_cast<float*>(vertexData + base)[1] = readFloat(in);
-                    reinterpret_cast<float*>(vertexData + base)[2] = readFloat(in);
-                    reinterpret_cast<float*>(vertexData + base)[3] = readFloat(in);
-                    break;
-                case Mesh::UByte4:
-                    in.read(reinterpret_cast<char*>(vertexData + base), 4);
-                    break;
-                default:
-                    assert(0);
-                    return nullptr;
-            }
-        }
+    size_t vertexDataSize = (size_t)plan.getRecordSize() * vertexCount;
+    if (in.remaining() < vertexDataSize) {
+        reportError("Unexpected end of vertex data");
+        return nullptr;
     }
+
+    auto result = std::make_shared<VertexData>();
+    result->resize((size_t)vertexDesc.stride * vertexCount);
+    plan.decode(in.current(), vertexCount, result->data());
+    in.ignore(vertexDataSize);
     return result;
 }
 
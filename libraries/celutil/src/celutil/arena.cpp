@@ -0,0 +1,44 @@
+// arena.cpp
+//
+// Copyright (C) 2001-2009, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "arena.h"
+
+#include <new>
+
+using namespace std;
+
+// Enough for any of the objects placed in an arena
+static const uint32_t ArenaAlignment = 16;
+
+Arena::Arena(uint32_t blockSize) : pool(ArenaAlignment, blockSize) {
+}
+
+Arena::~Arena() {
+    for (void* block : largeBlocks)
+        ::operator delete(block);
+}
+
+void* Arena::allocate(size_t size) {
+    // Keep big requests from wasting the tail of a pool block
+    if (size > pool.blockSize() / 4) {
+        // Make room first so that the block can't leak
+        largeBlocks.push_back(nullptr);
+        largeBlocks.back() = ::operator new(size);
+        return largeBlocks.back();
+    }
+
+    void* memory = pool.allocate((uint32_t)size);
+    if (memory == nullptr)
+        throw std::bad_alloc();
+    return memory;
+}
+
+const string* Arena::intern(const string& s) {
+    return &*strings.insert(s).first;
+}
@@ -0,0 +1,89 @@
+// arena.h
+//
+// Copyright (C) 2001-2009, the Celestia Development Team
+//
+// Reference counted MemoryPool for groups of objects that die together.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef _CELUTIL_ARENA_H_
+#define _CELUTIL_ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "memorypool.h"
+
+/*! An Arena hands out memory from a MemoryPool and never frees it
+ *  individually: everything goes at once when the arena is destroyed.
+ *  Objects are placed in it through ArenaAllocator, each copy of which
+ *  holds a reference to the arena, so the arena lives exactly as long as
+ *  the last container or shared_ptr control block allocated from it.
+ *
+ *  An arena isn't thread safe; it should be filled by one thread at a time.
+ *  Releasing the objects may happen anywhere.
+ */
+class Arena {
+public:
+    explicit Arena(uint32_t blockSize = 64 * 1024);
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size);
+
+    // Return a string equal to s owned by the arena; equal strings always
+    // map to the same object.
+    const std::string* intern(const std::string& s);
+
+private:
+    MemoryPool pool;
+    // Requests too large for the pool blocks
+    std::vector<void*> largeBlocks;
+    std::unordered_set<std::string> strings;
+};
+
+template <class T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    // A default constructed allocator has no arena and falls back to the
+    // global heap.
+    ArenaAllocator() noexcept = default;
+    explicit ArenaAllocator(const std::shared_ptr<Arena>& arena) noexcept : arena(arena) {}
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena(other.arena) {}
+
+    T* allocate(size_t n) {
+        if (arena == nullptr)
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        return static_cast<T*>(arena->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t) noexcept {
+        if (arena == nullptr)
+            ::operator delete(p);
+    }
+
+    std::shared_ptr<Arena> arena;
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+    return a.arena == b.arena;
+}
+
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+    return a.arena != b.arena;
+}
+
+#endif  // _CELUTIL_ARENA_H_
@@ -63,7 +63,7 @@ inline double bswap_double(double d) {
 
 #define LE_TO_CPU_FLOAT(ret, val) SWAP_FLOAT(ret, val)
 
-#define LE_TO_CPU_DOUBLE(ret, val) (ret = bswap_double(d))
+#define LE_TO_CPU_DOUBLE(ret, val) (ret = bswap_double(val))
 
 #define BE_TO_CPU_INT16(ret, val) (ret = val)
 
@@ -81,7 +81,7 @@ inline double bswap_double(double d) {
 
 #define BE_TO_CPU_FLOAT(ret, val) SWAP_FLOAT(ret, val)
 
-#define BE_TO_CPU_DOUBLE(ret, val) (ret = bswap_double(d))
+#define BE_TO_CPU_DOUBLE(ret, val) (ret = bswap_double(val))
 
 #define LE_TO_CPU_INT16(ret, val) (ret = val)
 
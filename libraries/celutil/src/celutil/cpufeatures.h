@@ -0,0 +1,29 @@
+// cpufeatures.h
+//
+// Copyright (C) 2001-2009, the Celestia Development Team
+//
+// Run time detection of the instruction sets used by vector kernels.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef _CELUTIL_CPUFEATURES_H_
+#define _CELUTIL_CPUFEATURES_H_
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CELESTIA_X86_64 1
+#ifdef _MSC_VER
+#define CELESTIA_TARGET_AVX2
+#else
+// Lets AVX2 code live in a translation unit built for the x86-64 baseline
+#define CELESTIA_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// True if both the CPU and the OS support AVX2. SSE2 is part of the x86-64
+// baseline and needs no check.
+extern bool CPUSupportsAVX2();
+
+#endif  // _CELUTIL_CPUFEATURES_H_
@@ -46,7 +46,7 @@ MemoryPool::MemoryPool(uint32_t alignment, uint32_t blockSize) :
 MemoryPool::~MemoryPool()
 {
     for (list<Block>::iterator iter = m_blockList.begin(); iter != m_blockList.end(); iter++)
-        delete iter->m_memory;
+        delete[] iter->m_memory;
 }
 
 
@@ -66,6 +66,7 @@ MemoryPool::allocate(uint32_t size)
     if (m_blockOffset + size > m_blockSize)
     {
         m_currentBlock++;
+        m_blockOffset = 0;
     }
     
     // See if we need to allocate a new block
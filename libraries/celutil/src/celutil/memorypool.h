@@ -15,6 +15,7 @@
 #define _CELUTIL_MEMORYPOOL_H_
 
 #include <list>
+#include <cstdint>
 
 class MemoryPool
 {
@@ -0,0 +1,186 @@
+// profiler.cpp
+//
+// Copyright (C) 2001-2009, the Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+
+using namespace std;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+const Clock::time_point epoch = Clock::now();
+
+// The owning thread is the only writer; the mutex is only ever contended
+// while the buffers are being exported.
+struct ThreadBuffer {
+    std::mutex mutex;
+    std::vector<Profiler::Event> events;
+    size_t next{ 0 };
+    bool wrapped{ false };
+    uint32_t threadId;
+
+    explicit ThreadBuffer(uint32_t threadId) : events(Profiler::RingSize), threadId(threadId) {}
+
+    void push(const Profiler::Event& event) {
+        std::lock_guard<std::mutex> lock(mutex);
+        events[next] = event;
+        if (++next == events.size()) {
+            next = 0;
+            wrapped = true;
+        }
+    }
+
+    // Copy out the events oldest first
+    void copyTo(std::vector<Profiler::Event>& out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (wrapped)
+            out.insert(out.end(), events.begin() + next, events.end());
+        out.insert(out.end(), events.begin(), events.begin() + next);
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        next = 0;
+        wrapped = false;
+    }
+};
+
+// Buffers outlive their threads so that short lived threads still show up
+// in the trace.
+std::mutex registryMutex;
+std::vector<std::shared_ptr<ThreadBuffer>> registry;
+
+ThreadBuffer& threadBuffer() {
+    static thread_local std::shared_ptr<ThreadBuffer> buffer;
+    if (!buffer) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffer = std::make_shared<ThreadBuffer>((uint32_t)registry.size());
+        registry.push_back(buffer);
+    }
+    return *buffer;
+}
+
+std::vector<std::shared_ptr<ThreadBuffer>> snapshotRegistry() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    return registry;
+}
+
+void writeJsonString(ostream& out, const char* s) {
+    out << '"';
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\')
+            out << '\\';
+        out << *s;
+    }
+    out << '"';
+}
+
+}  // namespace
+
+std::atomic<bool> Profiler::enabled{ false };
+
+void Profiler::setEnabled(bool enable) {
+    enabled.store(enable, std::memory_order_relaxed);
+}
+
+int64_t Profiler::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - epoch).count();
+}
+
+uint16_t& Profiler::threadDepth() {
+    static thread_local uint16_t depth = 0;
+    return depth;
+}
+
+void Profiler::recordZone(const char* name, int64_t start, int64_t end, uint16_t depth) {
+    threadBuffer().push({ name, start, end, 0.0, depth, false });
+}
+
+void Profiler::recordCounter(const char* name, double value) {
+    int64_t t = now();
+    threadBuffer().push({ name, t, t, value, threadDepth(), true });
+}
+
+void Profiler::clear() {
+    for (const auto& buffer : snapshotRegistry())
+        buffer->clear();
+}
+
+std::vector<Profiler::ZoneStatistics> Profiler::getZoneStatistics() {
+    // Group by name rather than by pointer, as identical literals in
+    // different translation units needn't be merged.
+    std::map<std::string, std::vector<double>> durations;
+    std::vector<Event> events;
+    for (const auto& buffer : snapshotRegistry()) {
+        events.clear();
+        buffer->copyTo(events);
+        for (const auto& event : events) {
+            if (!event.counter)
+                durations[event.name].push_back((event.end - event.start) * 1.0e-6);
+        }
+    }
+
+    std::vector<ZoneStatistics> stats;
+    for (auto& zone : durations) {
+        auto& times = zone.second;
+        std::sort(times.begin(), times.end());
+        double total = 0.0;
+        for (double t : times)
+            total += t;
+
+        // Nearest rank percentiles
+        auto percentile = [&times](double p) {
+            size_t rank = (size_t)(p * (times.size() - 1) + 0.5);
+            return times[rank];
+        };
+
+        ZoneStatistics zoneStats;
+        zoneStats.name = zone.first;
+        zoneStats.count = (uint32_t)times.size();
+        zoneStats.mean = total / times.size();
+        zoneStats.p50 = percentile(0.5);
+        zoneStats.p99 = percentile(0.99);
+        zoneStats.max = times.back();
+        stats.push_back(zoneStats);
+    }
+
+    std::sort(stats.begin(), stats.end(), [](const ZoneStatistics& a, const ZoneStatistics& b) {
+        return a.mean * a.count > b.mean * b.count;
+    });
+    return stats;
+}
+
+bool Profiler::writeChromeTrace(ostream& out) {
+    out << "{\"traceEvents\":[\n";
+    bool first = true;
+    std::vector<Event> events;
+    for (const auto& buffer : snapshotRegistry()) {
+        events.clear();
+        buffer->copyTo(events);
+        for (const auto& event : events) {
+            out << (first ? "" : ",\n") << "{\"name\":";
+            writeJsonString(out, event.name);
+            out << ",\"pid\":1,\"tid\":" << buffer->threadId << ",\"ts\":" << event.start * 1.0e-3;
+            if (event.counter)
+                out << ",\"ph\":\"C\",\"args\":{\"value\":" << event.value << "}}";
+            else
+                out << ",\"ph\":\"X\",\"dur\":" << (event.end - event.start) * 1.0e-3 << "}";
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+    return out.good();
+}
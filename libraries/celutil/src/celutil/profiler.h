@@ -0,0 +1,117 @@
+// profiler.h
+//
+// Copyright (C) 2001-2009, the Celestia Development Team
+//
+// Lightweight instrumentation: scoped zones and counters recorded into
+// per-thread ring buffers.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef _CELUTIL_PROFILER_H_
+#define _CELUTIL_PROFILER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+/*! Zones are marked with PROFILE_ZONE("name") at the top of a scope and
+ *  counters with PROFILE_COUNTER("name", value).  Names must be string
+ *  literals: only the pointer is stored.
+ *
+ *  Recording is off until Profiler::setEnabled(true); a disabled zone costs
+ *  a single relaxed atomic load.  Building without CELESTIA_PROFILING
+ *  removes the macros altogether.
+ *
+ *  Each thread records into its own fixed size ring buffer, so the buffers
+ *  always hold the most recent events.  They can be exported as a Chrome
+ *  trace (chrome://tracing, Perfetto) or summarized into per zone
+ *  percentiles while the program runs.
+ */
+class Profiler {
+public:
+    struct Event {
+        const char* name;
+        int64_t start;  // ns since the profiler epoch
+        int64_t end;    // ns; equal to start for counters
+        double value;   // counter value; unused for zones
+        uint16_t depth;
+        bool counter;
+    };
+
+    struct ZoneStatistics {
+        std::string name;
+        uint32_t count;
+        double mean;  // all times in milliseconds
+        double p50;
+        double p99;
+        double max;
+    };
+
+    static const size_t RingSize = 16384;
+
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool);
+
+    static int64_t now();
+    static void recordZone(const char* name, int64_t start, int64_t end, uint16_t depth);
+    static void recordCounter(const char* name, double value);
+    // Discard everything recorded so far
+    static void clear();
+
+    // Statistics over the events currently held in the ring buffers, sorted
+    // by total time
+    static std::vector<ZoneStatistics> getZoneStatistics();
+    static bool writeChromeTrace(std::ostream&);
+
+    // Nesting depth of the calling thread's open zones
+    static uint16_t& threadDepth();
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+class ProfileZone {
+public:
+    explicit ProfileZone(const char* name) : name(Profiler::isEnabled() ? name : nullptr) {
+        if (this->name) {
+            depth = Profiler::threadDepth()++;
+            start = Profiler::now();
+        }
+    }
+
+    ~ProfileZone() {
+        if (name) {
+            Profiler::recordZone(name, start, Profiler::now(), depth);
+            --Profiler::threadDepth();
+        }
+    }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+    const char* name;
+    int64_t start{ 0 };
+    uint16_t depth{ 0 };
+};
+
+#if defined(CELESTIA_PROFILING) && CELESTIA_PROFILING
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone_, __LINE__)(name)
+#define PROFILE_COUNTER(name, value)                    \
+    do {                                                \
+        if (Profiler::isEnabled())                      \
+            Profiler::recordCounter(name, (double)(value)); \
+    } while (0)
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_COUNTER(name, value)
+#endif
+
+#endif  // _CELUTIL_PROFILER_H_
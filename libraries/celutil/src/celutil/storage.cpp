@@ -7,9 +7,16 @@
 
 #include "storage.hpp"
 #include <string>
+#include <cstring>
+#include <stdexcept>
 
 #if defined(WIN32)
 #include <Windows.h>
+#elif !defined(__ANDROID__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 namespace storage {
@@ -88,7 +95,7 @@ private:
     HANDLE _file{ INVALID_HANDLE_VALUE };
     HANDLE _mapFile{ INVALID_HANDLE_VALUE };
 #else
-    std::vector<uint8_t> _data;
+    int _file{ -1 };
 #endif
 };
 
@@ -116,25 +123,26 @@ FileStorage::FileStorage(const std::string& filename) {
     }
     _mapped = (uint8_t*)MapViewOfFile(_mapFile, FILE_MAP_READ, 0, 0, 0);
 #else
-    // FIXME move to posix memory mapped files
-    // open the file:
-    std::ifstream file(filename, std::ios::binary);
-    // Stop eating new lines in binary mode!!!
-    file.unsetf(std::ios::skipws);
-
-    // get its size:
-    std::streampos fileSize;
-
-    file.seekg(0, std::ios::end);
-    fileSize = file.tellg();
-    file.seekg(0, std::ios::beg);
-
-    // reserve capacity
-    _data.reserve(fileSize);
-
-    // read the data:
-    _data.insert(vec.begin(), std::istream_iterator<uint8_t>(file), std::istream_iterator<uint8_t>());
-    file.close();
+    _file = open(filename.c_str(), O_RDONLY);
+    if (_file < 0) {
+        throw std::runtime_error("Failed to open file");
+    }
+    struct stat fileStat;
+    if (fstat(_file, &fileStat) != 0) {
+        close(_file);
+        throw std::runtime_error("Failed to stat file");
+    }
+    _size = (size_t)fileStat.st_size;
+    // mmap rejects zero length mappings; an empty file simply has no data
+    if (_size > 0) {
+        void* mapped = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _file, 0);
+        if (mapped == MAP_FAILED) {
+            close(_file);
+            throw std::runtime_error("Failed to create mapping");
+        }
+        posix_madvise(mapped, _size, POSIX_MADV_SEQUENTIAL);
+        _mapped = (uint8_t*)mapped;
+    }
 #endif
 }
 
@@ -146,6 +154,10 @@ FileStorage::~FileStorage() {
     CloseHandle(_mapFile);
     CloseHandle(_file);
 #else
+    if (_mapped) {
+        munmap(_mapped, _size);
+    }
+    close(_file);
 #endif
 }
 
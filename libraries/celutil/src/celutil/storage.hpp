@@ -8,6 +8,8 @@
 #pragma once
 
 #include <stdint.h>
+#include <string.h>
+#include <string>
 #include <vector>
 #include <memory>
 
@@ -74,6 +76,10 @@ struct IncrementalStorage {
 
     size_t tellg() const { return offset; }
 
+    // The data that hasn't been read yet
+    const uint8_t* current() const { return storage->data() + offset; }
+    size_t remaining() const { return offset < storage->size() ? storage->size() - offset : 0; }
+
 private:
     StoragePointer storage;
     size_t offset{ 0 };
@@ -0,0 +1,147 @@
+// threadpool.cpp
+//
+// Copyright (C) 2001-2009, the Celestia Development Team
+//
+// A small work-stealing thread pool.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "threadpool.h"
+
+ThreadPool::ThreadPool(uint32_t nThreads) {
+    if (nThreads == 0) {
+        uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        nThreads = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+    }
+
+    for (uint32_t i = 0; i < nThreads; ++i) {
+        queues.emplace_back(new Queue());
+    }
+
+    for (uint32_t i = 0; i < nThreads; ++i) {
+        threads.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+ThreadPool& ThreadPool::getDefault() {
+    static ThreadPool pool;
+    return pool;
+}
+
+bool ThreadPool::popTask(uint32_t index, Task& task) {
+    auto& queue = *queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+        return false;
+
+    task = std::move(queue.tasks.front());
+    queue.tasks.pop_front();
+    --pendingTasks;
+    return true;
+}
+
+// Steal from the back of another queue.  A thief index outside the range of
+// worker queues (used by threads waiting in parallelFor) may steal from all.
+bool ThreadPool::stealTask(uint32_t thief, Task& task) {
+    uint32_t nQueues = (uint32_t)queues.size();
+    for (uint32_t i = 1; i <= nQueues; ++i) {
+        auto& queue = *queues[(thief + i) % nQueues];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            --pendingTasks;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(uint32_t index) {
+    for (;;) {
+        Task task;
+        if (popTask(index, task) || stealTask(index, task)) {
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wakeCondition.wait(lock, [this] { return stopping || pendingTasks > 0; });
+        if (stopping)
+            return;
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& fn) {
+    if (count == 0)
+        return;
+
+    // Without workers, or for a single call, there is nothing to gain from
+    // going through the queues.
+    if (threads.empty() || count == 1) {
+        for (size_t i = 0; i < count; ++i) {
+            fn(i);
+        }
+        return;
+    }
+
+    struct Completion {
+        std::atomic<size_t> remaining;
+        std::mutex mutex;
+        std::condition_variable done;
+    } completion;
+    completion.remaining = count;
+
+    // Deal the calls out round robin so that every worker starts with work
+    // of its own; imbalance is then handled by stealing.
+    uint32_t nQueues = (uint32_t)queues.size();
+    uint32_t first = nextQueue++;
+    for (size_t i = 0; i < count; ++i) {
+        Task task = [&fn, &completion, i] {
+            fn(i);
+            std::lock_guard<std::mutex> lock(completion.mutex);
+            if (--completion.remaining == 0)
+                completion.done.notify_all();
+        };
+
+        auto& queue = *queues[(first + i) % nQueues];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+        ++pendingTasks;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+    }
+    wakeCondition.notify_all();
+
+    // Help out until every call has been started, then wait for the rest
+    while (completion.remaining > 0) {
+        Task task;
+        if (stealTask(nQueues, task)) {
+            task();
+        } else {
+            std::unique_lock<std::mutex> lock(completion.mutex);
+            completion.done.wait(lock, [&completion] { return completion.remaining == 0; });
+        }
+    }
+
+    // The last task may still hold the lock after decrementing the count;
+    // don't let completion go out of scope underneath it.
+    std::lock_guard<std::mutex> lock(completion.mutex);
+}
@@ -0,0 +1,67 @@
+// threadpool.h
+//
+// Copyright (C) 2001-2009, the Celestia Development Team
+//
+// A small work-stealing thread pool.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef _CELUTIL_THREADPOOL_H_
+#define _CELUTIL_THREADPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*! Every worker thread owns a task queue.  Workers take tasks from the front
+ *  of their own queue and, when it runs dry, steal from the back of the other
+ *  workers' queues.  A thread waiting in parallelFor() helps by stealing too,
+ *  so parallelFor() may be called from inside a task without deadlocking.
+ */
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    // A thread count of zero uses one worker per hardware thread, minus one
+    // for the calling thread.
+    explicit ThreadPool(uint32_t nThreads = 0);
+    ~ThreadPool();
+
+    uint32_t getThreadCount() const { return (uint32_t)threads.size(); }
+
+    // Run fn(0) ... fn(count - 1) on the pool and return once all calls have
+    // completed.  The order in which the calls execute is unspecified.
+    void parallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+    // The pool shared by the engine; created on first use.
+    static ThreadPool& getDefault();
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void workerLoop(uint32_t index);
+    bool popTask(uint32_t index, Task& task);
+    bool stealTask(uint32_t thief, Task& task);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+    std::atomic<size_t> pendingTasks{ 0 };
+    std::atomic<uint32_t> nextQueue{ 0 };
+    bool stopping{ false };
+};
+
+#endif  // _CELUTIL_THREADPOOL_H_
@@ -0,0 +1,93 @@
+// timecache.h
+//
+// Copyright (C) 2001-2009, the Celestia Development Team
+//
+// Small thread safe memo of values computed for a time.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#ifndef _CELUTIL_TIMECACHE_H_
+#define _CELUTIL_TIMECACHE_H_
+
+#include <atomic>
+#include <cstdint>
+#include "profiler.h"
+
+// Hits and misses of every cache of one kind. They are only counted while
+// the profiler is enabled.
+struct TimeCacheStatistics {
+    std::atomic<uint64_t> hits{ 0 };
+    std::atomic<uint64_t> misses{ 0 };
+
+    void record(bool hit) {
+        if (Profiler::isEnabled())
+            (hit ? hits : misses).fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+/*! A TimeCache remembers what was computed at the last N distinct times.
+ *  ENTRY holds every value that may be cached for one time, each with its
+ *  own valid flag, and must reset to all invalid on default construction.
+ *
+ *  The cache never blocks: its entries are guarded by a try-lock, and a
+ *  thread that finds them in use by another simply counts a miss and
+ *  computes the value itself. The lock is never held while computing, so
+ *  the compute functions may query the cache again.
+ */
+template <class ENTRY, unsigned N = 4>
+class TimeCache {
+public:
+    TimeCache() = default;
+    // A copy starts out empty
+    TimeCache(const TimeCache&) {}
+    TimeCache& operator=(const TimeCache&) { return *this; }
+
+    /*! Call read(entry) on the entry for time t, if there is one; read
+     *  returns whether the entry held the wanted value.
+     */
+    template <class READ>
+    bool find(double t, TimeCacheStatistics& stats, READ read) const {
+        bool hit = false;
+        if (!busy.test_and_set(std::memory_order_acquire)) {
+            for (unsigned i = 0; i < N && !hit; i++) {
+                if (times[i] == t)
+                    hit = read(entries[i]);
+            }
+            busy.clear(std::memory_order_release);
+        }
+        stats.record(hit);
+        return hit;
+    }
+
+    /*! Call write(entry) on the entry for time t, replacing the oldest
+     *  entry if there is none.
+     */
+    template <class WRITE>
+    void store(double t, WRITE write) const {
+        if (busy.test_and_set(std::memory_order_acquire))
+            return;
+
+        unsigned i = 0;
+        while (i < N && times[i] != t)
+            i++;
+        if (i == N) {
+            i = next;
+            next = (next + 1) % N;
+            times[i] = t;
+            entries[i] = ENTRY();
+        }
+        write(entries[i]);
+        busy.clear(std::memory_order_release);
+    }
+
+private:
+    mutable std::atomic_flag busy = ATOMIC_FLAG_INIT;
+    mutable double times[N]{};
+    mutable ENTRY entries[N];
+    mutable unsigned next{ 0 };
+};
+
+#endif  // _CELUTIL_TIMECACHE_H_
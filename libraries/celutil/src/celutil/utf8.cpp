@@ -595,6 +595,33 @@ int UTF8StringCompare(const std::string& s0, const std::string& s1, size_t n)
 }
 
 
+//! Apply the normalization used by UTF8StringCompare to every character of
+//! a string.  Comparing normalized strings bytewise orders them the same way
+//! UTF8StringCompare does, as UTF-8 preserves code point order.  Bytes that
+//! aren't valid UTF-8 are copied unchanged.
+std::string UTF8NormalizeString(const std::string& s)
+{
+    std::string result;
+    result.reserve(s.length());
+
+    size_t i = 0;
+    while (i < s.length())
+    {
+        wchar_t ch = 0;
+        if (!UTF8Decode(s, i, ch))
+        {
+            result += s[i++];
+            continue;
+        }
+
+        i += UTF8EncodedSize(ch);
+        char buf[7];
+        result.append(buf, UTF8Encode(UTF8Normalize(ch), buf));
+    }
+
+    return result;
+}
+
 //! Currently incomplete, but could be a helpful class for dealing with
 //! UTF-8 streams
 class UTF8StringIterator
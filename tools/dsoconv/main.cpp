@@ -0,0 +1,131 @@
+// Converts a text deep sky catalog into the binary format that Celestia maps
+// directly, then loads the result back and checks that it yields the same
+// objects and names as the text catalog. By default the output is written
+// beside the input, where it is picked up automatically in place of the
+// text file.
+//
+// usage: dsoconv <catalog.dsc> [output]
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <chrono>
+#include <celengine/dsodb.h>
+#include <celengine/galaxy.h>
+#include <celengine/globular.h>
+#include <celengine/nebula.h>
+
+using namespace std;
+
+using Clock = std::chrono::high_resolution_clock;
+
+static double elapsedMs(const Clock::time_point& start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Describe the first difference between two objects, or return an empty
+// string if there is none
+static string compareDSOs(const DeepSkyObject& a, const DeepSkyObject& b) {
+    if (string(a.getObjTypeName()) != b.getObjTypeName())
+        return "object type";
+    if (a.getCatalogNumber() != b.getCatalogNumber())
+        return "catalog number";
+    if (a.getPosition() != b.getPosition())
+        return "position";
+    if (!a.getOrientation().coeffs().isApprox(b.getOrientation().coeffs(), 0.0f))
+        return "orientation";
+    if (a.getRadius() != b.getRadius() || a.getBoundingSphereRadius() != b.getBoundingSphereRadius())
+        return "radius";
+    if (a.getAbsoluteMagnitude() != b.getAbsoluteMagnitude())
+        return "absolute magnitude";
+    if (a.getInfoURL() != b.getInfoURL())
+        return "info URL";
+    if (a.isVisible() != b.isVisible() || a.isClickable() != b.isClickable())
+        return "flags";
+    if (string(a.getType()) != b.getType())
+        return "type";
+
+    if (auto galaxy = dynamic_cast<const Galaxy*>(&a)) {
+        auto other = static_cast<const Galaxy*>(&b);
+        if (galaxy->getDetail() != other->getDetail() || galaxy->getCustomTmpName() != other->getCustomTmpName() ||
+            galaxy->getForm() != other->getForm())
+            return "galaxy parameters";
+    } else if (auto globular = dynamic_cast<const Globular*>(&a)) {
+        auto other = static_cast<const Globular*>(&b);
+        if (globular->getDetail() != other->getDetail() ||
+            globular->getCustomTmpName() != other->getCustomTmpName() ||
+            globular->getCoreRadius() != other->getCoreRadius() ||
+            globular->getConcentration() != other->getConcentration() || globular->getForm() != other->getForm())
+            return "globular parameters";
+    } else if (auto nebula = dynamic_cast<const Nebula*>(&a)) {
+        if (nebula->getGeometryFileName() != static_cast<const Nebula*>(&b)->getGeometryFileName())
+            return "nebula mesh";
+    }
+    return "";
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 3) {
+        cerr << "usage: dsoconv <catalog.dsc> [output]" << endl;
+        return 1;
+    }
+    string source = argv[1];
+    string destination = argc > 2 ? argv[2] : BinaryDSOCatalogFilename(source);
+
+    // Relative info URLs are kept relative; they're resolved against the
+    // catalog directory when the binary catalog is loaded.
+    DSODatabase textDB;
+    textDB.setNameDatabase(std::make_shared<DSONameDatabase>());
+    auto start = Clock::now();
+    {
+        ifstream in(source, ios::in);
+        if (!in.good() || !textDB.load(in, "")) {
+            cerr << "Error reading " << source << endl;
+            return 1;
+        }
+    }
+    double textMs = elapsedMs(start);
+
+    {
+        ofstream out(destination, ios::out | ios::binary | ios::trunc);
+        if (!out.good() || !textDB.saveBinary(out)) {
+            cerr << "Error writing " << destination << endl;
+            return 1;
+        }
+    }
+
+    DSODatabase binaryDB;
+    binaryDB.setNameDatabase(std::make_shared<DSONameDatabase>());
+    start = Clock::now();
+    bool loaded = false;
+    try {
+        loaded = binaryDB.loadBinary(storage::Storage::readFile(destination), "");
+    } catch (const std::runtime_error&) {
+    }
+    if (!loaded) {
+        cerr << "Error reading back " << destination << endl;
+        return 1;
+    }
+    double binaryMs = elapsedMs(start);
+
+    if (textDB.size() != binaryDB.size()) {
+        cerr << "Object count differs: " << textDB.size() << " vs " << binaryDB.size() << endl;
+        return 1;
+    }
+    for (size_t i = 0; i < textDB.size(); i++) {
+        const auto& a = textDB.getDSO(i);
+        const auto& b = binaryDB.getDSO(i);
+        string difference = compareDSOs(*a, *b);
+        if (difference.empty() && textDB.getNameDatabase()->getNamesByCatalogNumber(a->getCatalogNumber()) !=
+                                      binaryDB.getNameDatabase()->getNamesByCatalogNumber(b->getCatalogNumber()))
+            difference = "names";
+        if (!difference.empty()) {
+            cerr << "Object " << i << " (" << textDB.getDSOName(a, true) << ") differs in " << difference << endl;
+            return 1;
+        }
+    }
+
+    cout << textDB.size() << " objects written to " << destination << endl;
+    cout << "text: " << textMs << " ms, binary: " << binaryMs << " ms" << endl;
+    return 0;
+}
@@ -0,0 +1,116 @@
+// Parses a synthetic .ssc catalog of small bodies, timing the tokenizer and
+// parser both from a stream and from storage, and the release of the parsed
+// definitions.
+//
+// usage: parsebench [objects] [iterations] [--write FILE]
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+#include <celengine/catalogrecord.h>
+
+using namespace std;
+
+using Clock = std::chrono::high_resolution_clock;
+
+static double elapsedMs(const Clock::time_point& start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Definitions shaped like those of the larger asteroid add-ons
+static string makeCatalog(int objectCount) {
+    ostringstream out;
+    out.precision(10);
+    srand(1);
+    for (int i = 0; i < objectCount; i++) {
+        double a = 1.5 + 3.5 * rand() / RAND_MAX;
+        out << "\"" << i + 1 << " Asteroid" << i + 1 << "\" \"Sol\"\n"
+            << "{\n"
+            << "    Class \"asteroid\"\n"
+            << "    Texture \"asteroid.jpg\"\n"
+            << "    Mesh \"asteroid.cms\"\n"
+            << "    Radius <km> " << 1.0 + 100.0 * rand() / RAND_MAX << "\n"
+            << "    Color [ 0.5 0.45 0.4 ]\n"
+            << "    EllipticalOrbit\n"
+            << "    {\n"
+            << "        Epoch 2455400.5\n"
+            << "        Period " << a * sqrt(a) << "\n"
+            << "        SemiMajorAxis " << a << "\n"
+            << "        Eccentricity " << 0.3 * rand() / RAND_MAX << "\n"
+            << "        Inclination " << 30.0 * rand() / RAND_MAX << "\n"
+            << "        AscendingNode " << 360.0 * rand() / RAND_MAX << "\n"
+            << "        ArgOfPericenter " << 360.0 * rand() / RAND_MAX << "\n"
+            << "        MeanAnomaly " << 360.0 * rand() / RAND_MAX << "\n"
+            << "    }\n"
+            << "    RotationPeriod " << 2.0 + 20.0 * rand() / RAND_MAX << "\n"
+            << "    Albedo 0.15\n"
+            << "    Visible true\n"
+            << "}\n\n";
+    }
+    return out.str();
+}
+
+int main(int argc, char* argv[]) {
+    int objectCount = 100000;
+    int iterations = 5;
+    string writeFile;
+
+    int position = 0;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--write" && i + 1 < argc) {
+            writeFile = argv[++i];
+        } else if (position == 0) {
+            objectCount = max(1, atoi(argv[i]));
+            position++;
+        } else if (position == 1) {
+            iterations = max(1, atoi(argv[i]));
+            position++;
+        } else {
+            cerr << "usage: parsebench [objects] [iterations] [--write FILE]" << endl;
+            return 1;
+        }
+    }
+
+    string catalog = makeCatalog(objectCount);
+    if (!writeFile.empty()) {
+        ofstream out(writeFile);
+        out << catalog;
+    }
+    auto file = storage::Storage::create(catalog.size(), (uint8_t*)&catalog[0]);
+
+    double streamBest = 1e30, storageBest = 1e30, releaseBest = 1e30;
+    for (int i = 0; i < iterations; i++) {
+        {
+            CatalogRecordList records;
+            istringstream in(catalog);
+            auto start = Clock::now();
+            if (!ReadCatalogRecords(in, records) || records.size() != (size_t)objectCount) {
+                cerr << "Parse error (stream)" << endl;
+                return 1;
+            }
+            streamBest = min(streamBest, elapsedMs(start));
+        }
+
+        CatalogRecordList records;
+        auto start = Clock::now();
+        if (!ReadCatalogRecords(file, records) || records.size() != (size_t)objectCount) {
+            cerr << "Parse error (storage)" << endl;
+            return 1;
+        }
+        storageBest = min(storageBest, elapsedMs(start));
+
+        start = Clock::now();
+        records.clear();
+        releaseBest = min(releaseBest, elapsedMs(start));
+    }
+
+    cout << objectCount << " objects, " << catalog.size() / (1024 * 1024) << " MB" << endl;
+    cout << "stream:  " << streamBest << " ms" << endl;
+    cout << "storage: " << storageBest << " ms (" << storageBest * 1000.0 / objectCount << " us/object)" << endl;
+    cout << "release: " << releaseBest << " ms" << endl;
+    return 0;
+}
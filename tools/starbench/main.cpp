@@ -0,0 +1,81 @@
+// Compares the stream based stars.dat loader against the memory mapped one.
+//
+// usage: starbench <stars.dat> [iterations]
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cstdlib>
+#include <celengine/stardb.h>
+
+using namespace std;
+
+using Clock = std::chrono::high_resolution_clock;
+
+static double elapsedMs(const Clock::time_point& start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static bool loadStream(const string& path, StarDatabase& db) {
+    ifstream in(path, ios::in | ios::binary);
+    return in.good() && db.loadBinary(in);
+}
+
+static bool loadMapped(const string& path, StarDatabase& db) {
+    try {
+        return db.loadBinary(storage::Storage::readFile(path));
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+}
+
+static bool sameStars(const StarDatabase& a, const StarDatabase& b) {
+    if (a.size() != b.size())
+        return false;
+    for (uint32_t i = 0; i < a.size(); i++) {
+        const auto& s0 = a.getStar(i);
+        const auto& s1 = b.getStar(i);
+        if (s0->getCatalogNumber() != s1->getCatalogNumber() || s0->getPosition() != s1->getPosition() ||
+            s0->getAbsoluteMagnitude() != s1->getAbsoluteMagnitude() || s0->getDetails() != s1->getDetails())
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "usage: starbench <stars.dat> [iterations]" << endl;
+        return 1;
+    }
+    string path = argv[1];
+    int iterations = argc > 2 ? max(1, atoi(argv[2])) : 5;
+
+    double streamBest = 1e30, mappedBest = 1e30;
+    for (int i = 0; i < iterations; i++) {
+        StarDatabase streamDB, mappedDB;
+
+        auto start = Clock::now();
+        if (!loadStream(path, streamDB)) {
+            cerr << "Error reading " << path << " (stream)" << endl;
+            return 1;
+        }
+        streamBest = min(streamBest, elapsedMs(start));
+
+        start = Clock::now();
+        if (!loadMapped(path, mappedDB)) {
+            cerr << "Error reading " << path << " (mapped)" << endl;
+            return 1;
+        }
+        mappedBest = min(mappedBest, elapsedMs(start));
+
+        if (i == 0 && !sameStars(streamDB, mappedDB)) {
+            cerr << "Loaders disagree on " << path << endl;
+            return 1;
+        }
+    }
+
+    cout << "stream: " << streamBest << " ms" << endl;
+    cout << "mapped: " << mappedBest << " ms" << endl;
+    cout << "speedup: " << streamBest / mappedBest << "x" << endl;
+    return 0;
+}
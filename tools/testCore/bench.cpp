@@ -0,0 +1,439 @@
+// Headless benchmark: loads a data set through CelestiaCore and runs scripted
+// camera paths through the simulation, Renderer::preRender and the star and
+// DSO culling passes without any graphics device. Results are written as
+// JSON.
+//
+// usage: celbench [--config celestia.cfg] [--frames N] [--path NAME]...
+//                 [--target PATH] [--output FILE] [--trace FILE]
+//        celbench --vsop87 [--output FILE]
+//
+// Paths: flythrough  move away from the Sun through the star field
+//        goto        travel to --target (default Sol/Earth)
+//        timeaccel   watch --target with time running 100000x faster
+//
+// --trace writes the profiling zones of the camera paths as a Chrome trace
+// (chrome://tracing, Perfetto); per zone percentiles are always included in
+// the JSON when the build has CELESTIA_PROFILING.
+//
+// --vsop87 needs no data set: it checks each vector VSOP87 kernel against the
+// scalar one over +-3000 years from J2000, then times evaluating one time per
+// call, batches of times and all bodies at once. It fails if any kernel is
+// off by more than VSOP87Tolerance.
+//
+// Run from the data directory, as the config file paths are relative to it.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include <celengine/forward.h>
+#include <celengine/universe.h>
+#include <celengine/stardb.h>
+#include <celengine/dsodb.h>
+#include <celengine/staroctree.h>
+#include <celengine/render.h>
+#include <celengine/simulation.h>
+#include <celastro/astro.h>
+#include <celephem/vsop87.h>
+#include <celmath/mathlib.h>
+#include <celutil/profiler.h>
+
+#include <celapp/celestiacore.h>
+
+using namespace std;
+using namespace Eigen;
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMs(const Clock::time_point& start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Collects the stage timings reported while the catalogs load.
+class TimingNotifier : public ProgressNotifier {
+public:
+    void update(const std::string&) override {}
+    void reportTiming(const std::string& stage, double milliseconds) override {
+        stages.push_back({ stage, milliseconds });
+    }
+
+    std::vector<std::pair<std::string, double>> stages;
+};
+
+class DSOCounter : public DSOHandler {
+public:
+    void process(const DeepSkyObject::Pointer&, double, float) override { ++count; }
+    uint32_t count{ 0 };
+};
+
+// Phase timings of one frame, in milliseconds.
+struct FrameStats {
+    double simulation{ 0.0 };
+    double preRender{ 0.0 };
+    double renderLists{ 0.0 };
+    double labelLists{ 0.0 };
+    double starCulling{ 0.0 };
+    double dsoCulling{ 0.0 };
+    uint32_t visibleStars{ 0 };
+    uint32_t visibleDSOs{ 0 };
+};
+
+// Does all the CPU side work of a frame and nothing else.
+class HeadlessRenderer : public Renderer {
+public:
+    void render(const ObserverPtr& observer, const UniversePtr& universe, float faintestVisible, const Selection& sel) override {
+        auto start = Clock::now();
+        preRender(*observer, *universe, faintestVisible, sel);
+        stats.preRender = elapsedMs(start);
+        stats.renderLists = getPreRenderTimings().renderLists;
+        stats.labelLists = getPreRenderTimings().labelLists;
+
+        Vector3d obsPos = observer->getPosition().toLy();
+        auto frustum = ComputeStarOctreeFrustum(obsPos.cast<float>(), observer->getOrientationf(), fovY, aspectRatio);
+        start = Clock::now();
+        universe->getStarCatalog()->findVisibleStars(visibleStars, obsPos.cast<float>(), frustum, faintestVisible);
+        stats.starCulling = elapsedMs(start);
+        stats.visibleStars = (uint32_t)visibleStars.size();
+
+        DSOCounter dsoCounter;
+        start = Clock::now();
+        universe->getDSOCatalog()->findVisibleDSOs(dsoCounter, obsPos, observer->getOrientationf(), fovY, aspectRatio,
+                                                   faintestVisible);
+        stats.dsoCulling = elapsedMs(start);
+        stats.visibleDSOs = dsoCounter.count;
+    }
+
+    FrameStats stats;
+
+private:
+    const float fovY{ degToRad(45.0f) };
+    const float aspectRatio{ 16.0f / 9.0f };
+    std::vector<VisibleStar> visibleStars;
+};
+
+struct PathResult {
+    std::string name;
+    std::vector<FrameStats> frames;
+};
+
+static const double FrameTime = 1.0 / 60.0;
+
+static PathResult runPath(const std::string& name,
+                          const std::string& target,
+                          int frameCount,
+                          const SimulationPtr& sim,
+                          HeadlessRenderer& renderer) {
+    PathResult result;
+    result.name = name;
+
+    sim->setTimeScale(1.0);
+    sim->setObserverOrientation(Quaternionf::Identity());
+    Selection targetSel = sim->findObjectFromPath(target);
+
+    if (name == "flythrough") {
+        // Start at the Sun and head out along -z, covering 1000 ly
+        sim->setSelection(Selection());
+        sim->setFrame(ObserverFrame::Universal, Selection());
+        sim->setObserverPosition(UniversalCoord::Zero());
+    } else if (targetSel.empty()) {
+        cerr << "Unknown target " << target << endl;
+        return result;
+    } else {
+        sim->setSelection(targetSel);
+        sim->gotoSelection(name == "goto" ? 5.0 : 0.0, Vector3f::UnitY(), ObserverFrame::ObserverLocal);
+        if (name == "timeaccel") {
+            // Arrive before the clock starts running fast
+            sim->update(FrameTime);
+            sim->setTimeScale(1.0e5);
+        }
+    }
+
+    for (int i = 0; i < frameCount; i++) {
+        if (name == "flythrough") {
+            double distance = 1000.0 * (double)i / (double)frameCount;
+            sim->setObserverPosition(UniversalCoord::CreateLy(Vector3d(0.0, 0.0, -distance)));
+        }
+
+        auto start = Clock::now();
+        sim->update(FrameTime);
+        double simulation = elapsedMs(start);
+
+        renderer.render(sim->getActiveObserver(), sim->getUniverse(), sim->getFaintestVisible(), sim->getSelection());
+        renderer.stats.simulation = simulation;
+        result.frames.push_back(renderer.stats);
+    }
+
+    return result;
+}
+
+// Writes {"total": ..., "mean": ..., "max": ...} for one phase of a path.
+template <class FIELD>
+static void writePhase(ostream& out, const char* phase, const std::vector<FrameStats>& frames, FIELD field, bool last = false) {
+    double total = 0.0, maxTime = 0.0;
+    for (const auto& frame : frames) {
+        total += frame.*field;
+        maxTime = std::max(maxTime, (double)(frame.*field));
+    }
+    double mean = frames.empty() ? 0.0 : total / frames.size();
+    out << "        \"" << phase << "\": { \"total\": " << total << ", \"mean\": " << mean << ", \"max\": " << maxTime << " }"
+        << (last ? "\n" : ",\n");
+}
+
+static void writeJson(ostream& out,
+                      const std::string& configFile,
+                      double loadTime,
+                      const TimingNotifier& notifier,
+                      const std::vector<PathResult>& paths) {
+    out << "{\n";
+    out << "  \"config\": \"" << configFile << "\",\n";
+    out << "  \"load\": {\n";
+    out << "    \"total\": " << loadTime;
+    for (const auto& stage : notifier.stages)
+        out << ",\n    \"" << stage.first << "\": " << stage.second;
+    out << "\n  },\n";
+    out << "  \"paths\": [\n";
+    for (size_t i = 0; i < paths.size(); i++) {
+        const auto& path = paths[i];
+        out << "    {\n";
+        out << "      \"name\": \"" << path.name << "\",\n";
+        out << "      \"frames\": " << path.frames.size() << ",\n";
+        out << "      \"phases\": {\n";
+        writePhase(out, "simulation", path.frames, &FrameStats::simulation);
+        writePhase(out, "preRender", path.frames, &FrameStats::preRender);
+        writePhase(out, "renderLists", path.frames, &FrameStats::renderLists);
+        writePhase(out, "labelLists", path.frames, &FrameStats::labelLists);
+        writePhase(out, "starCulling", path.frames, &FrameStats::starCulling);
+        writePhase(out, "dsoCulling", path.frames, &FrameStats::dsoCulling, true);
+        out << "      },\n";
+        double stars = 0.0, dsos = 0.0;
+        for (const auto& frame : path.frames) {
+            stars += frame.visibleStars;
+            dsos += frame.visibleDSOs;
+        }
+        size_t n = std::max<size_t>(1, path.frames.size());
+        out << "      \"meanVisibleStars\": " << stars / n << ",\n";
+        out << "      \"meanVisibleDSOs\": " << dsos / n << "\n";
+        out << "    }" << (i + 1 < paths.size() ? ",\n" : "\n");
+    }
+    out << "  ],\n";
+    out << "  \"zones\": [\n";
+    auto zones = Profiler::getZoneStatistics();
+    for (size_t i = 0; i < zones.size(); i++) {
+        const auto& zone = zones[i];
+        out << "    { \"name\": \"" << zone.name << "\", \"count\": " << zone.count << ", \"mean\": " << zone.mean
+            << ", \"p50\": " << zone.p50 << ", \"p99\": " << zone.p99 << ", \"max\": " << zone.max << " }"
+            << (i + 1 < zones.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n";
+    out << "}\n";
+}
+
+// Largest difference from the scalar kernel allowed in a position (km) or a
+// velocity (km/day). The longitude series are not reduced and grow to ~1e5
+// radians over 3000 years, so merely summing the terms in another order moves
+// the planets by a few meters.
+static const double VSOP87Tolerance = 0.1;
+
+static const char* const VSOP87BodyNames[] = { "mercury", "venus",   "earth",   "mars", "jupiter",
+                                               "saturn",  "uranus", "neptune", "sun" };
+
+// Time in milliseconds per evaluated body state
+struct VSOP87Timings {
+    double single{ 0.0 };
+    double batch{ 0.0 };
+    double allBodies{ 0.0 };
+};
+
+static VSOP87Timings timeVSOP87(const std::vector<double>& jds) {
+    const int bodyCount = (int)VSOP87Body::Count;
+    const double states = (double)jds.size() * bodyCount;
+    std::vector<Vector3d> positions(jds.size() * bodyCount);
+    VSOP87Timings timings;
+
+    auto start = Clock::now();
+    for (int body = 0; body < bodyCount; body++) {
+        for (size_t i = 0; i < jds.size(); i++)
+            ComputeVSOP87States((VSOP87Body)body, &jds[i], 1, &positions[i], nullptr);
+    }
+    timings.single = elapsedMs(start) / states;
+
+    start = Clock::now();
+    for (int body = 0; body < bodyCount; body++)
+        ComputeVSOP87States((VSOP87Body)body, jds.data(), jds.size(), &positions[body * jds.size()], nullptr);
+    timings.batch = elapsedMs(start) / states;
+
+    start = Clock::now();
+    for (size_t i = 0; i < jds.size(); i++)
+        ComputeVSOP87Positions(jds[i], &positions[i * bodyCount]);
+    timings.allBodies = elapsedMs(start) / states;
+
+    return timings;
+}
+
+static int runVSOP87Bench(ostream& out) {
+    const int bodyCount = (int)VSOP87Body::Count;
+    const size_t sampleCount = 4096;
+    std::vector<double> jds(sampleCount);
+    for (size_t i = 0; i < sampleCount; i++)
+        jds[i] = astro::J2000 + (2.0 * i / (sampleCount - 1) - 1.0) * 3000.0 * 365.25;
+
+    const VSOP87Kernel initialKernel = GetVSOP87Kernel();
+
+    // Scalar reference states of every body
+    SetVSOP87Kernel(VSOP87Kernel::Scalar);
+    std::vector<Vector3d> refPositions(sampleCount * bodyCount);
+    std::vector<Vector3d> refVelocities(sampleCount * bodyCount);
+    for (int body = 0; body < bodyCount; body++) {
+        ComputeVSOP87States((VSOP87Body)body, jds.data(), sampleCount, &refPositions[body * sampleCount],
+                            &refVelocities[body * sampleCount]);
+    }
+
+    bool passed = true;
+    out << "{\n";
+    out << "  \"samples\": " << sampleCount << ",\n";
+    out << "  \"years\": [-3000, 3000],\n";
+    out << "  \"kernels\": [\n";
+    const VSOP87Kernel kernels[] = { VSOP87Kernel::Scalar, VSOP87Kernel::SSE2, VSOP87Kernel::AVX2 };
+    bool first = true;
+    for (auto kernel : kernels) {
+        SetVSOP87Kernel(kernel);
+        if (GetVSOP87Kernel() != kernel)
+            continue;
+
+        out << (first ? "" : ",\n");
+        first = false;
+        out << "    {\n";
+        out << "      \"name\": \"" << GetVSOP87KernelName(kernel) << "\",\n";
+        out << "      \"maxError\": {\n";
+        std::vector<Vector3d> positions(sampleCount);
+        std::vector<Vector3d> velocities(sampleCount);
+        for (int body = 0; body < bodyCount; body++) {
+            ComputeVSOP87States((VSOP87Body)body, jds.data(), sampleCount, positions.data(), velocities.data());
+            double positionError = 0.0, velocityError = 0.0;
+            for (size_t i = 0; i < sampleCount; i++) {
+                positionError = std::max(positionError, (positions[i] - refPositions[body * sampleCount + i]).norm());
+                velocityError = std::max(velocityError, (velocities[i] - refVelocities[body * sampleCount + i]).norm());
+            }
+            if (positionError > VSOP87Tolerance || velocityError > VSOP87Tolerance) {
+                cerr << GetVSOP87KernelName(kernel) << " kernel differs from the scalar kernel for "
+                     << VSOP87BodyNames[body] << " by " << positionError << " km, " << velocityError << " km/day"
+                     << endl;
+                passed = false;
+            }
+            out << "        \"" << VSOP87BodyNames[body] << "\": { \"position\": " << positionError
+                << ", \"velocity\": " << velocityError << " }" << (body + 1 < bodyCount ? ",\n" : "\n");
+        }
+        out << "      },\n";
+
+        VSOP87Timings timings = timeVSOP87(jds);
+        out << "      \"msPerState\": { \"single\": " << timings.single << ", \"batch\": " << timings.batch
+            << ", \"allBodies\": " << timings.allBodies << " }\n";
+        out << "    }";
+    }
+    out << "\n  ]\n";
+    out << "}\n";
+
+    SetVSOP87Kernel(initialKernel);
+    return passed ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    std::string configFile = "celestia.cfg";
+    std::string target = "Sol/Earth";
+    std::string outputFile;
+    std::string traceFile;
+    std::vector<std::string> pathNames;
+    int frameCount = 600;
+    bool vsop87 = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--config" && hasValue) {
+            configFile = argv[++i];
+        } else if (arg == "--frames" && hasValue) {
+            frameCount = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--path" && hasValue) {
+            pathNames.push_back(argv[++i]);
+        } else if (arg == "--target" && hasValue) {
+            target = argv[++i];
+        } else if (arg == "--output" && hasValue) {
+            outputFile = argv[++i];
+        } else if (arg == "--trace" && hasValue) {
+            traceFile = argv[++i];
+        } else if (arg == "--vsop87") {
+            vsop87 = true;
+        } else {
+            cerr << "usage: celbench [--config FILE] [--frames N] [--path flythrough|goto|timeaccel]... "
+                    "[--target PATH] [--output FILE] [--trace FILE]"
+                 << endl;
+            cerr << "       celbench --vsop87 [--output FILE]" << endl;
+            return 1;
+        }
+    }
+
+    if (vsop87) {
+        if (outputFile.empty())
+            return runVSOP87Bench(cout);
+        ofstream out(outputFile);
+        if (!out.good()) {
+            cerr << "Error opening " << outputFile << endl;
+            return 1;
+        }
+        return runVSOP87Bench(out);
+    }
+    if (pathNames.empty())
+        pathNames = { "flythrough", "goto", "timeaccel" };
+
+    auto notifier = std::make_shared<TimingNotifier>();
+    auto core = std::make_shared<CelestiaCore>();
+    auto start = Clock::now();
+    if (!core->initSimulation(configFile, {}, notifier)) {
+        cerr << "Failed to load " << configFile << endl;
+        return 1;
+    }
+    double loadTime = elapsedMs(start);
+
+    auto renderer = std::make_shared<HeadlessRenderer>();
+    renderer->setRenderFlags(Renderer::DefaultRenderFlags | Renderer::ShowOrbits);
+    renderer->setLabelMode(Renderer::BodyLabelMask);
+    core->setRenderer(renderer);
+
+    // Only the camera paths are profiled; loading is covered by the stage
+    // timings, and would push the frames out of the ring buffers.
+    Profiler::setEnabled(true);
+    std::vector<PathResult> paths;
+    for (const auto& name : pathNames) {
+        if (name != "flythrough" && name != "goto" && name != "timeaccel") {
+            cerr << "Unknown path " << name << endl;
+            return 1;
+        }
+        paths.push_back(runPath(name, target, frameCount, core->getSimulation(), *renderer));
+    }
+    Profiler::setEnabled(false);
+
+    if (outputFile.empty()) {
+        writeJson(cout, configFile, loadTime, *notifier, paths);
+    } else {
+        ofstream out(outputFile);
+        if (!out.good()) {
+            cerr << "Error opening " << outputFile << endl;
+            return 1;
+        }
+        writeJson(out, configFile, loadTime, *notifier, paths);
+    }
+    if (!traceFile.empty()) {
+        ofstream trace(traceFile);
+        if (!trace.good() || !Profiler::writeChromeTrace(trace)) {
+            cerr << "Error writing " << traceFile << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
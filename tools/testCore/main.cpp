@@ -12,7 +12,8 @@
 #include <celapp/configfile.h>
 #include <celapp/destination.h>
 #include <celapp/celestiacore.h>
-#include <Windows.h>
+#include <chrono>
+#include <thread>
 
 using namespace std;
 
@@ -23,7 +24,7 @@ int main(int argc, char* argv[]) {
     std::cout << "Simulation Loaded" << std::endl;
 
     for (int i = 0; i < 100; ++i) {
-        Sleep(1000);
+        std::this_thread::sleep_for(std::chrono::seconds(1));
         core->tick();
     }
 
@@ -0,0 +1,82 @@
+// Converts an ASCII xyz or xyzv trajectory into the binary format that
+// Celestia maps directly. By default the output is written beside the input,
+// where it is picked up automatically in place of the text file.
+//
+// usage: trajconv [--single] <trajectory.xyz|trajectory.xyzv> [output]
+
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <celutil/filetype.h>
+#include <celephem/samporbit.h>
+
+using namespace std;
+using namespace Eigen;
+
+// Largest position difference between the text and binary trajectories,
+// probed between the samples
+static double compareOrbits(const Orbit& a, const Orbit& b) {
+    double begin = 0.0, end = 0.0;
+    a.getValidRange(begin, end);
+    const int probes = 1000;
+    double maxDiff = 0.0;
+    for (int i = 0; i <= probes; i++) {
+        double t = begin + (end - begin) * i / probes;
+        maxDiff = max(maxDiff, (a.positionAtTime(t) - b.positionAtTime(t)).norm());
+    }
+    return maxDiff;
+}
+
+int main(int argc, char* argv[]) {
+    TrajectoryPrecision precision = TrajectoryPrecisionDouble;
+    string source, destination;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--single")
+            precision = TrajectoryPrecisionSingle;
+        else if (source.empty())
+            source = arg;
+        else if (destination.empty())
+            destination = arg;
+        else
+            source.clear();
+    }
+    if (source.empty()) {
+        cerr << "usage: trajconv [--single] <trajectory.xyz|trajectory.xyzv> [output]" << endl;
+        return 1;
+    }
+    if (destination.empty())
+        destination = BinaryTrajectoryFilename(source);
+
+    ContentType type = DetermineFileType(source);
+    if (type != Content_CelestiaXYZTrajectory && type != Content_CelestiaXYZVTrajectory) {
+        cerr << source << " is not an xyz or xyzv trajectory" << endl;
+        return 1;
+    }
+    bool hasVelocities = type == Content_CelestiaXYZVTrajectory;
+
+    if (!ConvertTrajectoryToBinary(source, destination, hasVelocities, precision)) {
+        cerr << "Error converting " << source << endl;
+        return 1;
+    }
+
+    // Check the result against the text file
+    auto binary = LoadBinaryTrajectory(destination, TrajectoryInterpolationCubic);
+    Orbit::Pointer text;
+    if (hasVelocities) {
+        text = precision == TrajectoryPrecisionSingle ? LoadXYZVTrajectorySinglePrec(source, TrajectoryInterpolationCubic)
+                                                      : LoadXYZVTrajectoryDoublePrec(source, TrajectoryInterpolationCubic);
+    } else {
+        text = precision == TrajectoryPrecisionSingle ? LoadSampledTrajectorySinglePrec(source, TrajectoryInterpolationCubic)
+                                                      : LoadSampledTrajectoryDoublePrec(source, TrajectoryInterpolationCubic);
+    }
+    if (binary == nullptr || text == nullptr) {
+        cerr << "Error reading back " << destination << endl;
+        return 1;
+    }
+
+    double maxDiff = compareOrbits(*text, *binary);
+    cout << destination << ": max difference " << maxDiff << " km" << endl;
+    return maxDiff == 0.0 ? 0 : 1;
+}